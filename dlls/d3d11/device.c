@@ -225,6 +225,19 @@ struct deferred_call
     };
 };
 
+/* Deferred calls are carved out of large chunks, so that recording doesn't
+ * hit the process heap for every call and freeing a command list only has
+ * to release the references held by its calls. */
+#define DEFERRED_CHUNK_SIZE 0x10000
+
+struct deferred_chunk
+{
+    struct list entry;
+    SIZE_T size;
+    SIZE_T used;
+    BYTE data[1];
+};
+
 /* ID3D11CommandList - command list */
 struct d3d11_command_list
 {
@@ -233,6 +246,7 @@ struct d3d11_command_list
     LONG refcount;
 
     struct list commands;
+    struct list chunks;
 
     struct wined3d_private_store private_store;
 };
@@ -245,16 +259,34 @@ struct d3d11_deferred_context
     LONG refcount;
 
     struct list commands;
+    struct list chunks;
 
     struct wined3d_private_store private_store;
 };
 
 static struct deferred_call *add_deferred_call(struct d3d11_deferred_context *context, size_t extra_size)
 {
+    struct deferred_chunk *chunk = NULL;
     struct deferred_call *call;
+    SIZE_T size;
 
-    if (!(call = HeapAlloc(GetProcessHeap(), 0, sizeof(*call) + extra_size)))
-        return NULL;
+    size = (sizeof(*call) + extra_size + 15) & ~(SIZE_T)15;
+
+    if (!list_empty(&context->chunks))
+        chunk = LIST_ENTRY(list_tail(&context->chunks), struct deferred_chunk, entry);
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        SIZE_T chunk_size = max(size, DEFERRED_CHUNK_SIZE);
+
+        if (!(chunk = HeapAlloc(GetProcessHeap(), 0, FIELD_OFFSET(struct deferred_chunk, data[chunk_size]))))
+            return NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        list_add_tail(&context->chunks, &chunk->entry);
+    }
+
+    call = (struct deferred_call *)&chunk->data[chunk->used];
+    chunk->used += size;
 
     call->cmd = 0xdeadbeef;
     list_add_tail(&context->commands, &call->entry);
@@ -325,12 +357,13 @@ static void add_deferred_set_constant_buffers(struct d3d11_deferred_context *con
     }
 }
 
-static void free_deferred_calls(struct list *commands)
+static void free_deferred_calls(struct list *commands, struct list *chunks)
 {
-    struct deferred_call *call, *call2;
+    struct deferred_chunk *chunk, *chunk2;
+    struct deferred_call *call;
     int i;
 
-    LIST_FOR_EACH_ENTRY_SAFE(call, call2, commands, struct deferred_call, entry)
+    LIST_FOR_EACH_ENTRY(call, commands, struct deferred_call, entry)
     {
         switch (call->cmd)
         {
@@ -501,13 +534,20 @@ static void free_deferred_calls(struct list *commands)
                 break;
             }
         }
+    }
+    list_init(commands);
 
-        list_remove(&call->entry);
-        HeapFree(GetProcessHeap(), 0, call);
+    LIST_FOR_EACH_ENTRY_SAFE(chunk, chunk2, chunks, struct deferred_chunk, entry)
+    {
+        HeapFree(GetProcessHeap(), 0, chunk);
     }
+    list_init(chunks);
 }
 
-static void exec_deferred_calls(ID3D11DeviceContext *iface, struct list *commands)
+/* The caller holds the wined3d mutex. Draws and dispatches don't touch any
+ * d3d11 state, so they go straight to wined3d. */
+static void exec_deferred_calls(ID3D11DeviceContext *iface, struct wined3d_device *wined3d_device,
+        struct list *commands)
 {
     struct deferred_call *call;
 
@@ -654,20 +694,22 @@ static void exec_deferred_calls(ID3D11DeviceContext *iface, struct list *command
             }
             case DEFERRED_DRAW:
             {
-                ID3D11DeviceContext_Draw(iface, call->draw_info.count, call->draw_info.start);
+                wined3d_device_draw_primitive(wined3d_device, call->draw_info.start, call->draw_info.count);
                 break;
             }
             case DEFERRED_DRAWINDEXED:
             {
-                ID3D11DeviceContext_DrawIndexed(iface, call->draw_indexed_info.count,
-                        call->draw_indexed_info.start_index, call->draw_indexed_info.base_vertex);
+                wined3d_device_set_base_vertex_index(wined3d_device, call->draw_indexed_info.base_vertex);
+                wined3d_device_draw_indexed_primitive(wined3d_device, call->draw_indexed_info.start_index,
+                        call->draw_indexed_info.count);
                 break;
             }
             case DEFERRED_DRAWINDEXEDINSTANCED:
             {
-                ID3D11DeviceContext_DrawIndexedInstanced(iface, call->draw_indexed_inst_info.count_per_instance,
-                        call->draw_indexed_inst_info.instance_count, call->draw_indexed_inst_info.start_index,
-                        call->draw_indexed_inst_info.base_vertex, call->draw_indexed_inst_info.start_instance);
+                wined3d_device_set_base_vertex_index(wined3d_device, call->draw_indexed_inst_info.base_vertex);
+                wined3d_device_draw_indexed_primitive_instanced(wined3d_device,
+                        call->draw_indexed_inst_info.start_index, call->draw_indexed_inst_info.count_per_instance,
+                        call->draw_indexed_inst_info.start_instance, call->draw_indexed_inst_info.instance_count);
                 break;
             }
             case DEFERRED_MAP:
@@ -689,7 +731,7 @@ static void exec_deferred_calls(ID3D11DeviceContext *iface, struct list *command
             }
             case DEFERRED_DISPATCH:
             {
-                ID3D11DeviceContext_Dispatch(iface, call->dispatch_info.count_x,
+                wined3d_device_dispatch_compute(wined3d_device, call->dispatch_info.count_x,
                         call->dispatch_info.count_y, call->dispatch_info.count_z);
                 break;
             }
@@ -765,7 +807,7 @@ static ULONG STDMETHODCALLTYPE d3d11_command_list_Release(ID3D11CommandList *ifa
 
     if (!refcount)
     {
-        free_deferred_calls(&cmdlist->commands);
+        free_deferred_calls(&cmdlist->commands, &cmdlist->chunks);
         wined3d_private_store_cleanup(&cmdlist->private_store);
         HeapFree(GetProcessHeap(), 0, cmdlist);
     }
@@ -1960,6 +2002,7 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_ResolveSubresource(ID3D11D
 static void STDMETHODCALLTYPE d3d11_immediate_context_ExecuteCommandList(ID3D11DeviceContext *iface,
         ID3D11CommandList *command_list, BOOL restore_state)
 {
+    struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
     struct d3d11_command_list *cmdlist = unsafe_impl_from_ID3D11CommandList(command_list);
 
     TRACE("iface %p, command_list %p, restore_state %#x.\n", iface, command_list, restore_state);
@@ -1971,7 +2014,7 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_ExecuteCommandList(ID3D11D
         FIXME("restoring state not supported!\n");
 
     wined3d_mutex_lock();
-    exec_deferred_calls(iface, &cmdlist->commands);
+    exec_deferred_calls(iface, device->wined3d_device, &cmdlist->commands);
     ID3D11DeviceContext_ClearState(iface);
     wined3d_mutex_unlock();
 }
@@ -3537,7 +3580,7 @@ static ULONG STDMETHODCALLTYPE d3d11_deferred_context_Release(ID3D11DeviceContex
 
     if (!refcount)
     {
-        free_deferred_calls(&context->commands);
+        free_deferred_calls(&context->commands, &context->chunks);
         wined3d_private_store_cleanup(&context->private_store);
         ID3D11Device_Release(context->device);
         HeapFree(GetProcessHeap(), 0, context);
@@ -4713,6 +4756,8 @@ static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_FinishCommandList(ID3D11
 
     list_init(&object->commands);
     list_move_tail(&object->commands, &context->commands);
+    list_init(&object->chunks);
+    list_move_tail(&object->chunks, &context->chunks);
 
     ID3D11Device_AddRef(context->device);
     wined3d_private_store_init(&object->private_store);
@@ -5517,6 +5562,7 @@ static HRESULT STDMETHODCALLTYPE d3d11_device_CreateDeferredContext(ID3D11Device
     object->refcount = 1;
 
     list_init(&object->commands);
+    list_init(&object->chunks);
 
     ID3D11Device_AddRef(iface);
     wined3d_private_store_init(&object->private_store);
@@ -11313,6 +11313,103 @@ static void test_swapchain_flip(void)
     DestroyWindow(window);
 }
 
+static void test_deferred_context(void)
+{
+    static const float red[] = {1.0f, 0.0f, 0.0f, 1.0f};
+    static const float blue[] = {0.0f, 0.0f, 1.0f, 1.0f};
+    static const struct vec4 green = {0.0f, 1.0f, 0.0f, 1.0f};
+    static const struct vec4 white = {1.0f, 1.0f, 1.0f, 1.0f};
+    struct d3d11_test_context test_context;
+    ID3D11DeviceContext *context, *deferred;
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    ID3D11CommandList *command_list;
+    D3D11_BUFFER_DESC buffer_desc;
+    unsigned int stride, offset;
+    ID3D11Buffer *cb;
+    D3D11_VIEWPORT vp;
+    ID3D11Device *device;
+    unsigned int i;
+    HRESULT hr;
+
+    if (!init_test_context(&test_context, NULL))
+        return;
+
+    device = test_context.device;
+    context = test_context.immediate_context;
+
+    /* Create the default shaders and vertex buffer. */
+    draw_color_quad(&test_context, &white);
+    check_texture_color(test_context.backbuffer, 0xffffffff, 0);
+
+    hr = ID3D11Device_CreateDeferredContext(device, 0, &deferred);
+    ok(SUCCEEDED(hr), "Failed to create deferred context, hr %#x.\n", hr);
+
+    buffer_desc.ByteWidth = sizeof(green);
+    buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+    buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+    hr = ID3D11Device_CreateBuffer(device, &buffer_desc, NULL, &cb);
+    ok(SUCCEEDED(hr), "Failed to create constant buffer, hr %#x.\n", hr);
+
+    /* Record enough calls to need more than one allocation. */
+    for (i = 0; i < 4096; ++i)
+        ID3D11DeviceContext_ClearRenderTargetView(deferred, test_context.backbuffer_rtv, i & 1 ? red : blue);
+
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)cb, 0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+    ok(SUCCEEDED(hr), "Failed to map constant buffer, hr %#x.\n", hr);
+    memcpy(map_desc.pData, &green, sizeof(green));
+    ID3D11DeviceContext_Unmap(deferred, (ID3D11Resource *)cb, 0);
+
+    stride = sizeof(struct vec2);
+    offset = 0;
+    vp.TopLeftX = 0.0f;
+    vp.TopLeftY = 0.0f;
+    vp.Width = 640.0f;
+    vp.Height = 480.0f;
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    ID3D11DeviceContext_IASetInputLayout(deferred, test_context.input_layout);
+    ID3D11DeviceContext_IASetPrimitiveTopology(deferred, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    ID3D11DeviceContext_IASetVertexBuffers(deferred, 0, 1, &test_context.vb, &stride, &offset);
+    ID3D11DeviceContext_VSSetShader(deferred, test_context.vs, NULL, 0);
+    ID3D11DeviceContext_PSSetShader(deferred, test_context.ps, NULL, 0);
+    ID3D11DeviceContext_PSSetConstantBuffers(deferred, 0, 1, &cb);
+    ID3D11DeviceContext_OMSetRenderTargets(deferred, 1, &test_context.backbuffer_rtv, NULL);
+    ID3D11DeviceContext_RSSetViewports(deferred, 1, &vp);
+
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &command_list);
+    ok(SUCCEEDED(hr), "Failed to finish command list, hr %#x.\n", hr);
+
+    /* Nothing is executed before the command list is. */
+    check_texture_color(test_context.backbuffer, 0xffffffff, 0);
+    ID3D11DeviceContext_ExecuteCommandList(context, command_list, FALSE);
+    check_texture_color(test_context.backbuffer, 0xff0000ff, 0);
+
+    /* Recording can continue after FinishCommandList(). */
+    ID3D11DeviceContext_IASetInputLayout(deferred, test_context.input_layout);
+    ID3D11DeviceContext_IASetPrimitiveTopology(deferred, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    ID3D11DeviceContext_IASetVertexBuffers(deferred, 0, 1, &test_context.vb, &stride, &offset);
+    ID3D11DeviceContext_VSSetShader(deferred, test_context.vs, NULL, 0);
+    ID3D11DeviceContext_PSSetShader(deferred, test_context.ps, NULL, 0);
+    ID3D11DeviceContext_PSSetConstantBuffers(deferred, 0, 1, &cb);
+    ID3D11DeviceContext_OMSetRenderTargets(deferred, 1, &test_context.backbuffer_rtv, NULL);
+    ID3D11DeviceContext_RSSetViewports(deferred, 1, &vp);
+    ID3D11DeviceContext_Draw(deferred, 4, 0);
+    ID3D11CommandList_Release(command_list);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &command_list);
+    ok(SUCCEEDED(hr), "Failed to finish command list, hr %#x.\n", hr);
+
+    ID3D11DeviceContext_ExecuteCommandList(context, command_list, FALSE);
+    check_texture_color(test_context.backbuffer, 0xff00ff00, 0);
+
+    ID3D11CommandList_Release(command_list);
+    ID3D11DeviceContext_Release(deferred);
+    ID3D11Buffer_Release(cb);
+    release_test_context(&test_context);
+}
+
 static void test_clear_render_target_view(void)
 {
     static const DWORD expected_color = 0xbf4c7f19, expected_srgb_color = 0xbf95bc59;
@@ -21049,6 +21146,7 @@ START_TEST(d3d11)
     run_for_each_feature_level(test_swapchain_formats);
     test_swapchain_views();
     test_swapchain_flip();
+    test_deferred_context();
     test_clear_render_target_view();
     test_clear_depth_stencil_view();
     test_clear_buffer_unordered_access_view();
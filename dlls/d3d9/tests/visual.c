@@ -22636,6 +22636,198 @@ done:
     DestroyWindow(window);
 }
 
+static void test_draw_constant_updates(void)
+{
+    static const struct vec3 quad[] =
+    {
+        {-1.0f, -1.0f, 0.0f},
+        {-1.0f,  1.0f, 0.0f},
+        { 1.0f, -1.0f, 0.0f},
+        { 1.0f,  1.0f, 0.0f},
+    };
+    static const DWORD ps_code[] =
+    {
+        0xffff0200,                                         /* ps_2_0           */
+        0x03000002, 0x800f0000, 0xa0e40000, 0xa0e40001,     /* add r0, c0, c1   */
+        0x02000001, 0x800f0800, 0x80e40000,                 /* mov oC0, r0      */
+        0x0000ffff,                                         /* end              */
+    };
+    static const float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    static const float green[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+    IDirect3DTexture9 *textures[2];
+    IDirect3DDevice9 *device;
+    IDirect3DPixelShader9 *ps;
+    unsigned int i, draw_count;
+    IDirect3D9 *d3d;
+    float color[4];
+    D3DCOLOR pixel;
+    ULONG refcount;
+    D3DCAPS9 caps;
+    HWND window;
+    HRESULT hr;
+
+    window = create_window();
+    d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    ok(!!d3d, "Failed to create a D3D object.\n");
+    if (!(device = create_device(d3d, window, window, TRUE)))
+    {
+        skip("Failed to create a D3D device.\n");
+        IDirect3D9_Release(d3d);
+        DestroyWindow(window);
+        return;
+    }
+
+    hr = IDirect3DDevice9_GetDeviceCaps(device, &caps);
+    ok(SUCCEEDED(hr), "Failed to get device caps, hr %#x.\n", hr);
+    if (caps.PixelShaderVersion < D3DPS_VERSION(2, 0))
+    {
+        skip("No ps_2_0 support, skipping constant update test.\n");
+        goto done;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(textures); ++i)
+    {
+        hr = IDirect3DDevice9_CreateTexture(device, 4, 4, 1, 0, D3DFMT_A8R8G8B8,
+                D3DPOOL_MANAGED, &textures[i], NULL);
+        ok(SUCCEEDED(hr), "Failed to create texture, hr %#x.\n", hr);
+    }
+    hr = IDirect3DDevice9_CreatePixelShader(device, ps_code, &ps);
+    ok(SUCCEEDED(hr), "Failed to create pixel shader, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetPixelShader(device, ps);
+    ok(SUCCEEDED(hr), "Failed to set pixel shader, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ);
+    ok(SUCCEEDED(hr), "Failed to set FVF, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    ok(SUCCEEDED(hr), "Failed to disable lighting, hr %#x.\n", hr);
+
+    /* Only constants and textures change between draws, similar to what a
+     * lot of games do. The last draw determines the result. */
+    draw_count = 16;
+    hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xffff0000, 1.0f, 0);
+    ok(SUCCEEDED(hr), "Failed to clear, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_BeginScene(device);
+    ok(SUCCEEDED(hr), "Failed to begin scene, hr %#x.\n", hr);
+    for (i = 0; i < draw_count; ++i)
+    {
+        color[0] = (i % 7) / 7.0f;
+        color[1] = (i % 5) / 5.0f;
+        color[2] = (i % 3) / 3.0f;
+        color[3] = 1.0f;
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 0, i == draw_count - 1 ? green : color, 1);
+        ok(SUCCEEDED(hr), "Failed to set pixel shader constant, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 1, zero, 1);
+        ok(SUCCEEDED(hr), "Failed to set pixel shader constant, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetTexture(device, 0, (IDirect3DBaseTexture9 *)textures[i & 1]);
+        ok(SUCCEEDED(hr), "Failed to set texture, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad, sizeof(*quad));
+        ok(SUCCEEDED(hr), "Failed to draw, hr %#x.\n", hr);
+    }
+    hr = IDirect3DDevice9_EndScene(device);
+    ok(SUCCEEDED(hr), "Failed to end scene, hr %#x.\n", hr);
+    pixel = getPixelColor(device, 320, 240);
+    ok(color_match(pixel, 0x0000ff00, 1), "Got unexpected color 0x%08x.\n", pixel);
+
+    IDirect3DPixelShader9_Release(ps);
+    for (i = 0; i < ARRAY_SIZE(textures); ++i)
+        IDirect3DTexture9_Release(textures[i]);
+done:
+    refcount = IDirect3DDevice9_Release(device);
+    ok(!refcount, "Device has %u references left.\n", refcount);
+    IDirect3D9_Release(d3d);
+    DestroyWindow(window);
+}
+
+static void test_shader_cache_reload(void)
+{
+    static const struct vec3 quad[] =
+    {
+        {-1.0f, -1.0f, 0.0f},
+        {-1.0f,  1.0f, 0.0f},
+        { 1.0f, -1.0f, 0.0f},
+        { 1.0f,  1.0f, 0.0f},
+    };
+    static const DWORD ps_code[] =
+    {
+        0xffff0200,                                         /* ps_2_0           */
+        0x03000002, 0x800f0000, 0xa0e40000, 0xa0e40001,     /* add r0, c0, c1   */
+        0x02000001, 0x800f0800, 0x80e40000,                 /* mov oC0, r0      */
+        0x0000ffff,                                         /* end              */
+    };
+    static const float colors[][4] =
+    {
+        {0.0f, 1.0f, 0.0f, 1.0f},
+        {0.0f, 0.0f, 1.0f, 1.0f},
+    };
+    static const float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    static const D3DCOLOR expected[] = {0x0000ff00, 0x000000ff};
+    IDirect3DDevice9 *device;
+    IDirect3DPixelShader9 *ps;
+    IDirect3D9 *d3d;
+    D3DCOLOR color;
+    ULONG refcount;
+    D3DCAPS9 caps;
+    unsigned int i;
+    HWND window;
+    HRESULT hr;
+
+    /* When the shader cache is enabled, the second device loads the program
+     * binary stored by the first one instead of linking it again. */
+    for (i = 0; i < ARRAY_SIZE(colors); ++i)
+    {
+        window = create_window();
+        d3d = Direct3DCreate9(D3D_SDK_VERSION);
+        ok(!!d3d, "Failed to create a D3D object.\n");
+        if (!(device = create_device(d3d, window, window, TRUE)))
+        {
+            skip("Failed to create a D3D device.\n");
+            IDirect3D9_Release(d3d);
+            DestroyWindow(window);
+            return;
+        }
+
+        hr = IDirect3DDevice9_GetDeviceCaps(device, &caps);
+        ok(SUCCEEDED(hr), "Failed to get device caps, hr %#x.\n", hr);
+        if (caps.PixelShaderVersion < D3DPS_VERSION(2, 0))
+        {
+            skip("No ps_2_0 support, skipping shader cache test.\n");
+            IDirect3DDevice9_Release(device);
+            IDirect3D9_Release(d3d);
+            DestroyWindow(window);
+            return;
+        }
+
+        hr = IDirect3DDevice9_CreatePixelShader(device, ps_code, &ps);
+        ok(SUCCEEDED(hr), "Failed to create pixel shader, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetPixelShader(device, ps);
+        ok(SUCCEEDED(hr), "Failed to set pixel shader, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 0, colors[i], 1);
+        ok(SUCCEEDED(hr), "Failed to set pixel shader constant, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetPixelShaderConstantF(device, 1, zero, 1);
+        ok(SUCCEEDED(hr), "Failed to set pixel shader constant, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ);
+        ok(SUCCEEDED(hr), "Failed to set FVF, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+        ok(SUCCEEDED(hr), "Failed to disable lighting, hr %#x.\n", hr);
+
+        hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xffff0000, 1.0f, 0);
+        ok(SUCCEEDED(hr), "Failed to clear, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_BeginScene(device);
+        ok(SUCCEEDED(hr), "Failed to begin scene, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_DrawPrimitiveUP(device, D3DPT_TRIANGLESTRIP, 2, quad, sizeof(*quad));
+        ok(SUCCEEDED(hr), "Failed to draw, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_EndScene(device);
+        ok(SUCCEEDED(hr), "Failed to end scene, hr %#x.\n", hr);
+        color = getPixelColor(device, 320, 240);
+        ok(color_match(color, expected[i], 1), "Test %u: got unexpected color 0x%08x.\n", i, color);
+
+        IDirect3DPixelShader9_Release(ps);
+        refcount = IDirect3DDevice9_Release(device);
+        ok(!refcount, "Device has %u references left.\n", refcount);
+        IDirect3D9_Release(d3d);
+        DestroyWindow(window);
+    }
+}
+
 START_TEST(visual)
 {
     D3DADAPTER_IDENTIFIER9 identifier;
@@ -22766,4 +22958,6 @@ START_TEST(visual)
     test_backbuffer_resize();
     test_drawindexedprimitiveup();
     test_vertex_texture();
+    test_draw_constant_updates();
+    test_shader_cache_reload();
 }
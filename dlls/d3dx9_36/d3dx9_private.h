@@ -260,6 +260,7 @@ struct d3dx_regstore
 };
 
 struct d3dx_pres_ins;
+struct d3dx_pres_program;
 
 struct d3dx_preshader
 {
@@ -267,6 +268,7 @@ struct d3dx_preshader
 
     unsigned int ins_count;
     struct d3dx_pres_ins *ins;
+    struct d3dx_pres_program *program;
 
     struct d3dx_const_tab inputs;
 };
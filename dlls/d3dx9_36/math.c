@@ -27,6 +27,10 @@
 
 #include "d3dx9_private.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(d3dx);
 
 struct ID3DXMatrixStackImpl
@@ -41,6 +45,75 @@ struct ID3DXMatrixStackImpl
 
 static const unsigned int INITIAL_STACK_SIZE = 32;
 
+enum transform_type
+{
+    TRANSFORM_POINT,    /* w = 1 */
+    TRANSFORM_COORD,    /* w = 1, divide by the resulting w */
+    TRANSFORM_NORMAL,   /* w = 0 */
+    TRANSFORM_VEC4,     /* w from the input */
+};
+
+/* Transforms arrays of strided 3 or 4 component vectors by the rows of "m".
+ * The additions are done in the same order as the scalar functions, so the
+ * results match those of D3DXVec3Transform() and friends. */
+static void transform_array(void *out, UINT outstride, UINT out_components, const void *in, UINT instride,
+        const D3DXMATRIX *m, enum transform_type type, UINT elements)
+{
+    /* The SSE version is only built when the compiler targets SSE by default,
+     * which is the case on x86_64 but not with the default i386 flags. */
+#ifdef __SSE__
+    const __m128 r0 = _mm_loadu_ps(m->u.m[0]), r1 = _mm_loadu_ps(m->u.m[1]);
+    const __m128 r2 = _mm_loadu_ps(m->u.m[2]), r3 = _mm_loadu_ps(m->u.m[3]);
+    const BYTE *src = in;
+    BYTE *dst = out;
+    const float *v;
+    __m128 res;
+    UINT i;
+
+    for (i = 0; i < elements; ++i, src += instride, dst += outstride)
+    {
+        v = (const float *)src;
+        res = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(v[0])), _mm_mul_ps(r1, _mm_set1_ps(v[1]))),
+                _mm_mul_ps(r2, _mm_set1_ps(v[2])));
+        if (type == TRANSFORM_VEC4)
+            res = _mm_add_ps(res, _mm_mul_ps(r3, _mm_set1_ps(v[3])));
+        else if (type != TRANSFORM_NORMAL)
+            res = _mm_add_ps(res, r3);
+        if (type == TRANSFORM_COORD)
+            res = _mm_div_ps(res, _mm_shuffle_ps(res, res, _MM_SHUFFLE(3, 3, 3, 3)));
+
+        if (out_components == 4)
+        {
+            _mm_storeu_ps((float *)dst, res);
+        }
+        else
+        {
+            _mm_storel_pi((__m64 *)dst, res);
+            _mm_store_ss((float *)dst + 2, _mm_movehl_ps(res, res));
+        }
+    }
+#else
+    const BYTE *src = in;
+    BYTE *dst = out;
+    float v[4], res[4];
+    UINT i, j;
+
+    for (i = 0; i < elements; ++i, src += instride, dst += outstride)
+    {
+        memcpy(v, src, (type == TRANSFORM_VEC4 ? 4 : 3) * sizeof(*v));
+        v[3] = type == TRANSFORM_VEC4 ? v[3] : type == TRANSFORM_NORMAL ? 0.0f : 1.0f;
+        for (j = 0; j < 4; ++j)
+            res[j] = m->u.m[0][j] * v[0] + m->u.m[1][j] * v[1] + m->u.m[2][j] * v[2] + m->u.m[3][j] * v[3];
+        if (type == TRANSFORM_COORD)
+        {
+            for (j = 0; j < 3; ++j)
+                res[j] /= res[3];
+        }
+        memcpy(dst, res, out_components * sizeof(*res));
+    }
+#endif
+}
+
 /*_________________D3DXColor____________________*/
 
 D3DXCOLOR* WINAPI D3DXColorAdjustContrast(D3DXCOLOR *pout, const D3DXCOLOR *pc, FLOAT s)
@@ -393,17 +466,11 @@ D3DXMATRIX * WINAPI D3DXMatrixLookAtRH(D3DXMATRIX *out, const D3DXVECTOR3 *eye,
 D3DXMATRIX* WINAPI D3DXMatrixMultiply(D3DXMATRIX *pout, const D3DXMATRIX *pm1, const D3DXMATRIX *pm2)
 {
     D3DXMATRIX out;
-    int i,j;
 
     TRACE("pout %p, pm1 %p, pm2 %p\n", pout, pm1, pm2);
 
-    for (i=0; i<4; i++)
-    {
-        for (j=0; j<4; j++)
-        {
-            out.u.m[i][j] = pm1->u.m[i][0] * pm2->u.m[0][j] + pm1->u.m[i][1] * pm2->u.m[1][j] + pm1->u.m[i][2] * pm2->u.m[2][j] + pm1->u.m[i][3] * pm2->u.m[3][j];
-        }
-    }
+    /* Each row of the result is the corresponding row of pm1 transformed by pm2. */
+    transform_array(&out, sizeof(out.u.m[0]), 4, pm1, sizeof(pm1->u.m[0]), pm2, TRANSFORM_VEC4, 4);
 
     *pout = out;
     return pout;
@@ -1324,16 +1391,9 @@ D3DXPLANE* WINAPI D3DXPlaneTransform(D3DXPLANE *pout, const D3DXPLANE *pplane, c
 
 D3DXPLANE* WINAPI D3DXPlaneTransformArray(D3DXPLANE* out, UINT outstride, const D3DXPLANE* in, UINT instride, const D3DXMATRIX* matrix, UINT elements)
 {
-    UINT i;
-
     TRACE("out %p, outstride %u, in %p, instride %u, matrix %p, elements %u\n", out, outstride, in, instride, matrix, elements);
 
-    for (i = 0; i < elements; ++i) {
-        D3DXPlaneTransform(
-            (D3DXPLANE*)((char*)out + outstride * i),
-            (const D3DXPLANE*)((const char*)in + instride * i),
-            matrix);
-    }
+    transform_array(out, outstride, 4, in, instride, matrix, TRANSFORM_VEC4, elements);
     return out;
 }
 
@@ -1859,40 +1919,60 @@ D3DXVECTOR3* WINAPI D3DXVec3Normalize(D3DXVECTOR3 *pout, const D3DXVECTOR3 *pv)
     return pout;
 }
 
+static void vec3_project_matrix(D3DXMATRIX *m, const D3DXMATRIX *projection, const D3DXMATRIX *view,
+        const D3DXMATRIX *world)
+{
+    D3DXMatrixIdentity(m);
+    if (world) D3DXMatrixMultiply(m, m, world);
+    if (view) D3DXMatrixMultiply(m, m, view);
+    if (projection) D3DXMatrixMultiply(m, m, projection);
+}
+
+static void vec3_viewport_project(D3DXVECTOR3 *v, const D3DVIEWPORT9 *viewport)
+{
+    v->x = viewport->X +  ( 1.0f + v->x ) * viewport->Width / 2.0f;
+    v->y = viewport->Y +  ( 1.0f - v->y ) * viewport->Height / 2.0f;
+    v->z = viewport->MinZ + v->z * ( viewport->MaxZ - viewport->MinZ );
+}
+
+static void vec3_viewport_unproject(D3DXVECTOR3 *v, const D3DVIEWPORT9 *viewport)
+{
+    v->x = 2.0f * ( v->x - viewport->X ) / viewport->Width - 1.0f;
+    v->y = 1.0f - 2.0f * ( v->y - viewport->Y ) / viewport->Height;
+    v->z = ( v->z - viewport->MinZ) / ( viewport->MaxZ - viewport->MinZ );
+}
+
 D3DXVECTOR3* WINAPI D3DXVec3Project(D3DXVECTOR3 *pout, const D3DXVECTOR3 *pv, const D3DVIEWPORT9 *pviewport, const D3DXMATRIX *pprojection, const D3DXMATRIX *pview, const D3DXMATRIX *pworld)
 {
     D3DXMATRIX m;
 
     TRACE("pout %p, pv %p, pviewport %p, pprojection %p, pview %p, pworld %p\n", pout, pv, pviewport, pprojection, pview, pworld);
 
-    D3DXMatrixIdentity(&m);
-    if (pworld) D3DXMatrixMultiply(&m, &m, pworld);
-    if (pview) D3DXMatrixMultiply(&m, &m, pview);
-    if (pprojection) D3DXMatrixMultiply(&m, &m, pprojection);
+    vec3_project_matrix(&m, pprojection, pview, pworld);
 
     D3DXVec3TransformCoord(pout, pv, &m);
 
     if (pviewport)
-    {
-        pout->x = pviewport->X +  ( 1.0f + pout->x ) * pviewport->Width / 2.0f;
-        pout->y = pviewport->Y +  ( 1.0f - pout->y ) * pviewport->Height / 2.0f;
-        pout->z = pviewport->MinZ + pout->z * ( pviewport->MaxZ - pviewport->MinZ );
-    }
+        vec3_viewport_project(pout, pviewport);
     return pout;
 }
 
 D3DXVECTOR3* WINAPI D3DXVec3ProjectArray(D3DXVECTOR3* out, UINT outstride, const D3DXVECTOR3* in, UINT instride, const D3DVIEWPORT9* viewport, const D3DXMATRIX* projection, const D3DXMATRIX* view, const D3DXMATRIX* world, UINT elements)
 {
+    D3DXMATRIX m;
     UINT i;
 
     TRACE("out %p, outstride %u, in %p, instride %u, viewport %p, projection %p, view %p, world %p, elements %u\n",
         out, outstride, in, instride, viewport, projection, view, world, elements);
 
-    for (i = 0; i < elements; ++i) {
-        D3DXVec3Project(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (const D3DXVECTOR3*)((const char*)in + instride * i),
-            viewport, projection, view, world);
+    /* The combined matrix is the same for all elements. */
+    vec3_project_matrix(&m, projection, view, world);
+    transform_array(out, outstride, 3, in, instride, &m, TRANSFORM_COORD, elements);
+
+    if (viewport)
+    {
+        for (i = 0; i < elements; ++i)
+            vec3_viewport_project((D3DXVECTOR3 *)((char *)out + outstride * i), viewport);
     }
     return out;
 }
@@ -1913,16 +1993,9 @@ D3DXVECTOR4* WINAPI D3DXVec3Transform(D3DXVECTOR4 *pout, const D3DXVECTOR3 *pv,
 
 D3DXVECTOR4* WINAPI D3DXVec3TransformArray(D3DXVECTOR4* out, UINT outstride, const D3DXVECTOR3* in, UINT instride, const D3DXMATRIX* matrix, UINT elements)
 {
-    UINT i;
-
     TRACE("out %p, outstride %u, in %p, instride %u, matrix %p, elements %u\n", out, outstride, in, instride, matrix, elements);
 
-    for (i = 0; i < elements; ++i) {
-        D3DXVec3Transform(
-            (D3DXVECTOR4*)((char*)out + outstride * i),
-            (const D3DXVECTOR3*)((const char*)in + instride * i),
-            matrix);
-    }
+    transform_array(out, outstride, 4, in, instride, matrix, TRANSFORM_POINT, elements);
     return out;
 }
 
@@ -1946,16 +2019,9 @@ D3DXVECTOR3* WINAPI D3DXVec3TransformCoord(D3DXVECTOR3 *pout, const D3DXVECTOR3
 
 D3DXVECTOR3* WINAPI D3DXVec3TransformCoordArray(D3DXVECTOR3* out, UINT outstride, const D3DXVECTOR3* in, UINT instride, const D3DXMATRIX* matrix, UINT elements)
 {
-    UINT i;
-
     TRACE("out %p, outstride %u, in %p, instride %u, matrix %p, elements %u\n", out, outstride, in, instride, matrix, elements);
 
-    for (i = 0; i < elements; ++i) {
-        D3DXVec3TransformCoord(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (const D3DXVECTOR3*)((const char*)in + instride * i),
-            matrix);
-    }
+    transform_array(out, outstride, 3, in, instride, matrix, TRANSFORM_COORD, elements);
     return out;
 }
 
@@ -1974,16 +2040,9 @@ D3DXVECTOR3* WINAPI D3DXVec3TransformNormal(D3DXVECTOR3 *pout, const D3DXVECTOR3
 
 D3DXVECTOR3* WINAPI D3DXVec3TransformNormalArray(D3DXVECTOR3* out, UINT outstride, const D3DXVECTOR3* in, UINT instride, const D3DXMATRIX* matrix, UINT elements)
 {
-    UINT i;
-
     TRACE("out %p, outstride %u, in %p, instride %u, matrix %p, elements %u\n", out, outstride, in, instride, matrix, elements);
 
-    for (i = 0; i < elements; ++i) {
-        D3DXVec3TransformNormal(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (const D3DXVECTOR3*)((const char*)in + instride * i),
-            matrix);
-    }
+    transform_array(out, outstride, 3, in, instride, matrix, TRANSFORM_NORMAL, elements);
     return out;
 }
 
@@ -1993,35 +2052,35 @@ D3DXVECTOR3* WINAPI D3DXVec3Unproject(D3DXVECTOR3 *pout, const D3DXVECTOR3 *pv,
 
     TRACE("pout %p, pv %p, pviewport %p, pprojection %p, pview %p, pworlds %p\n", pout, pv, pviewport, pprojection, pview, pworld);
 
-    D3DXMatrixIdentity(&m);
-    if (pworld) D3DXMatrixMultiply(&m, &m, pworld);
-    if (pview) D3DXMatrixMultiply(&m, &m, pview);
-    if (pprojection) D3DXMatrixMultiply(&m, &m, pprojection);
+    vec3_project_matrix(&m, pprojection, pview, pworld);
     D3DXMatrixInverse(&m, NULL, &m);
 
     *pout = *pv;
     if (pviewport)
-    {
-        pout->x = 2.0f * ( pout->x - pviewport->X ) / pviewport->Width - 1.0f;
-        pout->y = 1.0f - 2.0f * ( pout->y - pviewport->Y ) / pviewport->Height;
-        pout->z = ( pout->z - pviewport->MinZ) / ( pviewport->MaxZ - pviewport->MinZ );
-    }
+        vec3_viewport_unproject(pout, pviewport);
     D3DXVec3TransformCoord(pout, pout, &m);
     return pout;
 }
 
 D3DXVECTOR3* WINAPI D3DXVec3UnprojectArray(D3DXVECTOR3* out, UINT outstride, const D3DXVECTOR3* in, UINT instride, const D3DVIEWPORT9* viewport, const D3DXMATRIX* projection, const D3DXMATRIX* view, const D3DXMATRIX* world, UINT elements)
 {
+    D3DXMATRIX m;
     UINT i;
 
     TRACE("out %p, outstride %u, in %p, instride %u, viewport %p, projection %p, view %p, world %p, elements %u\n",
         out, outstride, in, instride, viewport, projection, view, world, elements);
 
-    for (i = 0; i < elements; ++i) {
-        D3DXVec3Unproject(
-            (D3DXVECTOR3*)((char*)out + outstride * i),
-            (const D3DXVECTOR3*)((const char*)in + instride * i),
-            viewport, projection, view, world);
+    /* Only compute the inverse once. */
+    vec3_project_matrix(&m, projection, view, world);
+    D3DXMatrixInverse(&m, NULL, &m);
+
+    for (i = 0; i < elements; ++i)
+    {
+        D3DXVECTOR3 v = *(const D3DXVECTOR3 *)((const char *)in + instride * i);
+
+        if (viewport)
+            vec3_viewport_unproject(&v, viewport);
+        transform_array((char *)out + outstride * i, 0, 3, &v, 0, &m, TRANSFORM_COORD, 1);
     }
     return out;
 }
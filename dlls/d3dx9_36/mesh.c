@@ -62,8 +62,20 @@ struct d3dx9_mesh
     int attrib_buffer_lock_count;
     DWORD attrib_table_size;
     D3DXATTRIBUTERANGE *attrib_table;
+
+    /* Ray intersection acceleration structure, built on demand by
+     * D3DXIntersect() and dropped whenever the geometry may change. */
+    struct mesh_bvh *bvh;
 };
 
+static void mesh_bvh_destroy(struct mesh_bvh *bvh);
+
+static void d3dx9_mesh_invalidate_bvh(struct d3dx9_mesh *mesh)
+{
+    mesh_bvh_destroy(mesh->bvh);
+    mesh->bvh = NULL;
+}
+
 static const UINT d3dx_decltype_size[] =
 {
    /* D3DDECLTYPE_FLOAT1    */ sizeof(FLOAT),
@@ -134,6 +146,7 @@ static ULONG WINAPI d3dx9_mesh_Release(ID3DXMesh *iface)
         IDirect3DDevice9_Release(mesh->device);
         HeapFree(GetProcessHeap(), 0, mesh->attrib_buffer);
         HeapFree(GetProcessHeap(), 0, mesh->attrib_table);
+        mesh_bvh_destroy(mesh->bvh);
         HeapFree(GetProcessHeap(), 0, mesh);
     }
 
@@ -780,6 +793,8 @@ static HRESULT WINAPI d3dx9_mesh_GetVertexBuffer(struct ID3DXMesh *iface,
 
     if (!vertex_buffer)
         return D3DERR_INVALIDCALL;
+    /* The application may write to the buffer behind our back. */
+    d3dx9_mesh_invalidate_bvh(mesh);
     *vertex_buffer = mesh->vertex_buffer;
     IDirect3DVertexBuffer9_AddRef(mesh->vertex_buffer);
 
@@ -795,6 +810,7 @@ static HRESULT WINAPI d3dx9_mesh_GetIndexBuffer(struct ID3DXMesh *iface,
 
     if (!index_buffer)
         return D3DERR_INVALIDCALL;
+    d3dx9_mesh_invalidate_bvh(mesh);
     *index_buffer = mesh->index_buffer;
     IDirect3DIndexBuffer9_AddRef(mesh->index_buffer);
 
@@ -807,6 +823,9 @@ static HRESULT WINAPI d3dx9_mesh_LockVertexBuffer(ID3DXMesh *iface, DWORD flags,
 
     TRACE("iface %p, flags %#x, data %p.\n", iface, flags, data);
 
+    if (!(flags & D3DLOCK_READONLY))
+        d3dx9_mesh_invalidate_bvh(mesh);
+
     return IDirect3DVertexBuffer9_Lock(mesh->vertex_buffer, 0, 0, data, flags);
 }
 
@@ -816,6 +835,9 @@ static HRESULT WINAPI d3dx9_mesh_UnlockVertexBuffer(ID3DXMesh *iface)
 
     TRACE("iface %p.\n", iface);
 
+    /* A tree built while the buffer was locked for writing may be stale. */
+    d3dx9_mesh_invalidate_bvh(mesh);
+
     return IDirect3DVertexBuffer9_Unlock(mesh->vertex_buffer);
 }
 
@@ -825,6 +847,9 @@ static HRESULT WINAPI d3dx9_mesh_LockIndexBuffer(ID3DXMesh *iface, DWORD flags,
 
     TRACE("iface %p, flags %#x, data %p.\n", iface, flags, data);
 
+    if (!(flags & D3DLOCK_READONLY))
+        d3dx9_mesh_invalidate_bvh(mesh);
+
     return IDirect3DIndexBuffer9_Lock(mesh->index_buffer, 0, 0, data, flags);
 }
 
@@ -834,6 +859,8 @@ static HRESULT WINAPI d3dx9_mesh_UnlockIndexBuffer(ID3DXMesh *iface)
 
     TRACE("iface %p.\n", iface);
 
+    d3dx9_mesh_invalidate_bvh(mesh);
+
     return IDirect3DIndexBuffer9_Unlock(mesh->index_buffer);
 }
 
@@ -1221,6 +1248,132 @@ static int compare_vertex_keys(const void *a, const void *b)
     return left->key < right->key ? -1 : 1;
 }
 
+static int compare_dwords(const void *a, const void *b)
+{
+    DWORD left = *(const DWORD *)a;
+    DWORD right = *(const DWORD *)b;
+
+    if (left == right)
+        return 0;
+    return left < right ? -1 : 1;
+}
+
+/* Uniform grid hashed on the cell coordinates, used to find the vertices
+ * within epsilon of each other without scanning runs of vertices that merely
+ * share the same x + y + z. With epsilon == 0 the "cell" is the exact
+ * position. */
+struct vertex_grid
+{
+    float epsilon;
+    DWORD mask;
+    DWORD *heads;
+    DWORD *next;
+    int (*cells)[3];
+};
+
+static void vertex_grid_cell(const struct vertex_grid *grid, const D3DXVECTOR3 *v, int cell[3])
+{
+    const float *coords = &v->x;
+    unsigned int i;
+
+    for (i = 0; i < 3; ++i)
+    {
+        if (grid->epsilon == 0.0f)
+        {
+            /* Adding 0.0f folds -0.0f into 0.0f, they compare equal. */
+            float f = coords[i] + 0.0f;
+            memcpy(&cell[i], &f, sizeof(f));
+        }
+        else
+        {
+            double c = floor(coords[i] / grid->epsilon);
+
+            /* Far away cells get merged, which only costs a few more
+             * comparisons. NaN ends up in cell 0 and never matches. */
+            if (c > (double)(1 << 30))
+                cell[i] = 1 << 30;
+            else if (c < -(double)(1 << 30))
+                cell[i] = -(1 << 30);
+            else if (c == c)
+                cell[i] = (int)c;
+            else
+                cell[i] = 0;
+        }
+    }
+}
+
+static DWORD vertex_grid_hash(const struct vertex_grid *grid, const int cell[3])
+{
+    return ((DWORD)cell[0] * 73856093u ^ (DWORD)cell[1] * 19349663u ^ (DWORD)cell[2] * 83492791u) & grid->mask;
+}
+
+static HRESULT vertex_grid_init(struct vertex_grid *grid, float epsilon, DWORD count)
+{
+    DWORD size = 1;
+
+    while (size < count && size < 0x80000000u)
+        size <<= 1;
+
+    grid->epsilon = epsilon;
+    grid->mask = size - 1;
+    grid->heads = HeapAlloc(GetProcessHeap(), 0, size * sizeof(*grid->heads));
+    grid->next = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*grid->next));
+    grid->cells = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*grid->cells));
+    if (!grid->heads || !grid->next || !grid->cells)
+        return E_OUTOFMEMORY;
+    memset(grid->heads, 0xff, size * sizeof(*grid->heads));
+
+    return D3D_OK;
+}
+
+static void vertex_grid_cleanup(struct vertex_grid *grid)
+{
+    HeapFree(GetProcessHeap(), 0, grid->heads);
+    HeapFree(GetProcessHeap(), 0, grid->next);
+    HeapFree(GetProcessHeap(), 0, grid->cells);
+}
+
+static void vertex_grid_insert(struct vertex_grid *grid, DWORD id, const D3DXVECTOR3 *v)
+{
+    DWORD bucket;
+
+    vertex_grid_cell(grid, v, grid->cells[id]);
+    bucket = vertex_grid_hash(grid, grid->cells[id]);
+    grid->next[id] = grid->heads[bucket];
+    grid->heads[bucket] = id;
+}
+
+/* Collects the ids of the entries in the cells around "id". */
+static DWORD vertex_grid_query(const struct vertex_grid *grid, DWORD id, DWORD *out)
+{
+    int range = grid->epsilon == 0.0f ? 0 : 1;
+    DWORD count = 0, entry;
+    int cell[3];
+    int x, y, z;
+
+    for (z = -range; z <= range; ++z)
+    {
+        for (y = -range; y <= range; ++y)
+        {
+            for (x = -range; x <= range; ++x)
+            {
+                cell[0] = grid->cells[id][0] + x;
+                cell[1] = grid->cells[id][1] + y;
+                cell[2] = grid->cells[id][2] + z;
+
+                for (entry = grid->heads[vertex_grid_hash(grid, cell)]; entry != ~0u; entry = grid->next[entry])
+                {
+                    if (grid->cells[entry][0] == cell[0] && grid->cells[entry][1] == cell[1]
+                            && grid->cells[entry][2] == cell[2])
+                        out[count++] = entry;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
 static HRESULT WINAPI d3dx9_mesh_GenerateAdjacency(ID3DXMesh *iface, float epsilon, DWORD *adjacency)
 {
     struct d3dx9_mesh *This = impl_from_ID3DXMesh(iface);
@@ -1234,6 +1387,9 @@ static HRESULT WINAPI d3dx9_mesh_GenerateAdjacency(ID3DXMesh *iface, float epsil
     /* shared_indices links together identical indices in the index buffer so
      * that adjacency checks can be limited to faces sharing a vertex */
     DWORD *shared_indices = NULL;
+    /* coincident vertices of the one being processed, as sorted positions */
+    DWORD *coincident = NULL;
+    struct vertex_grid grid = {0};
     const FLOAT epsilon_sq = epsilon * epsilon;
     DWORD i;
 
@@ -1242,12 +1398,26 @@ static HRESULT WINAPI d3dx9_mesh_GenerateAdjacency(ID3DXMesh *iface, float epsil
     if (!adjacency)
         return D3DERR_INVALIDCALL;
 
+    if (epsilon >= 0.0f)
+    {
+        if (FAILED(hr = vertex_grid_init(&grid, epsilon, This->numvertices)))
+            goto cleanup;
+        if (!(coincident = HeapAlloc(GetProcessHeap(), 0, This->numvertices * sizeof(*coincident))))
+        {
+            hr = E_OUTOFMEMORY;
+            goto cleanup;
+        }
+    }
+
     buffer_size = This->numfaces * 3 * sizeof(*shared_indices) + This->numvertices * sizeof(*sorted_vertices);
     if (!(This->options & D3DXMESH_32BIT))
         buffer_size += This->numfaces * 3 * sizeof(*indices);
     shared_indices = HeapAlloc(GetProcessHeap(), 0, buffer_size);
     if (!shared_indices)
-        return E_OUTOFMEMORY;
+    {
+        hr = E_OUTOFMEMORY;
+        goto cleanup;
+    }
     sorted_vertices = (struct vertex_metadata*)(shared_indices + This->numfaces * 3);
 
     hr = iface->lpVtbl->LockVertexBuffer(iface, D3DLOCK_READONLY, (void**)&vertices);
@@ -1278,15 +1448,44 @@ static HRESULT WINAPI d3dx9_mesh_GenerateAdjacency(ID3DXMesh *iface, float epsil
     }
     qsort(sorted_vertices, This->numvertices, sizeof(*sorted_vertices), compare_vertex_keys);
 
+    if (coincident)
+    {
+        for (i = 0; i < This->numvertices; i++)
+            vertex_grid_insert(&grid, i, (D3DXVECTOR3*)(vertices + sorted_vertices[i].vertex_index * vertex_size));
+    }
+
     for (i = 0; i < This->numvertices; i++) {
         struct vertex_metadata *sorted_vertex_a = &sorted_vertices[i];
         D3DXVECTOR3 *vertex_a = (D3DXVECTOR3*)(vertices + sorted_vertex_a->vertex_index * vertex_size);
         DWORD shared_index_a = sorted_vertex_a->first_shared_index;
+        DWORD coincident_count = 0;
+
+        if (coincident && shared_index_a != -1)
+        {
+            DWORD candidate_count = vertex_grid_query(&grid, i, coincident);
+            DWORD j;
+
+            /* Keep the vertices after this one in sort order within the
+             * epsilon box, the others have been or will be paired from their
+             * own side. */
+            for (j = 0; j < candidate_count; j++) {
+                struct vertex_metadata *candidate = &sorted_vertices[coincident[j]];
+                D3DXVECTOR3 *vertex_b = (D3DXVECTOR3*)(vertices + candidate->vertex_index * vertex_size);
+
+                if (coincident[j] > i && candidate->key - sorted_vertex_a->key <= epsilon * 3.0f
+                        && fabsf(vertex_a->x - vertex_b->x) <= epsilon
+                        && fabsf(vertex_a->y - vertex_b->y) <= epsilon
+                        && fabsf(vertex_a->z - vertex_b->z) <= epsilon)
+                    coincident[coincident_count++] = coincident[j];
+            }
+            if (coincident_count > 1)
+                qsort(coincident, coincident_count, sizeof(*coincident), compare_dwords);
+        }
 
         while (shared_index_a != -1) {
-            DWORD j = i;
+            DWORD j = 0;
             DWORD shared_index_b = shared_indices[shared_index_a];
-            struct vertex_metadata *sorted_vertex_b = sorted_vertex_a;
+            struct vertex_metadata *sorted_vertex_b;
 
             while (TRUE) {
                 while (shared_index_b != -1) {
@@ -1331,26 +1530,9 @@ static HRESULT WINAPI d3dx9_mesh_GenerateAdjacency(ID3DXMesh *iface, float epsil
 
                     shared_index_b = shared_indices[shared_index_b];
                 }
-                while (++j < This->numvertices) {
-                    D3DXVECTOR3 *vertex_b;
-
-                    sorted_vertex_b++;
-                    if (sorted_vertex_b->key - sorted_vertex_a->key > epsilon * 3.0f) {
-                        /* no more coincident vertices to try */
-                        j = This->numvertices;
-                        break;
-                    }
-                    /* check for coincidence */
-                    vertex_b = (D3DXVECTOR3*)(vertices + sorted_vertex_b->vertex_index * vertex_size);
-                    if (fabsf(vertex_a->x - vertex_b->x) <= epsilon &&
-                        fabsf(vertex_a->y - vertex_b->y) <= epsilon &&
-                        fabsf(vertex_a->z - vertex_b->z) <= epsilon)
-                    {
-                        break;
-                    }
-                }
-                if (j >= This->numvertices)
+                if (j >= coincident_count)
                     break;
+                sorted_vertex_b = &sorted_vertices[coincident[j++]];
                 shared_index_b = sorted_vertex_b->first_shared_index;
             }
 
@@ -1364,6 +1546,8 @@ cleanup:
     if (indices) iface->lpVtbl->UnlockIndexBuffer(iface);
     if (vertices) iface->lpVtbl->UnlockVertexBuffer(iface);
     HeapFree(GetProcessHeap(), 0, shared_indices);
+    HeapFree(GetProcessHeap(), 0, coincident);
+    vertex_grid_cleanup(&grid);
     return hr;
 }
 
@@ -1402,6 +1586,7 @@ static HRESULT WINAPI d3dx9_mesh_UpdateSemantics(ID3DXMesh *iface, D3DVERTEXELEM
 
     This->num_elem = i + 1;
     copy_declaration(This->cached_declaration, declaration, This->num_elem);
+    d3dx9_mesh_invalidate_bvh(This);
 
     if (This->vertex_declaration)
         IDirect3DVertexDeclaration9_Release(This->vertex_declaration);
@@ -1640,6 +1825,281 @@ static HRESULT remap_faces_for_attrsort(struct d3dx9_mesh *This, const DWORD *in
     return D3D_OK;
 }
 
+/* Vertex cache optimization, following Tom Forsyth's "Linear-Speed Vertex
+ * Cache Optimisation". Faces are greedily emitted by the score of their
+ * vertices, which favours vertices recently used (still in the simulated LRU
+ * cache) and vertices with few faces left to draw. */
+#define VCACHE_SIZE 32
+#define VCACHE_VALENCE_TABLE_SIZE 32
+
+struct vcache_vertex
+{
+    float score;
+    DWORD first_face;
+    DWORD face_count;
+    int cache_pos;
+};
+
+struct vcache_scores
+{
+    float cache[VCACHE_SIZE];
+    float valence[VCACHE_VALENCE_TABLE_SIZE];
+};
+
+static void vcache_init_scores(struct vcache_scores *scores)
+{
+    unsigned int i;
+
+    for (i = 0; i < VCACHE_SIZE; ++i)
+    {
+        /* The vertices of the last face get a fixed score, so the optimizer
+         * doesn't prefer a face sharing the exact same edge. */
+        if (i < 3)
+            scores->cache[i] = 0.75f;
+        else
+            scores->cache[i] = powf(1.0f - (float)(i - 3) / (VCACHE_SIZE - 3), 1.5f);
+    }
+    for (i = 0; i < VCACHE_VALENCE_TABLE_SIZE; ++i)
+        scores->valence[i] = i ? 2.0f / sqrtf(i) : 0.0f;
+}
+
+static float vcache_vertex_score(const struct vcache_scores *scores, const struct vcache_vertex *vertex)
+{
+    float score;
+
+    if (!vertex->face_count)
+        return -1.0f;
+
+    score = vertex->cache_pos >= 0 ? scores->cache[vertex->cache_pos] : 0.0f;
+    if (vertex->face_count < VCACHE_VALENCE_TABLE_SIZE)
+        return score + scores->valence[vertex->face_count];
+    return score + 2.0f / sqrtf(vertex->face_count);
+}
+
+/* Fills face_order with the faces in drawing order. */
+static HRESULT optimize_faces_for_vertex_cache(const DWORD *indices, DWORD num_faces,
+        DWORD num_vertices, DWORD *face_order)
+{
+    DWORD cache[VCACHE_SIZE + 3], new_cache[VCACHE_SIZE + 3];
+    DWORD cache_size = 0, new_cache_size;
+    struct vcache_vertex *vertices;
+    struct vcache_scores scores;
+    DWORD *vertex_faces;
+    DWORD next_face = 0;
+    DWORD best_face;
+    DWORD i, j, k;
+    BYTE *emitted;
+
+    for (i = 0; i < num_faces * 3; ++i)
+    {
+        if (indices[i] >= num_vertices)
+        {
+            WARN("Index %u of face %u is out of range.\n", indices[i], i / 3);
+            return D3DERR_INVALIDCALL;
+        }
+    }
+
+    vertices = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, num_vertices * sizeof(*vertices));
+    vertex_faces = HeapAlloc(GetProcessHeap(), 0, num_faces * 3 * sizeof(*vertex_faces));
+    emitted = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, num_faces * sizeof(*emitted));
+    if (!vertices || !vertex_faces || !emitted)
+    {
+        HeapFree(GetProcessHeap(), 0, vertices);
+        HeapFree(GetProcessHeap(), 0, vertex_faces);
+        HeapFree(GetProcessHeap(), 0, emitted);
+        return E_OUTOFMEMORY;
+    }
+
+    vcache_init_scores(&scores);
+
+    /* Build the per-vertex face lists. The first face_count entries of each
+     * list are the faces not emitted yet. */
+    for (i = 0; i < num_faces * 3; ++i)
+        ++vertices[indices[i]].face_count;
+    for (i = 0, j = 0; i < num_vertices; ++i)
+    {
+        vertices[i].first_face = j;
+        j += vertices[i].face_count;
+        vertices[i].face_count = 0;
+        vertices[i].cache_pos = -1;
+    }
+    for (i = 0; i < num_faces * 3; ++i)
+    {
+        struct vcache_vertex *vertex = &vertices[indices[i]];
+        vertex_faces[vertex->first_face + vertex->face_count++] = i / 3;
+    }
+    for (i = 0; i < num_vertices; ++i)
+        vertices[i].score = vcache_vertex_score(&scores, &vertices[i]);
+
+    best_face = num_faces ? 0 : ~0u;
+    for (i = 0; i < num_faces; ++i)
+    {
+        const DWORD *face = &indices[best_face * 3];
+        float best_score;
+
+        face_order[i] = best_face;
+        emitted[best_face] = 1;
+
+        /* Drop the face from the lists of its vertices and move them to the
+         * front of the cache. */
+        new_cache_size = 0;
+        for (j = 0; j < 3; ++j)
+        {
+            struct vcache_vertex *vertex = &vertices[face[j]];
+            DWORD *faces = &vertex_faces[vertex->first_face];
+
+            for (k = 0; k < vertex->face_count; ++k)
+            {
+                if (faces[k] == best_face)
+                {
+                    faces[k] = faces[--vertex->face_count];
+                    break;
+                }
+            }
+
+            for (k = 0; k < new_cache_size; ++k)
+            {
+                if (new_cache[k] == face[j])
+                    break;
+            }
+            if (k == new_cache_size)
+                new_cache[new_cache_size++] = face[j];
+        }
+        for (j = 0; j < cache_size; ++j)
+        {
+            DWORD v = cache[j];
+
+            if (v == face[0] || v == face[1] || v == face[2])
+                continue;
+            if (new_cache_size < VCACHE_SIZE)
+            {
+                new_cache[new_cache_size++] = v;
+            }
+            else
+            {
+                /* Falling out of the cache. */
+                vertices[v].cache_pos = -1;
+                vertices[v].score = vcache_vertex_score(&scores, &vertices[v]);
+            }
+        }
+
+        memcpy(cache, new_cache, new_cache_size * sizeof(*cache));
+        cache_size = new_cache_size;
+        for (j = 0; j < cache_size; ++j)
+        {
+            vertices[cache[j]].cache_pos = j;
+            vertices[cache[j]].score = vcache_vertex_score(&scores, &vertices[cache[j]]);
+        }
+
+        /* Only the faces touching the cache are candidates, score them and
+         * pick the best one. */
+        best_face = ~0u;
+        best_score = -1.0f;
+        for (j = 0; j < cache_size; ++j)
+        {
+            const struct vcache_vertex *vertex = &vertices[cache[j]];
+
+            for (k = 0; k < vertex->face_count; ++k)
+            {
+                DWORD face_idx = vertex_faces[vertex->first_face + k];
+                const DWORD *f = &indices[face_idx * 3];
+                float score = vertices[f[0]].score + vertices[f[1]].score + vertices[f[2]].score;
+
+                if (score > best_score || (score == best_score && face_idx < best_face))
+                {
+                    best_face = face_idx;
+                    best_score = score;
+                }
+            }
+        }
+
+        if (best_face == ~0u)
+        {
+            /* Nothing left around the cache, continue with the next face in
+             * the original order. This keeps the whole thing linear. */
+            while (next_face < num_faces && emitted[next_face])
+                ++next_face;
+            best_face = next_face;
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, vertices);
+    HeapFree(GetProcessHeap(), 0, vertex_faces);
+    HeapFree(GetProcessHeap(), 0, emitted);
+
+    return D3D_OK;
+}
+
+/* Reorder the faces of each attribute range of an attribute sorted mesh for
+ * the vertex cache, updating face_remap accordingly. */
+static HRESULT remap_faces_for_vertex_cache(struct d3dx9_mesh *This, const DWORD *indices,
+        const DWORD *sorted_attrib_buffer, DWORD *face_remap)
+{
+    DWORD *sorted_indices, *range_indices, *vertex_map, *face_order, *new_position;
+    DWORD start, end, range_vertices, i;
+    HRESULT hr = D3D_OK;
+
+    sorted_indices = HeapAlloc(GetProcessHeap(), 0, This->numfaces * 3 * sizeof(*sorted_indices));
+    range_indices = HeapAlloc(GetProcessHeap(), 0, This->numfaces * 3 * sizeof(*range_indices));
+    vertex_map = HeapAlloc(GetProcessHeap(), 0, This->numvertices * sizeof(*vertex_map));
+    face_order = HeapAlloc(GetProcessHeap(), 0, This->numfaces * sizeof(*face_order));
+    new_position = HeapAlloc(GetProcessHeap(), 0, This->numfaces * sizeof(*new_position));
+    if (!sorted_indices || !range_indices || !vertex_map || !face_order || !new_position)
+    {
+        hr = E_OUTOFMEMORY;
+        goto cleanup;
+    }
+    memset(vertex_map, 0xff, This->numvertices * sizeof(*vertex_map));
+
+    for (i = 0; i < This->numfaces; i++)
+        memcpy(&sorted_indices[face_remap[i] * 3], &indices[i * 3], 3 * sizeof(*indices));
+
+    for (start = 0; start < This->numfaces; start = end)
+    {
+        for (end = start + 1; end < This->numfaces; end++)
+        {
+            if (sorted_attrib_buffer[end] != sorted_attrib_buffer[start])
+                break;
+        }
+
+        /* Number the vertices used by the range from 0, so that the work
+         * done for each range doesn't depend on the size of the whole mesh. */
+        range_vertices = 0;
+        for (i = start * 3; i < end * 3; i++)
+        {
+            DWORD vertex = sorted_indices[i];
+
+            if (vertex >= This->numvertices)
+            {
+                WARN("Index %u of face %u is out of range.\n", vertex, i / 3);
+                hr = D3DERR_INVALIDCALL;
+                goto cleanup;
+            }
+            if (vertex_map[vertex] == ~0u)
+                vertex_map[vertex] = range_vertices++;
+            range_indices[i - start * 3] = vertex_map[vertex];
+        }
+        for (i = start * 3; i < end * 3; i++)
+            vertex_map[sorted_indices[i]] = ~0u;
+
+        hr = optimize_faces_for_vertex_cache(range_indices, end - start, range_vertices, face_order);
+        if (FAILED(hr)) goto cleanup;
+        for (i = 0; i < end - start; i++)
+            new_position[start + face_order[i]] = start + i;
+    }
+
+    for (i = 0; i < This->numfaces; i++)
+        face_remap[i] = new_position[face_remap[i]];
+
+cleanup:
+    HeapFree(GetProcessHeap(), 0, sorted_indices);
+    HeapFree(GetProcessHeap(), 0, range_indices);
+    HeapFree(GetProcessHeap(), 0, vertex_map);
+    HeapFree(GetProcessHeap(), 0, face_order);
+    HeapFree(GetProcessHeap(), 0, new_position);
+    return hr;
+}
+
 static HRESULT WINAPI d3dx9_mesh_OptimizeInplace(ID3DXMesh *iface, DWORD flags, const DWORD *adjacency_in,
         DWORD *adjacency_out, DWORD *face_remap_out, ID3DXBuffer **vertex_remap_out)
 {
@@ -1666,14 +2126,14 @@ static HRESULT WINAPI d3dx9_mesh_OptimizeInplace(ID3DXMesh *iface, DWORD flags,
     if ((flags & (D3DXMESHOPT_VERTEXCACHE | D3DXMESHOPT_STRIPREORDER)) == (D3DXMESHOPT_VERTEXCACHE | D3DXMESHOPT_STRIPREORDER))
         return D3DERR_INVALIDCALL;
 
-    if (flags & (D3DXMESHOPT_VERTEXCACHE | D3DXMESHOPT_STRIPREORDER))
+    if (flags & D3DXMESHOPT_STRIPREORDER)
     {
-        if (flags & D3DXMESHOPT_VERTEXCACHE)
-            FIXME("D3DXMESHOPT_VERTEXCACHE not implemented.\n");
-        if (flags & D3DXMESHOPT_STRIPREORDER)
-            FIXME("D3DXMESHOPT_STRIPREORDER not implemented.\n");
+        FIXME("D3DXMESHOPT_STRIPREORDER not implemented.\n");
         return E_NOTIMPL;
     }
+    /* The vertex cache optimization works within attribute ranges. */
+    if (flags & D3DXMESHOPT_VERTEXCACHE)
+        flags |= D3DXMESHOPT_ATTRSORT;
 
     hr = iface->lpVtbl->LockIndexBuffer(iface, 0, &indices);
     if (FAILED(hr)) goto cleanup;
@@ -1702,6 +2162,12 @@ static HRESULT WINAPI d3dx9_mesh_OptimizeInplace(ID3DXMesh *iface, DWORD flags,
 
         hr = remap_faces_for_attrsort(This, dword_indices, attrib_buffer, &sorted_attrib_buffer, &face_remap);
         if (FAILED(hr)) goto cleanup;
+
+        if (flags & D3DXMESHOPT_VERTEXCACHE)
+        {
+            hr = remap_faces_for_vertex_cache(This, dword_indices, sorted_attrib_buffer, face_remap);
+            if (FAILED(hr)) goto cleanup;
+        }
     }
 
     if (vertex_remap)
@@ -7209,20 +7675,17 @@ cleanup:
  *   Success: D3D_OK.
  *   Failure: D3DERR_INVALIDCALL.
  *
- * BUGS
- *   The face re-ordering does not use the vertex cache optimally.
- *
  */
 HRESULT WINAPI D3DXOptimizeFaces(const void *indices, UINT num_faces,
         UINT num_vertices, BOOL indices_are_32bit, DWORD *face_remap)
 {
     UINT i;
-    UINT j = num_faces - 1;
     UINT limit_16_bit = 2 << 15; /* According to MSDN */
+    DWORD *dword_indices = NULL;
+    DWORD *face_order;
     HRESULT hr = D3D_OK;
 
-    FIXME("indices %p, num_faces %u, num_vertices %u, indices_are_32bit %#x, face_remap %p semi-stub. "
-            "Face order will not be optimal.\n",
+    TRACE("indices %p, num_faces %u, num_vertices %u, indices_are_32bit %#x, face_remap %p.\n",
             indices, num_faces, num_vertices, indices_are_32bit, face_remap);
 
     if (!indices_are_32bit && num_faces >= limit_16_bit)
@@ -7240,21 +7703,35 @@ HRESULT WINAPI D3DXOptimizeFaces(const void *indices, UINT num_faces,
         goto error;
     }
 
-    /* The faces are drawn in reverse order for simple meshes. This ordering
-     * is not optimal for complicated meshes, but will not break anything
-     * either. The ordering should be changed to take advantage of the vertex
-     * cache on the graphics card.
-     *
-     * TODO Re-order to take advantage of vertex cache.
-     */
-    for (i = 0; i < num_faces; i++)
+    if (!indices_are_32bit)
     {
-        face_remap[i] = j--;
+        const WORD *word_indices = indices;
+
+        if (!(dword_indices = HeapAlloc(GetProcessHeap(), 0, num_faces * 3 * sizeof(*dword_indices))))
+            return E_OUTOFMEMORY;
+        for (i = 0; i < num_faces * 3; i++)
+            dword_indices[i] = word_indices[i];
+        indices = dword_indices;
     }
 
-    return D3D_OK;
+    if (!(face_order = HeapAlloc(GetProcessHeap(), 0, num_faces * sizeof(*face_order))))
+    {
+        hr = E_OUTOFMEMORY;
+        goto error;
+    }
+
+    if (SUCCEEDED(hr = optimize_faces_for_vertex_cache(indices, num_faces, num_vertices, face_order)))
+    {
+        /* Native returns the faces of simple meshes in reverse order, walk
+         * the optimized sequence back to front to match. The cache behaves
+         * about the same either way. */
+        for (i = 0; i < num_faces; i++)
+            face_remap[i] = face_order[num_faces - 1 - i];
+    }
 
+    HeapFree(GetProcessHeap(), 0, face_order);
 error:
+    HeapFree(GetProcessHeap(), 0, dword_indices);
     return hr;
 }
 
@@ -7565,16 +8042,384 @@ HRESULT WINAPI D3DXComputeNormalMap(IDirect3DTexture9 *texture, IDirect3DTexture
     return D3D_OK;
 }
 
+/* Bounding volume hierarchy over the faces of a mesh, used by D3DXIntersect().
+ * Inner nodes have their left child right after them and store the index of
+ * the right one in "start". Leaves have a non-zero face count and store the
+ * index of their first face in "faces". The face positions are copied in
+ * leaf order, so traversals don't need to lock the mesh. */
+#define MESH_BVH_LEAF_SIZE 4
+
+struct mesh_bvh_node
+{
+    D3DXVECTOR3 min, max;
+    DWORD start;
+    DWORD count;
+};
+
+struct mesh_bvh
+{
+    struct mesh_bvh_node *nodes;
+    DWORD node_count;
+    DWORD *faces;
+    D3DXVECTOR3 *positions;
+};
+
+struct mesh_bvh_ref
+{
+    D3DXVECTOR3 centroid;
+    DWORD face;
+};
+
+static void mesh_bvh_destroy(struct mesh_bvh *bvh)
+{
+    if (!bvh)
+        return;
+    HeapFree(GetProcessHeap(), 0, bvh->nodes);
+    HeapFree(GetProcessHeap(), 0, bvh->faces);
+    HeapFree(GetProcessHeap(), 0, bvh->positions);
+    HeapFree(GetProcessHeap(), 0, bvh);
+}
+
+static int mesh_bvh_compare_x(const void *a, const void *b)
+{
+    float left = ((const struct mesh_bvh_ref *)a)->centroid.x;
+    float right = ((const struct mesh_bvh_ref *)b)->centroid.x;
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static int mesh_bvh_compare_y(const void *a, const void *b)
+{
+    float left = ((const struct mesh_bvh_ref *)a)->centroid.y;
+    float right = ((const struct mesh_bvh_ref *)b)->centroid.y;
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static int mesh_bvh_compare_z(const void *a, const void *b)
+{
+    float left = ((const struct mesh_bvh_ref *)a)->centroid.z;
+    float right = ((const struct mesh_bvh_ref *)b)->centroid.z;
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static void mesh_bvh_build_node(struct mesh_bvh *bvh, const D3DXVECTOR3 *positions,
+        struct mesh_bvh_ref *refs, DWORD start, DWORD count)
+{
+    static int (* const compare[])(const void *, const void *) =
+    {
+        mesh_bvh_compare_x, mesh_bvh_compare_y, mesh_bvh_compare_z,
+    };
+    DWORD node_idx = bvh->node_count++;
+    struct mesh_bvh_node *node = &bvh->nodes[node_idx];
+    D3DXVECTOR3 cmin, cmax, extent;
+    float epsilon;
+    DWORD i, j, half;
+    unsigned int axis;
+
+    node->min.x = node->min.y = node->min.z = FLT_MAX;
+    node->max.x = node->max.y = node->max.z = -FLT_MAX;
+    cmin = node->min;
+    cmax = node->max;
+    for (i = start; i < start + count; ++i)
+    {
+        for (j = 0; j < 3; ++j)
+        {
+            D3DXVec3Minimize(&node->min, &node->min, &positions[refs[i].face * 3 + j]);
+            D3DXVec3Maximize(&node->max, &node->max, &positions[refs[i].face * 3 + j]);
+        }
+        D3DXVec3Minimize(&cmin, &cmin, &refs[i].centroid);
+        D3DXVec3Maximize(&cmax, &cmax, &refs[i].centroid);
+    }
+    /* D3DXIntersectTri() may accept hits slightly outside the face, grow
+     * the box a bit so they aren't culled. */
+    epsilon = max(max(fabsf(node->min.x), fabsf(node->max.x)), max(fabsf(node->min.y), fabsf(node->max.y)));
+    epsilon = max(epsilon, max(fabsf(node->min.z), fabsf(node->max.z))) * 1e-5f + 1e-30f;
+    node->min.x -= epsilon; node->min.y -= epsilon; node->min.z -= epsilon;
+    node->max.x += epsilon; node->max.y += epsilon; node->max.z += epsilon;
+
+    if (count <= MESH_BVH_LEAF_SIZE)
+    {
+        node->start = start;
+        node->count = count;
+        return;
+    }
+
+    /* Median split along the longest axis of the centroids. */
+    D3DXVec3Subtract(&extent, &cmax, &cmin);
+    axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    qsort(&refs[start], count, sizeof(*refs), compare[axis]);
+
+    half = count / 2;
+    node->count = 0;
+    mesh_bvh_build_node(bvh, positions, refs, start, half);
+    /* The node array was allocated up front, "node" is still valid. */
+    node->start = bvh->node_count;
+    mesh_bvh_build_node(bvh, positions, refs, start + half, count - half);
+}
+
+static HRESULT mesh_bvh_create(ID3DXBaseMesh *mesh, struct mesh_bvh **out)
+{
+    DWORD num_faces = mesh->lpVtbl->GetNumFaces(mesh);
+    DWORD num_vertices = mesh->lpVtbl->GetNumVertices(mesh);
+    BOOL indices_are_32bit = mesh->lpVtbl->GetOptions(mesh) & D3DXMESH_32BIT;
+    DWORD vertex_size = mesh->lpVtbl->GetNumBytesPerVertex(mesh);
+    D3DXVECTOR3 *positions = NULL;
+    struct mesh_bvh_ref *refs = NULL;
+    struct mesh_bvh *bvh;
+    const BYTE *vertices = NULL;
+    const void *indices = NULL;
+    HRESULT hr;
+    DWORD i, j;
+
+    if (!(bvh = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*bvh))))
+        return E_OUTOFMEMORY;
+
+    /* A binary tree with at least one face per leaf. */
+    bvh->nodes = HeapAlloc(GetProcessHeap(), 0, max(2 * num_faces, 1) * sizeof(*bvh->nodes));
+    bvh->faces = HeapAlloc(GetProcessHeap(), 0, max(num_faces, 1) * sizeof(*bvh->faces));
+    bvh->positions = HeapAlloc(GetProcessHeap(), 0, max(num_faces, 1) * 3 * sizeof(*bvh->positions));
+    positions = HeapAlloc(GetProcessHeap(), 0, max(num_faces, 1) * 3 * sizeof(*positions));
+    refs = HeapAlloc(GetProcessHeap(), 0, max(num_faces, 1) * sizeof(*refs));
+    if (!bvh->nodes || !bvh->faces || !bvh->positions || !positions || !refs)
+    {
+        hr = E_OUTOFMEMORY;
+        goto cleanup;
+    }
+
+    hr = mesh->lpVtbl->LockVertexBuffer(mesh, D3DLOCK_READONLY, (void **)&vertices);
+    if (FAILED(hr)) goto cleanup;
+    hr = mesh->lpVtbl->LockIndexBuffer(mesh, D3DLOCK_READONLY, (void **)&indices);
+    if (FAILED(hr)) goto cleanup;
+
+    for (i = 0; i < num_faces; ++i)
+    {
+        for (j = 0; j < 3; ++j)
+        {
+            DWORD index = indices_are_32bit ? ((const DWORD *)indices)[i * 3 + j]
+                    : ((const WORD *)indices)[i * 3 + j];
+
+            if (index >= num_vertices)
+            {
+                WARN("Index %u of face %u is out of range.\n", index, i);
+                hr = D3DERR_INVALIDCALL;
+                goto cleanup;
+            }
+            positions[i * 3 + j] = *(const D3DXVECTOR3 *)(vertices + index * vertex_size);
+        }
+        D3DXVec3Add(&refs[i].centroid, &positions[i * 3], &positions[i * 3 + 1]);
+        D3DXVec3Add(&refs[i].centroid, &refs[i].centroid, &positions[i * 3 + 2]);
+        D3DXVec3Scale(&refs[i].centroid, &refs[i].centroid, 1.0f / 3.0f);
+        refs[i].face = i;
+    }
+
+    if (num_faces)
+        mesh_bvh_build_node(bvh, positions, refs, 0, num_faces);
+    for (i = 0; i < num_faces; ++i)
+    {
+        bvh->faces[i] = refs[i].face;
+        memcpy(&bvh->positions[i * 3], &positions[refs[i].face * 3], 3 * sizeof(*positions));
+    }
+
+    *out = bvh;
+    bvh = NULL;
+    hr = D3D_OK;
+
+cleanup:
+    if (indices) mesh->lpVtbl->UnlockIndexBuffer(mesh);
+    if (vertices) mesh->lpVtbl->UnlockVertexBuffer(mesh);
+    HeapFree(GetProcessHeap(), 0, positions);
+    HeapFree(GetProcessHeap(), 0, refs);
+    mesh_bvh_destroy(bvh);
+    return hr;
+}
+
+/* Returns the distance at which the ray enters the box, or -1.0f if it
+ * misses it. */
+static float mesh_bvh_ray_box(const struct mesh_bvh_node *node, const D3DXVECTOR3 *ray_pos,
+        const D3DXVECTOR3 *ray_dir)
+{
+    const float *box_min = &node->min.x, *box_max = &node->max.x;
+    const float *pos = &ray_pos->x, *dir = &ray_dir->x;
+    float t_near = 0.0f, t_far = FLT_MAX;
+    unsigned int i;
+
+    for (i = 0; i < 3; ++i)
+    {
+        float t0, t1;
+
+        if (dir[i] == 0.0f)
+        {
+            if (pos[i] < box_min[i] || pos[i] > box_max[i])
+                return -1.0f;
+            continue;
+        }
+        t0 = (box_min[i] - pos[i]) / dir[i];
+        t1 = (box_max[i] - pos[i]) / dir[i];
+        if (t0 > t1)
+        {
+            float t = t0;
+            t0 = t1;
+            t1 = t;
+        }
+        if (t0 > t_near)
+            t_near = t0;
+        if (t1 < t_far)
+            t_far = t1;
+        if (t_near > t_far)
+            return -1.0f;
+    }
+
+    return t_near;
+}
+
+struct mesh_hits
+{
+    D3DXINTERSECTINFO *hits;
+    DWORD count;
+    DWORD size;
+};
+
+static int compare_intersect_info(const void *a, const void *b)
+{
+    DWORD left = ((const D3DXINTERSECTINFO *)a)->FaceIndex;
+    DWORD right = ((const D3DXINTERSECTINFO *)b)->FaceIndex;
+
+    if (left == right)
+        return 0;
+    return left < right ? -1 : 1;
+}
+
+/* Finds the closest hit, and all of them if "hits" is not NULL. Ties go to
+ * the lowest face index, like a linear walk over the faces would. */
+static HRESULT mesh_bvh_intersect(const struct mesh_bvh *bvh, const D3DXVECTOR3 *ray_pos,
+        const D3DXVECTOR3 *ray_dir, D3DXINTERSECTINFO *closest, struct mesh_hits *hits)
+{
+    DWORD stack[64];
+    unsigned int stack_size = 0;
+    DWORD i;
+
+    closest->FaceIndex = ~0u;
+    closest->Dist = FLT_MAX;
+    if (!bvh->node_count)
+        return D3D_OK;
+
+    stack[stack_size++] = 0;
+    while (stack_size)
+    {
+        const struct mesh_bvh_node *node = &bvh->nodes[stack[--stack_size]];
+        float t = mesh_bvh_ray_box(node, ray_pos, ray_dir);
+
+        if (t < 0.0f || (!hits && t > closest->Dist))
+            continue;
+
+        if (node->count)
+        {
+            for (i = node->start; i < node->start + node->count; ++i)
+            {
+                const D3DXVECTOR3 *p = &bvh->positions[i * 3];
+                D3DXINTERSECTINFO info;
+
+                if (!D3DXIntersectTri(&p[0], &p[1], &p[2], ray_pos, ray_dir, &info.U, &info.V, &info.Dist))
+                    continue;
+                info.FaceIndex = bvh->faces[i];
+
+                if (info.Dist < closest->Dist || (info.Dist == closest->Dist && info.FaceIndex < closest->FaceIndex))
+                    *closest = info;
+
+                if (hits)
+                {
+                    if (hits->count == hits->size)
+                    {
+                        DWORD new_size = max(hits->size * 2, 16);
+                        D3DXINTERSECTINFO *new_hits;
+
+                        if (hits->hits)
+                            new_hits = HeapReAlloc(GetProcessHeap(), 0, hits->hits, new_size * sizeof(*new_hits));
+                        else
+                            new_hits = HeapAlloc(GetProcessHeap(), 0, new_size * sizeof(*new_hits));
+                        if (!new_hits)
+                            return E_OUTOFMEMORY;
+                        hits->hits = new_hits;
+                        hits->size = new_size;
+                    }
+                    hits->hits[hits->count++] = info;
+                }
+            }
+        }
+        else
+        {
+            /* The tree is balanced, the stack can't overflow. */
+            stack[stack_size++] = node->start;
+            stack[stack_size++] = node - bvh->nodes + 1;
+        }
+    }
+
+    return D3D_OK;
+}
+
 /*************************************************************************
  * D3DXIntersect    (D3DX9_36.@)
  */
 HRESULT WINAPI D3DXIntersect(ID3DXBaseMesh *mesh, const D3DXVECTOR3 *ray_pos, const D3DXVECTOR3 *ray_dir,
         BOOL *hit, DWORD *face_index, float *u, float *v, float *distance, ID3DXBuffer **all_hits, DWORD *count_of_hits)
 {
-    FIXME("mesh %p, ray_pos %p, ray_dir %p, hit %p, face_index %p, u %p, v %p, distance %p, all_hits %p, "
-            "count_of_hits %p stub!\n", mesh, ray_pos, ray_dir, hit, face_index, u, v, distance, all_hits, count_of_hits);
+    struct mesh_hits hits = {NULL, 0, 0};
+    struct d3dx9_mesh *d3dx_mesh = NULL;
+    struct mesh_bvh *bvh = NULL;
+    D3DXINTERSECTINFO closest;
+    HRESULT hr;
 
-    return E_NOTIMPL;
+    TRACE("mesh %p, ray_pos %p, ray_dir %p, hit %p, face_index %p, u %p, v %p, distance %p, all_hits %p, "
+            "count_of_hits %p.\n", mesh, ray_pos, ray_dir, hit, face_index, u, v, distance, all_hits, count_of_hits);
+
+    if (!mesh || !ray_pos || !ray_dir)
+        return D3DERR_INVALIDCALL;
+
+    /* Our own meshes keep the tree around until their geometry changes. */
+    if (mesh->lpVtbl == (const void *)&D3DXMesh_Vtbl)
+    {
+        d3dx_mesh = impl_from_ID3DXMesh((ID3DXMesh *)mesh);
+        bvh = d3dx_mesh->bvh;
+    }
+    if (!bvh)
+    {
+        if (FAILED(hr = mesh_bvh_create(mesh, &bvh)))
+            return hr;
+        if (d3dx_mesh)
+            d3dx_mesh->bvh = bvh;
+    }
+
+    hr = mesh_bvh_intersect(bvh, ray_pos, ray_dir, &closest, all_hits || count_of_hits ? &hits : NULL);
+    if (FAILED(hr))
+        goto done;
+
+    if (hit)
+        *hit = closest.FaceIndex != ~0u;
+    if (closest.FaceIndex != ~0u)
+    {
+        if (face_index) *face_index = closest.FaceIndex;
+        if (u) *u = closest.U;
+        if (v) *v = closest.V;
+        if (distance) *distance = closest.Dist;
+    }
+    if (count_of_hits)
+        *count_of_hits = hits.count;
+    if (all_hits)
+    {
+        *all_hits = NULL;
+        if (hits.count)
+        {
+            if (FAILED(hr = D3DXCreateBuffer(hits.count * sizeof(*hits.hits), all_hits)))
+                goto done;
+            qsort(hits.hits, hits.count, sizeof(*hits.hits), compare_intersect_info);
+            memcpy(ID3DXBuffer_GetBufferPointer(*all_hits), hits.hits, hits.count * sizeof(*hits.hits));
+        }
+    }
+
+done:
+    HeapFree(GetProcessHeap(), 0, hits.hits);
+    if (!d3dx_mesh)
+        mesh_bvh_destroy(bvh);
+    return hr;
 }
 
 HRESULT WINAPI D3DXTessellateNPatches(ID3DXMesh *mesh, const DWORD *adjacency_in, float num_segs,
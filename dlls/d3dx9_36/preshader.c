@@ -23,6 +23,9 @@
 
 #include <float.h>
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3dx);
 
@@ -305,6 +308,7 @@ static unsigned int get_reg_components(unsigned int table)
 #define PRES_BITMASK_BLOCK_SIZE (sizeof(unsigned int) * 8)
 
 static HRESULT init_set_constants(struct d3dx_const_tab *const_tab, ID3DXConstantTable *ctab);
+static HRESULT compile_preshader(struct d3dx_preshader *pres);
 
 static HRESULT regstore_alloc_table(struct d3dx_regstore *rs, unsigned int table)
 {
@@ -970,6 +974,9 @@ void d3dx_create_param_eval(struct d3dx9_base_effect *base_effect, void *byte_co
             goto err_out;
     }
 
+    if (FAILED(compile_preshader(&peval->pres)))
+        goto err_out;
+
     if (TRACE_ON(d3dx))
     {
         dump_bytecode(byte_code, byte_code_size);
@@ -997,8 +1004,11 @@ static void d3dx_free_const_tab(struct d3dx_const_tab *ctab)
     HeapFree(GetProcessHeap(), 0, ctab->const_set);
 }
 
+static void free_preshader_program(struct d3dx_pres_program *program);
+
 static void d3dx_free_preshader(struct d3dx_preshader *pres)
 {
+    free_preshader_program(pres->program);
     HeapFree(GetProcessHeap(), 0, pres->ins);
 
     regstore_free_tables(&pres->regs);
@@ -1522,47 +1532,452 @@ static void exec_set_arg(struct d3dx_regstore *rs, const struct d3dx_pres_reg *r
 }
 
 #define ARGS_ARRAY_SIZE 8
-static HRESULT execute_preshader(struct d3dx_preshader *pres)
+static HRESULT exec_ins_interpreted(struct d3dx_preshader *pres, const struct d3dx_pres_ins *ins)
 {
-    unsigned int i, j, k;
+    const struct op_info *oi = &pres_op_info[ins->op];
     double args[ARGS_ARRAY_SIZE];
+    unsigned int j, k;
     double res;
 
-    for (i = 0; i < pres->ins_count; ++i)
+    if (oi->func_all_comps)
     {
-        const struct d3dx_pres_ins *ins;
-        const struct op_info *oi;
+        if (oi->input_count * ins->component_count > ARGS_ARRAY_SIZE)
+        {
+            FIXME("Too many arguments (%u) for one instruction.\n", oi->input_count * ins->component_count);
+            return E_FAIL;
+        }
+        for (k = 0; k < oi->input_count; ++k)
+            for (j = 0; j < ins->component_count; ++j)
+                args[k * ins->component_count + j] = exec_get_arg(&pres->regs, &ins->inputs[k],
+                        ins->scalar_op && !k ? 0 : j);
+        res = oi->func(args, ins->component_count);
 
-        ins = &pres->ins[i];
-        oi = &pres_op_info[ins->op];
-        if (oi->func_all_comps)
+        /* only 'dot' instruction currently falls here */
+        exec_set_arg(&pres->regs, &ins->output.reg, 0, res);
+    }
+    else
+    {
+        for (j = 0; j < ins->component_count; ++j)
         {
-            if (oi->input_count * ins->component_count > ARGS_ARRAY_SIZE)
-            {
-                FIXME("Too many arguments (%u) for one instruction.\n", oi->input_count * ins->component_count);
-                return E_FAIL;
-            }
             for (k = 0; k < oi->input_count; ++k)
-                for (j = 0; j < ins->component_count; ++j)
-                    args[k * ins->component_count + j] = exec_get_arg(&pres->regs, &ins->inputs[k],
-                            ins->scalar_op && !k ? 0 : j);
+                args[k] = exec_get_arg(&pres->regs, &ins->inputs[k], ins->scalar_op && !k ? 0 : j);
             res = oi->func(args, ins->component_count);
+            exec_set_arg(&pres->regs, &ins->output.reg, j, res);
+        }
+    }
+    return D3D_OK;
+}
+
+/* Preshaders are translated once into a program with all the operand
+ * addressing resolved to pointers, which is then run over all the components
+ * of an instruction at once. Arithmetic is still done in double precision,
+ * so the results match the interpreter.
+ *
+ * When the program reads the temporary registers only after writing them and
+ * doesn't use relative addressing, each instruction gets its own storage for
+ * temporary results. It is then enough to run the instructions depending on
+ * the inputs which actually changed. */
+struct d3dx_pres_vm_operand
+{
+    const void *comp[4];
+    BOOL is_double;
+};
+
+struct d3dx_pres_vm_ins
+{
+    enum pres_ops op;
+    unsigned int component_count;
+    /* Instructions we can't translate go through exec_get_arg(). */
+    const struct d3dx_pres_ins *interpreted;
+    struct d3dx_pres_vm_operand inputs[MAX_INPUTS_COUNT];
+    void *output;
+    enum pres_value_type output_type;
+    unsigned int output_count;
+    /* Set when writing to the temporary registers table. */
+    BOOL output_temp_table;
+    unsigned int output_offset;
+    const unsigned int *deps;
+};
 
-            /* only 'dot' instruction currently falls here */
-            exec_set_arg(&pres->regs, &ins->output.reg, 0, res);
+struct d3dx_pres_program
+{
+    struct d3dx_pres_vm_ins *ins;
+    float *temps;
+    unsigned int *deps;
+    unsigned int *dirty;
+    unsigned int deps_size;
+    BOOL partial;
+    BOOL evaluated;
+};
+
+static void free_preshader_program(struct d3dx_pres_program *program)
+{
+    if (!program)
+        return;
+
+    HeapFree(GetProcessHeap(), 0, program->ins);
+    HeapFree(GetProcessHeap(), 0, program->temps);
+    HeapFree(GetProcessHeap(), 0, program->deps);
+    HeapFree(GetProcessHeap(), 0, program->dirty);
+    HeapFree(GetProcessHeap(), 0, program);
+}
+
+static unsigned int get_ins_output_count(const struct d3dx_pres_ins *ins)
+{
+    return pres_op_info[ins->op].func_all_comps ? 1 : ins->component_count;
+}
+
+static unsigned int get_ins_input_offset(const struct d3dx_pres_ins *ins, unsigned int input, unsigned int comp)
+{
+    return ins->inputs[input].reg.offset + (ins->scalar_op && !input ? 0 : comp);
+}
+
+static BOOL is_ins_interpreted(struct d3dx_preshader *pres, const struct d3dx_pres_ins *ins)
+{
+    const struct op_info *oi = &pres_op_info[ins->op];
+    unsigned int i, j, k, table, offset;
+
+    if (oi->func_all_comps && oi->input_count * ins->component_count > ARGS_ARRAY_SIZE)
+        return TRUE;
+    for (i = 0; i < oi->input_count; ++i)
+    {
+        table = ins->inputs[i].reg.table;
+        if (ins->inputs[i].index_reg.table != PRES_REGTAB_COUNT)
+            return TRUE;
+        if (table_info[table].type != PRES_VT_FLOAT && table_info[table].type != PRES_VT_DOUBLE)
+            return TRUE;
+        /* Out of range reads are wrapped by exec_get_arg(). */
+        if (get_reg_offset(table, get_ins_input_offset(ins, i, ins->component_count - 1))
+                >= pres->regs.table_sizes[table])
+            return TRUE;
+        if (oi->func_all_comps || table != ins->output.reg.table)
+            continue;
+        /* Components are evaluated one by one, so a component may read the
+         * result of a previous one. */
+        for (k = 1; k < ins->component_count; ++k)
+        {
+            offset = get_ins_input_offset(ins, i, k);
+            for (j = 0; j < k; ++j)
+            {
+                if (offset == ins->output.reg.offset + j)
+                    return TRUE;
+            }
         }
-        else
+    }
+    return FALSE;
+}
+
+/* Checks if each instruction can have its own output storage. */
+static BOOL can_evaluate_partially(struct d3dx_preshader *pres)
+{
+    unsigned int table_components[PRES_REGTAB_COUNT];
+    BYTE *written[PRES_REGTAB_COUNT] = {NULL};
+    unsigned int i, j, k, table, offset;
+    BOOL ret = TRUE;
+
+    for (table = PRES_REGTAB_OCONST; table < PRES_REGTAB_COUNT; ++table)
+    {
+        table_components[table] = get_offset_reg(table, pres->regs.table_sizes[table]);
+        if (!(written[table] = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, table_components[table] + 1)))
         {
-            for (j = 0; j < ins->component_count; ++j)
+            ret = FALSE;
+            goto done;
+        }
+    }
+
+    for (i = 0; i < pres->ins_count && ret; ++i)
+    {
+        const struct d3dx_pres_ins *ins = &pres->ins[i];
+
+        if (is_ins_interpreted(pres, ins))
+        {
+            ret = FALSE;
+            break;
+        }
+        for (j = 0; j < pres_op_info[ins->op].input_count && ret; ++j)
+        {
+            table = ins->inputs[j].reg.table;
+            if (table == PRES_REGTAB_IMMED || table == PRES_REGTAB_CONST)
+                continue;
+            /* Outputs read back, or temporaries read before being written. */
+            if (table != PRES_REGTAB_TEMP)
+            {
+                ret = FALSE;
+                break;
+            }
+            for (k = 0; k < ins->component_count; ++k)
+            {
+                if (!written[table][get_ins_input_offset(ins, j, k)])
+                {
+                    ret = FALSE;
+                    break;
+                }
+            }
+        }
+        table = ins->output.reg.table;
+        for (k = 0; k < get_ins_output_count(ins) && ret; ++k)
+        {
+            offset = ins->output.reg.offset + k;
+            if (table < PRES_REGTAB_OCONST || offset >= table_components[table])
             {
-                for (k = 0; k < oi->input_count; ++k)
-                    args[k] = exec_get_arg(&pres->regs, &ins->inputs[k], ins->scalar_op && !k ? 0 : j);
-                res = oi->func(args, ins->component_count);
-                exec_set_arg(&pres->regs, &ins->output.reg, j, res);
+                ret = FALSE;
+                break;
             }
+            /* Outputs written more than once would need ordering. */
+            if (table != PRES_REGTAB_TEMP && written[table][offset])
+                ret = FALSE;
+            written[table][offset] = 1;
         }
     }
-    return D3D_OK;
+
+done:
+    for (table = PRES_REGTAB_OCONST; table < PRES_REGTAB_COUNT; ++table)
+        HeapFree(GetProcessHeap(), 0, written[table]);
+    return ret;
+}
+
+static HRESULT compile_preshader(struct d3dx_preshader *pres)
+{
+    unsigned int temp_count = get_offset_reg(PRES_REGTAB_TEMP, pres->regs.table_sizes[PRES_REGTAB_TEMP]);
+    unsigned int const_count = pres->regs.table_sizes[PRES_REGTAB_CONST];
+    struct d3dx_const_tab *inputs = &pres->inputs;
+    struct d3dx_pres_program *program;
+    const float **temp_src = NULL;
+    unsigned int *temp_deps = NULL;
+    unsigned int *const_input = NULL;
+    unsigned int i, j, k, w;
+    HRESULT hr = E_OUTOFMEMORY;
+
+    if (!pres->ins_count)
+        return D3D_OK;
+
+    if (!(program = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*program))))
+        return E_OUTOFMEMORY;
+    program->partial = can_evaluate_partially(pres);
+    program->deps_size = max((inputs->input_count + PRES_BITMASK_BLOCK_SIZE - 1) / PRES_BITMASK_BLOCK_SIZE, 1);
+    TRACE("Compiling %u instructions, partial evaluation %#x.\n", pres->ins_count, program->partial);
+
+    program->ins = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*program->ins) * pres->ins_count);
+    program->deps = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+            sizeof(*program->deps) * program->deps_size * pres->ins_count);
+    program->dirty = HeapAlloc(GetProcessHeap(), 0, sizeof(*program->dirty) * program->deps_size);
+    if (!program->ins || !program->deps || !program->dirty)
+        goto done;
+    if (program->partial)
+    {
+        program->temps = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*program->temps) * 4 * pres->ins_count);
+        temp_src = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*temp_src) * (temp_count + 1));
+        temp_deps = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                sizeof(*temp_deps) * program->deps_size * (temp_count + 1));
+        const_input = HeapAlloc(GetProcessHeap(), 0, sizeof(*const_input) * (const_count + 1));
+        if (!program->temps || !temp_src || !temp_deps || !const_input)
+            goto done;
+
+        /* Which input ends up in which constant register. */
+        for (i = 0; i < const_count; ++i)
+            const_input[i] = ~0u;
+        for (i = 0; i < inputs->input_count; ++i)
+        {
+            if (inputs->regset2table[inputs->inputs[i].RegisterSet] != PRES_REGTAB_CONST)
+                continue;
+            for (j = inputs->inputs[i].RegisterIndex;
+                    j < inputs->inputs[i].RegisterIndex + inputs->inputs[i].RegisterCount && j < const_count; ++j)
+                const_input[j] = i;
+        }
+    }
+
+    for (i = 0; i < pres->ins_count; ++i)
+    {
+        const struct d3dx_pres_ins *ins = &pres->ins[i];
+        struct d3dx_pres_vm_ins *vm = &program->ins[i];
+        unsigned int *deps = &program->deps[i * program->deps_size];
+        unsigned int table, offset;
+
+        vm->op = ins->op;
+        vm->component_count = ins->component_count;
+        vm->deps = deps;
+        if (is_ins_interpreted(pres, ins))
+        {
+            vm->interpreted = ins;
+            continue;
+        }
+
+        for (j = 0; j < pres_op_info[ins->op].input_count; ++j)
+        {
+            table = ins->inputs[j].reg.table;
+            vm->inputs[j].is_double = table_info[table].type == PRES_VT_DOUBLE;
+            for (k = 0; k < ins->component_count; ++k)
+            {
+                offset = get_ins_input_offset(ins, j, k);
+                if (program->partial && table == PRES_REGTAB_TEMP)
+                {
+                    vm->inputs[j].comp[k] = temp_src[offset];
+                    for (w = 0; w < program->deps_size; ++w)
+                        deps[w] |= temp_deps[offset * program->deps_size + w];
+                    continue;
+                }
+                if (program->partial && table == PRES_REGTAB_CONST)
+                {
+                    unsigned int input = const_input[get_reg_offset(table, offset)];
+
+                    if (input != ~0u)
+                        deps[input / PRES_BITMASK_BLOCK_SIZE] |= 1u << (input % PRES_BITMASK_BLOCK_SIZE);
+                }
+                vm->inputs[j].comp[k] = (BYTE *)pres->regs.tables[table]
+                        + offset * table_info[table].component_size;
+            }
+        }
+
+        table = ins->output.reg.table;
+        vm->output_count = get_ins_output_count(ins);
+        vm->output_offset = ins->output.reg.offset;
+        if (program->partial && table == PRES_REGTAB_TEMP)
+        {
+            vm->output = &program->temps[i * 4];
+            vm->output_type = PRES_VT_FLOAT;
+            for (k = 0; k < vm->output_count; ++k)
+            {
+                offset = vm->output_offset + k;
+                temp_src[offset] = &program->temps[i * 4 + k];
+                memcpy(&temp_deps[offset * program->deps_size], deps, sizeof(*deps) * program->deps_size);
+            }
+        }
+        else
+        {
+            vm->output = (BYTE *)pres->regs.tables[table] + vm->output_offset * table_info[table].component_size;
+            vm->output_type = table_info[table].type;
+            vm->output_temp_table = table == PRES_REGTAB_TEMP;
+        }
+    }
+
+    pres->program = program;
+    program = NULL;
+    hr = D3D_OK;
+
+done:
+    HeapFree(GetProcessHeap(), 0, temp_src);
+    HeapFree(GetProcessHeap(), 0, temp_deps);
+    HeapFree(GetProcessHeap(), 0, const_input);
+    free_preshader_program(program);
+    return hr;
+}
+
+#ifdef __SSE2__
+/* Only built when the compiler targets SSE2 by default, i.e. on x86_64.
+ * Handles the operations which map to SSE2 exactly, two components at a
+ * time. min / max are left to fmin() / fmax(), which differ from minpd / maxpd
+ * for NaNs and signed zeros. */
+static BOOL pres_vm_exec_simd(enum pres_ops op, unsigned int count, double args[][4], double *res)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    unsigned int i;
+
+    switch (op)
+    {
+        case PRESHADER_OP_MOV: case PRESHADER_OP_NEG: case PRESHADER_OP_RCP:
+        case PRESHADER_OP_LT: case PRESHADER_OP_GE: case PRESHADER_OP_ADD:
+        case PRESHADER_OP_MUL: case PRESHADER_OP_CMP:
+            break;
+        default:
+            return FALSE;
+    }
+
+    for (i = 0; i < count; i += 2)
+    {
+        __m128d a = _mm_loadu_pd(&args[0][i]), mask, r;
+
+        switch (op)
+        {
+            case PRESHADER_OP_MOV: r = a; break;
+            case PRESHADER_OP_NEG: r = _mm_xor_pd(a, _mm_set1_pd(-0.0)); break;
+            case PRESHADER_OP_RCP: r = _mm_div_pd(one, a); break;
+            case PRESHADER_OP_LT: r = _mm_and_pd(_mm_cmplt_pd(a, _mm_loadu_pd(&args[1][i])), one); break;
+            case PRESHADER_OP_GE: r = _mm_and_pd(_mm_cmpge_pd(a, _mm_loadu_pd(&args[1][i])), one); break;
+            case PRESHADER_OP_ADD: r = _mm_add_pd(a, _mm_loadu_pd(&args[1][i])); break;
+            case PRESHADER_OP_MUL: r = _mm_mul_pd(a, _mm_loadu_pd(&args[1][i])); break;
+            case PRESHADER_OP_CMP:
+                mask = _mm_cmpge_pd(a, _mm_setzero_pd());
+                r = _mm_or_pd(_mm_and_pd(mask, _mm_loadu_pd(&args[1][i])),
+                        _mm_andnot_pd(mask, _mm_loadu_pd(&args[2][i])));
+                break;
+            default: return FALSE;
+        }
+        _mm_storeu_pd(&res[i], r);
+    }
+    return TRUE;
+}
+#else
+static BOOL pres_vm_exec_simd(enum pres_ops op, unsigned int count, double args[][4], double *res)
+{
+    return FALSE;
+}
+#endif
+
+static void pres_vm_exec_ins(const struct d3dx_pres_vm_ins *vm)
+{
+    const struct op_info *oi = &pres_op_info[vm->op];
+    double args[MAX_INPUTS_COUNT][4], res[4];
+    unsigned int i, j;
+
+    for (i = 0; i < oi->input_count; ++i)
+    {
+        const struct d3dx_pres_vm_operand *opr = &vm->inputs[i];
+
+        if (opr->is_double)
+        {
+            for (j = 0; j < vm->component_count; ++j)
+                args[i][j] = *(const double *)opr->comp[j];
+        }
+        else
+        {
+            for (j = 0; j < vm->component_count; ++j)
+                args[i][j] = *(const float *)opr->comp[j];
+        }
+        for (; j < 4; ++j)
+            args[i][j] = 0.0;
+    }
+
+    if (oi->func_all_comps)
+    {
+        double dot_args[ARGS_ARRAY_SIZE];
+
+        for (i = 0; i < oi->input_count; ++i)
+            memcpy(&dot_args[i * vm->component_count], args[i], vm->component_count * sizeof(*dot_args));
+        res[0] = oi->func(dot_args, vm->component_count);
+    }
+    else if (!pres_vm_exec_simd(vm->op, vm->component_count, args, res))
+    {
+        double lane[MAX_INPUTS_COUNT];
+
+        for (j = 0; j < vm->component_count; ++j)
+        {
+            for (i = 0; i < oi->input_count; ++i)
+                lane[i] = args[i][j];
+            res[j] = oi->func(lane, vm->component_count);
+        }
+    }
+
+    switch (vm->output_type)
+    {
+        case PRES_VT_FLOAT:
+            for (j = 0; j < vm->output_count; ++j)
+                ((float *)vm->output)[j] = res[j];
+            break;
+        case PRES_VT_DOUBLE:
+            memcpy(vm->output, res, vm->output_count * sizeof(*res));
+            break;
+        case PRES_VT_INT:
+            for (j = 0; j < vm->output_count; ++j)
+                ((int *)vm->output)[j] = lrint(res[j]);
+            break;
+        case PRES_VT_BOOL:
+            for (j = 0; j < vm->output_count; ++j)
+                ((BOOL *)vm->output)[j] = !!res[j];
+            break;
+        default:
+            FIXME("Bad type %u.\n", vm->output_type);
+            break;
+    }
 }
 
 static void set_preshader_modified(struct d3dx_preshader *pres)
@@ -1582,6 +1997,68 @@ static void set_preshader_modified(struct d3dx_preshader *pres)
     }
 }
 
+static HRESULT execute_preshader(struct d3dx_preshader *pres)
+{
+    struct d3dx_pres_program *program = pres->program;
+    BOOL partial;
+    unsigned int i, j;
+    HRESULT hr;
+
+    if (!program)
+        return D3D_OK;
+
+    partial = program->partial && program->evaluated;
+    for (i = 0; i < pres->ins_count; ++i)
+    {
+        const struct d3dx_pres_vm_ins *vm = &program->ins[i];
+
+        if (partial)
+        {
+            for (j = 0; j < program->deps_size; ++j)
+            {
+                if (vm->deps[j] & program->dirty[j])
+                    break;
+            }
+            if (j == program->deps_size)
+                continue;
+        }
+
+        if (vm->interpreted)
+        {
+            if (FAILED(hr = exec_ins_interpreted(pres, vm->interpreted)))
+                return hr;
+            continue;
+        }
+        pres_vm_exec_ins(vm);
+        if (vm->output_temp_table)
+            regstore_set_modified(&pres->regs, PRES_REGTAB_TEMP, vm->output_offset, vm->output_count);
+    }
+    /* Skipped instructions keep their previous results, which still need to
+     * be uploaded. */
+    set_preshader_modified(pres);
+    program->evaluated = TRUE;
+    return D3D_OK;
+}
+
+static HRESULT update_preshader(struct d3dx_preshader *pres, ULONG64 new_update_version)
+{
+    struct d3dx_pres_program *program = pres->program;
+    unsigned int i;
+
+    if (program && program->partial && program->evaluated)
+    {
+        memset(program->dirty, 0, sizeof(*program->dirty) * program->deps_size);
+        for (i = 0; i < pres->inputs.input_count; ++i)
+        {
+            if (pres->inputs.inputs_param[i]
+                    && is_param_dirty(pres->inputs.inputs_param[i], pres->inputs.update_version))
+                program->dirty[i / PRES_BITMASK_BLOCK_SIZE] |= 1u << (i % PRES_BITMASK_BLOCK_SIZE);
+        }
+    }
+    set_constants(&pres->regs, &pres->inputs, new_update_version);
+    return execute_preshader(pres);
+}
+
 static BOOL is_const_tab_input_dirty(struct d3dx_const_tab *ctab, ULONG64 update_version)
 {
     unsigned int i;
@@ -1615,10 +2092,7 @@ HRESULT d3dx_evaluate_parameter(struct d3dx_param_eval *peval, const struct d3dx
 
     if (is_const_tab_input_dirty(&peval->pres.inputs, ULONG64_MAX))
     {
-        set_constants(&peval->pres.regs, &peval->pres.inputs,
-                next_update_version(peval->version_counter));
-
-        if (FAILED(hr = execute_preshader(&peval->pres)))
+        if (FAILED(hr = update_preshader(&peval->pres, next_update_version(peval->version_counter))))
             return hr;
     }
 
@@ -1721,8 +2195,7 @@ HRESULT d3dx_param_eval_set_shader_constants(ID3DXEffectStateManager *manager, s
 
     if (is_const_tab_input_dirty(&pres->inputs, ULONG64_MAX))
     {
-        set_constants(rs, &pres->inputs, new_update_version);
-        if (FAILED(hr = execute_preshader(pres)))
+        if (FAILED(hr = update_preshader(pres, new_update_version)))
             return hr;
         update_device = TRUE;
     }
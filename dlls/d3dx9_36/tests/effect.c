@@ -4841,6 +4841,87 @@ static void test_effect_preshader_ops(IDirect3DDevice9 *device)
     effect->lpVtbl->Release(effect);
 }
 
+static void test_effect_preshader_update_get_state(IDirect3DDevice9 *device, ID3DXEffect *effect,
+        const D3DXVECTOR4 *opvect1, const D3DXVECTOR4 *pos, D3DLIGHT9 *lights, D3DXVECTOR4 *vconsts)
+{
+    unsigned int i;
+    HRESULT hr;
+
+    hr = effect->lpVtbl->SetVector(effect, "opvect1", opvect1);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->SetVector(effect, "g_Pos1", pos);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->CommitChanges(effect);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+
+    if (!lights)
+        return;
+    for (i = 0; i < 8; ++i)
+    {
+        hr = IDirect3DDevice9_GetLight(device, i, &lights[i]);
+        ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    }
+    hr = IDirect3DDevice9_GetVertexShaderConstantF(device, 0, &vconsts[0].x,
+            ARRAY_SIZE(test_effect_preshader_fvect_v));
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+}
+
+static void test_effect_preshader_update(IDirect3DDevice9 *device)
+{
+    static const D3DXVECTOR4 opvect1 = {-0.3f, 4.0f, -2.2f, 3.4f};
+    D3DXVECTOR4 vconsts[ARRAY_SIZE(test_effect_preshader_fvect_v)];
+    D3DXVECTOR4 vconsts2[ARRAY_SIZE(test_effect_preshader_fvect_v)];
+    D3DLIGHT9 lights[8], lights2[8];
+    unsigned int i, passes_count;
+    ID3DXEffect *effect;
+    D3DXVECTOR4 vect;
+    HRESULT hr;
+
+    /* Evaluating the preshaders repeatedly with only some of the inputs
+     * changed gives the same results as evaluating them once. */
+    hr = D3DXCreateEffect(device, test_effect_preshader_effect_blob, sizeof(test_effect_preshader_effect_blob),
+            NULL, NULL, 0, NULL, &effect, NULL);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->Begin(effect, &passes_count, 0);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->BeginPass(effect, 0);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+
+    for (i = 0; i < 16; ++i)
+    {
+        vect.x = opvect1.x + i % 7;
+        vect.y = opvect1.y;
+        vect.z = opvect1.z - i % 3;
+        vect.w = opvect1.w;
+        test_effect_preshader_update_get_state(device, effect, i % 4 ? &opvect1 : &vect, &vect, NULL, NULL);
+    }
+    test_effect_preshader_update_get_state(device, effect, &opvect1, &vect, lights, vconsts);
+
+    hr = effect->lpVtbl->EndPass(effect);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->End(effect);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    effect->lpVtbl->Release(effect);
+
+    hr = D3DXCreateEffect(device, test_effect_preshader_effect_blob, sizeof(test_effect_preshader_effect_blob),
+            NULL, NULL, 0, NULL, &effect, NULL);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->Begin(effect, &passes_count, 0);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->BeginPass(effect, 0);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    test_effect_preshader_update_get_state(device, effect, &opvect1, &vect, lights2, vconsts2);
+
+    ok(!memcmp(lights, lights2, sizeof(lights)), "Light states differ.\n");
+    ok(!memcmp(vconsts, vconsts2, sizeof(vconsts)), "Vertex shader constants differ.\n");
+
+    hr = effect->lpVtbl->EndPass(effect);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    hr = effect->lpVtbl->End(effect);
+    ok(hr == D3D_OK, "Got result %#x.\n", hr);
+    effect->lpVtbl->Release(effect);
+}
+
 static void test_isparameterused_children(unsigned int line, ID3DXEffect *effect,
         D3DXHANDLE tech, D3DXHANDLE param)
 {
@@ -6785,6 +6866,7 @@ START_TEST(effect)
     test_effect_states(device);
     test_effect_preshader(device);
     test_effect_preshader_ops(device);
+    test_effect_preshader_update(device);
     test_effect_isparameterused(device);
     test_effect_out_of_bounds_selector(device);
     test_effect_commitchanges(device);
@@ -2446,6 +2446,68 @@ static void test_D3DXVec_Array(void)
     }
 }
 
+static void test_D3DXVec_Array_strided(void)
+{
+    /* Strided input, the way vertex buffers are laid out, checked element
+     * by element against the single vector functions. */
+    struct vertex
+    {
+        D3DXVECTOR3 position;
+        DWORD color;
+    };
+    static const unsigned int count = 1003;
+    D3DXVECTOR3 *out3, expected3;
+    D3DXVECTOR4 *out4, expected4;
+    unsigned int i, mismatches;
+    struct vertex *vertices;
+    D3DXMATRIX mat;
+
+    vertices = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*vertices));
+    out3 = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*out3));
+    out4 = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*out4));
+
+    for (i = 0; i < count; ++i)
+    {
+        vertices[i].position.x = (i % 37) / 2.0f - 9.0f;
+        vertices[i].position.y = (i / 37) / 2.0f - 7.0f;
+        vertices[i].position.z = (i % 77) - 38.0f;
+        vertices[i].color = i;
+    }
+    D3DXMatrixPerspectiveFovLH(&mat, D3DX_PI / 4.0f, 4.0f / 3.0f, 1.0f, 1000.0f);
+    U(mat).m[3][0] = 1.5f; U(mat).m[3][1] = -2.5f; U(mat).m[3][2] = 3.5f;
+
+    D3DXVec3TransformCoordArray(out3, sizeof(*out3), &vertices[0].position, sizeof(*vertices), &mat, count);
+    for (i = 0, mismatches = 0; i < count; ++i)
+    {
+        D3DXVec3TransformCoord(&expected3, &vertices[i].position, &mat);
+        if (!compare_vec3(&expected3, &out3[i], 1))
+            ++mismatches;
+    }
+    ok(!mismatches, "Got %u mismatches.\n", mismatches);
+
+    D3DXVec3TransformArray(out4, sizeof(*out4), &vertices[0].position, sizeof(*vertices), &mat, count);
+    for (i = 0, mismatches = 0; i < count; ++i)
+    {
+        D3DXVec3Transform(&expected4, &vertices[i].position, &mat);
+        if (!compare_vec4(&expected4, &out4[i], 1))
+            ++mismatches;
+    }
+    ok(!mismatches, "Got %u mismatches.\n", mismatches);
+
+    D3DXVec3TransformNormalArray(out3, sizeof(*out3), &vertices[0].position, sizeof(*vertices), &mat, count);
+    for (i = 0, mismatches = 0; i < count; ++i)
+    {
+        D3DXVec3TransformNormal(&expected3, &vertices[i].position, &mat);
+        if (!compare_vec3(&expected3, &out3[i], 1))
+            ++mismatches;
+    }
+    ok(!mismatches, "Got %u mismatches.\n", mismatches);
+
+    HeapFree(GetProcessHeap(), 0, out4);
+    HeapFree(GetProcessHeap(), 0, out3);
+    HeapFree(GetProcessHeap(), 0, vertices);
+}
+
 static void test_D3DXFloat_Array(void)
 {
     unsigned int i;
@@ -3625,6 +3687,7 @@ START_TEST(math)
     test_Matrix_Decompose();
     test_Matrix_Transformation2D();
     test_D3DXVec_Array();
+    test_D3DXVec_Array_strided();
     test_D3DXFloat_Array();
     test_D3DXSHAdd();
     test_D3DXSHDot();
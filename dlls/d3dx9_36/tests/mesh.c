@@ -10765,6 +10765,241 @@ static void test_optimize_faces(void)
     "faces when using 16-bit indices. Got %x\n, expected D3DERR_INVALIDCALL\n", hr);
 }
 
+/* Average cache miss ratio, the number of vertex shader runs per face with a
+ * 16 entry FIFO post-transform cache. */
+static float compute_acmr(const DWORD *indices, const DWORD *face_order, DWORD num_faces)
+{
+    DWORD cache[16], cache_size = 0, cache_pos = 0, misses = 0;
+    DWORD i, j, k;
+
+    for (i = 0; i < num_faces; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            DWORD index = indices[face_order[i] * 3 + j];
+
+            for (k = 0; k < cache_size; k++)
+            {
+                if (cache[k] == index)
+                    break;
+            }
+            if (k < cache_size)
+                continue;
+
+            misses++;
+            if (cache_size < ARRAY_SIZE(cache))
+            {
+                cache[cache_size++] = index;
+            }
+            else
+            {
+                cache[cache_pos] = index;
+                cache_pos = (cache_pos + 1) % ARRAY_SIZE(cache);
+            }
+        }
+    }
+
+    return num_faces ? (float)misses / num_faces : 0.0f;
+}
+
+static void test_optimize_faces_acmr(void)
+{
+    static const DWORD width = 32;
+    DWORD num_faces = width * width * 2, num_vertices = (width + 1) * (width + 1);
+    DWORD *indices, *face_order, *face_remap;
+    float acmr_before, acmr_after;
+    DWORD x, y, i, seed = 1;
+    HRESULT hr;
+
+    indices = HeapAlloc(GetProcessHeap(), 0, num_faces * 3 * sizeof(*indices));
+    face_order = HeapAlloc(GetProcessHeap(), 0, num_faces * sizeof(*face_order));
+    face_remap = HeapAlloc(GetProcessHeap(), 0, num_faces * sizeof(*face_remap));
+    if (!indices || !face_order || !face_remap)
+    {
+        skip("Failed to allocate memory.\n");
+        goto done;
+    }
+
+    /* A grid with its faces shuffled. */
+    for (y = 0, i = 0; y < width; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            DWORD base = y * (width + 1) + x;
+
+            indices[i++] = base;
+            indices[i++] = base + 1;
+            indices[i++] = base + width + 1;
+            indices[i++] = base + 1;
+            indices[i++] = base + width + 2;
+            indices[i++] = base + width + 1;
+        }
+    }
+    for (i = num_faces - 1; i > 0; i--)
+    {
+        DWORD face[3], j;
+
+        seed = seed * 1103515245 + 12345;
+        j = (seed >> 8) % (i + 1);
+        memcpy(face, &indices[i * 3], sizeof(face));
+        memcpy(&indices[i * 3], &indices[j * 3], sizeof(face));
+        memcpy(&indices[j * 3], face, sizeof(face));
+    }
+    for (i = 0; i < num_faces; i++)
+        face_order[i] = i;
+    acmr_before = compute_acmr(indices, face_order, num_faces);
+
+    hr = D3DXOptimizeFaces(indices, num_faces, num_vertices, TRUE, face_remap);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+    memset(face_order, 0, num_faces * sizeof(*face_order));
+    for (i = 0; i < num_faces; i++)
+    {
+        if (face_remap[i] < num_faces)
+            face_order[face_remap[i]]++;
+    }
+    for (i = 0; i < num_faces; i++)
+    {
+        if (face_order[i] != 1)
+            break;
+    }
+    ok(i == num_faces, "Face remap is not a permutation, face %u is used %u times.\n", i, face_order[i]);
+
+    acmr_after = compute_acmr(indices, face_remap, num_faces);
+    ok(acmr_after < 1.0f && acmr_after < acmr_before, "Got unexpected ACMR %.3f, was %.3f.\n",
+            acmr_after, acmr_before);
+
+done:
+    HeapFree(GetProcessHeap(), 0, indices);
+    HeapFree(GetProcessHeap(), 0, face_order);
+    HeapFree(GetProcessHeap(), 0, face_remap);
+}
+
+static void test_intersect(void)
+{
+    D3DXVECTOR3 ray_pos = {-5.0f, 0.01f, 0.02f}, ray_dir = {1.0f, 0.0f, 0.0f};
+    DWORD face_index, expected_face = ~0u, count, i;
+    struct test_context *test_context;
+    const D3DXINTERSECTINFO *info;
+    float u, v, distance, min_distance = FLT_MAX;
+    D3DXVECTOR3 *vertices;
+    DWORD *face_remap, *adjacency;
+    ID3DXMesh *sphere = NULL;
+    ID3DXBuffer *all_hits;
+    DWORD vertex_size;
+    WORD *indices;
+    BOOL hit;
+    HRESULT hr;
+
+    if (!(test_context = new_test_context()))
+    {
+        skip("Couldn't create test context\n");
+        return;
+    }
+
+    hr = D3DXCreateSphere(test_context->device, 1.0f, 32, 32, &sphere, NULL);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+    hr = D3DXIntersect(NULL, &ray_pos, &ray_dir, &hit, NULL, NULL, NULL, NULL, NULL, NULL);
+    ok(hr == D3DERR_INVALIDCALL, "Got unexpected hr %#x.\n", hr);
+
+    /* Find the expected face the slow way. */
+    vertex_size = sphere->lpVtbl->GetNumBytesPerVertex(sphere);
+    hr = sphere->lpVtbl->LockVertexBuffer(sphere, D3DLOCK_READONLY, (void **)&vertices);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = sphere->lpVtbl->LockIndexBuffer(sphere, D3DLOCK_READONLY, (void **)&indices);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    for (i = 0; i < sphere->lpVtbl->GetNumFaces(sphere); i++)
+    {
+        const D3DXVECTOR3 *p0 = (D3DXVECTOR3 *)((BYTE *)vertices + indices[i * 3] * vertex_size);
+        const D3DXVECTOR3 *p1 = (D3DXVECTOR3 *)((BYTE *)vertices + indices[i * 3 + 1] * vertex_size);
+        const D3DXVECTOR3 *p2 = (D3DXVECTOR3 *)((BYTE *)vertices + indices[i * 3 + 2] * vertex_size);
+
+        if (D3DXIntersectTri(p0, p1, p2, &ray_pos, &ray_dir, NULL, NULL, &distance) && distance < min_distance)
+        {
+            min_distance = distance;
+            expected_face = i;
+        }
+    }
+    sphere->lpVtbl->UnlockIndexBuffer(sphere);
+    sphere->lpVtbl->UnlockVertexBuffer(sphere);
+
+    hit = FALSE;
+    all_hits = NULL;
+    hr = D3DXIntersect((ID3DXBaseMesh *)sphere, &ray_pos, &ray_dir, &hit, &face_index,
+            &u, &v, &distance, &all_hits, &count);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    ok(hit, "Expected a hit.\n");
+    ok(face_index == expected_face, "Got face %u, expected %u.\n", face_index, expected_face);
+    ok(compare(distance, min_distance), "Got distance %.8e, expected %.8e.\n", distance, min_distance);
+    ok(fabsf(distance - 4.0f) < 0.01f, "Got distance %.8e.\n", distance);
+    ok(count == 2, "Got %u hits.\n", count);
+    ok(!!all_hits, "Expected a hits buffer.\n");
+    if (all_hits)
+    {
+        ok(ID3DXBuffer_GetBufferSize(all_hits) == count * sizeof(*info),
+                "Got unexpected buffer size %u.\n", ID3DXBuffer_GetBufferSize(all_hits));
+        info = ID3DXBuffer_GetBufferPointer(all_hits);
+        ok(info[0].FaceIndex == face_index || info[1].FaceIndex == face_index,
+                "Got faces %u, %u.\n", info[0].FaceIndex, info[1].FaceIndex);
+        ok(info[0].Dist >= distance && info[1].Dist >= distance,
+                "Got distances %.8e, %.8e.\n", info[0].Dist, info[1].Dist);
+        ID3DXBuffer_Release(all_hits);
+    }
+
+    /* Reordering the faces must be picked up. */
+    face_remap = HeapAlloc(GetProcessHeap(), 0, sphere->lpVtbl->GetNumFaces(sphere) * sizeof(*face_remap));
+    adjacency = HeapAlloc(GetProcessHeap(), 0, sphere->lpVtbl->GetNumFaces(sphere) * 3 * sizeof(*adjacency));
+    hr = sphere->lpVtbl->GenerateAdjacency(sphere, 0.0f, adjacency);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    hr = sphere->lpVtbl->OptimizeInplace(sphere, D3DXMESHOPT_VERTEXCACHE, adjacency, NULL, face_remap, NULL);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    if (SUCCEEDED(hr))
+    {
+        /* The face remap gives the old index of each new face. */
+        for (i = 0; i < sphere->lpVtbl->GetNumFaces(sphere); ++i)
+        {
+            if (face_remap[i] == expected_face)
+                break;
+        }
+        hr = D3DXIntersect((ID3DXBaseMesh *)sphere, &ray_pos, &ray_dir, &hit, &face_index,
+                NULL, NULL, &distance, NULL, NULL);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+        ok(hit, "Expected a hit.\n");
+        ok(face_index == i, "Got face %u, expected %u.\n", face_index, i);
+        ok(compare(distance, min_distance), "Got distance %.8e, expected %.8e.\n", distance, min_distance);
+    }
+    HeapFree(GetProcessHeap(), 0, face_remap);
+    HeapFree(GetProcessHeap(), 0, adjacency);
+
+    ray_pos.y = 3.0f;
+    hit = TRUE;
+    count = 0xdeadbeef;
+    hr = D3DXIntersect((ID3DXBaseMesh *)sphere, &ray_pos, &ray_dir, &hit, NULL, NULL, NULL, NULL, NULL, &count);
+    ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+    ok(!hit, "Unexpected hit.\n");
+    ok(!count, "Got %u hits.\n", count);
+
+    /* A grid of rays, clearly inside or outside of the sphere silhouette. */
+    for (i = 0; i < 16 * 16; i++)
+    {
+        float r2;
+
+        ray_pos.x = -5.0f;
+        ray_pos.y = (i % 16) * 0.2f - 1.5f;
+        ray_pos.z = (i / 16) * 0.2f - 1.5f;
+        r2 = ray_pos.y * ray_pos.y + ray_pos.z * ray_pos.z;
+        if (r2 > 0.9f && r2 < 1.1f)
+            continue;
+        hr = D3DXIntersect((ID3DXBaseMesh *)sphere, &ray_pos, &ray_dir, &hit, NULL, NULL, NULL, NULL, NULL, NULL);
+        ok(hr == D3D_OK, "Ray %u: got unexpected hr %#x.\n", i, hr);
+        ok(hit == (r2 < 1.0f), "Ray %u (%.2f, %.2f): got hit %#x.\n", i, ray_pos.y, ray_pos.z, hit);
+    }
+    sphere->lpVtbl->Release(sphere);
+
+    free_test_context(test_context);
+}
+
 static HRESULT clear_normals(ID3DXMesh *mesh)
 {
     HRESULT hr;
@@ -11427,5 +11662,7 @@ START_TEST(mesh)
     test_clone_mesh();
     test_valid_mesh();
     test_optimize_faces();
+    test_optimize_faces_acmr();
+    test_intersect();
     test_compute_normals();
 }
@@ -1230,6 +1230,89 @@ static void test_D3DXLoadSurface(IDirect3DDevice9 *device)
     if(testbitmap_ok) DeleteFileA("testbitmap.bmp");
 }
 
+static BOOL color_match(DWORD c1, DWORD c2, BYTE max_diff)
+{
+    unsigned int i;
+
+    for (i = 0; i < 32; i += 8)
+    {
+        if (abs((int)((c1 >> i) & 0xff) - (int)((c2 >> i) & 0xff)) > max_diff)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void test_dxtn_conversion(IDirect3DDevice9 *device)
+{
+    static const D3DFORMAT formats[] = {D3DFMT_DXT1, D3DFMT_DXT3, D3DFMT_DXT5};
+    static const unsigned int size = 64;
+    IDirect3DSurface9 *src_surf, *dst_surf, *dxt_surf;
+    unsigned int i, x, y, mismatches;
+    D3DLOCKED_RECT lock;
+    IDirect3DTexture9 *tex;
+    DWORD expected, color;
+    HRESULT hr;
+
+    hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, size, size, D3DFMT_A8R8G8B8,
+            D3DPOOL_SYSTEMMEM, &src_surf, NULL);
+    ok(SUCCEEDED(hr), "Failed to create surface, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, size, size, D3DFMT_A8R8G8B8,
+            D3DPOOL_SYSTEMMEM, &dst_surf, NULL);
+    ok(SUCCEEDED(hr), "Failed to create surface, hr %#x.\n", hr);
+
+    hr = IDirect3DSurface9_LockRect(src_surf, &lock, NULL, 0);
+    ok(SUCCEEDED(hr), "Failed to lock surface, hr %#x.\n", hr);
+    for (y = 0; y < size; ++y)
+    {
+        DWORD *row = (DWORD *)((BYTE *)lock.pBits + y * lock.Pitch);
+
+        for (x = 0; x < size; ++x)
+            row[x] = 0xff000000 | (x & 0xff) << 16 | (y & 0xff) << 8 | ((x + y) / 8 & 0xff);
+    }
+    hr = IDirect3DSurface9_UnlockRect(src_surf);
+    ok(SUCCEEDED(hr), "Failed to unlock surface, hr %#x.\n", hr);
+
+    for (i = 0; i < sizeof(formats) / sizeof(*formats); ++i)
+    {
+        hr = IDirect3DDevice9_CreateTexture(device, size, size, 1, 0, formats[i], D3DPOOL_SYSTEMMEM, &tex, NULL);
+        if (FAILED(hr))
+        {
+            skip("Failed to create texture with format %#x, hr %#x.\n", formats[i], hr);
+            continue;
+        }
+        hr = IDirect3DTexture9_GetSurfaceLevel(tex, 0, &dxt_surf);
+        ok(SUCCEEDED(hr), "Failed to get the surface, hr %#x.\n", hr);
+
+        hr = D3DXLoadSurfaceFromSurface(dxt_surf, NULL, NULL, src_surf, NULL, NULL, D3DX_FILTER_NONE, 0);
+        ok(SUCCEEDED(hr), "Failed to convert pixels to format %#x, hr %#x.\n", formats[i], hr);
+        hr = D3DXLoadSurfaceFromSurface(dst_surf, NULL, NULL, dxt_surf, NULL, NULL, D3DX_FILTER_NONE, 0);
+        ok(SUCCEEDED(hr), "Failed to convert pixels from format %#x, hr %#x.\n", formats[i], hr);
+
+        hr = IDirect3DSurface9_LockRect(dst_surf, &lock, NULL, D3DLOCK_READONLY);
+        ok(SUCCEEDED(hr), "Failed to lock surface, hr %#x.\n", hr);
+        for (y = 0, mismatches = 0, color = 0; y < size; ++y)
+        {
+            const DWORD *row = (const DWORD *)((const BYTE *)lock.pBits + y * lock.Pitch);
+
+            for (x = 0; x < size; ++x)
+            {
+                expected = 0xff000000 | (x & 0xff) << 16 | (y & 0xff) << 8 | ((x + y) / 8 & 0xff);
+                if (!color_match(row[x], expected, 8) && !mismatches++)
+                    color = row[x];
+            }
+        }
+        ok(!mismatches, "Format %#x: got %u mismatches, first color 0x%08x.\n", formats[i], mismatches, color);
+        hr = IDirect3DSurface9_UnlockRect(dst_surf);
+        ok(SUCCEEDED(hr), "Failed to unlock surface, hr %#x.\n", hr);
+
+        check_release((IUnknown *)dxt_surf, 1);
+        check_release((IUnknown *)tex, 0);
+    }
+
+    check_release((IUnknown *)dst_surf, 0);
+    check_release((IUnknown *)src_surf, 0);
+}
+
 static void test_D3DXSaveSurfaceToFileInMemory(IDirect3DDevice9 *device)
 {
     HRESULT hr;
@@ -1435,6 +1518,7 @@ START_TEST(surface)
 
     test_D3DXGetImageInfo();
     test_D3DXLoadSurface(device);
+    test_dxtn_conversion(device);
     test_D3DXSaveSurfaceToFileInMemory(device);
     test_D3DXSaveSurfaceToFile(device);
 
@@ -224,6 +224,7 @@ static unsigned push_instr(compiler_ctx_t *ctx, jsop_t op)
     }
 
     ctx->code->instrs[ctx->code_off].op = op;
+    ctx->code->instrs[ctx->code_off].cache = 0;
     return ctx->code_off++;
 }
 
@@ -233,6 +234,17 @@ static inline instr_t *instr_ptr(compiler_ctx_t *ctx, unsigned off)
     return ctx->code->instrs + off;
 }
 
+/* Assigns an inline cache slot to the last emitted instruction. */
+static void alloc_inline_cache(compiler_ctx_t *ctx)
+{
+    instr_t *instr = instr_ptr(ctx, ctx->code_off-1);
+
+    if(instr->op == OP_ident || instr->op == OP_identid)
+        instr->cache = ctx->code->ident_cache_cnt++;
+    else
+        instr->cache = ctx->code->prop_cache_cnt++;
+}
+
 static HRESULT push_instr_int(compiler_ctx_t *ctx, jsop_t op, LONG arg)
 {
     unsigned instr;
@@ -379,7 +391,12 @@ static HRESULT compile_member_expression(compiler_ctx_t *ctx, member_expression_
     if(FAILED(hres))
         return hres;
 
-    return push_instr_bstr(ctx, OP_member, expr->identifier);
+    hres = push_instr_bstr(ctx, OP_member, expr->identifier);
+    if(FAILED(hres))
+        return hres;
+
+    alloc_inline_cache(ctx);
+    return S_OK;
 }
 
 #define LABEL_FLAG 0x80000000
@@ -437,17 +454,33 @@ static BOOL bind_local(compiler_ctx_t *ctx, const WCHAR *identifier, int *ret_re
 static HRESULT emit_identifier_ref(compiler_ctx_t *ctx, const WCHAR *identifier, unsigned flags)
 {
     int local_ref;
+    HRESULT hres;
+
     if(bind_local(ctx, identifier, &local_ref))
         return push_instr_int(ctx, OP_local_ref, local_ref);
-    return push_instr_bstr_uint(ctx, OP_identid, identifier, flags);
+
+    hres = push_instr_bstr_uint(ctx, OP_identid, identifier, flags);
+    if(FAILED(hres))
+        return hres;
+
+    alloc_inline_cache(ctx);
+    return S_OK;
 }
 
 static HRESULT emit_identifier(compiler_ctx_t *ctx, const WCHAR *identifier)
 {
     int local_ref;
+    HRESULT hres;
+
     if(bind_local(ctx, identifier, &local_ref))
         return push_instr_int(ctx, OP_local, local_ref);
-    return push_instr_bstr(ctx, OP_ident, identifier);
+
+    hres = push_instr_bstr(ctx, OP_ident, identifier);
+    if(FAILED(hres))
+        return hres;
+
+    alloc_inline_cache(ctx);
+    return S_OK;
 }
 
 static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *expr, unsigned flags)
@@ -487,7 +520,10 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
         if(FAILED(hres))
             return hres;
 
+        /* The name is constant, so the lookup may be cached. */
         hres = push_instr_uint(ctx, OP_memberid, flags);
+        if(SUCCEEDED(hres))
+            alloc_inline_cache(ctx);
         break;
     }
     DEFAULT_UNREACHABLE;
@@ -2233,11 +2269,21 @@ void release_bytecode(bytecode_t *code)
         SysFreeString(code->bstr_pool[i]);
     for(i=0; i < code->str_cnt; i++)
         jsstr_release(code->str_pool[i]);
+    if(code->prop_caches) {
+        for(i=1; i < code->prop_cache_cnt; i++)
+            release_prop_cache(code->prop_caches+i);
+    }
+    if(code->ident_caches) {
+        for(i=1; i < code->ident_cache_cnt; i++)
+            release_ident_cache(code->ident_caches+i);
+    }
 
     heap_free(code->source);
     heap_pool_free(&code->heap);
     heap_free(code->bstr_pool);
     heap_free(code->str_pool);
+    heap_free(code->prop_caches);
+    heap_free(code->ident_caches);
     heap_free(code->instrs);
     heap_free(code);
 }
@@ -2265,6 +2311,8 @@ static HRESULT init_code(compiler_ctx_t *compiler, const WCHAR *source)
 
     compiler->code_size = 64;
     compiler->code_off = 1;
+    compiler->code->prop_cache_cnt = 1;
+    compiler->code->ident_cache_cnt = 1;
     return S_OK;
 }
 
@@ -2496,6 +2544,13 @@ HRESULT compile_script(script_ctx_t *ctx, const WCHAR *code, const WCHAR *args,
         return hres;
     }
 
+    compiler.code->prop_caches = heap_alloc_zero(compiler.code->prop_cache_cnt * sizeof(*compiler.code->prop_caches));
+    compiler.code->ident_caches = heap_alloc_zero(compiler.code->ident_cache_cnt * sizeof(*compiler.code->ident_caches));
+    if(!compiler.code->prop_caches || !compiler.code->ident_caches) {
+        release_bytecode(compiler.code);
+        return E_OUTOFMEMORY;
+    }
+
     *ret = compiler.code;
     return S_OK;
 }
@@ -53,6 +53,30 @@ struct _dispex_prop_t {
     int bucket_next;
 };
 
+/*
+ * Objects that got the same property names added in the same order share
+ * a shape. Since property DISPIDs are indexes in the props array, a DISPID
+ * looked up on one object is valid for all objects having the same shape,
+ * which lets the interpreter cache lookups per instruction. Objects that
+ * grow too big or get a property deleted switch to a private dictionary
+ * shape. It's still valid to cache ids found in such objects, but not
+ * failed lookups.
+ */
+#define SHAPE_MAX_PROPS 128
+
+struct _dispex_shape_t {
+    LONG ref;
+    BOOL dictionary;
+    const builtin_info_t *builtin_info;
+
+    dispex_shape_t *parent;
+    WCHAR *name;
+    unsigned hash;
+
+    dispex_shape_t *children;
+    dispex_shape_t *next;
+};
+
 static inline DISPID prop_to_id(jsdisp_t *This, dispex_prop_t *prop)
 {
     return prop - This->props;
@@ -145,6 +169,120 @@ static inline HRESULT resize_props(jsdisp_t *This)
     return S_OK;
 }
 
+dispex_shape_t *shape_addref(dispex_shape_t *shape)
+{
+    shape->ref++;
+    return shape;
+}
+
+void shape_release(dispex_shape_t *shape)
+{
+    dispex_shape_t *parent, **iter;
+
+    while(shape && !--shape->ref) {
+        parent = shape->parent;
+        if(parent) {
+            for(iter = &parent->children; *iter != shape; iter = &(*iter)->next);
+            *iter = shape->next;
+        }
+
+        heap_free(shape->name);
+        heap_free(shape);
+        shape = parent;
+    }
+}
+
+static dispex_shape_t *get_root_shape(script_ctx_t *ctx, const builtin_info_t *builtin_info)
+{
+    dispex_shape_t **root, *shape;
+
+    root = ctx->shape_roots + ((ULONG_PTR)builtin_info / sizeof(void*)) % (sizeof(ctx->shape_roots)/sizeof(*ctx->shape_roots));
+    for(shape = *root; shape; shape = shape->next) {
+        if(shape->builtin_info == builtin_info)
+            return shape_addref(shape);
+    }
+
+    shape = heap_alloc_zero(sizeof(*shape));
+    if(!shape)
+        return NULL;
+
+    /* One reference is held by the script context. */
+    shape->ref = 2;
+    shape->builtin_info = builtin_info;
+    shape->next = *root;
+    *root = shape;
+    return shape;
+}
+
+void release_shape_roots(script_ctx_t *ctx)
+{
+    dispex_shape_t *shape;
+    unsigned i;
+
+    for(i=0; i < sizeof(ctx->shape_roots)/sizeof(*ctx->shape_roots); i++) {
+        while(ctx->shape_roots[i]) {
+            shape = ctx->shape_roots[i];
+            ctx->shape_roots[i] = shape->next;
+            shape_release(shape);
+        }
+    }
+}
+
+static dispex_shape_t *alloc_dictionary_shape(dispex_shape_t *shape)
+{
+    dispex_shape_t *ret;
+
+    ret = heap_alloc_zero(sizeof(*ret));
+    if(!ret)
+        return NULL;
+
+    ret->ref = 1;
+    ret->dictionary = TRUE;
+    ret->builtin_info = shape->builtin_info;
+    return ret;
+}
+
+static void update_shape(jsdisp_t *This, dispex_prop_t *prop)
+{
+    dispex_shape_t *shape = This->shape, *child;
+
+    if(!shape || shape->dictionary)
+        return;
+
+    if(This->prop_cnt > SHAPE_MAX_PROPS) {
+        child = alloc_dictionary_shape(shape);
+    }else {
+        for(child = shape->children; child; child = child->next) {
+            if(child->hash == prop->hash && !strcmpW(child->name, prop->name))
+                break;
+        }
+
+        if(child) {
+            shape_addref(child);
+        }else {
+            child = heap_alloc_zero(sizeof(*child));
+            if(child) {
+                child->name = heap_strdupW(prop->name);
+                if(child->name) {
+                    child->ref = 1;
+                    child->builtin_info = shape->builtin_info;
+                    child->parent = shape_addref(shape);
+                    child->hash = prop->hash;
+                    child->next = shape->children;
+                    shape->children = child;
+                }else {
+                    heap_free(child);
+                    child = NULL;
+                }
+            }
+        }
+    }
+
+    /* If we're out of memory, lookups on the object are simply not cached. */
+    This->shape = child;
+    shape_release(shape);
+}
+
 static inline dispex_prop_t* alloc_prop(jsdisp_t *This, const WCHAR *name, prop_type_t type, DWORD flags)
 {
     dispex_prop_t *prop;
@@ -164,6 +302,8 @@ static inline dispex_prop_t* alloc_prop(jsdisp_t *This, const WCHAR *name, prop_
     bucket = get_props_idx(This, prop->hash);
     prop->bucket_next = This->props[bucket].bucket_head;
     This->props[bucket].bucket_head = This->prop_cnt++;
+
+    update_shape(This, prop);
     return prop;
 }
 
@@ -732,7 +872,7 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
     return hres;
 }
 
-static HRESULT delete_prop(dispex_prop_t *prop, BOOL *ret)
+static HRESULT delete_prop(jsdisp_t *This, dispex_prop_t *prop, BOOL *ret)
 {
     if(prop->flags & PROPF_DONTDELETE) {
         *ret = FALSE;
@@ -744,6 +884,13 @@ static HRESULT delete_prop(dispex_prop_t *prop, BOOL *ret)
     if(prop->type == PROP_JSVAL) {
         jsval_release(prop->u.val);
         prop->type = PROP_DELETED;
+
+        /* The property may be recreated in place, so the shape no longer describes failed lookups. */
+        if(This->shape && !This->shape->dictionary) {
+            dispex_shape_t *shape = This->shape;
+            This->shape = alloc_dictionary_shape(shape);
+            shape_release(shape);
+        }
     }
     return S_OK;
 }
@@ -768,7 +915,7 @@ static HRESULT WINAPI DispatchEx_DeleteMemberByName(IDispatchEx *iface, BSTR bst
         return S_OK;
     }
 
-    return delete_prop(prop, &b);
+    return delete_prop(This, prop, &b);
 }
 
 static HRESULT WINAPI DispatchEx_DeleteMemberByDispID(IDispatchEx *iface, DISPID id)
@@ -785,7 +932,7 @@ static HRESULT WINAPI DispatchEx_DeleteMemberByDispID(IDispatchEx *iface, DISPID
         return DISP_E_MEMBERNOTFOUND;
     }
 
-    return delete_prop(prop, &b);
+    return delete_prop(This, prop, &b);
 }
 
 static HRESULT WINAPI DispatchEx_GetMemberProperties(IDispatchEx *iface, DISPID id, DWORD grfdexFetch, DWORD *pgrfdex)
@@ -906,6 +1053,8 @@ HRESULT init_dispex(jsdisp_t *dispex, script_ctx_t *ctx, const builtin_info_t *b
         dispex->props[0].type = PROP_DELETED;
     }
 
+    dispex->shape = get_root_shape(ctx, builtin_info);
+
     script_addref(ctx);
     dispex->ctx = ctx;
 
@@ -951,6 +1100,7 @@ void jsdisp_free(jsdisp_t *obj)
         heap_free(prop->name);
     }
     heap_free(obj->props);
+    shape_release(obj->shape);
     script_release(obj->ctx);
     if(obj->prototype)
         jsdisp_release(obj->prototype);
@@ -1040,6 +1190,26 @@ HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *
     return DISP_E_UNKNOWNNAME;
 }
 
+/*
+ * Used to validate DISPIDs cached for the object's shape. Like jsdisp_get_id,
+ * it doesn't consider deleted properties as present.
+ */
+BOOL jsdisp_has_id(jsdisp_t *jsdisp, DISPID id)
+{
+    return get_prop(jsdisp, id) != NULL;
+}
+
+/*
+ * Returns TRUE if the object's shape determines failed lookups as well, which
+ * is not the case for dictionary shapes and objects inheriting properties or
+ * exposing index properties.
+ */
+BOOL jsdisp_can_cache_miss(jsdisp_t *jsdisp)
+{
+    return jsdisp->shape && !jsdisp->shape->dictionary && !jsdisp->prototype
+        && !jsdisp->builtin_info->idx_length;
+}
+
 HRESULT jsdisp_call_value(jsdisp_t *jsfunc, IDispatch *jsthis, WORD flags, unsigned argc, jsval_t *argv, jsval_t *r)
 {
     HRESULT hres;
@@ -1475,7 +1645,7 @@ HRESULT jsdisp_delete_idx(jsdisp_t *obj, DWORD idx)
     if(FAILED(hres) || !prop)
         return hres;
 
-    return delete_prop(prop, &b);
+    return delete_prop(obj, prop, &b);
 }
 
 HRESULT disp_delete(IDispatch *disp, DISPID id, BOOL *ret)
@@ -1490,7 +1660,7 @@ HRESULT disp_delete(IDispatch *disp, DISPID id, BOOL *ret)
 
         prop = get_prop(jsdisp, id);
         if(prop)
-            hres = delete_prop(prop, ret);
+            hres = delete_prop(jsdisp, prop, ret);
         else
             hres = DISP_E_MEMBERNOTFOUND;
 
@@ -1533,7 +1703,7 @@ HRESULT disp_delete_name(script_ctx_t *ctx, IDispatch *disp, jsstr_t *name, BOOL
 
         hres = find_prop_name(jsdisp, string_hash(ptr), ptr, &prop);
         if(prop) {
-            hres = delete_prop(prop, ret);
+            hres = delete_prop(jsdisp, prop, ret);
         }else {
             *ret = TRUE;
             hres = S_OK;
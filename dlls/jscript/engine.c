@@ -624,18 +624,172 @@ local_ref_t *lookup_local(const function_code_t *function, const WCHAR *identifi
     return bsearch(identifier, function->locals, function->locals_cnt, sizeof(*function->locals), local_ref_cmp);
 }
 
+void release_prop_cache(prop_cache_t *cache)
+{
+    unsigned i;
+
+    for(i=0; i < PROP_CACHE_SIZE; i++)
+        shape_release(cache->entries[i].shape);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static BOOL prop_cache_lookup(prop_cache_t *cache, jsdisp_t *jsdisp, DISPID *id)
+{
+    prop_cache_entry_t *entry;
+
+    if(!jsdisp->shape)
+        return FALSE;
+
+    for(entry = cache->entries; entry < cache->entries+PROP_CACHE_SIZE && entry->shape; entry++) {
+        if(entry->shape == jsdisp->shape) {
+            if(!jsdisp_has_id(jsdisp, entry->id))
+                return FALSE;
+
+            *id = entry->id;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void prop_cache_insert(prop_cache_t *cache, jsdisp_t *jsdisp, DISPID id)
+{
+    prop_cache_entry_t *entry;
+
+    if(!jsdisp->shape)
+        return;
+
+    for(entry = cache->entries; entry < cache->entries+PROP_CACHE_SIZE && entry->shape; entry++) {
+        if(entry->shape == jsdisp->shape) {
+            entry->id = id;
+            return;
+        }
+    }
+
+    /* The most recently seen shape goes first, evicting the oldest one if the cache is full. */
+    shape_release(cache->entries[PROP_CACHE_SIZE-1].shape);
+    memmove(cache->entries+1, cache->entries, (PROP_CACHE_SIZE-1)*sizeof(*cache->entries));
+    cache->entries[0].shape = shape_addref(jsdisp->shape);
+    cache->entries[0].id = id;
+}
+
+static HRESULT disp_get_id_cached(script_ctx_t *ctx, IDispatch *disp, const WCHAR *name, BSTR name_bstr, DWORD flags,
+        prop_cache_t *cache, DISPID *id)
+{
+    jsdisp_t *jsdisp;
+    HRESULT hres;
+
+    jsdisp = cache ? to_jsdisp(disp) : NULL;
+    if(!jsdisp)
+        return disp_get_id(ctx, disp, name, name_bstr, flags, id);
+
+    if(prop_cache_lookup(cache, jsdisp, id))
+        return S_OK;
+
+    hres = jsdisp_get_id(jsdisp, name, flags, id);
+    if(SUCCEEDED(hres))
+        prop_cache_insert(cache, jsdisp, *id);
+    return hres;
+}
+
+void release_ident_cache(ident_cache_t *cache)
+{
+    unsigned i;
+
+    for(i=0; i <= IDENT_CACHE_DEPTH; i++)
+        shape_release(cache->scopes[i].shape);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static inline const function_code_t *scope_function(scope_chain_t *scope)
+{
+    return scope->frame ? scope->frame->function : NULL;
+}
+
+static BOOL ident_cache_lookup(script_ctx_t *ctx, ident_cache_t *cache, exprval_t *ret)
+{
+    scope_chain_t *scope = ctx->call_ctx->scope;
+    const ident_cache_scope_t *cached = cache->scopes;
+
+    if(cache->type == IDENT_CACHE_EMPTY)
+        return FALSE;
+
+    /* Scopes skipped by the cached lookup still need to have the same shape and locals. */
+    for(; cached < cache->scopes+cache->depth; cached++, scope = scope->next) {
+        if(!scope || !scope->jsobj || scope->jsobj->shape != cached->shape || scope->jsobj->prototype
+           || scope_function(scope) != cached->function)
+            return FALSE;
+    }
+
+    switch(cache->type) {
+    case IDENT_CACHE_LOCAL:
+        if(!scope || !scope->frame || scope->frame->function != cached->function)
+            return FALSE;
+
+        ret->type = EXPRVAL_STACK_REF;
+        ret->u.off = local_off(scope->frame, cache->ref);
+        return TRUE;
+    case IDENT_CACHE_PROP:
+        if(!scope || !scope->jsobj || scope->jsobj->shape != cached->shape
+           || scope_function(scope) != cached->function || !jsdisp_has_id(scope->jsobj, cache->ref))
+            return FALSE;
+
+        exprval_set_disp_ref(ret, scope->obj, cache->ref);
+        return TRUE;
+    case IDENT_CACHE_GLOBAL:
+        if(scope || ctx->global->shape != cached->shape || !jsdisp_has_id(ctx->global, cache->ref))
+            return FALSE;
+
+        exprval_set_disp_ref(ret, to_disp(ctx->global), cache->ref);
+        return TRUE;
+    DEFAULT_UNREACHABLE;
+    }
+
+    return FALSE;
+}
+
+static void ident_cache_fill(script_ctx_t *ctx, ident_cache_t *cache, ident_cache_type_t type, unsigned depth,
+        jsdisp_t *obj, int ref)
+{
+    scope_chain_t *scope = ctx->call_ctx->scope;
+    unsigned i;
+
+    release_ident_cache(cache);
+
+    if(obj && !obj->shape)
+        return;
+
+    for(i=0; i < depth; i++, scope = scope->next) {
+        cache->scopes[i].function = scope_function(scope);
+        cache->scopes[i].shape = shape_addref(scope->jsobj->shape);
+    }
+
+    if(scope)
+        cache->scopes[depth].function = scope_function(scope);
+    if(obj)
+        cache->scopes[depth].shape = shape_addref(obj->shape);
+    cache->type = type;
+    cache->depth = depth;
+    cache->ref = ref;
+}
+
 /* ECMA-262 3rd Edition    10.1.4 */
-static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *ret)
+static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, ident_cache_t *cache, exprval_t *ret)
 {
     scope_chain_t *scope;
     named_item_t *item;
+    unsigned depth = 0;
     DISPID id = 0;
     HRESULT hres;
 
     TRACE("%s\n", debugstr_w(identifier));
 
     if(ctx->call_ctx) {
-        for(scope = ctx->call_ctx->scope; scope; scope = scope->next) {
+        if(cache && ident_cache_lookup(ctx, cache, ret))
+            return S_OK;
+
+        for(scope = ctx->call_ctx->scope; scope; scope = scope->next, depth++) {
             if(scope->frame) {
                 function_code_t *func = scope->frame->function;
                 local_ref_t *ref = lookup_local(func, identifier);
@@ -645,10 +799,14 @@ static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *re
                     ret->type = EXPRVAL_STACK_REF;
                     ret->u.off = local_off(scope->frame, ref->ref);
                     TRACE("returning ref %d for %d\n", ret->u.off, ref->ref);
+                    if(cache)
+                        ident_cache_fill(ctx, cache, IDENT_CACHE_LOCAL, depth, NULL, ref->ref);
                     return S_OK;
                 }
 
                 if(!strcmpW(identifier, argumentsW)) {
+                    /* Looking up arguments has side effects, so it's never cached. */
+                    cache = NULL;
                     hres = detach_variable_object(ctx, scope->frame, FALSE);
                     if(FAILED(hres))
                         return hres;
@@ -659,14 +817,23 @@ static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *re
             else
                 hres = disp_get_id(ctx, scope->obj, identifier, identifier, fdexNameImplicit, &id);
             if(SUCCEEDED(hres)) {
+                if(cache && scope->jsobj)
+                    ident_cache_fill(ctx, cache, IDENT_CACHE_PROP, depth, scope->jsobj, id);
                 exprval_set_disp_ref(ret, scope->obj, id);
                 return S_OK;
             }
+
+            if(depth == IDENT_CACHE_DEPTH || !scope->jsobj || !jsdisp_can_cache_miss(scope->jsobj))
+                cache = NULL;
         }
+    }else {
+        cache = NULL;
     }
 
     hres = jsdisp_get_id(ctx->global, identifier, 0, &id);
     if(SUCCEEDED(hres)) {
+        if(cache)
+            ident_cache_fill(ctx, cache, IDENT_CACHE_GLOBAL, depth, ctx->global, id);
         exprval_set_disp_ref(ret, to_disp(ctx->global), id);
         return S_OK;
     }
@@ -708,6 +875,20 @@ static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *re
     return S_OK;
 }
 
+static inline prop_cache_t *get_op_prop_cache(script_ctx_t *ctx)
+{
+    call_frame_t *frame = ctx->call_ctx;
+    unsigned cache = frame->bytecode->instrs[frame->ip].cache;
+    return cache ? frame->bytecode->prop_caches+cache : NULL;
+}
+
+static inline ident_cache_t *get_op_ident_cache(script_ctx_t *ctx)
+{
+    call_frame_t *frame = ctx->call_ctx;
+    unsigned cache = frame->bytecode->instrs[frame->ip].cache;
+    return cache ? frame->bytecode->ident_caches+cache : NULL;
+}
+
 static inline BSTR get_op_bstr(script_ctx_t *ctx, int i)
 {
     call_frame_t *frame = ctx->call_ctx;
@@ -1071,7 +1252,7 @@ static HRESULT interp_member(script_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    hres = disp_get_id(ctx, obj, arg, arg, 0, &id);
+    hres = disp_get_id_cached(ctx, obj, arg, arg, 0, get_op_prop_cache(ctx), &id);
     if(SUCCEEDED(hres)) {
         hres = disp_propget(ctx, obj, id, &v);
     }else if(hres == DISP_E_UNKNOWNNAME) {
@@ -1113,7 +1294,7 @@ static HRESULT interp_memberid(script_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    hres = disp_get_id(ctx, obj, name, NULL, arg, &id);
+    hres = disp_get_id_cached(ctx, obj, name, NULL, arg, get_op_prop_cache(ctx), &id);
     jsstr_release(name_str);
     if(SUCCEEDED(hres)) {
         ref.type = EXPRVAL_IDREF;
@@ -1225,12 +1406,12 @@ static HRESULT interp_this(script_ctx_t *ctx)
     return stack_push(ctx, jsval_disp(frame->this_obj));
 }
 
-static HRESULT interp_identifier_ref(script_ctx_t *ctx, BSTR identifier, unsigned flags)
+static HRESULT interp_identifier_ref(script_ctx_t *ctx, BSTR identifier, ident_cache_t *cache, unsigned flags)
 {
     exprval_t exprval;
     HRESULT hres;
 
-    hres = identifier_eval(ctx, identifier, &exprval);
+    hres = identifier_eval(ctx, identifier, cache, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -1253,13 +1434,13 @@ static HRESULT interp_identifier_ref(script_ctx_t *ctx, BSTR identifier, unsigne
     return stack_push_exprval(ctx, &exprval);
 }
 
-static HRESULT identifier_value(script_ctx_t *ctx, BSTR identifier)
+static HRESULT identifier_value(script_ctx_t *ctx, BSTR identifier, ident_cache_t *cache)
 {
     exprval_t exprval;
     jsval_t v;
     HRESULT hres;
 
-    hres = identifier_eval(ctx, identifier, &exprval);
+    hres = identifier_eval(ctx, identifier, cache, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -1283,7 +1464,7 @@ static HRESULT interp_local_ref(script_ctx_t *ctx)
     TRACE("%d\n", arg);
 
     if(!frame->base_scope || !frame->base_scope->frame)
-        return interp_identifier_ref(ctx, local_name(frame, arg), flags);
+        return interp_identifier_ref(ctx, local_name(frame, arg), NULL, flags);
 
     ref.type = EXPRVAL_STACK_REF;
     ref.u.off = local_off(frame, arg);
@@ -1300,7 +1481,7 @@ static HRESULT interp_local(script_ctx_t *ctx)
     TRACE("%d\n", arg);
 
     if(!frame->base_scope || !frame->base_scope->frame)
-        return identifier_value(ctx, local_name(frame, arg));
+        return identifier_value(ctx, local_name(frame, arg), NULL);
 
     hres = jsval_copy(ctx->stack[local_off(frame, arg)], &copy);
     if(FAILED(hres))
@@ -1316,7 +1497,7 @@ static HRESULT interp_ident(script_ctx_t *ctx)
 
     TRACE("%s\n", debugstr_w(arg));
 
-    return identifier_value(ctx, arg);
+    return identifier_value(ctx, arg, get_op_ident_cache(ctx));
 }
 
 /* ECMA-262 3rd Edition    10.1.4 */
@@ -1327,7 +1508,7 @@ static HRESULT interp_identid(script_ctx_t *ctx)
 
     TRACE("%s %x\n", debugstr_w(arg), flags);
 
-    return interp_identifier_ref(ctx, arg, flags);
+    return interp_identifier_ref(ctx, arg, get_op_ident_cache(ctx), flags);
 }
 
 /* ECMA-262 3rd Edition    7.8.1 */
@@ -1852,7 +2033,7 @@ static HRESULT interp_delete_ident(script_ctx_t *ctx)
 
     TRACE("%s\n", debugstr_w(arg));
 
-    hres = identifier_eval(ctx, arg, &exprval);
+    hres = identifier_eval(ctx, arg, NULL, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -1963,7 +2144,7 @@ static HRESULT interp_typeofident(script_ctx_t *ctx)
 
     TRACE("%s\n", debugstr_w(arg));
 
-    hres = identifier_eval(ctx, arg, &exprval);
+    hres = identifier_eval(ctx, arg, NULL, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -2820,7 +3001,7 @@ static HRESULT bind_event_target(script_ctx_t *ctx, function_code_t *func, jsdis
     jsval_t v;
     HRESULT hres;
 
-    hres = identifier_eval(ctx, func->event_target, &exprval);
+    hres = identifier_eval(ctx, func->event_target, NULL, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -122,6 +122,7 @@ typedef enum {
 
 typedef struct {
     jsop_t op;
+    unsigned cache; /* inline cache index, 0 if the instruction has none */
     union {
         instr_arg_t arg[2];
         double dbl;
@@ -160,6 +161,48 @@ typedef struct _function_code_t {
 
 local_ref_t *lookup_local(const function_code_t*,const WCHAR*) DECLSPEC_HIDDEN;
 
+/*
+ * Per-instruction inline caches. A property cache maps the shapes of the
+ * objects seen by a member access to the DISPID of the property. An
+ * identifier cache remembers the scope an identifier was resolved in,
+ * together with what's needed to validate that the scopes before it still
+ * don't contain the identifier.
+ */
+#define PROP_CACHE_SIZE 4
+
+typedef struct {
+    dispex_shape_t *shape;
+    DISPID id;
+} prop_cache_entry_t;
+
+typedef struct {
+    prop_cache_entry_t entries[PROP_CACHE_SIZE];
+} prop_cache_t;
+
+#define IDENT_CACHE_DEPTH 3
+
+typedef enum {
+    IDENT_CACHE_EMPTY,
+    IDENT_CACHE_LOCAL,
+    IDENT_CACHE_PROP,
+    IDENT_CACHE_GLOBAL
+} ident_cache_type_t;
+
+typedef struct {
+    const function_code_t *function;
+    dispex_shape_t *shape;
+} ident_cache_scope_t;
+
+typedef struct {
+    ident_cache_type_t type;
+    unsigned depth;
+    ident_cache_scope_t scopes[IDENT_CACHE_DEPTH+1];
+    int ref;
+} ident_cache_t;
+
+void release_prop_cache(prop_cache_t*) DECLSPEC_HIDDEN;
+void release_ident_cache(ident_cache_t*) DECLSPEC_HIDDEN;
+
 typedef struct _bytecode_t {
     LONG ref;
 
@@ -178,6 +221,11 @@ typedef struct _bytecode_t {
     unsigned str_pool_size;
     unsigned str_cnt;
 
+    prop_cache_t *prop_caches;
+    unsigned prop_cache_cnt;
+    ident_cache_t *ident_caches;
+    unsigned ident_cache_cnt;
+
     struct _bytecode_t *next;
 } bytecode_t;
 
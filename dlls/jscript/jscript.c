@@ -72,6 +72,8 @@ void script_release(script_ctx_t *ctx)
     if(ctx->cc)
         release_cc(ctx->cc);
     heap_pool_free(&ctx->tmp_heap);
+    release_shape_roots(ctx);
+    release_regexp_cache(ctx);
     if(ctx->last_match)
         jsstr_release(ctx->last_match);
     assert(!ctx->stack_top);
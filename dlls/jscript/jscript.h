@@ -37,6 +37,7 @@ typedef struct _jsval_t jsval_t;
 typedef struct _jsstr_t jsstr_t;
 typedef struct _script_ctx_t script_ctx_t;
 typedef struct _dispex_prop_t dispex_prop_t;
+typedef struct _dispex_shape_t dispex_shape_t;
 
 typedef struct {
     void **blocks;
@@ -228,6 +229,7 @@ struct jsdisp_t {
     DWORD buf_size;
     DWORD prop_cnt;
     dispex_prop_t *props;
+    dispex_shape_t *shape;
     script_ctx_t *ctx;
 
     jsdisp_t *prototype;
@@ -296,6 +298,12 @@ HRESULT disp_delete_name(script_ctx_t*,IDispatch*,jsstr_t*,BOOL*) DECLSPEC_HIDDE
 HRESULT jsdisp_delete_idx(jsdisp_t*,DWORD) DECLSPEC_HIDDEN;
 HRESULT jsdisp_is_own_prop(jsdisp_t*,const WCHAR*,BOOL*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_is_enumerable(jsdisp_t*,const WCHAR*,BOOL*) DECLSPEC_HIDDEN;
+BOOL jsdisp_has_id(jsdisp_t*,DISPID) DECLSPEC_HIDDEN;
+BOOL jsdisp_can_cache_miss(jsdisp_t*) DECLSPEC_HIDDEN;
+
+dispex_shape_t *shape_addref(dispex_shape_t*) DECLSPEC_HIDDEN;
+void shape_release(dispex_shape_t*) DECLSPEC_HIDDEN;
+void release_shape_roots(script_ctx_t*) DECLSPEC_HIDDEN;
 
 HRESULT create_builtin_function(script_ctx_t*,builtin_invoke_t,const WCHAR*,const builtin_info_t*,DWORD,
         jsdisp_t*,jsdisp_t**) DECLSPEC_HIDDEN;
@@ -386,6 +394,14 @@ typedef struct {
     unsigned length;
 } match_result_t;
 
+#define REGEXP_CACHE_SIZE 16
+
+typedef struct {
+    jsstr_t *src;
+    DWORD flags;
+    struct regexp_t *regexp;
+} regexp_cache_entry_t;
+
 struct _script_ctx_t {
     LONG ref;
 
@@ -416,6 +432,11 @@ struct _script_ctx_t {
     DWORD last_match_index;
     DWORD last_match_length;
 
+    dispex_shape_t *shape_roots[16];
+
+    regexp_cache_entry_t regexp_cache[REGEXP_CACHE_SIZE];
+    unsigned regexp_cache_next;
+
     jsdisp_t *global;
     jsdisp_t *function_constr;
     jsdisp_t *array_constr;
@@ -471,6 +492,7 @@ struct match_state_t;
 HRESULT regexp_match_next(script_ctx_t*,jsdisp_t*,DWORD,jsstr_t*,struct match_state_t**) DECLSPEC_HIDDEN;
 HRESULT parse_regexp_flags(const WCHAR*,DWORD,DWORD*) DECLSPEC_HIDDEN;
 HRESULT regexp_string_match(script_ctx_t*,jsdisp_t*,jsstr_t*,jsval_t*) DECLSPEC_HIDDEN;
+void release_regexp_cache(script_ctx_t*) DECLSPEC_HIDDEN;
 
 BOOL bool_obj_value(jsdisp_t*) DECLSPEC_HIDDEN;
 unsigned array_get_length(jsdisp_t*) DECLSPEC_HIDDEN;
@@ -599,7 +599,7 @@ static void RegExp_destructor(jsdisp_t *dispex)
     RegExpInstance *This = regexp_from_jsdisp(dispex);
 
     if(This->jsregexp)
-        regexp_destroy(This->jsregexp);
+        regexp_release(This->jsregexp);
     jsval_release(This->last_index_val);
     jsstr_release(This->str);
     heap_free(This);
@@ -665,8 +665,55 @@ static HRESULT alloc_regexp(script_ctx_t *ctx, jsdisp_t *object_prototype, RegEx
     return S_OK;
 }
 
+/*
+ * Compiled expressions are immutable, so instances created from the same source and flags (like
+ * a regular expression literal evaluated in a loop) share them through a small per-context cache.
+ * The cached source string is shared as well, because the compiled expression refers to its buffer.
+ */
+static regexp_cache_entry_t *lookup_regexp_cache(script_ctx_t *ctx, jsstr_t *src, DWORD flags)
+{
+    regexp_cache_entry_t *entry;
+
+    for(entry = ctx->regexp_cache; entry < ctx->regexp_cache + REGEXP_CACHE_SIZE; entry++) {
+        if(entry->regexp && entry->flags == flags && (entry->src == src || jsstr_eq(entry->src, src)))
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void add_regexp_cache(script_ctx_t *ctx, jsstr_t *src, DWORD flags, regexp_t *regexp)
+{
+    regexp_cache_entry_t *entry = ctx->regexp_cache + ctx->regexp_cache_next;
+
+    if(entry->regexp) {
+        regexp_release(entry->regexp);
+        jsstr_release(entry->src);
+    }
+
+    entry->src = jsstr_addref(src);
+    entry->flags = flags;
+    entry->regexp = regexp_addref(regexp);
+    ctx->regexp_cache_next = (ctx->regexp_cache_next + 1) % REGEXP_CACHE_SIZE;
+}
+
+void release_regexp_cache(script_ctx_t *ctx)
+{
+    unsigned i;
+
+    for(i = 0; i < REGEXP_CACHE_SIZE; i++) {
+        if(!ctx->regexp_cache[i].regexp)
+            continue;
+
+        regexp_release(ctx->regexp_cache[i].regexp);
+        jsstr_release(ctx->regexp_cache[i].src);
+        ctx->regexp_cache[i].regexp = NULL;
+    }
+}
+
 HRESULT create_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsdisp_t **ret)
 {
+    regexp_cache_entry_t *cache_entry;
     RegExpInstance *regexp;
     const WCHAR *str;
     HRESULT hres;
@@ -681,9 +728,18 @@ HRESULT create_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsdisp_t **r
     if(FAILED(hres))
         return hres;
 
-    regexp->str = jsstr_addref(src);
     regexp->last_index_val = jsval_number(0);
 
+    cache_entry = lookup_regexp_cache(ctx, src, flags);
+    if(cache_entry) {
+        regexp->str = jsstr_addref(cache_entry->src);
+        regexp->jsregexp = regexp_addref(cache_entry->regexp);
+        *ret = &regexp->dispex;
+        return S_OK;
+    }
+
+    regexp->str = jsstr_addref(src);
+
     regexp->jsregexp = regexp_new(ctx, &ctx->tmp_heap, str, jsstr_length(regexp->str), flags, FALSE);
     if(!regexp->jsregexp) {
         WARN("regexp_new failed\n");
@@ -691,6 +747,8 @@ HRESULT create_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsdisp_t **r
         return E_FAIL;
     }
 
+    add_regexp_cache(ctx, src, flags, regexp->jsregexp);
+
     *ret = &regexp->dispex;
     return S_OK;
 }
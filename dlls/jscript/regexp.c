@@ -352,6 +352,44 @@ static BOOL ParseRegExp(CompilerState*);
  */
 #define CLASS_BITMAPS_MEM_LIMIT (1 << 24)
 
+/*
+ * Regular expressions without backreferences and lookahead assertions are
+ * also compiled into a Thompson NFA. The NFA is simulated over the input
+ * before the backtracking matcher runs, to find the first position where a
+ * match starts (or to fail without backtracking at all). Simple ops reuse
+ * the bytecode representation and SimpleMatch.
+ */
+#define NFA_LENGTH_MAX  1024
+#define NFA_DEPTH_MAX   64
+#define NFA_NO_TARGET   (~0u)
+
+typedef enum {
+    NFA_CHAR,                       /* consumes a char matching code */
+    NFA_TEST,                       /* zero-width assertion in code */
+    NFA_SPLIT,                      /* continue at both next and alt */
+    NFA_JUMP,                       /* continue at next */
+    NFA_MATCH
+} RENFAOp;
+
+typedef struct RENFAInstr {
+    RENFAOp op;
+    UINT next;
+    UINT alt;
+    jsbytecode code[6];             /* simple op followed by its operands */
+} RENFAInstr;
+
+typedef struct NFACompilerState {
+    RENFAInstr *instrs;
+    UINT length;
+    UINT depth;
+    WORD flags;
+} NFACompilerState;
+
+typedef struct NFAThread {
+    UINT pc;
+    const WCHAR *start;             /* where the match of this thread began */
+} NFAThread;
+
 /*
  * Functions to get size and write/read bytecode that represent small indexes
  * compactly.
@@ -3070,18 +3108,172 @@ good:
     return x;
 }
 
+/*
+ * Skip to the next occurrence of the first character of any match.
+ */
+static inline const WCHAR *
+FindFirstChar(regexp_t *re, const WCHAR *cp, const WCHAR *cpend)
+{
+    WCHAR ch;
+
+    if (!(re->flags & REG_FOLD))
+        return memchrW(cp, re->firstChar, cpend - cp);
+
+    ch = toupperW(re->firstChar);
+    for (; cp < cpend; cp++) {
+        if (toupperW(*cp) == ch)
+            return cp;
+    }
+    return NULL;
+}
+
+static inline BOOL
+NFASimpleMatch(REGlobalData *gData, RENFAInstr *instr, const WCHAR *cp)
+{
+    match_state_t x;
+    jsbytecode *pc = instr->code + 1;
+
+    x.cp = cp;
+    return SimpleMatch(gData, &x, instr->code[0], &pc, FALSE) != NULL;
+}
+
+/*
+ * Add the thread at pc and everything reachable from it without consuming
+ * input to list. Each instruction is added at most once per position, so the
+ * thread that got there first, the one with the earliest start, wins.
+ */
+static void
+NFAAddThread(REGlobalData *gData, NFAThread *list, UINT *count, UINT *stack,
+             size_t *marks, size_t gen, UINT pc, const WCHAR *start,
+             const WCHAR *cp)
+{
+    RENFAInstr *nfa = gData->regexp->nfa;
+    UINT sp = 0;
+
+    if (marks[pc] == gen)
+        return;
+    marks[pc] = gen;
+    stack[sp++] = pc;
+
+    while (sp) {
+        RENFAInstr *instr = nfa + stack[--sp];
+
+        switch (instr->op) {
+          case NFA_CHAR:
+          case NFA_MATCH:
+            list[*count].pc = instr - nfa;
+            list[*count].start = start;
+            (*count)++;
+            continue;
+          case NFA_TEST:
+            if (!NFASimpleMatch(gData, instr, cp))
+                continue;
+            break;
+          case NFA_SPLIT:
+            if (marks[instr->alt] != gen) {
+                marks[instr->alt] = gen;
+                stack[sp++] = instr->alt;
+            }
+            break;
+          case NFA_JUMP:
+            break;
+        }
+
+        if (marks[instr->next] != gen) {
+            marks[instr->next] = gen;
+            stack[sp++] = instr->next;
+        }
+    }
+}
+
+/*
+ * Simulate the NFA from cp and return the leftmost position where a match
+ * starts, or NULL if there is no match. Threads are kept ordered by their
+ * start position, so once a thread matches, all threads behind it may be
+ * dropped and no new ones need to be started.
+ */
+static const WCHAR *
+NFAFindStart(REGlobalData *gData, const WCHAR *cp)
+{
+    regexp_t *re = gData->regexp;
+    NFAThread *clist, *nlist, *tmp;
+    UINT ccount = 0, ncount, i;
+    const WCHAR *best = NULL;
+    const WCHAR *pos;
+    size_t *marks;
+    UINT *stack;
+
+    clist = heap_pool_alloc(gData->pool, 2 * re->nfaLength * sizeof(NFAThread));
+    stack = heap_pool_alloc(gData->pool, re->nfaLength * sizeof(UINT));
+    marks = heap_pool_alloc(gData->pool, re->nfaLength * sizeof(size_t));
+    if (!clist || !stack || !marks)
+        return cp;
+    nlist = clist + re->nfaLength;
+    memset(marks, 0, re->nfaLength * sizeof(size_t));
+
+    for (pos = cp; ; pos++) {
+        if (!best) {
+            if (!ccount && re->hasFirstChar) {
+                pos = FindFirstChar(re, pos, gData->cpend);
+                if (!pos)
+                    break;
+            }
+            NFAAddThread(gData, clist, &ccount, stack, marks, pos - cp + 1, 0,
+                         pos, pos);
+        }
+        if (!ccount && (best || pos == gData->cpend))
+            break;
+
+        ncount = 0;
+        for (i = 0; i < ccount; i++) {
+            RENFAInstr *instr = re->nfa + clist[i].pc;
+
+            if (instr->op == NFA_MATCH) {
+                best = clist[i].start;
+                break;
+            }
+            if (pos != gData->cpend && NFASimpleMatch(gData, instr, pos)) {
+                NFAAddThread(gData, nlist, &ncount, stack, marks, pos - cp + 2,
+                             instr->next, clist[i].start, pos + 1);
+            }
+        }
+        if (pos == gData->cpend)
+            break;
+
+        tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+        ccount = ncount;
+    }
+
+    TRACE("NFA start %d\n", best ? (int)(best - cp) : -1);
+    return best;
+}
+
 static match_state_t *MatchRegExp(REGlobalData *gData, match_state_t *x)
 {
     match_state_t *result;
     const WCHAR *cp = x->cp;
-    const WCHAR *cp2;
+    const WCHAR *cp2 = cp;
     UINT j;
 
+    if (!(gData->regexp->flags & REG_STICKY) && gData->regexp->nfa) {
+        cp2 = NFAFindStart(gData, cp);
+        if (!cp2)
+            return NULL;
+    }
+
     /*
      * Have to include the position beyond the last character
      * in order to detect end-of-input/line condition.
      */
-    for (cp2 = cp; cp2 <= gData->cpend; cp2++) {
+    for (; cp2 <= gData->cpend; cp2++) {
+        if (gData->regexp->hasFirstChar &&
+            !(gData->regexp->flags & REG_STICKY)) {
+            cp2 = FindFirstChar(gData->regexp, cp2, gData->cpend);
+            if (!cp2)
+                return NULL;
+        }
         gData->skipped = cp2 - cp;
         x->cp = cp2;
         for (j = 0; j < gData->regexp->parenCount; j++)
@@ -3178,8 +3370,11 @@ HRESULT regexp_execute(regexp_t *regexp, void *cx, heap_pool_t *pool,
     return S_OK;
 }
 
-void regexp_destroy(regexp_t *re)
+void regexp_release(regexp_t *re)
 {
+    if (--re->ref)
+        return;
+
     if (re->classList) {
         UINT i;
         for (i = 0; i < re->classCount; i++) {
@@ -3189,9 +3384,245 @@ void regexp_destroy(regexp_t *re)
         }
         heap_free(re->classList);
     }
+    heap_free(re->nfa);
     heap_free(re);
 }
 
+static BOOL
+NFAEmit(NFACompilerState *nfa, RENFAOp op, UINT *ret)
+{
+    RENFAInstr *instr;
+
+    if (nfa->length == NFA_LENGTH_MAX)
+        return FALSE;
+
+    instr = nfa->instrs + nfa->length;
+    instr->op = op;
+    instr->next = nfa->length + 1;
+    instr->alt = NFA_NO_TARGET;
+    if (ret)
+        *ret = nfa->length;
+    nfa->length++;
+    return TRUE;
+}
+
+static BOOL
+NFAEmitSimple(NFACompilerState *nfa, RENFAOp op, REOp reop)
+{
+    UINT i;
+
+    if (!NFAEmit(nfa, op, &i))
+        return FALSE;
+    nfa->instrs[i].code[0] = reop;
+    return TRUE;
+}
+
+static BOOL
+NFAEmitChar(NFACompilerState *nfa, WCHAR chr)
+{
+    RENFAInstr *instr;
+    UINT i;
+
+    if (!NFAEmit(nfa, NFA_CHAR, &i))
+        return FALSE;
+    instr = nfa->instrs + i;
+    if (chr < 256) {
+        instr->code[0] = (nfa->flags & REG_FOLD) ? REOP_FLAT1i : REOP_FLAT1;
+        instr->code[1] = (jsbytecode) chr;
+    } else {
+        instr->code[0] = (nfa->flags & REG_FOLD) ? REOP_UCFLAT1i : REOP_UCFLAT1;
+        SET_ARG(instr->code + 1, chr);
+    }
+    return TRUE;
+}
+
+static BOOL NFACompileList(NFACompilerState*, RENode*);
+
+static BOOL
+NFACompileNode(NFACompilerState *nfa, RENode *t)
+{
+    UINT i, start, split, jump;
+    size_t count;
+
+    switch (t->op) {
+      case REOP_EMPTY:
+        return TRUE;
+
+      case REOP_BOL:
+      case REOP_EOL:
+      case REOP_WBDRY:
+      case REOP_WNONBDRY:
+        return NFAEmitSimple(nfa, NFA_TEST, t->op);
+
+      case REOP_DOT:
+      case REOP_DIGIT:
+      case REOP_NONDIGIT:
+      case REOP_ALNUM:
+      case REOP_NONALNUM:
+      case REOP_SPACE:
+      case REOP_NONSPACE:
+        return NFAEmitSimple(nfa, NFA_CHAR, t->op);
+
+      case REOP_FLAT:
+        if (t->kid && t->u.flat.length > 1) {
+            for (count = 0; count < t->u.flat.length; count++) {
+                if (!NFAEmitChar(nfa, ((WCHAR*)t->kid)[count]))
+                    return FALSE;
+            }
+            return TRUE;
+        }
+        return NFAEmitChar(nfa, t->u.flat.chr);
+
+      case REOP_CLASS:
+        if (GetCompactIndexWidth(t->u.ucclass.index) > 4 ||
+            !NFAEmitSimple(nfa, NFA_CHAR,
+                           t->u.ucclass.sense ? REOP_CLASS : REOP_NCLASS))
+            return FALSE;
+        WriteCompactIndex(nfa->instrs[nfa->length - 1].code + 1,
+                          t->u.ucclass.index);
+        return TRUE;
+
+      case REOP_LPAREN:
+      case REOP_LPARENNON:
+      case REOP_ALT:
+      case REOP_ALTPREREQ:
+      case REOP_ALTPREREQ2:
+      case REOP_QUANT:
+        break;
+
+      default:
+        /* Backreferences and assertions are left to the backtracking matcher. */
+        return FALSE;
+    }
+
+    if (nfa->depth == NFA_DEPTH_MAX)
+        return FALSE;
+    nfa->depth++;
+
+    switch (t->op) {
+      case REOP_LPAREN:
+      case REOP_LPARENNON:
+        if (!NFACompileList(nfa, t->kid))
+            return FALSE;
+        break;
+
+      case REOP_ALT:
+      case REOP_ALTPREREQ:
+      case REOP_ALTPREREQ2:
+        if (!NFAEmit(nfa, NFA_SPLIT, &split) ||
+            !NFACompileList(nfa, t->kid) ||
+            !NFAEmit(nfa, NFA_JUMP, &jump))
+            return FALSE;
+        nfa->instrs[split].alt = nfa->length;
+        if (!NFACompileList(nfa, t->u.kid2))
+            return FALSE;
+        nfa->instrs[jump].next = nfa->length;
+        break;
+
+      case REOP_QUANT:
+        if (t->u.range.min > NFA_LENGTH_MAX)
+            return FALSE;
+        for (i = 0; i < t->u.range.min; i++) {
+            if (!NFACompileList(nfa, t->kid))
+                return FALSE;
+        }
+
+        if (t->u.range.max == (UINT)-1) {
+            if (!NFAEmit(nfa, NFA_SPLIT, &split) ||
+                !NFACompileList(nfa, t->kid) ||
+                !NFAEmit(nfa, NFA_JUMP, &jump))
+                return FALSE;
+            nfa->instrs[jump].next = split;
+            nfa->instrs[split].alt = nfa->length;
+            break;
+        }
+
+        if (t->u.range.max - t->u.range.min > NFA_LENGTH_MAX)
+            return FALSE;
+        start = nfa->length;
+        for (; i < t->u.range.max; i++) {
+            if (!NFAEmit(nfa, NFA_SPLIT, &split) ||
+                !NFACompileList(nfa, t->kid))
+                return FALSE;
+        }
+        for (i = start; i < nfa->length; i++) {
+            if (nfa->instrs[i].op == NFA_SPLIT &&
+                nfa->instrs[i].alt == NFA_NO_TARGET)
+                nfa->instrs[i].alt = nfa->length;
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    nfa->depth--;
+    return TRUE;
+}
+
+static BOOL
+NFACompileList(NFACompilerState *nfa, RENode *t)
+{
+    for (; t; t = t->next) {
+        if (!NFACompileNode(nfa, t))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Compile the parse tree into an NFA, see NFAFindStart. Returns FALSE if the
+ * expression is not suitable for it.
+ */
+static BOOL
+CompileNFA(CompilerState *state, regexp_t *re)
+{
+    NFACompilerState nfa;
+
+    nfa.instrs = heap_pool_alloc(state->pool, NFA_LENGTH_MAX * sizeof(RENFAInstr));
+    if (!nfa.instrs)
+        return FALSE;
+    nfa.length = 0;
+    nfa.depth = 0;
+    nfa.flags = state->flags;
+
+    if (!NFACompileList(&nfa, state->result) || !NFAEmit(&nfa, NFA_MATCH, NULL))
+        return FALSE;
+
+    re->nfa = heap_alloc(nfa.length * sizeof(RENFAInstr));
+    if (!re->nfa)
+        return FALSE;
+    memcpy(re->nfa, nfa.instrs, nfa.length * sizeof(RENFAInstr));
+    re->nfaLength = nfa.length;
+    return TRUE;
+}
+
+/*
+ * Find a literal character that every match has to start with.
+ */
+static BOOL
+GetFirstChar(RENode *t, WCHAR *ret)
+{
+    while (t) {
+        switch (t->op) {
+          case REOP_FLAT:
+            *ret = t->u.flat.chr;
+            return TRUE;
+          case REOP_QUANT:
+            if (!t->u.range.min)
+                return FALSE;
+            /* fall through */
+          case REOP_LPAREN:
+          case REOP_LPARENNON:
+            t = t->kid;
+            break;
+          default:
+            return FALSE;
+        }
+    }
+    return FALSE;
+}
+
 regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
         DWORD str_len, WORD flags, BOOL flat)
 {
@@ -3242,12 +3673,18 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
     if (!re)
         goto out;
 
+    re->ref = 1;
+    re->nfa = NULL;
+    re->nfaLength = 0;
+    re->hasFirstChar = GetFirstChar(state.result, &re->firstChar);
+    CompileNFA(&state, re);
+
     assert(state.classBitmapsMem <= CLASS_BITMAPS_MEM_LIMIT);
     re->classCount = state.classCount;
     if (re->classCount) {
         re->classList = heap_alloc(re->classCount * sizeof(RECharSet));
         if (!re->classList) {
-            regexp_destroy(re);
+            regexp_release(re);
             re = NULL;
             goto out;
         }
@@ -3258,7 +3695,7 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
     }
     endPC = EmitREBytecode(&state, re, state.treeDepth, re->program, state.result);
     if (!endPC) {
-        regexp_destroy(re);
+        regexp_release(re);
         re = NULL;
         goto out;
     }
@@ -1784,6 +1784,83 @@ ok(tmp, "tmp = " + tmp);
     ok(x === undefined, "x = " + x);
 })();
 
+/* Property lookups may be cached per instruction, make sure they are invalidated. */
+(function() {
+    var objs = [{x: 1}, {y: 0, x: 2}, {x: 3, y: 0}, {z: 0, y: 0, x: 4}, {w: 0, x: 5}, {v: 0, x: 6}], o, i, j;
+
+    function getX(o) { return o.x; }
+
+    for(j = 0; j < 3; j++) {
+        for(i = 0; i < objs.length; i++)
+            ok(getX(objs[i]) === i+1, "getX(objs[" + i + "]) = " + getX(objs[i]));
+    }
+
+    o = {x: 1};
+    ok(getX(o) === 1, "getX(o) = " + getX(o));
+    delete o.x;
+    ok(getX(o) === undefined, "getX(o) = " + getX(o));
+    o.x = 2;
+    ok(getX(o) === 2, "getX(o) = " + getX(o));
+
+    o = {};
+    for(i = 0; i < 200; i++)
+        o["p" + i] = i;
+    for(i = 0; i < 3; i++)
+        ok(o.p150 === 150, "o.p150 = " + o.p150);
+    delete o.p150;
+    ok(o.p150 === undefined, "o.p150 = " + o.p150);
+})();
+
+(function() {
+    var c, i;
+
+    function C() {}
+    C.prototype.f = function() { return 1; };
+
+    c = new C();
+    for(i = 0; i < 3; i++)
+        ok(c.f() === 1, "c.f() = " + c.f());
+    C.prototype.f = function() { return 2; };
+    ok(c.f() === 2, "c.f() = " + c.f());
+    c.f = function() { return 3; };
+    ok(c.f() === 3, "c.f() = " + c.f());
+    ok((new C()).f() === 2, "(new C()).f() = " + (new C()).f());
+})();
+
+var cachedGlobal = 1;
+
+(function() {
+    var i;
+
+    function getCachedGlobal() { return cachedGlobal; }
+
+    for(i = 0; i < 3; i++)
+        ok(getCachedGlobal() === 1, "getCachedGlobal() = " + getCachedGlobal());
+    eval("var cachedGlobal = 2;");
+    ok(getCachedGlobal() === 2, "getCachedGlobal() = " + getCachedGlobal());
+    with({cachedGlobal: 3})
+        ok(getCachedGlobal() === 2, "getCachedGlobal() = " + getCachedGlobal());
+})();
+
+cachedDeletedGlobal = 1;
+
+(function() {
+    var i;
+
+    function getCachedDeletedGlobal() {
+        try {
+            return cachedDeletedGlobal;
+        }catch(e) {
+            return "exception";
+        }
+    }
+
+    for(i = 0; i < 3; i++)
+        ok(getCachedDeletedGlobal() === 1, "getCachedDeletedGlobal() = " + getCachedDeletedGlobal());
+    ok((delete cachedDeletedGlobal) === true, "delete cachedDeletedGlobal did not return true");
+    ok(getCachedDeletedGlobal() === "exception", "getCachedDeletedGlobal() = " + getCachedDeletedGlobal());
+})();
+
 /* NoNewline rule parser tests */
 while(true) {
     if(true) break
@@ -677,4 +677,50 @@ ok(re.ignoreCase === false, "re.ignoreCase = " + re.ignoreCase);
 ok(re.multiline === true, "re.multiline = " + re.multiline);
 ok(re.global === true, "re.global = " + re.global);
 
+function testMatchIndex(re, str, exidx, exlen) {
+    var m = re.exec(str);
+    if(exidx === -1) {
+        ok(m === null, re + ".exec(\"" + str + "\") = " + m);
+        return;
+    }
+    ok(m !== null, re + ".exec(\"" + str + "\") = null");
+    if(m === null)
+        return;
+    ok(m.index === exidx, re + ".exec(\"" + str + "\").index = " + m.index);
+    ok(m[0].length === exlen, re + ".exec(\"" + str + "\")[0] = " + m[0]);
+}
+
+testMatchIndex(/(ab)+c/, "xababxabababc", 6, 7);
+testMatchIndex(/(ab)+c/i, "xABABXAbaBabC", 6, 7);
+testMatchIndex(/(ab)+c/, "xababxababab", -1);
+testMatchIndex(/(x|y)+z/, "aaxyxyaxzz", 7, 2);
+testMatchIndex(/(x|y)+z/, "aaxyxyaxyx", -1);
+testMatchIndex(/[a-c]\d{2,3}/, "a1b2c345d", 4, 4);
+testMatchIndex(/\s(\w+)$/, "aa bb cc", 5, 3);
+testMatchIndex(/^b.*$/m, "aa\nbb\ncc", 3, 2);
+testMatchIndex(/^b.*$/, "aa\nbb\ncc", -1);
+testMatchIndex(/\bcd?/, "abc cde", 4, 2);
+testMatchIndex(/a*?b/, "aaaac", -1);
+testMatchIndex(/(a|ab)(c|bcd)(d*)/, "xabcd", 1, 4);
+testMatchIndex(/(a)\1b/, "aaxaab", 3, 3);
+testMatchIndex(/a(?=bc)/, "abdabc", 3, 1);
+testMatchIndex(/(?:ab)+c/, "xababxabababc", 6, 7);
+testMatchIndex(/(?:x|y)+z/, "aaxyxyaxzz", 7, 2);
+testMatchIndex(/a(?:b|c)d/, "abxacd", 3, 3);
+
+for(i = 0; i < 3; i++) {
+    re = /(ab)+c/g;
+    ok(re.lastIndex === 0, "re.lastIndex = " + re.lastIndex);
+    m = re.exec("abc ababc");
+    ok(m.index === 0, "m.index = " + m.index);
+    ok(re.lastIndex === 3, "re.lastIndex = " + re.lastIndex);
+}
+
+re = new RegExp("(ab)+c", "i");
+ok(re.test("ABC"), "re.test(\"ABC\") failed");
+ok(re.source === "(ab)+c", "re.source = " + re.source);
+re = new RegExp("(ab)+c");
+ok(!re.test("ABC"), "re.test(\"ABC\") succeeded");
+ok(re.source === "(ab)+c", "re.source = " + re.source);
+
 reportSuccess();
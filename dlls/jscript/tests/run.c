@@ -2889,6 +2889,9 @@ static void run_benchmarks(void)
     run_benchmark("dna.js");
     run_benchmark("base64.js");
     run_benchmark("validateinput.js");
+    run_benchmark("nbody.js");
+    run_benchmark("closures.js");
+    run_benchmark("regexpscan.js");
 }
 
 static BOOL check_jscript(void)
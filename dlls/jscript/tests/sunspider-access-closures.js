@@ -0,0 +1,45 @@
+// Scope chain benchmark in the style of the SunSpider access tests.
+// Stresses identifier lookups in enclosing function scopes and the
+// global object from nested closures.
+
+var counter = 0;
+var step = 1;
+
+function makeAccumulator(start) {
+    var total = start;
+
+    function inner(n) {
+        var i;
+
+        for(i = 0; i < n; i++) {
+            total += step;
+            counter++;
+        }
+        return total;
+    }
+
+    return function(n) {
+        return inner(n) + step;
+    };
+}
+
+function makeAccumulators(count) {
+    var ret = [], i;
+
+    for(i = 0; i < count; i++)
+        ret.push(makeAccumulator(i));
+    return ret;
+}
+
+var accumulators = makeAccumulators(16);
+var sum = 0;
+
+for(var round = 0; round < 200; round++) {
+    for(var i = 0; i < accumulators.length; i++)
+        sum += accumulators[i](16);
+}
+
+if(counter !== 200 * 16 * 16)
+    throw "bad counter: " + counter;
+if(sum !== 5172800)
+    throw "bad sum: " + sum;
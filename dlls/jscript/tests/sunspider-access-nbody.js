@@ -0,0 +1,133 @@
+// N-body simulation in the style of the SunSpider access-nbody test.
+// Stresses property gets and puts on objects sharing the same layout,
+// prototype method calls and global lookups from nested functions.
+
+var PI = 3.141592653589793;
+var SOLAR_MASS = 4 * PI * PI;
+var DAYS_PER_YEAR = 365.24;
+
+function Body(x, y, z, vx, vy, vz, mass) {
+    this.x = x;
+    this.y = y;
+    this.z = z;
+    this.vx = vx;
+    this.vy = vy;
+    this.vz = vz;
+    this.mass = mass;
+}
+
+Body.prototype.offsetMomentum = function(px, py, pz) {
+    this.vx = -px / SOLAR_MASS;
+    this.vy = -py / SOLAR_MASS;
+    this.vz = -pz / SOLAR_MASS;
+    return this;
+};
+
+function Jupiter() {
+    return new Body(4.84143144246472090e+00, -1.16032004402742839e+00, -1.03622044471123109e-01,
+            1.66007664274403694e-03 * DAYS_PER_YEAR, 7.69901118419740425e-03 * DAYS_PER_YEAR,
+            -6.90460016972063023e-05 * DAYS_PER_YEAR, 9.54791938424326609e-04 * SOLAR_MASS);
+}
+
+function Saturn() {
+    return new Body(8.34336671824457987e+00, 4.12479856412430479e+00, -4.03523417114321381e-01,
+            -2.76742510726862411e-03 * DAYS_PER_YEAR, 4.99852801234917238e-03 * DAYS_PER_YEAR,
+            2.30417297573763929e-05 * DAYS_PER_YEAR, 2.85885980666130812e-04 * SOLAR_MASS);
+}
+
+function Uranus() {
+    return new Body(1.28943695621391310e+01, -1.51111514016986312e+01, -2.23307578892655734e-01,
+            2.96460137564761618e-03 * DAYS_PER_YEAR, 2.37847173959480950e-03 * DAYS_PER_YEAR,
+            -2.96589568540237556e-05 * DAYS_PER_YEAR, 4.36624404335156298e-05 * SOLAR_MASS);
+}
+
+function Neptune() {
+    return new Body(1.53796971148509165e+01, -2.59193146099879641e+01, 1.79258772950371181e-01,
+            2.68067772490389322e-03 * DAYS_PER_YEAR, 1.62824170038242295e-03 * DAYS_PER_YEAR,
+            -9.51592254519715870e-05 * DAYS_PER_YEAR, 5.15138902046611451e-05 * SOLAR_MASS);
+}
+
+function Sun() {
+    return new Body(0, 0, 0, 0, 0, 0, SOLAR_MASS);
+}
+
+function NBodySystem(bodies) {
+    var px = 0, py = 0, pz = 0, b, i;
+
+    this.bodies = bodies;
+    for(i = 0; i < bodies.length; i++) {
+        b = bodies[i];
+        px += b.vx * b.mass;
+        py += b.vy * b.mass;
+        pz += b.vz * b.mass;
+    }
+    bodies[0].offsetMomentum(px, py, pz);
+}
+
+NBodySystem.prototype.advance = function(dt) {
+    var bodies = this.bodies, size = bodies.length, bi, bj, dx, dy, dz, d2, mag, i, j;
+
+    for(i = 0; i < size; i++) {
+        bi = bodies[i];
+        for(j = i + 1; j < size; j++) {
+            bj = bodies[j];
+            dx = bi.x - bj.x;
+            dy = bi.y - bj.y;
+            dz = bi.z - bj.z;
+
+            d2 = dx * dx + dy * dy + dz * dz;
+            mag = dt / (d2 * Math.sqrt(d2));
+
+            bi.vx -= dx * bj.mass * mag;
+            bi.vy -= dy * bj.mass * mag;
+            bi.vz -= dz * bj.mass * mag;
+
+            bj.vx += dx * bi.mass * mag;
+            bj.vy += dy * bi.mass * mag;
+            bj.vz += dz * bi.mass * mag;
+        }
+    }
+
+    for(i = 0; i < size; i++) {
+        bi = bodies[i];
+        bi.x += dt * bi.vx;
+        bi.y += dt * bi.vy;
+        bi.z += dt * bi.vz;
+    }
+};
+
+NBodySystem.prototype.energy = function() {
+    var bodies = this.bodies, size = bodies.length, e = 0, bi, bj, dx, dy, dz, i, j;
+
+    for(i = 0; i < size; i++) {
+        bi = bodies[i];
+        e += 0.5 * bi.mass * (bi.vx * bi.vx + bi.vy * bi.vy + bi.vz * bi.vz);
+
+        for(j = i + 1; j < size; j++) {
+            bj = bodies[j];
+            dx = bi.x - bj.x;
+            dy = bi.y - bj.y;
+            dz = bi.z - bj.z;
+            e -= (bi.mass * bj.mass) / Math.sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+
+    return e;
+};
+
+var ret = 0;
+
+for(var n = 3; n <= 24; n *= 2) {
+    (function() {
+        var system = new NBodySystem([Sun(), Jupiter(), Saturn(), Uranus(), Neptune()]);
+        var max = n * 100, i;
+
+        ret += system.energy();
+        for(i = 0; i < max; i++)
+            system.advance(0.01);
+        ret += system.energy();
+    })();
+}
+
+if(Math.abs(ret + 1.3524862408537381) > 1e-10)
+    throw "bad nbody result: " + ret;
@@ -0,0 +1,69 @@
+// Regular expression scanning benchmark in the style of the SunSpider regexp tests.
+// Runs a corpus of common pattern shapes (literal prefixes, case insensitive
+// literals, alternations, classes and patterns that never match) over a
+// generated server log, compiling the same expressions over and over.
+
+var methods = ["GET", "POST", "PUT", "DELETE"];
+var paths = ["/index.html", "/api/users", "/api/orders/42", "/static/app.js", "/login"];
+var agents = ["Mozilla/5.0 (Windows NT 6.1)", "curl/7.58.0", "Wget/1.19"];
+
+function makeLog(lines) {
+    var ret = [], i;
+
+    for(i = 0; i < lines; i++) {
+        ret.push("10." + (i % 7) + "." + (i % 13) + "." + (i % 251) + " - - [12/Mar/2018:10:"
+                 + (10 + i % 50) + ":00] \"" + methods[i % methods.length] + " "
+                 + paths[i % paths.length] + " HTTP/1.1\" " + (i % 17 ? 200 : 404) + " "
+                 + (i * 37 % 5000) + " \"" + agents[i % agents.length] + "\"");
+    }
+
+    return ret.join("\n");
+}
+
+var log = makeLog(400);
+
+var patterns = [
+    ["HTTP/1\\.1\" 404", "g", 24],
+    ["mozilla", "gi", 134],
+    ["(GET|DELETE) /api", "g", 80],
+    ["\\d+\\.\\d+\\.\\d+\\.\\d+", "g", 400],
+    ["(foo|bar)+baz", "g", 0],
+    ["[xyz]{3}\\d", "g", 0],
+    ["^10\\.3\\.", "gm", 57],
+    ["(?:orders|users)/?\\d*", "g", 160],
+    ["\"(curl|Wget)/\\d", "g", 266]
+];
+
+function countMatches(src, flags) {
+    var re = new RegExp(src, flags), cnt = 0;
+
+    while(re.exec(log))
+        cnt++;
+    return cnt;
+}
+
+for(var round = 0; round < 4; round++) {
+    for(var i = 0; i < patterns.length; i++) {
+        var cnt = countMatches(patterns[i][0], patterns[i][1]);
+        if(cnt !== patterns[i][2])
+            throw "bad match count for " + patterns[i][0] + ": " + cnt;
+    }
+}
+
+var lines = log.split("\n"), errors = 0, apis = 0;
+
+for(var i = 0; i < lines.length; i++) {
+    if(/" 404 /.test(lines[i]))
+        errors++;
+    if(/^[\d.]+ .*\/api\//.test(lines[i]))
+        apis++;
+}
+
+if(errors !== 24)
+    throw "bad errors: " + errors;
+if(apis !== 160)
+    throw "bad apis: " + apis;
+
+var replaced = log.replace(/\d+\.\d+\.\d+\.\d+/g, "x.x.x.x");
+if(replaced.length !== log.length - 1070)
+    throw "bad replaced length: " + (log.length - replaced.length);
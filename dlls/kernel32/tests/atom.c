@@ -318,6 +318,37 @@ static void test_error_handling(void)
     }
 }
 
+static void test_many_atoms(void)
+{
+    static ATOM atoms[1000];
+    char name[32];
+    ATOM atom;
+    int i;
+
+    for (i = 0; i < 1000; i++)
+    {
+        sprintf( name, "wine_test_many_%d", i );
+        atoms[i] = GlobalAddAtomA( name );
+        ok( atoms[i] != 0, "failed to add atom %d\n", i );
+    }
+    for (i = 0; i < 1000; i += 2) GlobalDeleteAtom( atoms[i] );
+    for (i = 0; i < 1000; i++)
+    {
+        sprintf( name, "WINE_TEST_MANY_%d", i );
+        atom = GlobalFindAtomA( name );
+        if (i & 1) ok( atom == atoms[i], "%d: got %04x, expected %04x\n", i, atom, atoms[i] );
+        else ok( !atom, "%d: deleted atom still found as %04x\n", i, atom );
+    }
+    for (i = 0; i < 1000; i += 2)
+    {
+        sprintf( name, "wine_test_many_%d", i );
+        atoms[i] = GlobalAddAtomA( name );
+        ok( atoms[i] != 0, "failed to add atom %d again\n", i );
+        ok( GlobalFindAtomA( name ) == atoms[i], "failed to find atom %d again\n", i );
+    }
+    for (i = 0; i < 1000; i++) GlobalDeleteAtom( atoms[i] );
+}
+
 static void test_local_add_atom(void)
 {
     ATOM atom, w_atom;
@@ -593,6 +624,7 @@ START_TEST(atom)
     test_add_atom();
     test_get_atom_name();
     test_error_handling();
+    test_many_atoms();
     test_local_add_atom();
     test_local_get_atom_name();
     test_local_error_handling();
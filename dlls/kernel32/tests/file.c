@@ -4497,6 +4497,72 @@ static void test_WriteFileGather(void)
     DeleteFileA( filename );
 }
 
+static void test_unbuffered_overlapped_io(void)
+{
+    char temp_path[MAX_PATH], filename[MAX_PATH];
+    HANDLE hfile, event;
+    FILE_SEGMENT_ELEMENT fse[3];
+    OVERLAPPED ovl;
+    SYSTEM_INFO si;
+    DWORD ret, size;
+    char *buf;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "uoi", 0, filename );
+
+    hfile = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                         FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED | FILE_ATTRIBUTE_NORMAL, 0 );
+    ok( hfile != INVALID_HANDLE_VALUE, "CreateFile failed err %u\n", GetLastError() );
+    if (hfile == INVALID_HANDLE_VALUE) return;
+
+    event = CreateEventA( NULL, TRUE, FALSE, NULL );
+    GetSystemInfo( &si );
+    buf = VirtualAlloc( NULL, 4 * si.dwPageSize, MEM_COMMIT, PAGE_READWRITE );
+    memset( buf, 'a', si.dwPageSize );
+    memset( buf + si.dwPageSize, 'b', si.dwPageSize );
+
+    /* gather the pages in reverse order */
+    memset( fse, 0, sizeof(fse) );
+    fse[0].Buffer = buf + si.dwPageSize;
+    fse[1].Buffer = buf;
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = event;
+    ret = WriteFileGather( hfile, fse, 2 * si.dwPageSize, NULL, &ovl );
+    ok( ret || GetLastError() == ERROR_IO_PENDING, "WriteFileGather failed err %u\n", GetLastError() );
+    ret = GetOverlappedResult( hfile, &ovl, &size, TRUE );
+    ok( ret, "GetOverlappedResult failed err %u\n", GetLastError() );
+    ok( size == 2 * si.dwPageSize, "got size %u\n", size );
+
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = event;
+    ovl.Offset = si.dwPageSize;
+    ret = ReadFile( hfile, buf + 2 * si.dwPageSize, si.dwPageSize, NULL, &ovl );
+    ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed err %u\n", GetLastError() );
+    ret = GetOverlappedResult( hfile, &ovl, &size, TRUE );
+    ok( ret, "GetOverlappedResult failed err %u\n", GetLastError() );
+    ok( size == si.dwPageSize, "got size %u\n", size );
+    ok( !memcmp( buf + 2 * si.dwPageSize, buf, si.dwPageSize ), "wrong data\n" );
+
+    /* scatter the pages back in reverse order */
+    memset( fse, 0, sizeof(fse) );
+    fse[0].Buffer = buf + 3 * si.dwPageSize;
+    fse[1].Buffer = buf + 2 * si.dwPageSize;
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = event;
+    ret = ReadFileScatter( hfile, fse, 2 * si.dwPageSize, NULL, &ovl );
+    ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFileScatter failed err %u\n", GetLastError() );
+    ret = GetOverlappedResult( hfile, &ovl, &size, TRUE );
+    ok( ret, "GetOverlappedResult failed err %u\n", GetLastError() );
+    ok( size == 2 * si.dwPageSize, "got size %u\n", size );
+    ok( !memcmp( buf + 3 * si.dwPageSize, buf + si.dwPageSize, si.dwPageSize ), "wrong data\n" );
+    ok( !memcmp( buf + 2 * si.dwPageSize, buf, si.dwPageSize ), "wrong data\n" );
+
+    CloseHandle( event );
+    CloseHandle( hfile );
+    VirtualFree( buf, 0, MEM_RELEASE );
+    DeleteFileA( filename );
+}
+
 static unsigned file_map_access(unsigned access)
 {
     if (access & GENERIC_READ)    access |= FILE_GENERIC_READ;
@@ -4979,6 +5045,7 @@ START_TEST(file)
     test_OpenFileById();
     test_SetFileValidData();
     test_WriteFileGather();
+    test_unbuffered_overlapped_io();
     test_file_access();
     test_GetFinalPathNameByHandleA();
     test_GetFinalPathNameByHandleW();
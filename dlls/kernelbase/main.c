@@ -17,6 +17,14 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#include <stdarg.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(kernelbase);
@@ -38,3 +46,26 @@ BOOL WINAPI QuirkIsEnabled3(void *unk1, void *unk2)
     FIXME("(%p, %p) stub!\n", unk1, unk2);
     return FALSE;
 }
+
+/***********************************************************************
+ *          WaitOnAddress (KERNELBASE.@)
+ */
+BOOL WINAPI WaitOnAddress(volatile void *addr, void *cmp, SIZE_T size, DWORD timeout)
+{
+    LARGE_INTEGER to;
+    NTSTATUS status;
+
+    if (timeout != INFINITE)
+    {
+        to.QuadPart = -(LONGLONG)timeout * 10000;
+        status = RtlWaitOnAddress((const void *)addr, cmp, size, &to);
+    }
+    else status = RtlWaitOnAddress((const void *)addr, cmp, size, NULL);
+
+    if (status)
+    {
+        SetLastError(RtlNtStatusToDosError(status));
+        return FALSE;
+    }
+    return TRUE;
+}
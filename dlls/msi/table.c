@@ -58,6 +58,7 @@ typedef struct tagMSICOLUMNINFO
     INT     ref_count;
     BOOL    temporary;
     MSICOLUMNHASHENTRY **hash_table;
+    UINT    hash_size;
 } MSICOLUMNINFO;
 
 struct tagMSITABLE
@@ -81,14 +82,14 @@ static const WCHAR szNumber[]  = {'N','u','m','b','e','r',0};
 static const WCHAR szType[]    = {'T','y','p','e',0};
 
 static const MSICOLUMNINFO _Columns_cols[4] = {
-    { szColumns, 1, szTable,  MSITYPE_VALID | MSITYPE_STRING | MSITYPE_KEY | 64, 0, 0, 0, NULL },
-    { szColumns, 2, szNumber, MSITYPE_VALID | MSITYPE_KEY | 2,     2, 0, 0, NULL },
-    { szColumns, 3, szName,   MSITYPE_VALID | MSITYPE_STRING | 64, 4, 0, 0, NULL },
-    { szColumns, 4, szType,   MSITYPE_VALID | 2,                   6, 0, 0, NULL },
+    { szColumns, 1, szTable,  MSITYPE_VALID | MSITYPE_STRING | MSITYPE_KEY | 64, 0, 0, 0, NULL, 0 },
+    { szColumns, 2, szNumber, MSITYPE_VALID | MSITYPE_KEY | 2,     2, 0, 0, NULL, 0 },
+    { szColumns, 3, szName,   MSITYPE_VALID | MSITYPE_STRING | 64, 4, 0, 0, NULL, 0 },
+    { szColumns, 4, szType,   MSITYPE_VALID | 2,                   6, 0, 0, NULL, 0 },
 };
 
 static const MSICOLUMNINFO _Tables_cols[1] = {
-    { szTables,  1, szName,   MSITYPE_VALID | MSITYPE_STRING | MSITYPE_KEY | 64, 0, 0, 0, NULL },
+    { szTables,  1, szName,   MSITYPE_VALID | MSITYPE_STRING | MSITYPE_KEY | 64, 0, 0, 0, NULL, 0 },
 };
 
 #define MAX_STREAM_NAME 0x1f
@@ -1895,6 +1896,7 @@ static UINT TABLE_find_matching_rows( struct tagMSIVIEW *view, UINT col,
     {
         UINT i;
         UINT num_rows = tv->table->row_count;
+        UINT hash_size = max( num_rows, MSITABLE_HASH_TABLE_SIZE );
         MSICOLUMNHASHENTRY **hash_table;
         MSICOLUMNHASHENTRY *new_entry;
 
@@ -1907,40 +1909,35 @@ static UINT TABLE_find_matching_rows( struct tagMSIVIEW *view, UINT col,
 
         /* allocate contiguous memory for the table and its entries so we
          * don't have to do an expensive cleanup */
-        hash_table = msi_alloc(MSITABLE_HASH_TABLE_SIZE * sizeof(MSICOLUMNHASHENTRY*) +
+        hash_table = msi_alloc(hash_size * sizeof(MSICOLUMNHASHENTRY*) +
             num_rows * sizeof(MSICOLUMNHASHENTRY));
         if (!hash_table)
             return ERROR_OUTOFMEMORY;
 
-        memset(hash_table, 0, MSITABLE_HASH_TABLE_SIZE * sizeof(MSICOLUMNHASHENTRY*));
+        memset(hash_table, 0, hash_size * sizeof(MSICOLUMNHASHENTRY*));
         tv->columns[col-1].hash_table = hash_table;
+        tv->columns[col-1].hash_size = hash_size;
 
-        new_entry = (MSICOLUMNHASHENTRY *)(hash_table + MSITABLE_HASH_TABLE_SIZE);
+        new_entry = (MSICOLUMNHASHENTRY *)(hash_table + hash_size) + num_rows;
 
-        for (i = 0; i < num_rows; i++, new_entry++)
+        /* insert from the last row so that the chains are in row order */
+        for (i = num_rows; i > 0; i--)
         {
             UINT row_value;
 
-            if (view->ops->fetch_int( view, i, col, &row_value ) != ERROR_SUCCESS)
+            new_entry--;
+            if (view->ops->fetch_int( view, i - 1, col, &row_value ) != ERROR_SUCCESS)
                 continue;
 
-            new_entry->next = NULL;
             new_entry->value = row_value;
-            new_entry->row = i;
-            if (hash_table[row_value % MSITABLE_HASH_TABLE_SIZE])
-            {
-                MSICOLUMNHASHENTRY *prev_entry = hash_table[row_value % MSITABLE_HASH_TABLE_SIZE];
-                while (prev_entry->next)
-                    prev_entry = prev_entry->next;
-                prev_entry->next = new_entry;
-            }
-            else
-                hash_table[row_value % MSITABLE_HASH_TABLE_SIZE] = new_entry;
+            new_entry->row = i - 1;
+            new_entry->next = hash_table[row_value % hash_size];
+            hash_table[row_value % hash_size] = new_entry;
         }
     }
 
     if( !*handle )
-        entry = tv->columns[col-1].hash_table[val % MSITABLE_HASH_TABLE_SIZE];
+        entry = tv->columns[col-1].hash_table[val % tv->columns[col-1].hash_size];
     else
         entry = (*handle)->next;
 
@@ -4076,6 +4076,143 @@ static void test_join(void)
     DeleteFileA(msifile);
 }
 
+static void test_join_large(void)
+{
+    static const char insert_component[] =
+        "INSERT INTO `Component` (`Component`, `ComponentId`, `Directory_`, `Attributes`) "
+        "VALUES( ?, '', 'TARGETDIR', 0 )";
+    static const char insert_file[] =
+        "INSERT INTO `File` (`File`, `Component_`, `Sequence`) VALUES( ?, ?, ? )";
+    static const char insert_feature_components[] =
+        "INSERT INTO `FeatureComponents` (`Feature_`, `Component_`) VALUES( ?, ? )";
+    static const char join_query[] =
+        "SELECT `File`.`File`, `FeatureComponents`.`Feature_` "
+        "FROM `File`, `Component`, `FeatureComponents` "
+        "WHERE `File`.`Component_` = `Component`.`Component` "
+        "AND `Component`.`Component` = `FeatureComponents`.`Component_` ";
+    MSIHANDLE hdb, hview, hrec;
+    char query[512], name[32], comp[32], feature[32];
+    UINT r, i, count;
+    DWORD size;
+
+    hdb = create_db();
+    ok( hdb, "failed to create db\n" );
+
+    r = create_component_table( hdb );
+    ok( r == ERROR_SUCCESS, "cannot create Component table: %u\n", r );
+
+    r = create_feature_components_table( hdb );
+    ok( r == ERROR_SUCCESS, "cannot create FeatureComponents table: %u\n", r );
+
+    r = run_query( hdb, 0, "CREATE TABLE `File` (`File` CHAR(72) NOT NULL, "
+                   "`Component_` CHAR(72) NOT NULL, `Sequence` SHORT NOT NULL PRIMARY KEY `File`)" );
+    ok( r == ERROR_SUCCESS, "cannot create File table: %u\n", r );
+
+    /* 1000 components spread over 10 features, three files each */
+    hrec = MsiCreateRecord( 3 );
+    for (i = 0; i < 1000; i++)
+    {
+        sprintf( comp, "comp%04u", i );
+        sprintf( feature, "feature%u", i % 10 );
+        MsiRecordSetStringA( hrec, 1, comp );
+        r = run_query( hdb, hrec, insert_component );
+        ok( r == ERROR_SUCCESS, "cannot add component: %u\n", r );
+
+        MsiRecordSetStringA( hrec, 1, feature );
+        MsiRecordSetStringA( hrec, 2, comp );
+        r = run_query( hdb, hrec, insert_feature_components );
+        ok( r == ERROR_SUCCESS, "cannot add feature components: %u\n", r );
+    }
+    for (i = 0; i < 3000; i++)
+    {
+        sprintf( name, "file%04u", i );
+        sprintf( comp, "comp%04u", i % 1000 );
+        MsiRecordSetStringA( hrec, 1, name );
+        MsiRecordSetStringA( hrec, 2, comp );
+        MsiRecordSetInteger( hrec, 3, i + 1 );
+        r = run_query( hdb, hrec, insert_file );
+        ok( r == ERROR_SUCCESS, "cannot add file: %u\n", r );
+    }
+    MsiCloseHandle( hrec );
+
+    /* constant predicate on the last table in the FROM list */
+    sprintf( query, "%sAND `FeatureComponents`.`Feature_` = 'feature3'", join_query );
+    r = MsiDatabaseOpenViewA( hdb, query, &hview );
+    ok( r == ERROR_SUCCESS, "failed to open view: %u\n", r );
+    r = MsiViewExecute( hview, 0 );
+    ok( r == ERROR_SUCCESS, "failed to execute view: %u\n", r );
+
+    count = 0;
+    while (MsiViewFetch( hview, &hrec ) == ERROR_SUCCESS)
+    {
+        size = sizeof(name);
+        r = MsiRecordGetStringA( hrec, 1, name, &size );
+        ok( r == ERROR_SUCCESS, "failed to get string: %u\n", r );
+        ok( name[7] == '3', "unexpected file %s\n", name );
+
+        size = sizeof(feature);
+        r = MsiRecordGetStringA( hrec, 2, feature, &size );
+        ok( r == ERROR_SUCCESS, "failed to get string: %u\n", r );
+        ok( !strcmp( feature, "feature3" ), "unexpected feature %s\n", feature );
+
+        MsiCloseHandle( hrec );
+        count++;
+    }
+    ok( count == 300, "expected 300 rows, got %u\n", count );
+    MsiViewClose( hview );
+    MsiCloseHandle( hview );
+
+    /* parameter and integer predicates */
+    sprintf( query, "%sAND `FeatureComponents`.`Feature_` = ? AND `File`.`Sequence` <= 1500", join_query );
+    r = MsiDatabaseOpenViewA( hdb, query, &hview );
+    ok( r == ERROR_SUCCESS, "failed to open view: %u\n", r );
+
+    hrec = MsiCreateRecord( 1 );
+    MsiRecordSetStringA( hrec, 1, "feature7" );
+    r = MsiViewExecute( hview, hrec );
+    ok( r == ERROR_SUCCESS, "failed to execute view: %u\n", r );
+    MsiCloseHandle( hrec );
+
+    count = 0;
+    while (MsiViewFetch( hview, &hrec ) == ERROR_SUCCESS)
+    {
+        size = sizeof(name);
+        r = MsiRecordGetStringA( hrec, 1, name, &size );
+        ok( r == ERROR_SUCCESS, "failed to get string: %u\n", r );
+        ok( name[7] == '7' && strcmp( name, "file1500" ) < 0, "unexpected file %s\n", name );
+
+        MsiCloseHandle( hrec );
+        count++;
+    }
+    ok( count == 150, "expected 150 rows, got %u\n", count );
+    MsiViewClose( hview );
+    MsiCloseHandle( hview );
+
+    /* a value that doesn't exist in the table */
+    sprintf( query, "%sAND `FeatureComponents`.`Feature_` = 'nofeature'", join_query );
+    r = do_query( hdb, query, &hrec );
+    ok( r == ERROR_NO_MORE_ITEMS, "expected ERROR_NO_MORE_ITEMS, got %u\n", r );
+
+    /* join without constant predicates */
+    r = MsiDatabaseOpenViewA( hdb, join_query, &hview );
+    ok( r == ERROR_SUCCESS, "failed to open view: %u\n", r );
+    r = MsiViewExecute( hview, 0 );
+    ok( r == ERROR_SUCCESS, "failed to execute view: %u\n", r );
+
+    count = 0;
+    while (MsiViewFetch( hview, &hrec ) == ERROR_SUCCESS)
+    {
+        MsiCloseHandle( hrec );
+        count++;
+    }
+    ok( count == 3000, "expected 3000 rows, got %u\n", count );
+    MsiViewClose( hview );
+    MsiCloseHandle( hview );
+
+    MsiCloseHandle( hdb );
+    DeleteFileA( msifile );
+}
+
 static void test_temporary_table(void)
 {
     MSICONDITION cond;
@@ -9747,6 +9884,7 @@ START_TEST(db)
     test_handle_limit();
     test_try_transform();
     test_join();
+    test_join_large();
     test_temporary_table();
     test_alter();
     test_integers();
@@ -54,6 +54,18 @@ typedef struct tagJOINTABLE
     UINT table_index;
 } JOINTABLE;
 
+typedef struct tagJOINLEVEL
+{
+    JOINTABLE *table;
+    struct expr **conds; /* condition terms evaluated once the table is joined */
+    UINT cond_count;
+    UINT probe_col;      /* column used to look up the matching rows, 0 to scan the table */
+    UINT probe_value;
+    const union ext_column *probe_join; /* column of an outer table holding the lookup value */
+    BOOL probe_string;
+    BOOL empty;          /* no row can match the condition */
+} JOINLEVEL;
+
 typedef struct tagMSIORDERINFO
 {
     UINT col_count;
@@ -72,7 +84,7 @@ typedef struct tagMSIWHEREVIEW
     MSIROWENTRY  **reorder;
     UINT           reorder_size; /* number of entries available in reorder */
     struct expr   *cond;
-    UINT           rec_index;
+    UINT           rec_index; /* number of wildcards in the condition */
     MSIORDERINFO  *order_info;
 } MSIWHEREVIEW;
 
@@ -504,7 +516,7 @@ static UINT STRING_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
         break;
 
     case EXPR_WILDCARD:
-        *str = MSI_RecordGetString(record, ++wv->rec_index);
+        *str = MSI_RecordGetString(record, expr->u.uval);
         break;
 
     default:
@@ -588,7 +600,7 @@ static UINT WHERE_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
         return STRCMP_Evaluate( wv, rows, &cond->u.expr, val, record );
 
     case EXPR_WILDCARD:
-        *val = MSI_RecordGetInteger( record, ++wv->rec_index );
+        *val = MSI_RecordGetInteger( record, cond->u.uval );
         return ERROR_SUCCESS;
 
     default:
@@ -599,41 +611,6 @@ static UINT WHERE_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
     return ERROR_SUCCESS;
 }
 
-static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
-                             UINT table_rows[] )
-{
-    UINT r = ERROR_FUNCTION_FAILED;
-    INT val;
-
-    for (table_rows[(*tables)->table_index] = 0;
-         table_rows[(*tables)->table_index] < (*tables)->row_count;
-         table_rows[(*tables)->table_index]++)
-    {
-        val = 0;
-        wv->rec_index = 0;
-        r = WHERE_evaluate( wv, table_rows, wv->cond, &val, record );
-        if (r != ERROR_SUCCESS && r != ERROR_CONTINUE)
-            break;
-        if (val)
-        {
-            if (*(tables + 1))
-            {
-                r = check_condition(wv, record, tables + 1, table_rows);
-                if (r != ERROR_SUCCESS)
-                    break;
-            }
-            else
-            {
-                if (r != ERROR_SUCCESS)
-                    break;
-                add_row (wv, table_rows);
-            }
-        }
-    }
-    table_rows[(*tables)->table_index] = INVALID_ROW_INDEX;
-    return r;
-}
-
 static int compare_entry( const void *left, const void *right )
 {
     const MSIROWENTRY *le = *(const MSIROWENTRY**)left;
@@ -681,86 +658,399 @@ static int compare_entry( const void *left, const void *right )
     return 0;
 }
 
-static void add_to_array( JOINTABLE **array, JOINTABLE *elem )
+static UINT count_conditions( const struct expr *cond )
 {
-    while (*array && *array != elem)
-        array++;
-    if (!*array)
-        *array = elem;
+    if (cond->type == EXPR_COMPLEX && cond->u.expr.op == OP_AND)
+        return count_conditions( cond->u.expr.left ) + count_conditions( cond->u.expr.right );
+    return 1;
 }
 
-static BOOL in_array( JOINTABLE **array, JOINTABLE *elem )
+/* splits the condition into the terms of its top level conjunction */
+static void collect_conditions( struct expr *cond, struct expr **conds, UINT *count )
 {
-    while (*array && *array != elem)
-        array++;
-    return *array != NULL;
+    if (cond->type == EXPR_COMPLEX && cond->u.expr.op == OP_AND)
+    {
+        collect_conditions( cond->u.expr.left, conds, count );
+        collect_conditions( cond->u.expr.right, conds, count );
+    }
+    else
+        conds[(*count)++] = cond;
 }
 
-#define CONST_EXPR 1 /* comparison to a constant value */
-#define JOIN_TO_CONST_EXPR 0x10000 /* comparison to a table involved with
-                                      a CONST_EXPR comaprison */
+static inline BOOL is_column_expr( const struct expr *expr )
+{
+    return expr->type == EXPR_COL_NUMBER || expr->type == EXPR_COL_NUMBER32 ||
+           expr->type == EXPR_COL_NUMBER_STRING;
+}
 
-static UINT reorder_check( const struct expr *expr, JOINTABLE **ordered_tables,
-                           BOOL process_joins, JOINTABLE **lastused )
+/* returns the last position in the join order of the tables referenced by the condition */
+static UINT condition_level( const struct expr *expr, const UINT pos[] )
 {
-    UINT res = 0;
+    UINT left, right;
 
     switch (expr->type)
     {
-        case EXPR_WILDCARD:
-        case EXPR_SVAL:
-        case EXPR_UVAL:
-            return 0;
-        case EXPR_COL_NUMBER:
-        case EXPR_COL_NUMBER32:
-        case EXPR_COL_NUMBER_STRING:
-            if (in_array(ordered_tables, expr->u.column.parsed.table))
-                return JOIN_TO_CONST_EXPR;
-            *lastused = expr->u.column.parsed.table;
-            return CONST_EXPR;
-        case EXPR_STRCMP:
-        case EXPR_COMPLEX:
-            res = reorder_check(expr->u.expr.right, ordered_tables, process_joins, lastused);
-            /* fall through */
-        case EXPR_UNARY:
-            res += reorder_check(expr->u.expr.left, ordered_tables, process_joins, lastused);
-            if (res == 0)
-                return 0;
-            if (res == CONST_EXPR)
-                add_to_array(ordered_tables, *lastused);
-            if (process_joins && res == JOIN_TO_CONST_EXPR + CONST_EXPR)
-                add_to_array(ordered_tables, *lastused);
-            return res;
-        default:
-            ERR("Unknown expr type: %i\n", expr->type);
-            assert(0);
-            return 0x1000000;
+    case EXPR_COL_NUMBER:
+    case EXPR_COL_NUMBER32:
+    case EXPR_COL_NUMBER_STRING:
+        return pos[expr->u.column.parsed.table->table_index];
+    case EXPR_STRCMP:
+    case EXPR_COMPLEX:
+        left = condition_level( expr->u.expr.left, pos );
+        right = condition_level( expr->u.expr.right, pos );
+        return max( left, right );
+    case EXPR_UNARY:
+        return condition_level( expr->u.expr.left, pos );
+    default:
+        return 0;
     }
 }
 
-/* reorders the tablelist in a way to evaluate the condition as fast as possible */
-static JOINTABLE **ordertables( MSIWHEREVIEW *wv )
+/* checks for an equality between two columns of the same type from different tables */
+static BOOL is_equijoin( const struct expr *expr )
 {
-    JOINTABLE *table;
-    JOINTABLE **tables;
+    const struct expr *left, *right;
 
-    tables = msi_alloc_zero( (wv->table_count + 1) * sizeof(*tables) );
+    if ((expr->type != EXPR_COMPLEX && expr->type != EXPR_STRCMP) || expr->u.expr.op != OP_EQ)
+        return FALSE;
 
-    if (wv->cond)
+    left = expr->u.expr.left;
+    right = expr->u.expr.right;
+    if (!is_column_expr( left ) || left->type != right->type)
+        return FALSE;
+
+    return left->u.column.parsed.table != right->u.column.parsed.table;
+}
+
+/* checks for an equality between a column and a constant or a record field */
+static const struct expr *const_equality( const struct expr *expr, const struct expr **value )
+{
+    const struct expr *left, *right;
+
+    if ((expr->type != EXPR_COMPLEX && expr->type != EXPR_STRCMP) || expr->u.expr.op != OP_EQ)
+        return NULL;
+
+    left = expr->u.expr.left;
+    right = expr->u.expr.right;
+    if (!is_column_expr( left ))
     {
-        table = NULL;
-        reorder_check(wv->cond, tables, FALSE, &table);
-        table = NULL;
-        reorder_check(wv->cond, tables, TRUE, &table);
+        const struct expr *tmp = left;
+        left = right;
+        right = tmp;
     }
+    if (!is_column_expr( left ))
+        return NULL;
 
-    table = wv->tables;
-    while (table)
+    if (right->type == EXPR_WILDCARD ||
+        (left->type == EXPR_COL_NUMBER_STRING ? right->type == EXPR_SVAL : right->type == EXPR_UVAL))
     {
-        add_to_array(tables, table);
-        table = table->next;
+        *value = right;
+        return left;
+    }
+    return NULL;
+}
+
+static BOOL is_hashable_column( const union ext_column *column )
+{
+    JOINTABLE *table = column->parsed.table;
+    UINT type;
+
+    if (!table->view->ops->find_matching_rows)
+        return FALSE;
+    if (table->view->ops->get_column_info( table->view, column->parsed.column, NULL, &type,
+                                           NULL, NULL ) != ERROR_SUCCESS)
+        return FALSE;
+    return !MSITYPE_IS_BINARY(type);
+}
+
+/* Computes the stored value a column has to hold to compare equal to a constant.
+ * Returns ERROR_NO_MORE_ITEMS if no row can match and ERROR_CONTINUE if the rows
+ * have to be scanned. */
+static UINT get_const_key( MSIWHEREVIEW *wv, const struct expr *column, const struct expr *value,
+                           MSIRECORD *record, UINT *key )
+{
+    const WCHAR *str;
+    INT ival;
+
+    if (value->type == EXPR_WILDCARD && !record)
+        return ERROR_CONTINUE;
+
+    if (column->type == EXPR_COL_NUMBER_STRING)
+    {
+        if (value->type == EXPR_SVAL)
+            str = value->u.sval;
+        else
+            str = MSI_RecordGetString( record, value->u.uval );
+
+        /* null and empty strings compare equal */
+        if (!str || !*str)
+            return ERROR_CONTINUE;
+        if (msi_string2id( wv->db->strings, str, -1, key ) != ERROR_SUCCESS)
+            return ERROR_NO_MORE_ITEMS;
+        return ERROR_SUCCESS;
+    }
+
+    if (value->type == EXPR_UVAL)
+        ival = value->u.uval;
+    else
+        ival = MSI_RecordGetInteger( record, value->u.uval );
+
+    if (column->type == EXPR_COL_NUMBER32)
+    {
+        *key = ival + 0x80000000;
+        return ERROR_SUCCESS;
+    }
+
+    if (ival < -0x8000 || ival > 0x7fff)
+        return ERROR_NO_MORE_ITEMS;
+    *key = ival + 0x8000;
+    return ERROR_SUCCESS;
+}
+
+/* Checks whether the rows of a table can be found through a hash lookup, either
+ * on a constant or on a column of a table that has already been joined. */
+static BOOL can_probe_table( MSIWHEREVIEW *wv, MSIRECORD *record, const JOINTABLE *table,
+                             struct expr **conds, UINT cond_count, const UINT pos[] )
+{
+    const struct expr *column, *value;
+    const union ext_column *left, *right;
+    UINT i, key;
+
+    for (i = 0; i < cond_count; i++)
+    {
+        if ((column = const_equality( conds[i], &value )))
+        {
+            if (column->u.column.parsed.table == table && is_hashable_column( &column->u.column ) &&
+                get_const_key( wv, column, value, record, &key ) != ERROR_CONTINUE)
+                return TRUE;
+            continue;
+        }
+        if (!is_equijoin( conds[i] ))
+            continue;
+
+        left = &conds[i]->u.expr.left->u.column;
+        right = &conds[i]->u.expr.right->u.column;
+        if (left->parsed.table == table && is_hashable_column( left ) &&
+            pos[right->parsed.table->table_index] != INVALID_ROW_INDEX)
+            return TRUE;
+        if (right->parsed.table == table && is_hashable_column( right ) &&
+            pos[left->parsed.table->table_index] != INVALID_ROW_INDEX)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Orders the tables for the nested loop join and assigns each condition term to
+ * the first table at which it can be evaluated. The tables keep their list order,
+ * where the last one of the FROM clause is the outermost, except that a table
+ * whose rows can be found through a hash lookup is moved ahead of the others. */
+static UINT plan_join( MSIWHEREVIEW *wv, MSIRECORD *record, JOINLEVEL *levels,
+                       struct expr **conds, UINT cond_count )
+{
+    JOINTABLE *table, *best;
+    struct expr **sorted;
+    const struct expr *column, *value;
+    UINT *pos, *cond_levels;
+    UINT i, j, level, key, r = ERROR_OUTOFMEMORY;
+
+    pos = msi_alloc( wv->table_count * sizeof(*pos) );
+    cond_levels = msi_alloc( (cond_count + 1) * sizeof(*cond_levels) );
+    sorted = msi_alloc( (cond_count + 1) * sizeof(*sorted) );
+    if (!pos || !cond_levels || !sorted)
+        goto done;
+
+    for (table = wv->tables; table; table = table->next)
+        pos[table->table_index] = INVALID_ROW_INDEX;
+
+    for (level = 0; level < wv->table_count; level++)
+    {
+        best = NULL;
+
+        for (table = wv->tables; table; table = table->next)
+        {
+            if (pos[table->table_index] != INVALID_ROW_INDEX)
+                continue;
+            if (!best)
+                best = table;
+            if (can_probe_table( wv, record, table, conds, cond_count, pos ))
+            {
+                best = table;
+                break;
+            }
+        }
+
+        pos[best->table_index] = level;
+        memset( &levels[level], 0, sizeof(levels[level]) );
+        levels[level].table = best;
+    }
+
+    /* push each term down to the first table at which all its columns are available */
+    for (i = 0; i < cond_count; i++)
+    {
+        cond_levels[i] = condition_level( conds[i], pos );
+        levels[cond_levels[i]].cond_count++;
     }
-    return tables;
+
+    for (level = 0, j = 0; level < wv->table_count; level++)
+    {
+        levels[level].conds = conds + j;
+        for (i = 0; i < cond_count; i++)
+        {
+            if (cond_levels[i] == level)
+                sorted[j++] = conds[i];
+        }
+    }
+    memcpy( conds, sorted, cond_count * sizeof(*conds) );
+
+    /* pick the hash lookup used to find the rows of each table */
+    for (level = 0; level < wv->table_count; level++)
+    {
+        JOINLEVEL *cur = &levels[level];
+
+        for (i = 0; i < cur->cond_count && !cur->probe_col; i++)
+        {
+            if (!(column = const_equality( cur->conds[i], &value )) ||
+                column->u.column.parsed.table != cur->table ||
+                !is_hashable_column( &column->u.column ))
+                continue;
+
+            r = get_const_key( wv, column, value, record, &key );
+            if (r == ERROR_NO_MORE_ITEMS)
+            {
+                cur->empty = TRUE;
+                break;
+            }
+            if (r != ERROR_SUCCESS)
+                continue;
+
+            cur->probe_col = column->u.column.parsed.column;
+            cur->probe_value = key;
+        }
+
+        for (i = 0; i < cur->cond_count && !cur->probe_col && !cur->empty; i++)
+        {
+            const union ext_column *inner, *outer;
+
+            if (!is_equijoin( cur->conds[i] ))
+                continue;
+
+            inner = &cur->conds[i]->u.expr.left->u.column;
+            outer = &cur->conds[i]->u.expr.right->u.column;
+            if (inner->parsed.table != cur->table)
+            {
+                const union ext_column *tmp = inner;
+                inner = outer;
+                outer = tmp;
+            }
+            if (inner->parsed.table != cur->table || pos[outer->parsed.table->table_index] >= level ||
+                !is_hashable_column( inner ))
+                continue;
+
+            cur->probe_col = inner->parsed.column;
+            cur->probe_join = outer;
+            cur->probe_string = cur->conds[i]->type == EXPR_STRCMP;
+        }
+
+        TRACE("level %u: table %u, %u conditions, probe column %u\n", level,
+              cur->table->table_index, cur->cond_count, cur->probe_col);
+    }
+    r = ERROR_SUCCESS;
+
+done:
+    msi_free( pos );
+    msi_free( cond_levels );
+    msi_free( sorted );
+    return r;
+}
+
+static UINT get_probe_key( MSIWHEREVIEW *wv, const JOINLEVEL *level, const UINT rows[], UINT *key )
+{
+    const WCHAR *str;
+    UINT r;
+
+    if (!level->probe_join)
+    {
+        *key = level->probe_value;
+        return ERROR_SUCCESS;
+    }
+
+    r = expr_fetch_value( level->probe_join, rows, key );
+    if (r != ERROR_SUCCESS || !level->probe_string)
+        return r;
+
+    /* null and empty strings compare equal, scan all rows for them */
+    if (!*key || !(str = msi_string_lookup( wv->db->strings, *key, NULL )) || !*str)
+        return ERROR_CONTINUE;
+    return ERROR_SUCCESS;
+}
+
+static UINT join_tables( MSIWHEREVIEW *wv, MSIRECORD *record, const JOINLEVEL *levels,
+                         UINT level, UINT rows[] );
+
+static UINT check_row( MSIWHEREVIEW *wv, MSIRECORD *record, const JOINLEVEL *levels,
+                       UINT level, UINT rows[] )
+{
+    const JOINLEVEL *cur = &levels[level];
+    UINT i, r;
+    INT val;
+
+    for (i = 0; i < cur->cond_count; i++)
+    {
+        val = 0;
+        r = WHERE_evaluate( wv, rows, cur->conds[i], &val, record );
+        if (r != ERROR_SUCCESS)
+            return r;
+        if (!val)
+            return ERROR_SUCCESS;
+    }
+
+    if (level + 1 < wv->table_count)
+        return join_tables( wv, record, levels, level + 1, rows );
+    return add_row( wv, rows );
+}
+
+static UINT join_tables( MSIWHEREVIEW *wv, MSIRECORD *record, const JOINLEVEL *levels,
+                         UINT level, UINT rows[] )
+{
+    const JOINLEVEL *cur = &levels[level];
+    JOINTABLE *table = cur->table;
+    MSIITERHANDLE handle = NULL;
+    UINT r = ERROR_SUCCESS, row, key;
+
+    if (cur->empty)
+        return ERROR_SUCCESS;
+
+    if (cur->probe_col && get_probe_key( wv, cur, rows, &key ) == ERROR_SUCCESS)
+    {
+        for (;;)
+        {
+            r = table->view->ops->find_matching_rows( table->view, cur->probe_col, key, &row, &handle );
+            if (r != ERROR_SUCCESS)
+            {
+                if (r == ERROR_NO_MORE_ITEMS)
+                    r = ERROR_SUCCESS;
+                break;
+            }
+
+            rows[table->table_index] = row;
+            r = check_row( wv, record, levels, level, rows );
+            if (r != ERROR_SUCCESS)
+                break;
+        }
+    }
+    else
+    {
+        for (row = 0; row < table->row_count; row++)
+        {
+            rows[table->table_index] = row;
+            r = check_row( wv, record, levels, level, rows );
+            if (r != ERROR_SUCCESS)
+                break;
+        }
+    }
+
+    rows[table->table_index] = INVALID_ROW_INDEX;
+    return r;
 }
 
 static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
@@ -769,8 +1059,9 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     UINT r;
     JOINTABLE *table = wv->tables;
     UINT *rows;
-    JOINTABLE **ordered_tables;
-    UINT i = 0;
+    JOINLEVEL *levels;
+    struct expr **conds;
+    UINT i, cond_count = 0;
 
     TRACE("%p %p\n", wv, record);
 
@@ -798,13 +1089,26 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     }
     while ((table = table->next));
 
-    ordered_tables = ordertables( wv );
-
+    conds = msi_alloc( ((wv->cond ? count_conditions( wv->cond ) : 0) + 1) * sizeof(*conds) );
+    levels = msi_alloc( wv->table_count * sizeof(*levels) );
     rows = msi_alloc( wv->table_count * sizeof(*rows) );
+    if (!conds || !levels || !rows)
+    {
+        r = ERROR_OUTOFMEMORY;
+        goto done;
+    }
+
+    if (wv->cond)
+        collect_conditions( wv->cond, conds, &cond_count );
+
+    r = plan_join( wv, record, levels, conds, cond_count );
+    if (r != ERROR_SUCCESS)
+        goto done;
+
     for (i = 0; i < wv->table_count; i++)
         rows[i] = INVALID_ROW_INDEX;
 
-    r =  check_condition(wv, record, ordered_tables, rows);
+    r = join_tables( wv, record, levels, 0, rows );
 
     if (wv->order_info)
         wv->order_info->error = ERROR_SUCCESS;
@@ -814,8 +1118,10 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     if (wv->order_info)
         r = wv->order_info->error;
 
+done:
     msi_free( rows );
-    msi_free( ordered_tables );
+    msi_free( levels );
+    msi_free( conds );
     return r;
 }
 
@@ -1193,6 +1499,7 @@ static UINT WHERE_VerifyCondition( MSIWHEREVIEW *wv, struct expr *cond,
         break;
     case EXPR_WILDCARD:
         *valid = 1;
+        cond->u.uval = ++wv->rec_index;
         break;
     case EXPR_SVAL:
         *valid = 1;
@@ -349,6 +349,42 @@ NTSTATUS WINAPI NtDeleteAtom(RTL_ATOM atom)
     return status;
 }
 
+/******************************************************************
+ *		find_shared_atom
+ *
+ * Look up a global atom in the snapshot published by the server.
+ * The hash must match atom_hash() in server/atom.c.
+ */
+static BOOL find_shared_atom( const WCHAR *name, ULONG length, RTL_ATOM *atom )
+{
+    const volatile shmatom_t *entry;
+    shmglobal_t *shm = wine_get_shmglobal();
+    unsigned int i, hash = 0x811c9dc5, seq, retry;
+    WCHAR str[60];
+    atom_t value;
+    int barrier;
+
+    if (!shm || length > sizeof(str)) return FALSE;
+    for (i = 0; i < length / sizeof(WCHAR); i++) hash = (hash ^ toupperW(name[i])) * 0x01000193;
+    entry = &shm->atoms[hash & (SHM_ATOM_COUNT - 1)];
+
+    for (retry = 0; retry < 16; retry++)
+    {
+        seq = entry->seq;
+        if (seq & 1) continue;  /* the server is updating the entry */
+        interlocked_xchg( &barrier, 0 );  /* order the entry reads against the sequence number */
+        if (!(value = entry->atom) || entry->hash != hash || entry->len != length) return FALSE;
+        for (i = 0; i < length / sizeof(WCHAR); i++) str[i] = entry->str[i];
+        interlocked_xchg( &barrier, 0 );
+        if (entry->seq != seq) continue;
+
+        if (memicmpW( str, name, length / sizeof(WCHAR) )) return FALSE;
+        *atom = value;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 /******************************************************************
  *		NtFindAtom (NTDLL.@)
  */
@@ -357,6 +393,8 @@ NTSTATUS WINAPI NtFindAtom( const WCHAR* name, ULONG length, RTL_ATOM* atom )
     NTSTATUS    status;
 
     status = is_integral_atom( name, length / sizeof(WCHAR), atom );
+    if (status == STATUS_MORE_ENTRIES && find_shared_atom( name, length, atom ))
+        status = STATUS_SUCCESS;
     if (status == STATUS_MORE_ENTRIES)
     {
         SERVER_START_REQ( find_atom )
@@ -26,9 +26,6 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <sys/types.h>
-#ifdef HAVE_SYS_SYSCALL_H
-#include <sys/syscall.h>
-#endif
 #include <time.h>
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -39,6 +36,10 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(lockprof);
+
+/* upper bound for the spin count of sections using RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN */
+#define MAX_DYNAMIC_SPIN_COUNT 4000
 
 static inline LONG interlocked_inc( PLONG dest )
 {
@@ -52,46 +53,130 @@ static inline LONG interlocked_dec( PLONG dest )
 
 static inline void small_pause(void)
 {
-#ifdef __i386__
+#if defined(__i386__) || defined(__x86_64__)
     __asm__ __volatile__( "rep;nop" : : : "memory" );
 #else
     __asm__ __volatile__( "" : : : "memory" );
 #endif
 }
 
-#ifdef __linux__
+/* Lock contention profiling
+ *
+ * Enabled with WINEDEBUG=+lockprof. Every blocking wait on a critical
+ * section or SRW lock is accounted to the lock in a fixed size table, and
+ * the most contended locks are dumped when the process shuts down.
+ */
 
-static int wait_op = 128; /*FUTEX_WAIT|FUTEX_PRIVATE_FLAG*/
-static int wake_op = 129; /*FUTEX_WAKE|FUTEX_PRIVATE_FLAG*/
+#define LOCK_PROFILE_SIZE  1024  /* must be a power of 2 */
+#define LOCK_PROFILE_DUMP  20
 
-static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+struct lock_profile_entry
 {
-    return syscall( __NR_futex, addr, wait_op, val, timeout, 0, 0 );
+    const void *lock;       /* address of the lock */
+    const char *name;       /* name from the debug info, if any */
+    LONG        waits;      /* number of blocking waits */
+    LONGLONG    wait_time;  /* total time spent waiting, in performance counter ticks */
+    LONGLONG    max_wait;   /* longest single wait */
+};
+
+static struct lock_profile_entry lock_profile[LOCK_PROFILE_SIZE];
+static LONG lock_profile_dropped;
+
+static struct lock_profile_entry *get_lock_profile_entry( const void *lock )
+{
+    unsigned int i, hash = (unsigned int)((ULONG_PTR)lock >> 3) * 0x9e3779b1;
+
+    for (i = 0; i < LOCK_PROFILE_SIZE; i++)
+    {
+        struct lock_profile_entry *entry = &lock_profile[(hash + i) & (LOCK_PROFILE_SIZE - 1)];
+        const void *cur = entry->lock;
+
+        if (!cur) cur = interlocked_cmpxchg_ptr( (void **)&entry->lock, (void *)lock, NULL );
+        if (!cur || cur == lock) return entry;
+    }
+    return NULL;
 }
 
-static inline int futex_wake( int *addr, int val )
+/***********************************************************************
+ *           lock_profile_start
+ *
+ * Returns the start time of a blocking wait, or 0 if profiling is disabled.
+ */
+LONGLONG lock_profile_start(void)
 {
-    return syscall( __NR_futex, addr, wake_op, val, NULL, 0, 0 );
+    LARGE_INTEGER counter;
+
+    if (!TRACE_ON(lockprof)) return 0;
+    NtQueryPerformanceCounter( &counter, NULL );
+    return counter.QuadPart;
 }
 
-static inline int use_futexes(void)
+/***********************************************************************
+ *           lock_profile_record
+ *
+ * Accounts a blocking wait that started at 'start' to the given lock.
+ */
+void lock_profile_record( const void *lock, const char *name, LONGLONG start )
 {
-    static int supported = -1;
+    struct lock_profile_entry *entry;
+    LARGE_INTEGER counter;
+    LONGLONG elapsed, old;
+
+    if (!start) return;
+    NtQueryPerformanceCounter( &counter, NULL );
+    elapsed = counter.QuadPart - start;
 
-    if (supported == -1)
+    if (!(entry = get_lock_profile_entry( lock )))
     {
-        futex_wait( &supported, 10, NULL );
-        if (errno == ENOSYS)
-        {
-            wait_op = 0; /*FUTEX_WAIT*/
-            wake_op = 1; /*FUTEX_WAKE*/
-            futex_wait( &supported, 10, NULL );
-        }
-        supported = (errno != ENOSYS);
+        interlocked_xchg_add( &lock_profile_dropped, 1 );
+        return;
     }
-    return supported;
+    if (name) entry->name = name;
+    interlocked_xchg_add( &entry->waits, 1 );
+    do old = entry->wait_time;
+    while (interlocked_cmpxchg64( &entry->wait_time, old + elapsed, old ) != old);
+    do old = entry->max_wait;
+    while (elapsed > old && interlocked_cmpxchg64( &entry->max_wait, elapsed, old ) != old);
 }
 
+/***********************************************************************
+ *           lock_profile_dump
+ *
+ * Prints the most contended locks; called on process shutdown.
+ */
+void lock_profile_dump(void)
+{
+    struct lock_profile_entry *top[LOCK_PROFILE_DUMP];
+    LARGE_INTEGER freq;
+    unsigned int i, j, count = 0;
+
+    if (!TRACE_ON(lockprof)) return;
+
+    for (i = 0; i < LOCK_PROFILE_SIZE; i++)
+    {
+        struct lock_profile_entry *entry = &lock_profile[i];
+
+        if (!entry->waits) continue;
+        for (j = count; j > 0 && top[j - 1]->wait_time < entry->wait_time; j--)
+            if (j < LOCK_PROFILE_DUMP) top[j] = top[j - 1];
+        if (j < LOCK_PROFILE_DUMP) top[j] = entry;
+        if (count < LOCK_PROFILE_DUMP) count++;
+    }
+
+    NtQueryPerformanceCounter( NULL, &freq );
+    if (!freq.QuadPart) freq.QuadPart = 1;
+    TRACE_(lockprof)( "%u most contended locks in process %04x:\n", count, GetCurrentProcessId() );
+    for (i = 0; i < count; i++)
+        TRACE_(lockprof)( "%p %-40s waits %8u total %10s us max %10s us\n", top[i]->lock,
+                          debugstr_a(top[i]->name ? top[i]->name : "?"), top[i]->waits,
+                          wine_dbgstr_longlong( top[i]->wait_time * 1000000 / freq.QuadPart ),
+                          wine_dbgstr_longlong( top[i]->max_wait * 1000000 / freq.QuadPart ));
+    if (lock_profile_dropped)
+        TRACE_(lockprof)( "%u waits not accounted, table full\n", lock_profile_dropped );
+}
+
+#ifdef __linux__
+
 static inline NTSTATUS fast_wait( RTL_CRITICAL_SECTION *crit, int timeout )
 {
     int val;
@@ -311,7 +396,7 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionAndSpinCount( RTL_CRITICAL_SECTION *
  */
 NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULONG spincount, ULONG flags )
 {
-    if (flags & (RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN|RTL_CRITICAL_SECTION_FLAG_STATIC_INIT))
+    if (flags & RTL_CRITICAL_SECTION_FLAG_STATIC_INIT)
         FIXME("(%p,%u,0x%08x) semi-stub\n", crit, spincount, flags);
 
     /* FIXME: if RTL_CRITICAL_SECTION_FLAG_STATIC_INIT is given, we should use
@@ -340,8 +425,11 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
     crit->LockSemaphore  = 0;
-    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
-    crit->SpinCount = spincount & ~0x80000000;
+    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) crit->SpinCount = 0;
+    else if (flags & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+        crit->SpinCount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN |
+                          min( spincount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS, MAX_DYNAMIC_SPIN_COUNT );
+    else crit->SpinCount = spincount & ~0x80000000;
     return STATUS_SUCCESS;
 }
 
@@ -359,6 +447,8 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
  *
  * NOTES
  *  If the system is not SMP, spincount is ignored and set to 0.
+ *  For sections using a dynamic spin count, spincount only sets the
+ *  starting point of the adaptation.
  *
  * SEE
  *  RtlInitializeCriticalSectionEx(),
@@ -370,6 +460,11 @@ ULONG WINAPI RtlSetCriticalSectionSpinCount( RTL_CRITICAL_SECTION *crit, ULONG s
 {
     ULONG oldspincount = crit->SpinCount;
     if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
+    if (oldspincount & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+    {
+        crit->SpinCount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN | min( spincount, MAX_DYNAMIC_SPIN_COUNT );
+        return oldspincount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+    }
     crit->SpinCount = spincount;
     return oldspincount;
 }
@@ -436,6 +531,8 @@ NTSTATUS WINAPI RtlDeleteCriticalSection( RTL_CRITICAL_SECTION *crit )
 NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
     LONGLONG timeout = NtCurrentTeb()->Peb->CriticalSectionTimeout.QuadPart / -10000000;
+    LONGLONG start = lock_profile_start();
+
     for (;;)
     {
         EXCEPTION_RECORD rec;
@@ -477,6 +574,7 @@ NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
         RtlRaiseException( &rec );
     }
     if (crit->DebugInfo) crit->DebugInfo->ContentionCount++;
+    if (start) lock_profile_record( crit, crit->DebugInfo ? (char *)crit->DebugInfo->Spare[0] : NULL, start );
     return STATUS_SUCCESS;
 }
 
@@ -540,18 +638,38 @@ NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
     if (crit->SpinCount)
     {
-        ULONG count;
+        ULONG count, limit = crit->SpinCount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+        BOOL dynamic = (crit->SpinCount & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN) != 0;
+        BOOL acquired = FALSE;
 
         if (RtlTryEnterCriticalSection( crit )) return STATUS_SUCCESS;
-        for (count = crit->SpinCount; count > 0; count--)
+
+        /* with a dynamic spin count, allow spinning up to twice as long as the
+         * owners have recently held the section before it was released */
+        if (dynamic) limit = min( limit * 2 + 10, MAX_DYNAMIC_SPIN_COUNT );
+        for (count = 0; count < limit; count++)
         {
             if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
             if (crit->LockCount == -1)       /* try again */
             {
-                if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1) goto done;
+                if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1)
+                {
+                    acquired = TRUE;
+                    break;
+                }
             }
             small_pause();
         }
+        if (dynamic)
+        {
+            /* moving average of the number of spins needed, decaying when spinning
+             * didn't help; races are harmless here */
+            ULONG spin = crit->SpinCount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+            if (acquired) spin += ((LONG)count - (LONG)spin) / 8;
+            else spin -= spin / 8;
+            crit->SpinCount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN | spin;
+        }
+        if (acquired) goto done;
     }
 
     if (interlocked_inc( &crit->LockCount ))
@@ -57,6 +57,9 @@
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef MAJOR_IN_MKDEV
 # include <sys/mkdev.h>
 #elif defined(MAJOR_IN_SYSMACROS)
@@ -102,6 +105,7 @@
 #include "wine/unicode.h"
 #include "wine/debug.h"
 #include "wine/server.h"
+#include "wine/list.h"
 #include "ntdll_misc.h"
 
 #include "winternl.h"
@@ -902,6 +906,290 @@ static NTSTATUS register_async_file_read( HANDLE handle, HANDLE event,
 }
 
 
+/* maximum number of page segments transferred by a single vectored call */
+#define FILE_RW_IOV_MAX 64
+
+/* buffer of a regular file transfer, either contiguous or made of page sized segments */
+struct file_rw_buffer
+{
+    char                 *buffer;
+    FILE_SEGMENT_ELEMENT *segments;
+};
+
+/* state of a regular file transfer executed by a worker thread */
+struct async_file_rw
+{
+    struct list           entry;      /* entry in the list of pending transfers */
+    HANDLE                handle;     /* handle the request was issued on, for cancellation */
+    HANDLE                completion; /* private copy of the handle for the completion port */
+    DWORD                 thread;     /* thread that issued the request */
+    BOOL                  cancelled;
+    int                   unix_fd;    /* private copy of the file descriptor */
+    HANDLE                event;
+    IO_STATUS_BLOCK      *io_status;
+    ULONG_PTR             cvalue;
+    BOOL                  write;
+    off_t                 offset;
+    ULONG                 length;
+    struct file_rw_buffer buf;
+};
+
+static inline ssize_t file_preadv( int fd, const struct iovec *iov, int count, off_t offset )
+{
+#ifdef HAVE_PREADV
+    return preadv( fd, iov, count, offset );
+#else
+    return pread( fd, iov[0].iov_base, iov[0].iov_len, offset );
+#endif
+}
+
+static inline ssize_t file_pwritev( int fd, const struct iovec *iov, int count, off_t offset )
+{
+#ifdef HAVE_PWRITEV
+    return pwritev( fd, iov, count, offset );
+#else
+    return pwrite( fd, iov[0].iov_base, iov[0].iov_len, offset );
+#endif
+}
+
+/***********************************************************************
+ *             file_rw_iovec
+ *
+ * Fill the iovec array for the remaining part of a transfer.
+ */
+static int file_rw_iovec( const struct file_rw_buffer *buf, ULONG pos, ULONG length, struct iovec *iov )
+{
+    int count = 0;
+
+    if (buf->buffer)
+    {
+        iov[0].iov_base = buf->buffer + pos;
+        iov[0].iov_len  = length - pos;
+        return 1;
+    }
+
+    while (pos < length && count < FILE_RW_IOV_MAX)
+    {
+        ULONG page_offset = pos % page_size;
+        iov[count].iov_base = (char *)buf->segments[pos / page_size].Buffer + page_offset;
+        iov[count].iov_len  = page_size - page_offset;
+        pos += page_size - page_offset;
+        count++;
+    }
+    return count;
+}
+
+/***********************************************************************
+ *             file_rw_transfer
+ *
+ * Read or write a regular file, using one vectored call per batch of
+ * segments. If offset is NULL the current file position is used.
+ */
+static NTSTATUS file_rw_transfer( int fd, BOOL write, const struct file_rw_buffer *buf,
+                                  ULONG length, const off_t *offset, ULONG *total )
+{
+    struct iovec iov[FILE_RW_IOV_MAX];
+    ssize_t result;
+    int i, count;
+
+    *total = 0;
+    while (*total < length)
+    {
+        count = file_rw_iovec( buf, *total, length, iov );
+
+        if (offset)
+            result = write ? file_pwritev( fd, iov, count, *offset + *total )
+                           : file_preadv( fd, iov, count, *offset + *total );
+        else
+            result = write ? writev( fd, iov, count ) : readv( fd, iov, count );
+
+        if (result == -1)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EFAULT) return FILE_GetNtStatus();
+            if (write) return STATUS_INVALID_USER_BUFFER;
+
+            /* make sure the buffers are committed and retry */
+            for (i = 0; i < count; i++)
+                if (virtual_check_buffer_for_write( iov[i].iov_base, iov[i].iov_len ) < iov[i].iov_len)
+                    return STATUS_ACCESS_VIOLATION;
+            continue;
+        }
+        if (!result) return write ? STATUS_DISK_FULL : STATUS_END_OF_FILE;
+        *total += result;
+        /* like a single pread/pwrite, a contiguous transfer returns a short count as is */
+        if (buf->buffer) break;
+    }
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *             file_rw_check_buffer
+ *
+ * Check that the data of a write is readable before handing it to a worker.
+ */
+static BOOL file_rw_check_buffer( const struct file_rw_buffer *buf, ULONG length )
+{
+    ULONG pos;
+
+    if (buf->buffer) return virtual_check_buffer_for_read( buf->buffer, length );
+    for (pos = 0; pos < length; pos += page_size)
+        if (!virtual_check_buffer_for_read( buf->segments[pos / page_size].Buffer, page_size ))
+            return FALSE;
+    return TRUE;
+}
+
+/***********************************************************************
+ *             use_async_file_rw
+ *
+ * Check whether a regular file transfer can be executed by a worker thread.
+ * Completion is reported through the event and the completion port; waiting
+ * on the file handle itself and APCs to the calling thread would need the
+ * help of the server, so these requests are still completed synchronously.
+ * Buffered handles are mostly served from the page cache, where the hand-off
+ * to another thread costs more than the transfer itself.
+ */
+static inline BOOL use_async_file_rw( unsigned int options, HANDLE event, PIO_APC_ROUTINE apc )
+{
+    if (options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT)) return FALSE;
+    if (!(options & FILE_NO_INTERMEDIATE_BUFFERING)) return FALSE;
+    return event && !apc;
+}
+
+/* transfers queued to worker threads, they can be cancelled until the worker picks them up */
+static struct list async_file_rw_list = LIST_INIT( async_file_rw_list );
+
+static RTL_CRITICAL_SECTION async_file_rw_section;
+static RTL_CRITICAL_SECTION_DEBUG async_file_rw_section_debug =
+{
+    0, 0, &async_file_rw_section,
+    { &async_file_rw_section_debug.ProcessLocksList, &async_file_rw_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": async_file_rw_section") }
+};
+static RTL_CRITICAL_SECTION async_file_rw_section = { &async_file_rw_section_debug, -1, 0, 0, 0, 0 };
+
+static DWORD WINAPI async_file_rw_proc( void *arg )
+{
+    struct async_file_rw *rw = arg;
+    NTSTATUS status;
+    ULONG total = 0;
+    BOOL cancelled;
+
+    RtlEnterCriticalSection( &async_file_rw_section );
+    list_remove( &rw->entry );
+    cancelled = rw->cancelled;
+    RtlLeaveCriticalSection( &async_file_rw_section );
+
+    if (cancelled) status = STATUS_CANCELLED;
+    else status = file_rw_transfer( rw->unix_fd, rw->write, &rw->buf, rw->length, &rw->offset, &total );
+    close( rw->unix_fd );
+
+    TRACE( "%p %s %u bytes at 0x%s = 0x%08x\n", rw->handle, rw->write ? "write" : "read",
+           total, wine_dbgstr_longlong( rw->offset ), status );
+
+    rw->io_status->Information = total;
+    rw->io_status->u.Status = status;
+    NtSetEvent( rw->event, NULL );
+    if (rw->completion)
+    {
+        NTDLL_AddCompletion( rw->completion, rw->cvalue, status, total );
+        NtClose( rw->completion );
+    }
+
+    RtlFreeHeap( GetProcessHeap(), 0, rw );
+    return 0;
+}
+
+/***********************************************************************
+ *             cancel_async_file_rw
+ *
+ * Cancel the queued transfers of a handle, either those of the current
+ * thread or those using the given IO_STATUS_BLOCK.
+ */
+static BOOL cancel_async_file_rw( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread )
+{
+    struct async_file_rw *rw;
+    BOOL found = FALSE;
+
+    RtlEnterCriticalSection( &async_file_rw_section );
+    LIST_FOR_EACH_ENTRY( rw, &async_file_rw_list, struct async_file_rw, entry )
+    {
+        if (rw->handle != handle) continue;
+        if (only_thread && rw->thread != GetCurrentThreadId()) continue;
+        if (iosb && rw->io_status != iosb) continue;
+        rw->cancelled = TRUE;
+        found = TRUE;
+    }
+    RtlLeaveCriticalSection( &async_file_rw_section );
+    return found;
+}
+
+/***********************************************************************
+ *             queue_async_file_rw
+ *
+ * Queue a regular file transfer to a worker thread. Returns STATUS_PENDING
+ * on success, the caller has to complete the request synchronously otherwise.
+ */
+static NTSTATUS queue_async_file_rw( HANDLE handle, int unix_fd, HANDLE event, IO_STATUS_BLOCK *io_status,
+                                     ULONG_PTR cvalue, BOOL write, const struct file_rw_buffer *buf,
+                                     ULONG length, off_t offset )
+{
+    struct async_file_rw *rw;
+    NTSTATUS status;
+
+    /* a faulting write fails synchronously, without a completion */
+    if (write && !file_rw_check_buffer( buf, length )) return STATUS_INVALID_USER_BUFFER;
+
+    if (!(rw = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*rw) ))) return STATUS_NO_MEMORY;
+
+    /* the handle may be closed, and its value reused, while the transfer is in progress */
+    rw->completion = 0;
+    if (cvalue && (status = NtDuplicateObject( NtCurrentProcess(), handle, NtCurrentProcess(),
+                                               &rw->completion, 0, 0, DUPLICATE_SAME_ACCESS )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, rw );
+        return status;
+    }
+    if ((rw->unix_fd = dup( unix_fd )) == -1)
+    {
+        status = FILE_GetNtStatus();
+        if (rw->completion) NtClose( rw->completion );
+        RtlFreeHeap( GetProcessHeap(), 0, rw );
+        return status;
+    }
+    rw->handle    = handle;
+    rw->thread    = GetCurrentThreadId();
+    rw->cancelled = FALSE;
+    rw->event     = event;
+    rw->io_status = io_status;
+    rw->cvalue    = cvalue;
+    rw->write     = write;
+    rw->offset    = offset;
+    rw->length    = length;
+    rw->buf       = *buf;
+
+    io_status->u.Status = STATUS_PENDING;
+    io_status->Information = 0;
+    NtResetEvent( event, NULL );
+
+    RtlEnterCriticalSection( &async_file_rw_section );
+    list_add_tail( &async_file_rw_list, &rw->entry );
+    RtlLeaveCriticalSection( &async_file_rw_section );
+
+    if ((status = RtlQueueWorkItem( async_file_rw_proc, rw, WT_EXECUTEDEFAULT )))
+    {
+        RtlEnterCriticalSection( &async_file_rw_section );
+        list_remove( &rw->entry );
+        RtlLeaveCriticalSection( &async_file_rw_section );
+        close( rw->unix_fd );
+        if (rw->completion) NtClose( rw->completion );
+        RtlFreeHeap( GetProcessHeap(), 0, rw );
+        return status;
+    }
+    return STATUS_PENDING;
+}
+
+
 /******************************************************************************
  *  NtReadFile					[NTDLL.@]
  *  ZwReadFile					[NTDLL.@]
@@ -964,7 +1252,15 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
-            /* async I/O doesn't make sense on regular files */
+            if (use_async_file_rw( options, hEvent, apc ))
+            {
+                struct file_rw_buffer buf = { buffer, NULL };
+                status = queue_async_file_rw( hFile, unix_handle, hEvent, io_status, cvalue,
+                                              FALSE, &buf, length, offset->QuadPart );
+                if (status == STATUS_PENDING) goto err;
+            }
+
+            /* buffered async I/O doesn't make sense on regular files */
             while ((result = pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
                 if (errno == EFAULT)
@@ -1142,15 +1438,17 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
                                    PIO_STATUS_BLOCK io_status, FILE_SEGMENT_ELEMENT *segments,
                                    ULONG length, PLARGE_INTEGER offset, PULONG key )
 {
-    int result, unix_handle, needs_close;
+    int unix_handle, needs_close;
     unsigned int options;
     NTSTATUS status;
-    ULONG pos = 0, total = 0;
+    ULONG total = 0;
+    struct file_rw_buffer buf = { NULL, segments };
+    off_t pos;
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE;
 
-    TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p),partial stub!\n",
+    TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p)\n",
            file, event, apc, apc_user, io_status, segments, length, offset, key);
 
     if (length % page_size) return STATUS_INVALID_PARAMETER;
@@ -1168,33 +1466,19 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         goto error;
     }
 
-    while (length)
+    if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
     {
-        if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pread( unix_handle, (char *)segments->Buffer + pos,
-                            page_size - pos, offset->QuadPart + total );
-        else
-            result = read( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
-
-        if (result == -1)
-        {
-            if (errno == EINTR) continue;
-            status = FILE_GetNtStatus();
-            break;
-        }
-        if (!result)
-        {
-            status = STATUS_END_OF_FILE;
-            break;
-        }
-        total += result;
-        length -= result;
-        if ((pos += result) == page_size)
+        pos = offset->QuadPart;
+        if (use_async_file_rw( options, event, apc ) &&
+            queue_async_file_rw( file, unix_handle, event, io_status, cvalue,
+                                 FALSE, &buf, length, pos ) == STATUS_PENDING)
         {
-            pos = 0;
-            segments++;
+            status = STATUS_PENDING;
+            goto error;
         }
+        status = file_rw_transfer( unix_handle, FALSE, &buf, length, &pos, &total );
     }
+    else status = file_rw_transfer( unix_handle, FALSE, &buf, length, NULL, &total );
 
     send_completion = cvalue != 0;
 
@@ -1385,7 +1669,15 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 goto done;
             }
 
-            /* async I/O doesn't make sense on regular files */
+            if (use_async_file_rw( options, hEvent, apc ))
+            {
+                struct file_rw_buffer buf = { (char *)buffer, NULL };
+                status = queue_async_file_rw( hFile, unix_handle, hEvent, io_status, cvalue,
+                                              TRUE, &buf, length, off );
+                if (status == STATUS_PENDING) goto err;
+            }
+
+            /* buffered async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
                 if (errno != EINTR)
@@ -1540,15 +1832,17 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
                                    PIO_STATUS_BLOCK io_status, FILE_SEGMENT_ELEMENT *segments,
                                    ULONG length, PLARGE_INTEGER offset, PULONG key )
 {
-    int result, unix_handle, needs_close;
+    int unix_handle, needs_close;
     unsigned int options;
     NTSTATUS status;
-    ULONG pos = 0, total = 0;
+    ULONG total = 0;
+    struct file_rw_buffer buf = { NULL, segments };
+    off_t pos;
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE;
 
-    TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p),partial stub!\n",
+    TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p)\n",
            file, event, apc, apc_user, io_status, segments, length, offset, key);
 
     if (length % page_size) return STATUS_INVALID_PARAMETER;
@@ -1566,38 +1860,22 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         goto error;
     }
 
-    while (length)
+    if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
     {
-        if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pwrite( unix_handle, (char *)segments->Buffer + pos,
-                             page_size - pos, offset->QuadPart + total );
-        else
-            result = write( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
-
-        if (result == -1)
+        pos = offset->QuadPart;
+        if (use_async_file_rw( options, event, apc ) &&
+            queue_async_file_rw( file, unix_handle, event, io_status, cvalue,
+                                 TRUE, &buf, length, pos ) == STATUS_PENDING)
         {
-            if (errno == EINTR) continue;
-            if (errno == EFAULT)
-            {
-                status = STATUS_INVALID_USER_BUFFER;
-                goto error;
-            }
-            status = FILE_GetNtStatus();
-            break;
-        }
-        if (!result)
-        {
-            status = STATUS_DISK_FULL;
-            break;
-        }
-        total += result;
-        length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
+            status = STATUS_PENDING;
+            goto error;
         }
+        status = file_rw_transfer( unix_handle, TRUE, &buf, length, &pos, &total );
     }
+    else status = file_rw_transfer( unix_handle, TRUE, &buf, length, NULL, &total );
+
+    /* a faulting buffer fails synchronously, without a completion */
+    if (status == STATUS_INVALID_USER_BUFFER) goto error;
 
     send_completion = cvalue != 0;
 
@@ -4099,8 +4377,12 @@ NTSTATUS WINAPI NtDeleteFile( POBJECT_ATTRIBUTES ObjectAttributes )
  */
 NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATUS_BLOCK io_status )
 {
+    BOOL found;
+
     TRACE("%p %p %p\n", hFile, iosb, io_status );
 
+    found = cancel_async_file_rw( hFile, iosb, FALSE );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -4110,6 +4392,8 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATU
     }
     SERVER_END_REQ;
 
+    if (found && io_status->u.Status == STATUS_NOT_FOUND) io_status->u.Status = STATUS_SUCCESS;
+
     return io_status->u.Status;
 }
 
@@ -4120,8 +4404,12 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATU
  */
 NTSTATUS WINAPI NtCancelIoFile( HANDLE hFile, PIO_STATUS_BLOCK io_status )
 {
+    BOOL found;
+
     TRACE("%p %p\n", hFile, io_status );
 
+    found = cancel_async_file_rw( hFile, NULL, TRUE );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -4131,6 +4419,8 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE hFile, PIO_STATUS_BLOCK io_status )
     }
     SERVER_END_REQ;
 
+    if (found && io_status->u.Status == STATUS_NOT_FOUND) io_status->u.Status = STATUS_SUCCESS;
+
     return io_status->u.Status;
 }
 
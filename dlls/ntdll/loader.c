@@ -3194,6 +3194,8 @@ void WINAPI LdrShutdownProcess(void)
     TRACE("()\n");
     process_detaching = TRUE;
     process_detach();
+    lock_profile_dump();
+    server_dump_fd_cache_stats();
 }
 
 
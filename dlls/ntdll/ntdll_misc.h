@@ -98,6 +98,8 @@ extern unsigned int server_select( const select_op_t *select_op, data_size_t siz
                                    UINT flags, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *call, apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_remove_fd_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void server_dup_fd_cache_entry( HANDLE source, HANDLE dest ) DECLSPEC_HIDDEN;
+extern void server_dump_fd_cache_stats(void) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
 extern int server_pipe( int fd[2] ) DECLSPEC_HIDDEN;
@@ -106,6 +108,19 @@ extern NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct o
 extern NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr ) DECLSPEC_HIDDEN;
 extern void *server_get_shared_memory( HANDLE thread ) DECLSPEC_HIDDEN;
 
+/* futexes, shared by critical sections and the sync primitives */
+extern int use_futexes(void) DECLSPEC_HIDDEN;
+#ifdef __linux__
+struct timespec;
+extern int futex_wait( int *addr, int val, struct timespec *timeout ) DECLSPEC_HIDDEN;
+extern int futex_wake( int *addr, int val ) DECLSPEC_HIDDEN;
+#endif
+
+/* lock contention profiling */
+extern LONGLONG lock_profile_start(void) DECLSPEC_HIDDEN;
+extern void lock_profile_record( const void *lock, const char *name, LONGLONG start ) DECLSPEC_HIDDEN;
+extern void lock_profile_dump(void) DECLSPEC_HIDDEN;
+
 /* module handling */
 extern LIST_ENTRY tls_links DECLSPEC_HIDDEN;
 extern NTSTATUS MODULE_DllThreadAttach( LPVOID lpReserved ) DECLSPEC_HIDDEN;
@@ -431,6 +431,9 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
             }
+            else if (dest && reply->self && dest_process == NtCurrentProcess() &&
+                     (options & DUPLICATE_SAME_ACCESS))
+                server_dup_fd_cache_entry( source, *dest );
         }
     }
     SERVER_END_REQ;
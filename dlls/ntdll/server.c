@@ -84,6 +84,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
+WINE_DECLARE_DEBUG_CHANNEL(fdcache);
 
 /* Some versions of glibc don't define this */
 #ifndef SCM_RIGHTS
@@ -853,6 +854,15 @@ C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
 static union fd_cache_entry *fd_cache[FD_CACHE_ENTRIES];
 static union fd_cache_entry fd_cache_initial_block[FD_CACHE_BLOCK_SIZE];
 
+/* cache statistics, only collected when the fdcache channel is enabled */
+static struct
+{
+    LONG hits;          /* lookups satisfied without taking fd_cache_section */
+    LONG misses;        /* lookups that had to take fd_cache_section */
+    LONG server_calls;  /* get_handle_fd requests sent to the server */
+    LONG prefetched;    /* entries inherited from a duplicated handle */
+} fd_cache_stats;
+
 static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 {
     unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
@@ -860,6 +870,17 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
     return idx % FD_CACHE_BLOCK_SIZE;
 }
 
+/* atomically read a cache entry; on 64-bit a plain aligned load is enough and,
+ * unlike a locked cmpxchg, doesn't need exclusive ownership of the cache line */
+static inline LONG64 read_fd_cache_entry( union fd_cache_entry *cache )
+{
+#ifdef _WIN64
+    return *(volatile LONG64 *)&cache->data;
+#else
+    return interlocked_cmpxchg64( &cache->data, 0, 0 );
+#endif
+}
+
 
 /***********************************************************************
  *           add_fd_to_cache
@@ -912,7 +933,7 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 
     if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return STATUS_INVALID_HANDLE;
 
-    cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    cache.data = read_fd_cache_entry( &fd_cache[entry][idx] );
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
     /* if fd type is invalid, fd stores an error value */
@@ -945,6 +966,48 @@ int server_remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           server_dup_fd_cache_entry
+ *
+ * Fill the cache entry of a newly duplicated handle from the entry of its
+ * source handle, so that the first use of the new handle doesn't need a
+ * server round trip. Both handles must refer to the same object with the
+ * same access rights.
+ */
+void server_dup_fd_cache_entry( HANDLE source, HANDLE dest )
+{
+    unsigned int access = 0, options = 0;
+    enum server_fd_type type = FD_TYPE_INVALID;
+    sigset_t sigset;
+    int fd = -1, dummy;
+
+    if (get_cached_fd( source, &fd, &type, &access, &options )) return;
+    if ((fd = dup( fd )) == -1) return;
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    if (get_cached_fd( dest, &dummy, NULL, NULL, NULL ) == STATUS_INVALID_HANDLE &&
+        add_fd_to_cache( dest, fd, type, access, options ))
+        fd = -1;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (fd != -1) close( fd );
+    else if (TRACE_ON(fdcache)) interlocked_xchg_add( &fd_cache_stats.prefetched, 1 );
+}
+
+
+/***********************************************************************
+ *           server_dump_fd_cache_stats
+ */
+void server_dump_fd_cache_stats(void)
+{
+    if (!TRACE_ON(fdcache)) return;
+    TRACE_(fdcache)( "hits %d misses %d server calls %d prefetched %d\n",
+                     fd_cache_stats.hits, fd_cache_stats.misses,
+                     fd_cache_stats.server_calls, fd_cache_stats.prefetched );
+}
+
+
 /***********************************************************************
  *           wine_server_close_fds_by_type
  *
@@ -960,7 +1023,7 @@ void CDECL wine_server_close_fds_by_type( enum server_fd_type type )
         if (!fd_cache[entry]) continue;
         for (idx = 0; idx < FD_CACHE_BLOCK_SIZE; idx++)
         {
-            cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+            cache.data = read_fd_cache_entry( &fd_cache[entry][idx] );
             if (cache.s.type != type || cache.s.fd == 0) continue;
             if (interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, cache.data ) != cache.data) continue;
             close( cache.s.fd - 1 );
@@ -987,12 +1050,18 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
     wanted_access &= FILE_READ_DATA | FILE_WRITE_DATA | FILE_APPEND_DATA;
 
     ret = get_cached_fd( handle, &fd, type, &access, options );
-    if (ret != STATUS_INVALID_HANDLE) goto done;
+    if (ret != STATUS_INVALID_HANDLE)
+    {
+        if (TRACE_ON(fdcache)) interlocked_xchg_add( &fd_cache_stats.hits, 1 );
+        goto done;
+    }
+    if (TRACE_ON(fdcache)) interlocked_xchg_add( &fd_cache_stats.misses, 1 );
 
     server_enter_uninterrupted_section( &fd_cache_section, &sigset );
     ret = get_cached_fd( handle, &fd, type, &access, options );
     if (ret == STATUS_INVALID_HANDLE)
     {
+        if (TRACE_ON(fdcache)) interlocked_xchg_add( &fd_cache_stats.server_calls, 1 );
         SERVER_START_REQ( get_handle_fd )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -1096,11 +1165,25 @@ void *server_get_shared_memory( HANDLE thread )
 
     if (!server_get_shared_memory_fd( thread, &fd ))
     {
-        SIZE_T size = thread ? sizeof(shmlocal_t) : sizeof(shmglobal_t);
+        SIZE_T size = thread ? SHM_CLIENT_OFFSET + sizeof(shmclient_t) : sizeof(shmglobal_t);
         virtual_map_shared_memory( fd, &mem, 0, &size, PAGE_READONLY );
         close( fd );
     }
 
+    /* the client block of the thread local memory is the only part we may write to */
+    if (thread && mem)
+    {
+        void *client = (char *)mem + SHM_CLIENT_OFFSET;
+        SIZE_T size = sizeof(shmclient_t);
+        ULONG old_prot;
+
+        if (NtProtectVirtualMemory( NtCurrentProcess(), &client, &size, PAGE_READWRITE, &old_prot ))
+        {
+            NtUnmapViewOfSection( NtCurrentProcess(), mem );
+            mem = NULL;
+        }
+    }
+
     if (!thread)
     {
         if (mem) WARN_(winediag)("Using shared memory wineserver communication\n");
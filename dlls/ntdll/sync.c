@@ -42,6 +42,10 @@
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <limits.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -55,6 +59,7 @@
 #include "winternl.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
@@ -72,6 +77,297 @@ static inline int interlocked_dec_if_nonzero( int *dest )
     return val;
 }
 
+#ifdef __linux__
+
+static int futex_private = 128; /* FUTEX_PRIVATE_FLAG */
+
+int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */ | futex_private, val, timeout, 0, 0 );
+}
+
+int futex_wake( int *addr, int val )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */ | futex_private, val, NULL, 0, 0 );
+}
+
+/* note: unlike FUTEX_WAIT, the timeout of FUTEX_WAIT_BITSET is an absolute CLOCK_MONOTONIC time */
+static inline int futex_wait_bitset( int *addr, int val, struct timespec *timeout, int mask )
+{
+    return syscall( __NR_futex, addr, 9 /* FUTEX_WAIT_BITSET */ | futex_private, val, timeout, 0, mask );
+}
+
+static inline int futex_wake_bitset( int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, 10 /* FUTEX_WAKE_BITSET */ | futex_private, val, NULL, 0, mask );
+}
+
+int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        futex_wait_bitset( &supported, 10, NULL, ~0 );
+        if (errno == ENOSYS)
+        {
+            futex_private = 0;
+            futex_wait_bitset( &supported, 10, NULL, ~0 );
+        }
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* timeouts longer than this are treated as infinite, so that they fit in a 32-bit time_t */
+#define FUTEX_MAX_TIMEOUT_SECS (INT_MAX / 2)
+
+/* converts an NT timeout to a relative timespec suitable for FUTEX_WAIT,
+ * returns FALSE if the timeout is too far in the future to be represented */
+static BOOL timespec_from_timeout( struct timespec *timespec, const LARGE_INTEGER *timeout )
+{
+    LARGE_INTEGER now;
+    LONGLONG diff;
+
+    if (timeout->QuadPart >= 0)
+    {
+        NtQuerySystemTime( &now );
+        diff = timeout->QuadPart - now.QuadPart;
+    }
+    else diff = -timeout->QuadPart;
+
+    if (diff < 0) diff = 0;
+    if (diff / 10000000 > FUTEX_MAX_TIMEOUT_SECS) return FALSE;
+    timespec->tv_sec  = diff / 10000000;
+    timespec->tv_nsec = (diff % 10000000) * 100;
+    return TRUE;
+}
+
+/* converts an NT timeout to an absolute CLOCK_MONOTONIC time for FUTEX_WAIT_BITSET,
+ * returns FALSE if the wait has to be infinite */
+static BOOL futex_deadline( struct timespec *end, const LARGE_INTEGER *timeout )
+{
+    struct timespec rel;
+
+    if (!timespec_from_timeout( &rel, timeout )) return FALSE;
+    clock_gettime( CLOCK_MONOTONIC, end );
+    /* time_t may only be 32 bits wide */
+    if (end->tv_sec > INT_MAX - rel.tv_sec - 1) return FALSE;
+    end->tv_sec  += rel.tv_sec;
+    end->tv_nsec += rel.tv_nsec;
+    if (end->tv_nsec >= 1000000000)
+    {
+        end->tv_sec++;
+        end->tv_nsec -= 1000000000;
+    }
+    return TRUE;
+}
+
+/* simple futex mutex: 0 = unlocked, 1 = locked, 2 = locked with waiters */
+static void futex_lock( int *lock )
+{
+    int val;
+
+    if (!(val = interlocked_cmpxchg( lock, 1, 0 ))) return;
+    if (val != 2) val = interlocked_xchg( lock, 2 );
+    while (val)
+    {
+        futex_wait( lock, 2, NULL );
+        val = interlocked_xchg( lock, 2 );
+    }
+}
+
+static void futex_unlock( int *lock )
+{
+    if (interlocked_xchg( lock, 0 ) == 2) futex_wake( lock, 1 );
+}
+
+#else
+
+int use_futexes(void)
+{
+    return 0;
+}
+
+#endif
+
+/* In-process wait queues
+ *
+ * Waits on the process private keyed event and on addresses (WaitOnAddress)
+ * are queued in a hashed table of waiter lists, so that they can be
+ * satisfied without a server round trip. Each waiter lives on the stack of
+ * the waiting thread and is blocked on its own futex. When futexes are not
+ * available, or when the wait has to be alertable, waiters block on the
+ * private keyed event in the server instead, using the waiter address as key.
+ */
+
+enum wait_queue_kind
+{
+    WAIT_KEYED_WAIT,     /* NtWaitForKeyedEvent */
+    WAIT_KEYED_RELEASE,  /* NtReleaseKeyedEvent */
+    WAIT_ADDRESS         /* RtlWaitOnAddress */
+};
+
+struct wait_queue_entry
+{
+    struct list          entry;
+    const void          *key;       /* keyed event key or waited address */
+    enum wait_queue_kind kind;
+    int                  signaled;  /* set under the bucket lock once the entry has been dequeued */
+    BOOL                 server;    /* blocked on the server keyed event rather than on a futex */
+};
+
+#define WAIT_QUEUE_BUCKETS 256
+
+struct wait_queue_bucket
+{
+    int         lock;      /* futex lock, only used with futexes */
+    struct list waiters;
+};
+
+static struct wait_queue_bucket wait_queue_buckets[WAIT_QUEUE_BUCKETS];
+
+static RTL_CRITICAL_SECTION wait_queue_section;
+static RTL_CRITICAL_SECTION_DEBUG wait_queue_section_debug =
+{
+    0, 0, &wait_queue_section,
+    { &wait_queue_section_debug.ProcessLocksList, &wait_queue_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": wait_queue_section") }
+};
+static RTL_CRITICAL_SECTION wait_queue_section = { &wait_queue_section_debug, -1, 0, 0, 0, 0 };
+
+static struct wait_queue_bucket *lock_wait_queue( const void *key )
+{
+    struct wait_queue_bucket *bucket;
+    unsigned int hash = (unsigned int)((ULONG_PTR)key >> 2) * 0x9e3779b1;
+
+    bucket = &wait_queue_buckets[hash >> 24];
+#ifdef __linux__
+    if (use_futexes()) futex_lock( &bucket->lock );
+    else
+#endif
+    RtlEnterCriticalSection( &wait_queue_section );
+    if (!bucket->waiters.next) list_init( &bucket->waiters );
+    return bucket;
+}
+
+static void unlock_wait_queue( struct wait_queue_bucket *bucket )
+{
+#ifdef __linux__
+    if (use_futexes()) futex_unlock( &bucket->lock );
+    else
+#endif
+    RtlLeaveCriticalSection( &wait_queue_section );
+}
+
+static NTSTATUS keyed_event_select( HANDLE handle, const void *key, int op,
+                                    BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    select_op_t select_op;
+    UINT flags = SELECT_INTERRUPTIBLE;
+
+    if (alertable) flags |= SELECT_ALERTABLE;
+    select_op.keyed_event.op     = op;
+    select_op.keyed_event.handle = wine_server_obj_handle( handle );
+    select_op.keyed_event.key    = wine_server_client_ptr( key );
+    return server_select( &select_op, sizeof(select_op.keyed_event), flags, timeout );
+}
+
+/* dequeue a waiter; must be called with the bucket locked and followed by wake_wait_queue_entry,
+ * returns whether the waiter is blocked in the server, which has to be read before unlocking */
+static BOOL signal_wait_queue_entry( struct wait_queue_entry *waiter )
+{
+    list_remove( &waiter->entry );
+    waiter->signaled = 1;
+    return waiter->server;
+}
+
+/* wake a dequeued waiter; must be called without holding the bucket lock */
+static void wake_wait_queue_entry( struct wait_queue_entry *waiter, BOOL server )
+{
+#ifdef __linux__
+    /* the waiter may already be gone, a spurious wake of a reused address is harmless */
+    if (!server)
+    {
+        futex_wake( &waiter->signaled, 1 );
+        return;
+    }
+#endif
+    keyed_event_select( keyed_event, waiter, SELECT_KEYED_EVENT_RELEASE, FALSE, NULL );
+}
+
+/* queue a waiter in a locked bucket, release the lock and wait for it to be signaled */
+static NTSTATUS wait_queue_wait( struct wait_queue_bucket *bucket, struct wait_queue_entry *waiter,
+                                 BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    NTSTATUS status;
+
+    waiter->signaled = 0;
+    /* APCs can only interrupt a wait in the server */
+    waiter->server = alertable || !use_futexes();
+    list_add_tail( &bucket->waiters, &waiter->entry );
+    unlock_wait_queue( bucket );
+
+#ifdef __linux__
+    if (!waiter->server)
+    {
+        struct timespec end;
+        int ret;
+
+        if (timeout && !futex_deadline( &end, timeout )) timeout = NULL;
+        while (!*(volatile int *)&waiter->signaled)
+        {
+            ret = futex_wait_bitset( &waiter->signaled, 0, timeout ? &end : NULL, ~0 );
+            if (ret == -1 && errno == ETIMEDOUT)
+            {
+                bucket = lock_wait_queue( waiter->key );
+                ret = waiter->signaled;
+                if (!ret) list_remove( &waiter->entry );
+                unlock_wait_queue( bucket );
+                return ret ? STATUS_SUCCESS : STATUS_TIMEOUT;
+            }
+        }
+        return STATUS_SUCCESS;
+    }
+#endif
+
+    status = keyed_event_select( keyed_event, waiter, SELECT_KEYED_EVENT_WAIT, alertable, timeout );
+    if (status != STATUS_SUCCESS)
+    {
+        bucket = lock_wait_queue( waiter->key );
+        if (!waiter->signaled) list_remove( &waiter->entry );
+        else status = STATUS_SUCCESS;
+        unlock_wait_queue( bucket );
+        /* somebody dequeued us concurrently and is about to release us */
+        if (status == STATUS_SUCCESS)
+            keyed_event_select( keyed_event, waiter, SELECT_KEYED_EVENT_WAIT, FALSE, NULL );
+    }
+    return status;
+}
+
+/* keyed event waits and releases pair up with each other, whichever comes first blocks */
+static NTSTATUS wait_queue_keyed_event( const void *key, enum wait_queue_kind kind,
+                                        BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    enum wait_queue_kind other_kind = (kind == WAIT_KEYED_WAIT) ? WAIT_KEYED_RELEASE : WAIT_KEYED_WAIT;
+    struct wait_queue_bucket *bucket = lock_wait_queue( key );
+    struct wait_queue_entry *other, waiter;
+    BOOL server;
+
+    LIST_FOR_EACH_ENTRY( other, &bucket->waiters, struct wait_queue_entry, entry )
+    {
+        if (other->key != key || other->kind != other_kind) continue;
+        server = signal_wait_queue_entry( other );
+        unlock_wait_queue( bucket );
+        wake_wait_queue_entry( other, server );
+        return STATUS_SUCCESS;
+    }
+
+    waiter.key  = key;
+    waiter.kind = kind;
+    return wait_queue_wait( bucket, &waiter, alertable, timeout );
+}
+
 /* creates a struct security_descriptor and contained information in one contiguous piece of memory */
 NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                   data_size_t *ret_len )
@@ -1182,15 +1478,11 @@ NTSTATUS WINAPI NtOpenKeyedEvent( HANDLE *handle, ACCESS_MASK access, const OBJE
 NTSTATUS WINAPI NtWaitForKeyedEvent( HANDLE handle, const void *key,
                                      BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
-    select_op_t select_op;
-    UINT flags = SELECT_INTERRUPTIBLE;
-
     if ((ULONG_PTR)key & 1) return STATUS_INVALID_PARAMETER_1;
-    if (alertable) flags |= SELECT_ALERTABLE;
-    select_op.keyed_event.op     = SELECT_KEYED_EVENT_WAIT;
-    select_op.keyed_event.handle = wine_server_obj_handle( handle );
-    select_op.keyed_event.key    = wine_server_client_ptr( key );
-    return server_select( &select_op, sizeof(select_op.keyed_event), flags, timeout );
+    /* the private keyed event is paired in process, alertable waiters still block in the server */
+    if (handle == keyed_event && use_futexes())
+        return wait_queue_keyed_event( key, WAIT_KEYED_WAIT, alertable, timeout );
+    return keyed_event_select( handle, key, SELECT_KEYED_EVENT_WAIT, alertable, timeout );
 }
 
 /******************************************************************************
@@ -1199,15 +1491,10 @@ NTSTATUS WINAPI NtWaitForKeyedEvent( HANDLE handle, const void *key,
 NTSTATUS WINAPI NtReleaseKeyedEvent( HANDLE handle, const void *key,
                                      BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
-    select_op_t select_op;
-    UINT flags = SELECT_INTERRUPTIBLE;
-
     if ((ULONG_PTR)key & 1) return STATUS_INVALID_PARAMETER_1;
-    if (alertable) flags |= SELECT_ALERTABLE;
-    select_op.keyed_event.op     = SELECT_KEYED_EVENT_RELEASE;
-    select_op.keyed_event.handle = wine_server_obj_handle( handle );
-    select_op.keyed_event.key    = wine_server_client_ptr( key );
-    return server_select( &select_op, sizeof(select_op.keyed_event), flags, timeout );
+    if (handle == keyed_event && use_futexes())
+        return wait_queue_keyed_event( key, WAIT_KEYED_RELEASE, alertable, timeout );
+    return keyed_event_select( handle, key, SELECT_KEYED_EVENT_RELEASE, alertable, timeout );
 }
 
 /******************************************************************
@@ -1600,6 +1887,201 @@ DWORD WINAPI RtlRunOnceExecuteOnce( RTL_RUN_ONCE *once, PRTL_RUN_ONCE_INIT_FN fu
 #define srwlock_key_shared(lock)      (&lock->Ptr)
 #endif
 
+#ifdef __linux__
+
+/* Futex based SRW locks
+ *
+ * When futexes are available the lock word uses a simpler layout, since
+ * waiters don't need to be counted per queue to pair them with keyed event
+ * releases:
+ *
+ * 32 31            16               0
+ *  ________________ ________________
+ * | X| #exclusive  |    #shared     |
+ *  ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+ * X is set while the lock is owned exclusively, #exclusive counts the
+ * threads waiting for exclusive access and #shared the current shared
+ * owners. Shared and exclusive waiters sleep on the same futex with
+ * distinct bitsets, so that releases only wake the right kind of waiter.
+ */
+
+#define SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT      0x80000000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK  0x7fff0000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC   0x00010000
+#define SRWLOCK_FUTEX_SHARED_OWNERS_MASK      0x0000ffff
+#define SRWLOCK_FUTEX_SHARED_OWNERS_INC       0x00000001
+
+#define SRWLOCK_FUTEX_BITSET_EXCLUSIVE  1
+#define SRWLOCK_FUTEX_BITSET_SHARED     2
+
+static inline int *srwlock_futex( RTL_SRWLOCK *lock )
+{
+    return (int *)&lock->Ptr;
+}
+
+static BOOLEAN fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return interlocked_cmpxchg( srwlock_futex(lock), SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT, 0 ) == 0;
+}
+
+static void fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *futex = srwlock_futex( lock );
+    unsigned int old, new;
+    LONGLONG start;
+
+    if (fast_try_acquire_srw_exclusive( lock )) return;
+
+    start = lock_profile_start();
+    interlocked_xchg_add( futex, SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC );
+    for (;;)
+    {
+        old = *futex;
+        if (!(old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_SHARED_OWNERS_MASK)))
+        {
+            /* unowned, grab it and leave the waiter queue */
+            new = (old - SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC) | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+            if (interlocked_cmpxchg( futex, new, old ) == old) break;
+            continue;
+        }
+        futex_wait_bitset( futex, old, NULL, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    }
+    lock_profile_record( lock, NULL, start );
+}
+
+static BOOLEAN fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *futex = srwlock_futex( lock );
+    unsigned int old;
+
+    for (;;)
+    {
+        old = *futex;
+        /* exclusive waiters take precedence over new shared owners */
+        if (old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)) return FALSE;
+        if ((old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) == SRWLOCK_FUTEX_SHARED_OWNERS_MASK)
+            RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        if (interlocked_cmpxchg( futex, old + SRWLOCK_FUTEX_SHARED_OWNERS_INC, old ) == old) return TRUE;
+    }
+}
+
+static void fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *futex = srwlock_futex( lock );
+    unsigned int old;
+    LONGLONG start;
+
+    if (fast_try_acquire_srw_shared( lock )) return;
+
+    start = lock_profile_start();
+    for (;;)
+    {
+        old = *futex;
+        if (!(old & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)))
+        {
+            if (fast_try_acquire_srw_shared( lock )) break;
+            continue;
+        }
+        futex_wait_bitset( futex, old, NULL, SRWLOCK_FUTEX_BITSET_SHARED );
+    }
+    lock_profile_record( lock, NULL, start );
+}
+
+static void fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *futex = srwlock_futex( lock );
+    unsigned int old, new;
+
+    do
+    {
+        old = *futex;
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT))
+        {
+            ERR( "lock %p is not owned exclusively (%#x)\n", lock, old );
+            RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        }
+        new = old & ~SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    if (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)
+        futex_wake_bitset( futex, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    else
+        futex_wake_bitset( futex, INT_MAX, SRWLOCK_FUTEX_BITSET_SHARED );
+}
+
+static void fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *futex = srwlock_futex( lock );
+    unsigned int old, new;
+
+    do
+    {
+        old = *futex;
+        if ((old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) || !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            ERR( "lock %p is not owned shared (%#x)\n", lock, old );
+            RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        }
+        new = old - SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    /* only the last shared owner needs to wake an exclusive waiter */
+    if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) && (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        futex_wake_bitset( futex, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+}
+
+#else
+
+static inline BOOLEAN fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock ) { return FALSE; }
+static inline void fast_acquire_srw_exclusive( RTL_SRWLOCK *lock ) { }
+static inline BOOLEAN fast_try_acquire_srw_shared( RTL_SRWLOCK *lock ) { return FALSE; }
+static inline void fast_acquire_srw_shared( RTL_SRWLOCK *lock ) { }
+static inline void fast_release_srw_exclusive( RTL_SRWLOCK *lock ) { }
+static inline void fast_release_srw_shared( RTL_SRWLOCK *lock ) { }
+
+#endif
+
+/* Futex based condition variables
+ *
+ * With futexes the variable holds a sequence number that is incremented by
+ * every wake; sleepers wait for it to change from the value they observed
+ * while still holding the lock, so no wake-up can be lost.
+ */
+static NTSTATUS fast_sleep_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+#ifdef __linux__
+    struct timespec timespec;
+    int ret;
+
+    if (timeout && timespec_from_timeout( &timespec, timeout ))
+        ret = futex_wait( (int *)&variable->Ptr, val, &timespec );
+    else
+        ret = futex_wait( (int *)&variable->Ptr, val, NULL );
+
+    if (ret != -1) return STATUS_SUCCESS;
+    switch (errno)
+    {
+    case EAGAIN:  /* the variable has already been woken */
+    case EINTR:   /* spurious wake-ups are allowed */
+        return STATUS_SUCCESS;
+    case ETIMEDOUT:
+        return STATUS_TIMEOUT;
+    default:
+        return FILE_GetNtStatus();
+    }
+#else
+    return STATUS_NOT_IMPLEMENTED;
+#endif
+}
+
+static void fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+#ifdef __linux__
+    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    futex_wake( (int *)&variable->Ptr, count );
+#endif
+}
+
 static inline void srwlock_check_invalid( unsigned int val )
 {
     /* Throw exception if it's impossible to acquire/release this lock. */
@@ -1675,9 +2157,10 @@ static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
  * NOTES
  *  Please note that SRWLocks do not keep track of the owner of a lock.
  *  It doesn't make any difference which thread for example unlocks an
- *  SRWLock (see corresponding tests). This implementation uses two
- *  keyed events (one for the exclusive waiters and one for the shared
- *  waiters) and is limited to 2^15-1 waiting threads.
+ *  SRWLock (see corresponding tests). When futexes are not available,
+ *  this implementation uses two keyed events (one for the exclusive
+ *  waiters and one for the shared waiters) and is limited to 2^15-1
+ *  waiting threads.
  */
 void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
 {
@@ -1694,8 +2177,18 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (use_futexes())
+    {
+        fast_acquire_srw_exclusive( lock );
+        return;
+    }
+
     if (srwlock_lock_exclusive( (unsigned int *)&lock->Ptr, SRWLOCK_RES_EXCLUSIVE ))
+    {
+        LONGLONG start = lock_profile_start();
         NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
+        lock_profile_record( lock, NULL, start );
+    }
 }
 
 /***********************************************************************
@@ -1708,6 +2201,14 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+    LONGLONG start = 0;
+
+    if (use_futexes())
+    {
+        fast_acquire_srw_shared( lock );
+        return;
+    }
+
     /* Acquires a shared lock. If it's currently not possible to add elements to
      * the shared queue, then request exclusive access instead. */
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
@@ -1723,6 +2224,7 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
     /* Drop exclusive access again and instead requeue for shared access. */
     if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_IN_EXCLUSIVE))
     {
+        start = lock_profile_start();
         NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
         val = srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr, (SRWLOCK_RES_SHARED
                                         - SRWLOCK_RES_EXCLUSIVE) ) - SRWLOCK_RES_EXCLUSIVE;
@@ -1730,7 +2232,11 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
     }
 
     if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
+    {
+        if (!start) start = lock_profile_start();
         NtWaitForKeyedEvent( keyed_event, srwlock_key_shared(lock), FALSE, NULL );
+    }
+    lock_profile_record( lock, NULL, start );
 }
 
 /***********************************************************************
@@ -1738,6 +2244,12 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (use_futexes())
+    {
+        fast_release_srw_exclusive( lock );
+        return;
+    }
+
     srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr,
                              - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
 }
@@ -1747,6 +2259,12 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
+    if (use_futexes())
+    {
+        fast_release_srw_shared( lock );
+        return;
+    }
+
     srwlock_leave_shared( lock, srwlock_lock_exclusive( (unsigned int *)&lock->Ptr,
                           - SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
 }
@@ -1760,6 +2278,8 @@ void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (use_futexes()) return fast_try_acquire_srw_exclusive( lock );
+
     return interlocked_cmpxchg( (int *)&lock->Ptr, SRWLOCK_MASK_IN_EXCLUSIVE |
                                 SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
 }
@@ -1770,6 +2290,9 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+
+    if (use_futexes()) return fast_try_acquire_srw_shared( lock );
+
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
     {
         if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
@@ -1813,6 +2336,12 @@ void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
+    if (use_futexes())
+    {
+        fast_wake_cv( variable, 1 );
+        return;
+    }
+
     if (interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1824,7 +2353,15 @@ void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
-    int val = interlocked_xchg( (int *)&variable->Ptr, 0 );
+    int val;
+
+    if (use_futexes())
+    {
+        fast_wake_cv( variable, INT_MAX );
+        return;
+    }
+
+    val = interlocked_xchg( (int *)&variable->Ptr, 0 );
     while (val-- > 0)
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1848,14 +2385,22 @@ NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, R
                                              const LARGE_INTEGER *timeout )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = *(volatile int *)&variable->Ptr;
+
+    if (!use_futexes()) interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+
     RtlLeaveCriticalSection( crit );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
+    if (use_futexes())
+        status = fast_sleep_cv( variable, val, timeout );
+    else
     {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+        if (status != STATUS_SUCCESS)
+        {
+            if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+                status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        }
     }
 
     RtlEnterCriticalSection( crit );
@@ -1885,18 +2430,25 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
                                               const LARGE_INTEGER *timeout, ULONG flags )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = *(volatile int *)&variable->Ptr;
+
+    if (!use_futexes()) interlocked_xchg_add( (int *)&variable->Ptr, 1 );
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
         RtlReleaseSRWLockShared( lock );
     else
         RtlReleaseSRWLockExclusive( lock );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
+    if (use_futexes())
+        status = fast_sleep_cv( variable, val, timeout );
+    else
     {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+        if (status != STATUS_SUCCESS)
+        {
+            if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+                status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        }
     }
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
@@ -1905,3 +2457,108 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
         RtlAcquireSRWLockExclusive( lock );
     return status;
 }
+
+static BOOL compare_addr( const void *addr, const void *cmp, SIZE_T size )
+{
+    switch (size)
+    {
+        case 1:
+            return (*(const UCHAR *)addr == *(const UCHAR *)cmp);
+        case 2:
+            return (*(const USHORT *)addr == *(const USHORT *)cmp);
+        case 4:
+            return (*(const ULONG *)addr == *(const ULONG *)cmp);
+        case 8:
+            return (*(const ULONG64 *)addr == *(const ULONG64 *)cmp);
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *           RtlWaitOnAddress   (NTDLL.@)
+ *
+ * Waits until the value at the given address differs from the compare value,
+ * or until woken by RtlWakeAddressSingle or RtlWakeAddressAll.
+ *
+ * PARAMS
+ *  addr    [I] address to wait on
+ *  cmp     [I] value to compare against
+ *  size    [I] size of the value, 1, 2, 4 or 8 bytes
+ *  timeout [I] timeout, or NULL for an infinite wait
+ *
+ * RETURNS
+ *  STATUS_SUCCESS, or STATUS_TIMEOUT if the timeout expired.
+ */
+NTSTATUS WINAPI RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size,
+                                  const LARGE_INTEGER *timeout )
+{
+    struct wait_queue_bucket *bucket;
+    struct wait_queue_entry waiter;
+
+    if (size != 1 && size != 2 && size != 4 && size != 8)
+        return STATUS_INVALID_PARAMETER;
+
+    /* the value is checked under the bucket lock, so a wake can't slip in between */
+    bucket = lock_wait_queue( addr );
+    if (!compare_addr( addr, cmp, size ))
+    {
+        unlock_wait_queue( bucket );
+        return STATUS_SUCCESS;
+    }
+
+    waiter.key  = addr;
+    waiter.kind = WAIT_ADDRESS;
+    return wait_queue_wait( bucket, &waiter, FALSE, timeout );
+}
+
+/***********************************************************************
+ *           RtlWakeAddressAll    (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressAll( const void *addr )
+{
+    struct wait_queue_bucket *bucket;
+    struct wait_queue_entry *waiter, *next, *futex_waiters[64];
+    struct list woken = LIST_INIT( woken );
+    unsigned int i, count;
+
+    do
+    {
+        count = 0;
+        bucket = lock_wait_queue( addr );
+        LIST_FOR_EACH_ENTRY_SAFE( waiter, next, &bucket->waiters, struct wait_queue_entry, entry )
+        {
+            if (waiter->key != addr || waiter->kind != WAIT_ADDRESS) continue;
+            if (count == sizeof(futex_waiters) / sizeof(futex_waiters[0])) break;
+            /* a signaled futex waiter may return at any time, only its address is kept for the wake */
+            if (!signal_wait_queue_entry( waiter )) futex_waiters[count++] = waiter;
+            else list_add_tail( &woken, &waiter->entry );
+        }
+        unlock_wait_queue( bucket );
+
+        for (i = 0; i < count; i++) wake_wait_queue_entry( futex_waiters[i], FALSE );
+    } while (count == sizeof(futex_waiters) / sizeof(futex_waiters[0]));
+
+    /* keyed event waiters stay blocked until released, so the list remains valid */
+    LIST_FOR_EACH_ENTRY_SAFE( waiter, next, &woken, struct wait_queue_entry, entry )
+        wake_wait_queue_entry( waiter, TRUE );
+}
+
+/***********************************************************************
+ *           RtlWakeAddressSingle (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressSingle( const void *addr )
+{
+    struct wait_queue_bucket *bucket = lock_wait_queue( addr );
+    struct wait_queue_entry *waiter;
+    BOOL server;
+
+    LIST_FOR_EACH_ENTRY( waiter, &bucket->waiters, struct wait_queue_entry, entry )
+    {
+        if (waiter->key != addr || waiter->kind != WAIT_ADDRESS) continue;
+        server = signal_wait_queue_entry( waiter );
+        unlock_wait_queue( bucket );
+        wake_wait_queue_entry( waiter, server );
+        return;
+    }
+    unlock_wait_queue( bucket );
+}
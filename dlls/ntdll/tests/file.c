@@ -4389,6 +4389,58 @@ static void test_read_write(void)
     CloseHandle(hfile);
 }
 
+static void test_duplicated_handle_io(void)
+{
+    static const char contents[] = "duplicated handle";
+    HANDLE file, dup, dup2;
+    IO_STATUS_BLOCK iosb;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+    char buf[32];
+    BOOL ret;
+
+    file = create_temp_file(0);
+    if (!file) return;
+
+    /* use the handle first, so that its unix fd gets cached */
+    offset.QuadPart = 0;
+    status = pNtWriteFile(file, NULL, NULL, NULL, &iosb, contents, sizeof(contents), &offset, NULL);
+    ok(status == STATUS_SUCCESS, "NtWriteFile failed %x\n", status);
+
+    ret = DuplicateHandle(GetCurrentProcess(), file, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle failed %u\n", GetLastError());
+    ret = DuplicateHandle(GetCurrentProcess(), file, GetCurrentProcess(), &dup2, FILE_READ_DATA, FALSE, 0);
+    ok(ret, "DuplicateHandle failed %u\n", GetLastError());
+
+    /* the duplicated handles stay usable after the source has been closed */
+    CloseHandle(file);
+
+    memset(buf, 0, sizeof(buf));
+    offset.QuadPart = 0;
+    status = pNtReadFile(dup, NULL, NULL, NULL, &iosb, buf, sizeof(buf), &offset, NULL);
+    ok(status == STATUS_SUCCESS, "NtReadFile failed %x\n", status);
+    ok(iosb.Information == sizeof(contents), "got %lu\n", iosb.Information);
+    ok(!strcmp(buf, contents), "got %s\n", buf);
+
+    offset.QuadPart = 0;
+    status = pNtWriteFile(dup, NULL, NULL, NULL, &iosb, contents, sizeof(contents), &offset, NULL);
+    ok(status == STATUS_SUCCESS, "NtWriteFile failed %x\n", status);
+
+    memset(buf, 0, sizeof(buf));
+    offset.QuadPart = 0;
+    status = pNtReadFile(dup2, NULL, NULL, NULL, &iosb, buf, sizeof(buf), &offset, NULL);
+    ok(status == STATUS_SUCCESS, "NtReadFile failed %x\n", status);
+    ok(!strcmp(buf, contents), "got %s\n", buf);
+
+    /* the second handle only has read access */
+    offset.QuadPart = 0;
+    status = pNtWriteFile(dup2, NULL, NULL, NULL, &iosb, contents, sizeof(contents), &offset, NULL);
+    ok(status == STATUS_ACCESS_DENIED, "expected STATUS_ACCESS_DENIED, got %x\n", status);
+
+    CloseHandle(dup2);
+    CloseHandle(dup);
+}
+
 static void test_ioctl(void)
 {
     HANDLE event = CreateEventA(NULL, TRUE, FALSE, NULL);
@@ -4775,6 +4827,7 @@ START_TEST(file)
     test_query_volume_information_file();
     test_query_attribute_information_file();
     test_ioctl();
+    test_duplicated_handle_io();
     test_flush_buffers_file();
     test_query_ea();
     test_junction_points();
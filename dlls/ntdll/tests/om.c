@@ -70,6 +70,9 @@ static NTSTATUS (WINAPI *pNtReleaseKeyedEvent)( HANDLE, const void *, BOOLEAN, c
 static NTSTATUS (WINAPI *pNtCreateIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES, ULONG);
 static NTSTATUS (WINAPI *pNtOpenIoCompletion)( PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES );
 static NTSTATUS (WINAPI *pNtQuerySystemInformation)(SYSTEM_INFORMATION_CLASS, PVOID, ULONG, PULONG);
+static NTSTATUS (WINAPI *pRtlWaitOnAddress)( const void *, const void *, SIZE_T, const LARGE_INTEGER * );
+static void     (WINAPI *pRtlWakeAddressAll)( const void * );
+static void     (WINAPI *pRtlWakeAddressSingle)( const void * );
 
 #define KEYEDEVENT_WAIT       0x0001
 #define KEYEDEVENT_WAKE       0x0002
@@ -1888,6 +1891,69 @@ static void test_keyed_events(void)
     NtClose( event );
 }
 
+static LONG address_value;
+
+static DWORD WINAPI wait_on_address_thread( void *arg )
+{
+    LONG compare = 0;
+    NTSTATUS status;
+
+    while (address_value == compare)
+    {
+        status = pRtlWaitOnAddress( &address_value, &compare, sizeof(compare), NULL );
+        ok( !status, "RtlWaitOnAddress failed %x\n", status );
+    }
+    return 0;
+}
+
+static void test_wait_on_address(void)
+{
+    LARGE_INTEGER timeout;
+    LONG compare;
+    NTSTATUS status;
+    HANDLE threads[2];
+    DWORD ret;
+    int i;
+
+    if (!pRtlWaitOnAddress)
+    {
+        win_skip( "RtlWaitOnAddress not supported, skipping test\n" );
+        return;
+    }
+
+    /* invalid size */
+    address_value = compare = 0;
+    timeout.QuadPart = -10000;
+    status = pRtlWaitOnAddress( &address_value, &compare, 3, &timeout );
+    ok( status == STATUS_INVALID_PARAMETER, "got %x\n", status );
+
+    /* value already differs */
+    compare = 1;
+    status = pRtlWaitOnAddress( &address_value, &compare, sizeof(compare), &timeout );
+    ok( !status, "got %x\n", status );
+
+    /* timeout */
+    compare = 0;
+    status = pRtlWaitOnAddress( &address_value, &compare, sizeof(compare), &timeout );
+    ok( status == STATUS_TIMEOUT, "got %x\n", status );
+    status = pRtlWaitOnAddress( &address_value, &compare, 1, &timeout );
+    ok( status == STATUS_TIMEOUT, "got %x\n", status );
+
+    /* waking without waiters */
+    pRtlWakeAddressSingle( &address_value );
+    pRtlWakeAddressAll( &address_value );
+
+    for (i = 0; i < 2; i++)
+        threads[i] = CreateThread( NULL, 0, wait_on_address_thread, NULL, 0, NULL );
+    Sleep( 100 );
+    InterlockedIncrement( &address_value );
+    pRtlWakeAddressSingle( &address_value );
+    pRtlWakeAddressAll( &address_value );
+    ret = WaitForMultipleObjects( 2, threads, TRUE, 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    for (i = 0; i < 2; i++) CloseHandle( threads[i] );
+}
+
 static void test_null_device(void)
 {
     OBJECT_ATTRIBUTES attr;
@@ -2147,6 +2213,9 @@ START_TEST(om)
     pNtCreateIoCompletion   =  (void *)GetProcAddress(hntdll, "NtCreateIoCompletion");
     pNtOpenIoCompletion     =  (void *)GetProcAddress(hntdll, "NtOpenIoCompletion");
     pNtQuerySystemInformation = (void *)GetProcAddress(hntdll, "NtQuerySystemInformation");
+    pRtlWaitOnAddress       =  (void *)GetProcAddress(hntdll, "RtlWaitOnAddress");
+    pRtlWakeAddressAll      =  (void *)GetProcAddress(hntdll, "RtlWakeAddressAll");
+    pRtlWakeAddressSingle   =  (void *)GetProcAddress(hntdll, "RtlWakeAddressSingle");
 
     test_case_sensitive();
     test_namespace_pipe();
@@ -2161,4 +2230,5 @@ START_TEST(om)
     test_mutant();
     test_keyed_events();
     test_null_device();
+    test_wait_on_address();
 }
@@ -3160,6 +3160,83 @@ static void test_RtlInitializeCriticalSectionEx(void)
     ok(cs.SpinCount == 0 || broken(cs.SpinCount != 0) /* >= Win 8 */,
        "expected SpinCount == 0, got %ld\n", cs.SpinCount);
     RtlDeleteCriticalSection(&cs);
+
+    memset(&cs, 0x11, sizeof(cs));
+    pRtlInitializeCriticalSectionEx(&cs, 1000, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    ok(cs.LockCount == -1, "expected LockCount == -1, got %d\n", cs.LockCount);
+    ok(cs.RecursionCount == 0, "expected RecursionCount == 0, got %d\n", cs.RecursionCount);
+    RtlEnterCriticalSection(&cs);
+    ok(cs.RecursionCount == 1, "expected RecursionCount == 1, got %d\n", cs.RecursionCount);
+    RtlEnterCriticalSection(&cs);
+    ok(cs.RecursionCount == 2, "expected RecursionCount == 2, got %d\n", cs.RecursionCount);
+    RtlLeaveCriticalSection(&cs);
+    RtlLeaveCriticalSection(&cs);
+    ok(cs.LockCount == -1, "expected LockCount == -1, got %d\n", cs.LockCount);
+    ok(cs.RecursionCount == 0, "expected RecursionCount == 0, got %d\n", cs.RecursionCount);
+    RtlDeleteCriticalSection(&cs);
+}
+
+struct dynamic_spin_params
+{
+    RTL_CRITICAL_SECTION *cs;
+    HANDLE held, released;
+};
+
+static DWORD WINAPI dynamic_spin_thread(void *arg)
+{
+    struct dynamic_spin_params *params = arg;
+    unsigned int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        RtlEnterCriticalSection(params->cs);
+        SetEvent(params->held);
+        Sleep(20);
+        RtlLeaveCriticalSection(params->cs);
+        WaitForSingleObject(params->released, INFINITE);
+    }
+    return 0;
+}
+
+static void test_dynamic_spin_count(void)
+{
+    struct dynamic_spin_params params;
+    RTL_CRITICAL_SECTION cs;
+    HANDLE thread;
+    unsigned int i;
+    ULONG spin;
+
+    if (!pRtlInitializeCriticalSectionEx)
+        return; /* Skip winxp */
+    if (strcmp(winetest_platform, "wine"))
+    {
+        skip("The dynamic spin count is not visible in SpinCount on Windows.\n");
+        return;
+    }
+
+    /* spinning always fails when the owner holds the section for a long
+     * time, so the spin count has to go down instead of up */
+    pRtlInitializeCriticalSectionEx(&cs, 1000, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    params.cs = &cs;
+    params.held = CreateEventA(NULL, FALSE, FALSE, NULL);
+    params.released = CreateEventA(NULL, FALSE, FALSE, NULL);
+    thread = CreateThread(NULL, 0, dynamic_spin_thread, &params, 0, NULL);
+    for (i = 0; i < 10; i++)
+    {
+        WaitForSingleObject(params.held, INFINITE);
+        RtlEnterCriticalSection(&cs);
+        RtlLeaveCriticalSection(&cs);
+        SetEvent(params.released);
+    }
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    CloseHandle(params.held);
+    CloseHandle(params.released);
+
+    spin = cs.SpinCount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+    if (cs.SpinCount)  /* single processor systems don't spin */
+        ok(spin < 1000, "expected the spin count to decrease, got %u\n", spin);
+    RtlDeleteCriticalSection(&cs);
 }
 
 static void test_RtlLeaveCriticalSection(void)
@@ -3381,6 +3458,7 @@ START_TEST(rtl)
     test_RtlDecompressBuffer();
     test_RtlIsCriticalSectionLocked();
     test_RtlInitializeCriticalSectionEx();
+    test_dynamic_spin_count();
     test_RtlLeaveCriticalSection();
     test_LdrEnumerateLoadedModules();
     test_RtlQueryPackageIdentity();
@@ -84,11 +84,39 @@ struct wait_work_item
     BOOLEAN CallbackInProgress;
 };
 
+/*
+ * Hierarchical timer wheel, shared by both timer implementations
+ */
+
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SIZE    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS  ((64 + TIMER_WHEEL_BITS - 1) / TIMER_WHEEL_BITS)
+
+struct timer_wheel_entry
+{
+    struct list entry;
+    ULONGLONG   expire;         /* expiration time, in the time base of the wheel */
+    BYTE        level;          /* position in the wheel, valid while queued */
+    BYTE        index;
+};
+
+struct timer_wheel
+{
+    ULONGLONG   unit;           /* duration of a level 0 slot, in the time base of the wheel */
+    ULONGLONG   current;        /* slot currently being expired, in units */
+    ULONG       count;          /* number of queued entries */
+    ULONGLONG   occupied[TIMER_WHEEL_LEVELS];   /* bitmaps of non-empty slots */
+    struct list slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+};
+
 struct timer_queue;
 struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct timer_wheel_entry wheel_entry;
+    struct list fire_entry;     /* entry in the list of timers expired in one pass */
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -103,7 +131,9 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers of the queue */
+    struct timer_wheel wheel;   /* scheduled timers, by expiration time */
+    ULONGLONG wakeup;           /* time at which the queue thread is going to wake up */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -182,7 +212,7 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_wheel_entry wheel_entry;
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -238,15 +268,16 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    ULONGLONG               wakeup;
     RTL_CONDITION_VARIABLE  update_event;
+    struct timer_wheel      pending_timers;
 }
 timerqueue =
 {
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    EXPIRE_NEVER,                               /* wakeup */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -326,6 +357,7 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static void tp_object_submit_locked( struct threadpool_object *object, BOOL signaled );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_prepare_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
@@ -694,6 +726,169 @@ NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
 }
 
 
+/************************** Timer Wheel Impl **************************/
+
+/* Timers are kept in a hierarchical timer wheel instead of a sorted list,
+ * so that adding and removing a timer is O(1) independently of the number
+ * of queued timers. Level 0 has one slot per time unit, each higher level
+ * covers TIMER_WHEEL_SIZE slots of the level below; entries are moved down
+ * ("cascaded") when the wheel reaches the beginning of their slot. The
+ * exact expiration time is always kept in the entry, the wheel only
+ * narrows down which entries need to be checked. */
+
+static void timer_wheel_init( struct timer_wheel *wheel, ULONGLONG unit, ULONGLONG now )
+{
+    int level, index;
+
+    wheel->unit    = unit;
+    wheel->current = now / unit;
+    wheel->count   = 0;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        wheel->occupied[level] = 0;
+        for (index = 0; index < TIMER_WHEEL_SIZE; index++)
+            list_init( &wheel->slots[level][index] );
+    }
+}
+
+static void timer_wheel_add( struct timer_wheel *wheel, struct timer_wheel_entry *entry )
+{
+    ULONGLONG units = entry->expire / wheel->unit;
+    ULONGLONG diff;
+    int level = 0, index;
+
+    /* Entries which are already expired go to the slot that is checked next. */
+    if (units < wheel->current) units = wheel->current;
+
+    /* The level is determined by the most significant digit in which the
+     * expiration time differs from the current position of the wheel.
+     * The levels cover the whole 64-bit range, so the digit of the entry
+     * is always above the current one and the slot is reached before the
+     * entry expires. */
+    for (diff = (units ^ wheel->current) >> TIMER_WHEEL_BITS; diff; diff >>= TIMER_WHEEL_BITS)
+        level++;
+    index = (units >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+
+    entry->level = level;
+    entry->index = index;
+    list_add_tail( &wheel->slots[level][index], &entry->entry );
+    wheel->occupied[level] |= (ULONGLONG)1 << index;
+    wheel->count++;
+}
+
+static void timer_wheel_remove( struct timer_wheel *wheel, struct timer_wheel_entry *entry )
+{
+    list_remove( &entry->entry );
+    if (list_empty( &wheel->slots[entry->level][entry->index] ))
+        wheel->occupied[entry->level] &= ~((ULONGLONG)1 << entry->index);
+    wheel->count--;
+}
+
+/* returns the next position after the current one at which an occupied
+ * slot has to be processed, or EXPIRE_NEVER if the wheel is empty */
+static ULONGLONG timer_wheel_next_position( const struct timer_wheel *wheel, int *next_level )
+{
+    ULONGLONG result = EXPIRE_NEVER, base, pos, mask;
+    int level, shift, cur_index;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        shift     = level * TIMER_WHEEL_BITS;
+        cur_index = (wheel->current >> shift) & TIMER_WHEEL_MASK;
+        mask      = wheel->occupied[level] & ~(((ULONGLONG)2 << cur_index) - 1);
+        if (!mask) continue;
+
+        base = (wheel->current >> shift) & ~(ULONGLONG)TIMER_WHEEL_MASK;
+        pos  = (base + RtlFindLeastSignificantBit( mask )) << shift;
+        if (pos < result)
+        {
+            result = pos;
+            *next_level = level;
+        }
+    }
+
+    return result;
+}
+
+/* moves all entries of a slot one or more levels down */
+static void timer_wheel_cascade( struct timer_wheel *wheel, int level )
+{
+    int index = (wheel->current >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+    struct list *slot = &wheel->slots[level][index];
+    struct timer_wheel_entry *entry, *next;
+    struct list entries;
+
+    if (!(wheel->occupied[level] & ((ULONGLONG)1 << index))) return;
+
+    list_init( &entries );
+    list_move_tail( &entries, slot );
+    wheel->occupied[level] &= ~((ULONGLONG)1 << index);
+    wheel->count -= list_count( &entries );
+
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, &entries, struct timer_wheel_entry, entry )
+    {
+        list_remove( &entry->entry );
+        timer_wheel_add( wheel, entry );
+    }
+}
+
+/* returns the expiration time of the next entry, or a lower bound of it if
+ * it still has to be cascaded, or EXPIRE_NEVER if the wheel is empty */
+static ULONGLONG timer_wheel_next_expire( const struct timer_wheel *wheel )
+{
+    const struct list *slot = &wheel->slots[0][wheel->current & TIMER_WHEEL_MASK];
+    ULONGLONG result = EXPIRE_NEVER, pos;
+    struct timer_wheel_entry *entry;
+    int level;
+
+    if (!wheel->count) return EXPIRE_NEVER;
+
+    if (list_empty( slot ))
+    {
+        pos = timer_wheel_next_position( wheel, &level );
+        if (level) return pos * wheel->unit;
+        slot = &wheel->slots[0][pos & TIMER_WHEEL_MASK];
+    }
+
+    LIST_FOR_EACH_ENTRY( entry, slot, struct timer_wheel_entry, entry )
+        if (entry->expire < result) result = entry->expire;
+    return result;
+}
+
+/* removes all entries which expire at or before the given time from the
+ * wheel and appends them to the expired list */
+static void timer_wheel_expire( struct timer_wheel *wheel, ULONGLONG now, struct list *expired )
+{
+    ULONGLONG now_units = now / wheel->unit, pos;
+    struct timer_wheel_entry *entry, *next;
+    struct list *slot;
+    int level;
+
+    for (;;)
+    {
+        slot = &wheel->slots[0][wheel->current & TIMER_WHEEL_MASK];
+        LIST_FOR_EACH_ENTRY_SAFE( entry, next, slot, struct timer_wheel_entry, entry )
+        {
+            if (entry->expire > now) continue;
+            timer_wheel_remove( wheel, entry );
+            list_add_tail( expired, &entry->entry );
+        }
+
+        /* Entries remaining in the current slot have not expired yet. */
+        if (!list_empty( slot ) || wheel->current >= now_units) break;
+
+        /* Skip ahead to the next occupied slot, cascading higher levels on the way. */
+        pos = timer_wheel_next_position( wheel, &level );
+        wheel->current = min( pos, now_units );
+
+        for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            if (wheel->current & (((ULONGLONG)1 << (level * TIMER_WHEEL_BITS)) - 1)) continue;
+            timer_wheel_cascade( wheel, level );
+        }
+    }
+}
+
 /************************** Timer Queue Impl **************************/
 
 static void queue_remove_timer(struct queue_timer *t)
@@ -706,6 +901,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->runcount == 0);
     assert(t->destroy);
 
+    if (t->expire != EXPIRE_NEVER)
+        timer_wheel_remove(&q->wheel, &t->wheel_entry);
     list_remove(&t->entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
@@ -744,69 +941,79 @@ static inline ULONGLONG queue_current_time(void)
     return now.QuadPart * 1000 / freq.QuadPart;
 }
 
-static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
-                            BOOL set_event)
+static void queue_schedule_timer(struct queue_timer *t, ULONGLONG time,
+                                 BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
+
+    t->wheel_entry.expire = time;
+    timer_wheel_add(&q->wheel, &t->wheel_entry);
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    /* If the timer expires before the queue thread wakes up, we need to
+       expire sooner than expected.  */
+    if (set_event && time < q->wakeup)
         NtSetEvent(q->event, NULL);
 }
 
+static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
+                            BOOL set_event)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    list_add_tail(&t->q->timers, &t->entry);
+    queue_schedule_timer(t, time, set_event);
+}
+
 static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
-    queue_add_timer(t, time, set_event);
+    if (t->expire != EXPIRE_NEVER)
+        timer_wheel_remove(&t->q->wheel, &t->wheel_entry);
+    queue_schedule_timer(t, time, set_event);
 }
 
 static void queue_timer_expire(struct timer_queue *q)
 {
-    struct queue_timer *t = NULL;
+    struct queue_timer *t, *temp;
+    struct list *ptr, *ptr2;
+    struct list expired = LIST_INIT(expired);
+    struct list fire = LIST_INIT(fire);
+    ULONGLONG now, next;
 
+    /* Expire all due timers in one pass, the callbacks are dispatched
+       after the queue lock has been released.  */
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    now = queue_current_time();
+    timer_wheel_expire(&q->wheel, now, &expired);
+    LIST_FOR_EACH_SAFE(ptr, ptr2, &expired)
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        t = LIST_ENTRY(ptr, struct queue_timer, wheel_entry.entry);
+        assert(!t->destroy);
+        list_remove(ptr);
+
+        ++t->runcount;
+        if (t->period)
         {
-            ++t->runcount;
-            if (t->period)
-            {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
-            }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
+            next = t->expire + t->period;
+            /* avoid trigger cascade if overloaded / hibernated */
+            if (next < now)
+                next = now + t->period;
         }
         else
-            t = NULL;
+            next = EXPIRE_NEVER;
+        queue_schedule_timer(t, next, FALSE);
+        list_add_tail(&fire, &t->fire_entry);
     }
     RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
+    LIST_FOR_EACH_ENTRY_SAFE(t, temp, &fire, struct queue_timer, fire_entry)
     {
         if (t->flags & WT_EXECUTEINTIMERTHREAD)
             timer_callback_wrapper(t);
@@ -825,20 +1032,15 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
-    struct queue_timer *t;
+    ULONGLONG expire;
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    expire = q->wakeup = timer_wheel_next_expire(&q->wheel);
+    if (expire != EXPIRE_NEVER)
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ULONGLONG time = queue_current_time();
+        timeout = expire < time ? 0 : min(expire - time, INFINITE - 1);
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -897,8 +1099,7 @@ static void queue_destroy_timer(struct queue_timer *t)
            cleanup wrapper.  */
         queue_remove_timer(t);
     else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+        /* Make sure a destroyed timer doesn't fire anymore.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -923,6 +1124,8 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    timer_wheel_init(&q->wheel, 1, queue_current_time());
+    q->wakeup = EXPIRE_NEVER;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -1189,15 +1392,42 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           tp_timerqueue_add    (internal)
+ *
+ * Adds a timer to the timer wheel. Returns TRUE if the timer thread has
+ * to be woken up to handle the new timeout. Called with timerqueue.cs held.
+ */
+static BOOL tp_timerqueue_add( struct threadpool_object *timer )
+{
+    ULONGLONG expire = timer->u.timer.timeout;
+
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
+    assert( !timer->u.timer.timer_pending );
+
+    /* Use the window length to align the timeout, so that timers with
+     * overlapping windows expire in the same pass of the timer thread. */
+    if (timer->u.timer.window_length > 0)
+    {
+        ULONGLONG granularity = (ULONGLONG)10000 << RtlFindMostSignificantBit( timer->u.timer.window_length );
+        expire = (expire + granularity - 1) / granularity * granularity;
+    }
+
+    timer->u.timer.wheel_entry.expire = expire;
+    timer_wheel_add( &timerqueue.pending_timers, &timer->u.timer.wheel_entry );
+    timer->u.timer.timer_pending = TRUE;
+
+    return expire < timerqueue.wakeup;
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    struct threadpool *pool;
+    struct list expired, *ptr, *next;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
 
     TRACE( "starting timer queue thread\n" );
 
@@ -1207,18 +1437,29 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        list_init( &expired );
+        timer_wheel_expire( &timerqueue.pending_timers, now.QuadPart, &expired );
+
+        pool = NULL;
+        LIST_FOR_EACH_SAFE( ptr, next, &expired )
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.wheel_entry.entry );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
-            if (timer->u.timer.timeout > now.QuadPart)
-                break;
 
-            /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
+            list_remove( &timer->u.timer.wheel_entry.entry );
             timer->u.timer.timer_pending = FALSE;
-            tp_object_submit( timer, FALSE );
+
+            /* Queue a new callback in one of the worker threads. Timers
+             * expiring together usually belong to the same pool, so only
+             * switch the pool lock when necessary. */
+            if (timer->pool != pool)
+            {
+                if (pool) RtlLeaveCriticalSection( &pool->cs );
+                pool = timer->pool;
+                RtlEnterCriticalSection( &pool->cs );
+            }
+            tp_object_submit_locked( timer, FALSE );
 
             /* Insert the timer back into the queue, except it's marked for shutdown. */
             if (timer->u.timer.period && !timer->shutdown)
@@ -1226,40 +1467,18 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
-
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
-                timer->u.timer.timer_pending = TRUE;
+                tp_timerqueue_add( timer );
             }
         }
+        if (pool) RtlLeaveCriticalSection( &pool->cs );
 
-        timeout_lower = TIMEOUT_INFINITE;
-        timeout_upper = TIMEOUT_INFINITE;
-
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
-        }
+        /* Determine next timeout, TpSetTimer wakes us up if a timer expires earlier. */
+        timerqueue.wakeup = timer_wheel_next_expire( &timerqueue.pending_timers );
 
         /* Wait for timer update events or until the next timer expires. */
         if (timerqueue.objcount)
         {
-            timeout.QuadPart = timeout_lower;
+            timeout.QuadPart = min( timerqueue.wakeup, TIMEOUT_INFINITE );
             RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
             continue;
         }
@@ -1323,6 +1542,13 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
 
     RtlEnterCriticalSection( &timerqueue.cs );
 
+    if (!timerqueue.pending_timers.unit)
+    {
+        LARGE_INTEGER now;
+        NtQuerySystemTime( &now );
+        timer_wheel_init( &timerqueue.pending_timers, 10000, now.QuadPart );
+    }
+
     /* Make sure that the timerqueue thread is running. */
     if (!timerqueue.thread_running)
     {
@@ -1361,14 +1587,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            timer_wheel_remove( &timerqueue.pending_timers, &timer->u.timer.wheel_entry );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.pending_timers.count );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1903,12 +2129,11 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 }
 
 /***********************************************************************
- *           tp_object_submit    (internal)
+ *           tp_object_submit_locked    (internal)
  *
- * Submits a threadpool object to the associated threadpool. This
- * function has to be VOID because TpPostWork can never fail on Windows.
+ * Same as tp_object_submit, but the caller has to hold the pool lock.
  */
-static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+static void tp_object_submit_locked( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
     NTSTATUS status = STATUS_UNSUCCESSFUL;
@@ -1916,8 +2141,6 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
-    RtlEnterCriticalSection( &pool->cs );
-
     /* Start new worker threads if required. */
     if (pool->num_busy_workers >= pool->num_workers &&
         pool->num_workers < pool->max_workers)
@@ -1938,7 +2161,20 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
         assert( pool->num_workers > 0 );
         RtlWakeConditionVariable( &pool->update_event );
     }
+}
+
+/***********************************************************************
+ *           tp_object_submit    (internal)
+ *
+ * Submits a threadpool object to the associated threadpool. This
+ * function has to be VOID because TpPostWork can never fail on Windows.
+ */
+static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+{
+    struct threadpool *pool = object->pool;
 
+    RtlEnterCriticalSection( &pool->cs );
+    tp_object_submit_locked( object, signaled );
     RtlLeaveCriticalSection( &pool->cs );
 }
 
@@ -2720,7 +2956,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -2759,7 +2994,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        timer_wheel_remove( &timerqueue.pending_timers, &this->u.timer.wheel_entry );
         this->u.timer.timer_pending = FALSE;
     }
 
@@ -2770,20 +3005,9 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
-
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (tp_timerqueue_add( this ))
             RtlWakeAllConditionVariable( &timerqueue.update_event );
-
-        this->u.timer.timer_pending = TRUE;
     }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
@@ -171,20 +171,22 @@ static void update_mouse_coords( INPUT *input )
  */
 UINT WINAPI SendInput( UINT count, LPINPUT inputs, int size )
 {
-    UINT i;
+    INPUT batch[MAX_HW_INPUT_BATCH];
+    UINT i, j, sent, total = 0;
     NTSTATUS status;
 
-    for (i = 0; i < count; i++)
+    /* send the events in batches to save server round trips */
+    for (i = 0; i < count; i += j)
     {
-        if (inputs[i].type == INPUT_MOUSE)
+        for (j = 0; j < sizeof(batch) / sizeof(batch[0]) && i + j < count; j++)
         {
+            batch[j] = inputs[i + j];
             /* we need to update the coordinates to what the server expects */
-            INPUT input = inputs[i];
-            update_mouse_coords( &input );
-            status = send_hardware_message( 0, &input, SEND_HWMSG_INJECTED );
+            if (batch[j].type == INPUT_MOUSE) update_mouse_coords( &batch[j] );
         }
-        else status = send_hardware_message( 0, &inputs[i], SEND_HWMSG_INJECTED );
 
+        status = send_hardware_input( batch, j, SEND_HWMSG_INJECTED, &sent );
+        total += sent;
         if (status)
         {
             SetLastError( RtlNtStatusToDosError(status) );
@@ -192,7 +194,7 @@ UINT WINAPI SendInput( UINT count, LPINPUT inputs, int size )
         }
     }
 
-    return i;
+    return total;
 }
 
 
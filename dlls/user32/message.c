@@ -56,6 +56,9 @@ WINE_DECLARE_DEBUG_CHANNEL(key);
 
 #define MAX_PACK_COUNT 4
 
+/* packed message data above this size is passed through a section instead of the server */
+#define MESSAGE_SECTION_THRESHOLD 0x10000
+
 /* the various structures that can be sent in messages, in platform-independent layout */
 struct packed_CREATESTRUCTW
 {
@@ -1495,6 +1498,109 @@ static BOOL unpack_message( HWND hwnd, UINT message, WPARAM *wparam, LPARAM *lpa
 }
 
 
+/***********************************************************************
+ *		is_message_data_in_place
+ *
+ * Check whether unpack_message uses the packed data of a message in place,
+ * so that it can be unpacked directly from a mapped section.
+ */
+static BOOL is_message_data_in_place( UINT message )
+{
+    switch(message)
+    {
+    case WM_NCCREATE:
+    case WM_CREATE:
+    case WM_SETTEXT:
+    case WM_WININICHANGE:
+    case WM_DEVMODECHANGE:
+    case WM_COPYDATA:
+    case WM_DEVICECHANGE:
+    case WM_MDICREATE:
+    case CB_DIR:
+    case CB_ADDSTRING:
+    case CB_INSERTSTRING:
+    case CB_FINDSTRING:
+    case CB_FINDSTRINGEXACT:
+    case CB_SELECTSTRING:
+    case LB_DIR:
+    case LB_ADDFILE:
+    case LB_ADDSTRING:
+    case LB_INSERTSTRING:
+    case LB_FINDSTRING:
+    case LB_FINDSTRINGEXACT:
+    case LB_SELECTSTRING:
+    case LB_SETTABSTOPS:
+    case EM_REPLACESEL:
+    case EM_SETTABSTOPS:
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *		create_message_section
+ *
+ * Copy the packed data of a large message into a section, to avoid
+ * transferring it through the server.
+ */
+static HANDLE create_message_section( UINT message, const struct packed_message *data,
+                                      data_size_t *size )
+{
+    HANDLE section;
+    LARGE_INTEGER section_size;
+    SIZE_T view_size = 0;
+    size_t total = 0;
+    void *view = NULL;
+    char *ptr;
+    int i;
+
+    for (i = 0; i < data->count; i++) total += data->size[i];
+    if (total < MESSAGE_SECTION_THRESHOLD || total != (data_size_t)total) return 0;
+    if (!is_message_data_in_place( message )) return 0;
+
+    section_size.QuadPart = total;
+    if (NtCreateSection( &section, SECTION_MAP_READ | SECTION_MAP_WRITE, NULL, &section_size,
+                         PAGE_READWRITE, SEC_COMMIT, 0 ))
+        return 0;
+    if (NtMapViewOfSection( section, GetCurrentProcess(), &view, 0, 0, NULL, &view_size,
+                            ViewShare, 0, PAGE_READWRITE ))
+    {
+        NtClose( section );
+        return 0;
+    }
+    for (i = 0, ptr = view; i < data->count; ptr += data->size[i++])
+        memcpy( ptr, data->data[i], data->size[i] );
+    NtUnmapViewOfSection( GetCurrentProcess(), view );
+    *size = total;
+    return section;
+}
+
+
+/***********************************************************************
+ *		map_message_section
+ *
+ * Map the section holding the data of a large message sent from another process.
+ */
+static void *map_message_section( HANDLE section, size_t size )
+{
+    SIZE_T view_size = 0;
+    void *view = NULL;
+    NTSTATUS status;
+
+    status = NtMapViewOfSection( section, GetCurrentProcess(), &view, 0, 0, NULL, &view_size,
+                                 ViewShare, 0, PAGE_READWRITE );
+    NtClose( section );
+    if (status) return NULL;
+    if (view_size < size)
+    {
+        NtUnmapViewOfSection( GetCurrentProcess(), view );
+        return NULL;
+    }
+    return view;
+}
+
+
 /***********************************************************************
  *		pack_reply
  *
@@ -2726,6 +2832,37 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/***********************************************************************
+ *           get_shm_posted_message
+ *
+ * Retrieve a posted message from the shared memory ring without a server call.
+ */
+static BOOL get_shm_posted_message( shmlocal_t *shm, shmclient_t *client, MSG *msg )
+{
+    unsigned int tail = client->post_tail;
+
+    while (tail != *(volatile unsigned int *)&shm->post_head)
+    {
+        const volatile shmmessage_t *entry = &shm->post_ring[tail & (SHM_POST_RING_SIZE - 1)];
+
+        shared_read_barrier();
+        msg->hwnd    = wine_server_ptr_handle( entry->win );
+        msg->message = entry->msg;
+        msg->wParam  = entry->wparam;
+        msg->lParam  = entry->lparam;
+        msg->time    = entry->time;
+        msg->pt.x    = entry->x;
+        msg->pt.y    = entry->y;
+        /* release the entry only once we have read it */
+        InterlockedExchange( (LONG *)&client->post_tail, ++tail );
+
+        /* the server drops the messages of destroyed windows, so do the same */
+        if (!msg->hwnd || IsWindow( msg->hwnd )) return TRUE;
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2741,16 +2878,30 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     void *buffer;
     size_t buffer_size = 256;
     shmlocal_t *shm = wine_get_shmlocal();
+    shmclient_t *client = wine_get_shmclient();
 
-    /* From time to time we are forced to do a wineserver call in
-     * order to update last_msg_time stored for each server thread. */
-    if (shm && GetTickCount() - thread_info->last_get_msg < 500)
+    if (shm)
     {
         int filter = flags >> 16;
         if (!filter) filter = QS_ALLINPUT;
         filter |= QS_SENDMESSAGE;
         if (filter & QS_INPUT) filter |= QS_INPUT;
+
+        /* let the server know that we are still processing messages */
+        client->get_msg_count++;
         if (!(shm->queue_bits & filter)) return FALSE;
+
+        /* posted messages have priority over everything except sent messages */
+        if ((flags & PM_REMOVE) && !hwnd && !first && (!last || last == ~0U) &&
+            (filter & QS_POSTMESSAGE) && !(shm->queue_bits & QS_SENDMESSAGE) &&
+            get_shm_posted_message( shm, client, msg ))
+        {
+            thread_info->GetMessagePosVal = MAKELONG( msg->pt.x, msg->pt.y );
+            thread_info->GetMessageTimeVal = msg->time;
+            thread_info->GetMessageExtraInfoVal = 0;
+            HOOK_CallHooks( WH_GETMESSAGE, HC_ACTION, flags & PM_REMOVE, (LPARAM)msg, TRUE );
+            return TRUE;
+        }
     }
 
     if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
@@ -2762,9 +2913,10 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     {
         NTSTATUS res;
         size_t size = 0;
+        HANDLE section = 0;
+        void *view = NULL;
         const message_data_t *msg_data = buffer;
 
-        if (shm) thread_info->last_get_msg = GetTickCount();
         SERVER_START_REQ( get_message )
         {
             req->flags     = flags;
@@ -2788,6 +2940,7 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
                 info.msg.pt.y    = reply->y;
                 hw_id            = 0;
                 thread_info->active_hooks = reply->active_hooks;
+                if ((section = wine_server_ptr_handle( reply->section ))) size = reply->total;
             }
             else buffer_size = reply->total;
         }
@@ -2903,11 +3056,38 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
             continue;
         case MSG_OTHER_PROCESS:
             info.flags = ISMEX_SEND;
+            if (section)
+            {
+                if (!(view = map_message_section( section, size )))
+                {
+                    reply_message( &info, 0, TRUE );
+                    continue;
+                }
+                if (!is_message_data_in_place( info.msg.message ))
+                {
+                    void *new_buffer = HeapReAlloc( GetProcessHeap(), 0, buffer, max( size, 1 ) );
+
+                    if (new_buffer)
+                    {
+                        buffer = new_buffer;
+                        buffer_size = max( size, 1 );
+                        memcpy( buffer, view, size );
+                    }
+                    NtUnmapViewOfSection( GetCurrentProcess(), view );
+                    view = NULL;
+                    if (!new_buffer)
+                    {
+                        reply_message( &info, 0, TRUE );
+                        continue;
+                    }
+                }
+            }
             if (!unpack_message( info.msg.hwnd, info.msg.message, &info.msg.wParam,
-                                 &info.msg.lParam, &buffer, size ))
+                                 &info.msg.lParam, view ? &view : &buffer, size ))
             {
                 /* ignore it */
                 reply_message( &info, 0, TRUE );
+                if (view) NtUnmapViewOfSection( GetCurrentProcess(), view );
                 continue;
             }
             break;
@@ -2972,6 +3152,7 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
                                    WMCHAR_MAP_RECVMESSAGE );
         reply_message( &info, result, TRUE );
         thread_info->receive_info = old_info;
+        if (view) NtUnmapViewOfSection( GetCurrentProcess(), view );
 
         /* if some PM_QS* flags were specified, only handle sent messages from now on */
         if (HIWORD(flags) && !changed_mask) flags = PM_QS_SENDMESSAGE | LOWORD(flags);
@@ -3101,6 +3282,8 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
 {
     struct packed_message data;
     message_data_t msg_data;
+    HANDLE section = 0;
+    data_size_t section_size = 0;
     unsigned int res;
     int i;
     timeout_t timeout = TIMEOUT_INFINITE;
@@ -3127,6 +3310,7 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
             WARN( "cannot pack message %x\n", info->msg );
             return FALSE;
         }
+        section = create_message_section( info->msg, &data, &section_size );
     }
     else if (info->type == MSG_CALLBACK)
     {
@@ -3154,7 +3338,12 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
         req->timeout = timeout;
 
         if (info->flags & SMTO_ABORTIFHUNG) req->flags |= SEND_MSG_ABORT_IF_HUNG;
-        for (i = 0; i < data.count; i++) wine_server_add_data( req, data.data[i], data.size[i] );
+        if (section)
+        {
+            req->section      = wine_server_obj_handle( section );
+            req->section_size = section_size;
+        }
+        else for (i = 0; i < data.count; i++) wine_server_add_data( req, data.data[i], data.size[i] );
         if ((res = wine_server_call( req )))
         {
             if (res == STATUS_INVALID_PARAMETER)
@@ -3165,6 +3354,7 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
         }
     }
     SERVER_END_REQ;
+    if (section) NtClose( section );
     return !res;
 }
 
@@ -3305,6 +3495,39 @@ static BOOL send_message( struct send_message_info *info, DWORD_PTR *res_ptr, BO
 }
 
 
+/***********************************************************************
+ *		pack_hw_input
+ *
+ * Convert an INPUT structure to the server format.
+ */
+static void pack_hw_input( const INPUT *input, hw_input_t *hw )
+{
+    hw->type = input->type;
+    switch (input->type)
+    {
+    case INPUT_MOUSE:
+        hw->mouse.x     = input->u.mi.dx;
+        hw->mouse.y     = input->u.mi.dy;
+        hw->mouse.data  = input->u.mi.mouseData;
+        hw->mouse.flags = input->u.mi.dwFlags;
+        hw->mouse.time  = input->u.mi.time;
+        hw->mouse.info  = input->u.mi.dwExtraInfo;
+        break;
+    case INPUT_KEYBOARD:
+        hw->kbd.vkey  = input->u.ki.wVk;
+        hw->kbd.scan  = input->u.ki.wScan;
+        hw->kbd.flags = input->u.ki.dwFlags;
+        hw->kbd.time  = input->u.ki.time;
+        hw->kbd.info  = input->u.ki.dwExtraInfo;
+        break;
+    case INPUT_HARDWARE:
+        hw->hw.msg    = input->u.hi.uMsg;
+        hw->hw.lparam = MAKELONG( input->u.hi.wParamL, input->u.hi.wParamH );
+        break;
+    }
+}
+
+
 /***********************************************************************
  *		send_hardware_message
  */
@@ -3325,35 +3548,78 @@ NTSTATUS send_hardware_message( HWND hwnd, const INPUT *input, UINT flags )
 
     SERVER_START_REQ( send_hardware_message )
     {
-        req->win        = wine_server_user_handle( hwnd );
-        req->flags      = flags;
-        req->input.type = input->type;
-        switch (input->type)
+        req->win   = wine_server_user_handle( hwnd );
+        req->flags = flags;
+        pack_hw_input( input, &req->input );
+        if (key_state_info) wine_server_set_reply( req, key_state_info->state,
+                                                   sizeof(key_state_info->state) );
+        ret = wine_server_call( req );
+        wait = reply->wait;
+        prev_x = reply->prev_x;
+        prev_y = reply->prev_y;
+        new_x  = reply->new_x;
+        new_y  = reply->new_y;
+    }
+    SERVER_END_REQ;
+
+    if (!ret)
+    {
+        if (key_state_info)
         {
-        case INPUT_MOUSE:
-            req->input.mouse.x     = input->u.mi.dx;
-            req->input.mouse.y     = input->u.mi.dy;
-            req->input.mouse.data  = input->u.mi.mouseData;
-            req->input.mouse.flags = input->u.mi.dwFlags;
-            req->input.mouse.time  = input->u.mi.time;
-            req->input.mouse.info  = input->u.mi.dwExtraInfo;
-            break;
-        case INPUT_KEYBOARD:
-            req->input.kbd.vkey  = input->u.ki.wVk;
-            req->input.kbd.scan  = input->u.ki.wScan;
-            req->input.kbd.flags = input->u.ki.dwFlags;
-            req->input.kbd.time  = input->u.ki.time;
-            req->input.kbd.info  = input->u.ki.dwExtraInfo;
-            break;
-        case INPUT_HARDWARE:
-            req->input.hw.msg    = input->u.hi.uMsg;
-            req->input.hw.lparam = MAKELONG( input->u.hi.wParamL, input->u.hi.wParamH );
-            break;
+            key_state_info->time    = GetTickCount();
+            key_state_info->counter = counter;
         }
+        if ((flags & SEND_HWMSG_INJECTED) && (prev_x != new_x || prev_y != new_y))
+            USER_Driver->pSetCursorPos( new_x, new_y );
+    }
+
+    if (wait)
+    {
+        LRESULT ignored;
+        wait_message_reply( 0 );
+        retrieve_reply( &info, 0, &ignored );
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *		send_hardware_input
+ *
+ * Send a batch of at most MAX_HW_INPUT_BATCH hardware input events in a
+ * single request. The server merges consecutive cursor motions and only
+ * waits for the low-level hooks once per batch.
+ */
+NTSTATUS send_hardware_input( const INPUT *inputs, UINT count, UINT flags, UINT *sent )
+{
+    struct user_key_state_info *key_state_info = get_user_thread_info()->key_state;
+    struct send_message_info info;
+    hw_input_t hw[MAX_HW_INPUT_BATCH];
+    int prev_x, prev_y, new_x, new_y;
+    INT counter = global_key_state_counter;
+    NTSTATUS ret;
+    UINT i;
+    BOOL wait;
+
+    assert( count <= MAX_HW_INPUT_BATCH );
+
+    info.type     = MSG_HARDWARE;
+    info.dest_tid = 0;
+    info.hwnd     = 0;
+    info.flags    = 0;
+    info.timeout  = 0;
+
+    for (i = 0; i < count; i++) pack_hw_input( &inputs[i], &hw[i] );
+
+    SERVER_START_REQ( send_hardware_input )
+    {
+        req->flags = flags;
+        wine_server_add_data( req, hw, count * sizeof(hw[0]) );
         if (key_state_info) wine_server_set_reply( req, key_state_info->state,
                                                    sizeof(key_state_info->state) );
         ret = wine_server_call( req );
-        wait = reply->wait;
+        *sent  = ret ? reply->count : count;
+        wait   = reply->wait;
         prev_x = reply->prev_x;
         prev_y = reply->prev_y;
         new_x  = reply->new_x;
@@ -26,13 +26,119 @@
 
 #include "windef.h"
 #include "winbase.h"
+#include "wingdi.h"
 #include "winuser.h"
 #include "wine/unicode.h"
 #include "wine/server.h"
+#include "win.h"
 
 /* size of buffer needed to store an atom string */
 #define ATOM_BUFFER_SIZE 256
 
+/* number of GetProp results cached per window */
+#define PROP_CACHE_SIZE     8
+#define PROP_CACHE_NAME_LEN 32
+
+struct prop_cache_entry
+{
+    ATOM   atom;                       /* property atom, 0 for a string entry */
+    WCHAR  name[PROP_CACHE_NAME_LEN];  /* property name for a string entry */
+    HANDLE data;                       /* property data */
+};
+
+/* cache of GetProp results for windows of the current thread, validated against
+ * the property serial number published by the server in the shared window snapshot */
+struct prop_cache
+{
+    unsigned int            serial;    /* serial number of the cached properties */
+    unsigned int            count;     /* number of valid entries */
+    unsigned int            next;      /* next entry to replace */
+    struct prop_cache_entry entries[PROP_CACHE_SIZE];
+};
+
+
+/***********************************************************************
+ *              get_prop_serial
+ *
+ * Get the property serial number of a window of the current thread.
+ * Returns FALSE if the properties of the window can't be cached.
+ */
+static BOOL get_prop_serial( HWND hwnd, unsigned int *serial )
+{
+    shmwindow_t info;
+
+    if (!WIN_IsCurrentThread( hwnd )) return FALSE;
+    if (!get_shared_window( hwnd, &info )) return FALSE;
+    *serial = info.prop_serial;
+    return TRUE;
+}
+
+
+static inline BOOL prop_cache_match( const struct prop_cache_entry *entry, LPCWSTR str )
+{
+    if (IS_INTRESOURCE(str)) return entry->atom == LOWORD(str);
+    return !entry->atom && !strcmpiW( entry->name, str );
+}
+
+
+/***********************************************************************
+ *              get_cached_prop
+ */
+static BOOL get_cached_prop( HWND hwnd, LPCWSTR str, unsigned int serial, HANDLE *data )
+{
+    struct prop_cache *cache;
+    unsigned int i;
+    BOOL ret = FALSE;
+    WND *win;
+
+    if (!(win = WIN_GetPtr( hwnd )) || win == WND_OTHER_PROCESS || win == WND_DESKTOP) return FALSE;
+    if ((cache = win->prop_cache) && cache->serial == serial)
+    {
+        for (i = 0; i < cache->count; i++)
+        {
+            if (!prop_cache_match( &cache->entries[i], str )) continue;
+            *data = cache->entries[i].data;
+            ret = TRUE;
+            break;
+        }
+    }
+    WIN_ReleasePtr( win );
+    return ret;
+}
+
+
+/***********************************************************************
+ *              set_cached_prop
+ */
+static void set_cached_prop( HWND hwnd, LPCWSTR str, unsigned int serial, HANDLE data )
+{
+    struct prop_cache_entry *entry;
+    struct prop_cache *cache;
+    WND *win;
+
+    if (!IS_INTRESOURCE(str) && strlenW( str ) >= PROP_CACHE_NAME_LEN) return;
+    if (!(win = WIN_GetPtr( hwnd )) || win == WND_OTHER_PROCESS || win == WND_DESKTOP) return;
+    if (!(cache = win->prop_cache))
+        cache = win->prop_cache = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) );
+    if (cache)
+    {
+        /* the properties changed since the entries were cached */
+        if (cache->serial != serial) cache->count = cache->next = 0;
+        cache->serial = serial;
+        entry = &cache->entries[cache->next];
+        cache->next = (cache->next + 1) % PROP_CACHE_SIZE;
+        if (cache->count < PROP_CACHE_SIZE) cache->count++;
+        if (IS_INTRESOURCE(str)) entry->atom = LOWORD(str);
+        else
+        {
+            entry->atom = 0;
+            strcpyW( entry->name, str );
+        }
+        entry->data = data;
+    }
+    WIN_ReleasePtr( win );
+}
+
 
 /***********************************************************************
  *              get_properties
@@ -130,6 +236,11 @@ HANDLE WINAPI GetPropA( HWND hwnd, LPCSTR str )
 HANDLE WINAPI GetPropW( HWND hwnd, LPCWSTR str )
 {
     ULONG_PTR ret = 0;
+    unsigned int serial = 0;
+    BOOL cache = get_prop_serial( hwnd, &serial );
+    HANDLE data;
+
+    if (cache && get_cached_prop( hwnd, str, serial, &data )) return data;
 
     SERVER_START_REQ( get_window_property )
     {
@@ -137,8 +248,10 @@ HANDLE WINAPI GetPropW( HWND hwnd, LPCWSTR str )
         if (IS_INTRESOURCE(str)) req->atom = LOWORD(str);
         else wine_server_add_data( req, str, strlenW(str) * sizeof(WCHAR) );
         if (!wine_server_call_err( req )) ret = reply->data;
+        else cache = FALSE;
     }
     SERVER_END_REQ;
+    if (cache) set_cached_prop( hwnd, str, serial, (HANDLE)ret );
     return (HANDLE)ret;
 }
 
@@ -2793,6 +2793,61 @@ static void test_GetKeyState(void)
     CloseHandle(semaphores[1]);
 }
 
+static void test_Input_mouse_batch(void)
+{
+    TEST_INPUT inputs[200];
+    POINT pt_org, pt_single, pt;
+    UINT i, ret;
+
+    GetCursorPos( &pt_org );
+
+    memset( inputs, 0, sizeof(inputs) );
+    inputs[0].type = INPUT_MOUSE;
+    inputs[0].u.mi.dx = 0x4000;
+    inputs[0].u.mi.dy = 0x4000;
+    inputs[0].u.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+    ret = pSendInput( 1, (INPUT *)inputs, sizeof(INPUT) );
+    ok( ret == 1, "SendInput returned %u\n", ret );
+    GetCursorPos( &pt_single );
+
+    /* a batch of motions must end up at the same position as its last motion */
+    for (i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        inputs[i].type = INPUT_MOUSE;
+        inputs[i].u.mi.dx = (i & 1) ? 0x2000 : 0x6000;
+        inputs[i].u.mi.dy = (i & 1) ? 0x6000 : 0x2000;
+        inputs[i].u.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+    }
+    inputs[i - 1].u.mi.dx = 0x4000;
+    inputs[i - 1].u.mi.dy = 0x4000;
+
+    ret = pSendInput( i, (INPUT *)inputs, sizeof(INPUT) );
+    ok( ret == i, "SendInput returned %u\n", ret );
+    GetCursorPos( &pt );
+    ok( pt.x == pt_single.x && pt.y == pt_single.y, "got (%d,%d), expected (%d,%d)\n",
+        pt.x, pt.y, pt_single.x, pt_single.y );
+
+    /* motions interleaved with other events */
+    inputs[10].u.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_WHEEL;
+    inputs[10].u.mi.mouseData = 0;
+    memset( &inputs[20], 0, 2 * sizeof(inputs[0]) );
+    inputs[20].type = INPUT_KEYBOARD;
+    inputs[20].u.ki.wVk = VK_SHIFT;
+    inputs[21].type = INPUT_KEYBOARD;
+    inputs[21].u.ki.wVk = VK_SHIFT;
+    inputs[21].u.ki.dwFlags = KEYEVENTF_KEYUP;
+    ret = pSendInput( 30, (INPUT *)(inputs + 1), sizeof(INPUT) );
+    ok( ret == 30, "SendInput returned %u\n", ret );
+    ret = pSendInput( 1, (INPUT *)(inputs + i - 1), sizeof(INPUT) );
+    ok( ret == 1, "SendInput returned %u\n", ret );
+    GetCursorPos( &pt );
+    ok( pt.x == pt_single.x && pt.y == pt_single.y, "got (%d,%d), expected (%d,%d)\n",
+        pt.x, pt.y, pt_single.x, pt_single.y );
+
+    empty_message_queue();
+    SetCursorPos( pt_org.x, pt_org.y );
+}
+
 static void test_OemKeyScan(void)
 {
     DWORD ret, expect, vkey, scan;
@@ -2833,6 +2888,7 @@ START_TEST(input)
         test_Input_whitebox();
         test_Input_unicode();
         test_Input_mouse();
+        test_Input_mouse_batch();
     }
     else win_skip("SendInput is not available\n");
 
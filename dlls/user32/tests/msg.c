@@ -12060,6 +12060,70 @@ done:
     flush_events();
 }
 
+static void test_posted_message_order(void)
+{
+    DWORD status;
+    unsigned int i;
+    BOOL ret;
+    MSG msg;
+
+    flush_events();
+
+    /* messages are returned in posting order, whatever the filters used in between */
+    for (i = 0; i < 300; i++)
+    {
+        ret = PostThreadMessageA( GetCurrentThreadId(), WM_USER + (i % 3 == 1), i, 0 );
+        ok( ret, "%u: PostThreadMessage failed, error %u\n", i, GetLastError() );
+    }
+    ret = PeekMessageA( &msg, NULL, WM_USER + 1, WM_USER + 1, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 1 && msg.wParam == 1, "got %04x/%lu\n", msg.message, msg.wParam );
+    for (i = 0; PeekMessageA( &msg, NULL, 0, 0, PM_REMOVE );)
+    {
+        if (msg.message != WM_USER && msg.message != WM_USER + 1) continue;
+        if (i == 1) i++;
+        ok( msg.wParam == i, "expected %u, got %lu\n", i, msg.wParam );
+        i++;
+        if (i == 150)
+        {
+            ret = PeekMessageA( &msg, NULL, 0, 0, PM_NOREMOVE );
+            ok( ret && msg.wParam == i, "expected %u, got %lu\n", i, msg.wParam );
+            PostThreadMessageA( GetCurrentThreadId(), WM_USER, 300, 0 );
+        }
+    }
+    ok( i == 301, "got %u messages\n", i );
+
+    /* the wake bits are cleared once all the posted messages have been retrieved */
+    for (i = 0; i < 10; i++) PostThreadMessageA( GetCurrentThreadId(), WM_USER, i, 0 );
+    for (i = 0; PeekMessageA( &msg, NULL, 0, 0, PM_REMOVE ); i++)
+        ok( msg.message == WM_USER && msg.wParam == i, "got %04x/%lu\n", msg.message, msg.wParam );
+    ok( i == 10, "got %u messages\n", i );
+    status = MsgWaitForMultipleObjects( 0, NULL, FALSE, 0, QS_POSTMESSAGE );
+    ok( status == WAIT_TIMEOUT, "MsgWaitForMultipleObjects returned %x\n", status );
+    status = GetQueueStatus( QS_POSTMESSAGE );
+    ok( !status, "GetQueueStatus returned %x\n", status );
+}
+
+/* run the posted message tests again in a process using the wineserver shared memory */
+static void test_posted_message_order_shm( char *argv0 )
+{
+    char path[MAX_PATH];
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA startup;
+    BOOL ret;
+
+    SetEnvironmentVariableA( "STAGING_SHARED_MEMORY", "1" );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( path, "%s msg posted_shm", argv0 );
+    ret = CreateProcessA( NULL, path, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &pi );
+    ok( ret, "CreateProcess '%s' failed err %u.\n", path, GetLastError() );
+    SetEnvironmentVariableA( "STAGING_SHARED_MEMORY", NULL );
+    if (!ret) return;
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+}
+
 static void test_PeekMessage3(void)
 {
     HWND hwnd;
@@ -15804,6 +15868,80 @@ static void test_WaitForInputIdle( char *argv0 )
     CloseHandle( thread );
 }
 
+/* sizes around the limit above which the message data goes through a section */
+static const DWORD copydata_sizes[] = { 0x1000, 0xffff, 0x10000, 0x40000 + 3 };
+
+static LRESULT WINAPI copydata_wnd_proc( HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam )
+{
+    if (message == WM_COPYDATA)
+    {
+        const COPYDATASTRUCT *cds = (const COPYDATASTRUCT *)lparam;
+        const BYTE *data = cds->lpData;
+        DWORD i;
+
+        for (i = 0; i < cds->cbData; i++) if (data[i] != (BYTE)(i * 7 + cds->dwData)) break;
+        ok( i == cds->cbData, "%lu: data mismatch at %u/%u\n", cds->dwData, i, cds->cbData );
+        return cds->cbData;
+    }
+    return DefWindowProcA( hwnd, message, wparam, lparam );
+}
+
+static void do_copydata_child( HWND hwnd )
+{
+    DWORD i, j, count = sizeof(copydata_sizes) / sizeof(copydata_sizes[0]);
+    COPYDATASTRUCT cds;
+    LRESULT res;
+    BYTE *data;
+
+    data = HeapAlloc( GetProcessHeap(), 0, copydata_sizes[count - 1] );
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < copydata_sizes[i]; j++) data[j] = j * 7 + i;
+        cds.dwData = i;
+        cds.cbData = copydata_sizes[i];
+        cds.lpData = data;
+        res = SendMessageA( hwnd, WM_COPYDATA, 0, (LPARAM)&cds );
+        ok( res == copydata_sizes[i], "%u: got %lu, expected %u\n", i, res, copydata_sizes[i] );
+    }
+    HeapFree( GetProcessHeap(), 0, data );
+}
+
+static void test_copydata_cross_process( char *argv0 )
+{
+    char path[MAX_PATH];
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA startup;
+    WNDCLASSA cls;
+    HWND hwnd;
+    MSG msg;
+    BOOL ret;
+
+    memset( &cls, 0, sizeof(cls) );
+    cls.lpfnWndProc = copydata_wnd_proc;
+    cls.hInstance = GetModuleHandleA( NULL );
+    cls.lpszClassName = "CopyDataClass";
+    RegisterClassA( &cls );
+
+    hwnd = CreateWindowA( "CopyDataClass", NULL, WS_POPUP, 0, 0, 10, 10, 0, 0, 0, NULL );
+    ok( hwnd != 0, "CreateWindow failed, error %u\n", GetLastError() );
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( path, "%s msg copydata %p", argv0, hwnd );
+    ret = CreateProcessA( NULL, path, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &pi );
+    ok( ret, "CreateProcess '%s' failed err %u.\n", path, GetLastError() );
+    if (ret)
+    {
+        while (MsgWaitForMultipleObjects( 1, &pi.hProcess, FALSE, 10000, QS_ALLINPUT ) == WAIT_OBJECT_0 + 1)
+            while (PeekMessageA( &msg, 0, 0, 0, PM_REMOVE )) DispatchMessageA( &msg );
+        winetest_wait_child_process( pi.hProcess );
+        CloseHandle( pi.hProcess );
+        CloseHandle( pi.hThread );
+    }
+    DestroyWindow( hwnd );
+    UnregisterClassA( "CopyDataClass", GetModuleHandleA( NULL ) );
+}
+
 static const struct message WmSetParentSeq_1[] = {
     { WM_SHOWWINDOW, sent|wparam, 0 },
     { EVENT_OBJECT_PARENTCHANGE, winevent_hook|wparam|lparam, 0, 0 },
@@ -17214,6 +17352,19 @@ START_TEST(msg)
     init_funcs();
 
     argc = winetest_get_mainargs( &test_argv );
+    if (argc >= 4 && !strcmp( test_argv[2], "copydata" ))
+    {
+        HWND hwnd;
+
+        sscanf( test_argv[3], "%p", &hwnd );
+        do_copydata_child( hwnd );
+        return;
+    }
+    if (argc >= 3 && !strcmp( test_argv[2], "posted_shm" ))
+    {
+        test_posted_message_order();
+        return;
+    }
     if (argc >= 3)
     {
         unsigned int arg;
@@ -17278,7 +17429,10 @@ START_TEST(msg)
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_posted_message_order();
+    test_posted_message_order_shm( test_argv[0] );
     test_WaitForInputIdle( test_argv[0] );
+    test_copydata_cross_process( test_argv[0] );
     test_scrollwindowex();
     test_messages();
     test_setwindowpos();
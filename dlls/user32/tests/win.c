@@ -8862,6 +8862,198 @@ static void test_window_from_point(const char *argv0)
     DestroyWindow(hwnd);
 }
 
+static void test_window_from_point_many_children(void)
+{
+    HWND hwnd, children[100], win;
+    POINT pt;
+    int i, j;
+
+    hwnd = CreateWindowExA(0, "MainWindowClass", NULL, WS_POPUP | WS_VISIBLE,
+            100, 100, 400, 400, 0, 0, NULL, NULL);
+    ok(hwnd != 0, "CreateWindowEx failed\n");
+
+    pt.x = pt.y = 300;
+    win = WindowFromPoint(pt);
+    if (win != hwnd)
+    {
+        skip("there's another window covering test window\n");
+        DestroyWindow(hwnd);
+        return;
+    }
+
+    for (i = 0; i < 100; i++)
+    {
+        children[i] = CreateWindowExA(0, "button", "button", WS_CHILD | WS_VISIBLE,
+                (i % 10) * 40, (i / 10) * 40, 40, 40, hwnd, 0, NULL, NULL);
+        ok(children[i] != 0, "CreateWindowEx failed\n");
+    }
+
+    /* query twice, the second pass may use a cached index */
+    for (j = 0; j < 2; j++)
+    {
+        for (i = 0; i < 100; i++)
+        {
+            pt.x = 100 + (i % 10) * 40 + 20;
+            pt.y = 100 + (i / 10) * 40 + 20;
+            win = WindowFromPoint(pt);
+            ok(win == children[i], "%d: WindowFromPoint returned %p, expected %p\n", i, win, children[i]);
+        }
+    }
+
+    /* move a child on top of another one */
+    SetWindowPos(children[0], HWND_TOP, 200, 200, 40, 40, SWP_NOACTIVATE);
+    pt.x = pt.y = 320;
+    win = WindowFromPoint(pt);
+    ok(win == children[0], "WindowFromPoint returned %p, expected %p\n", win, children[0]);
+    pt.x = pt.y = 120;
+    win = WindowFromPoint(pt);
+    ok(win == hwnd, "WindowFromPoint returned %p, expected %p\n", win, hwnd);
+
+    /* change the z-order without moving, the cached ranks must be refreshed */
+    SetWindowPos(children[55], HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    pt.x = pt.y = 320;
+    win = WindowFromPoint(pt);
+    ok(win == children[55], "WindowFromPoint returned %p, expected %p\n", win, children[55]);
+    SetWindowPos(children[55], HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    win = WindowFromPoint(pt);
+    ok(win == children[0], "WindowFromPoint returned %p, expected %p\n", win, children[0]);
+
+    /* hidden children are skipped */
+    ShowWindow(children[0], SW_HIDE);
+    pt.x = pt.y = 320;
+    win = WindowFromPoint(pt);
+    ok(win == children[55], "WindowFromPoint returned %p, expected %p\n", win, children[55]);
+
+    DestroyWindow(hwnd);
+}
+
+static BOOL CALLBACK count_props_proc(HWND hwnd, LPSTR str, HANDLE data, ULONG_PTR lparam)
+{
+    (*(int *)lparam)++;
+    return TRUE;
+}
+
+static void test_many_properties(void)
+{
+    char name[16];
+    HANDLE data;
+    HWND hwnd;
+    int i, count;
+
+    hwnd = CreateWindowExA(0, "MainWindowClass", NULL, WS_POPUP, 0, 0, 10, 10, 0, 0, NULL, NULL);
+    ok(hwnd != 0, "CreateWindowEx failed\n");
+
+    for (i = 0; i < 40; i++)
+    {
+        sprintf(name, "prop%d", i);
+        ok(SetPropA(hwnd, name, (HANDLE)(ULONG_PTR)(i + 1)), "SetProp %s failed\n", name);
+    }
+    for (i = 0; i < 40; i += 2)
+    {
+        sprintf(name, "prop%d", i);
+        data = RemovePropA(hwnd, name);
+        ok(data == (HANDLE)(ULONG_PTR)(i + 1), "RemoveProp %s returned %p\n", name, data);
+    }
+    for (i = 0; i < 40; i++)
+    {
+        sprintf(name, "PROP%d", i);
+        data = GetPropA(hwnd, name);
+        if (i & 1) ok(data == (HANDLE)(ULONG_PTR)(i + 1), "GetProp %s returned %p\n", name, data);
+        else ok(!data, "GetProp %s returned %p\n", name, data);
+    }
+
+    /* overwrite an existing property and reuse the removed entries */
+    ok(SetPropA(hwnd, "prop1", (HANDLE)0xdead), "SetProp failed\n");
+    data = GetPropA(hwnd, "prop1");
+    ok(data == (HANDLE)0xdead, "GetProp returned %p\n", data);
+    for (i = 0; i < 40; i += 2)
+    {
+        sprintf(name, "prop%d", i);
+        ok(SetPropA(hwnd, name, (HANDLE)(ULONG_PTR)(i + 100)), "SetProp %s failed\n", name);
+    }
+    for (i = 0; i < 40; i += 2)
+    {
+        sprintf(name, "prop%d", i);
+        data = GetPropA(hwnd, name);
+        ok(data == (HANDLE)(ULONG_PTR)(i + 100), "GetProp %s returned %p\n", name, data);
+    }
+    count = 0;
+    EnumPropsExA(hwnd, count_props_proc, (LPARAM)&count);
+    ok(count >= 40, "got %d properties\n", count);
+
+    DestroyWindow(hwnd);
+}
+
+struct shared_window_info
+{
+    HWND  hwnd;
+    BOOL  is_window;
+    RECT  rect;
+    LONG  style;
+    HWND  parent;
+};
+
+static DWORD CALLBACK shared_window_info_thread(void *arg)
+{
+    struct shared_window_info *info = arg;
+
+    info->is_window = IsWindow(info->hwnd);
+    GetWindowRect(info->hwnd, &info->rect);
+    info->style = GetWindowLongA(info->hwnd, GWL_STYLE);
+    info->parent = GetParent(info->hwnd);
+    return 0;
+}
+
+/* query the window from another thread, so that the state comes from the server */
+static void get_shared_window_info(HWND hwnd, struct shared_window_info *info)
+{
+    HANDLE thread;
+
+    memset(info, 0, sizeof(*info));
+    info->hwnd = hwnd;
+    thread = CreateThread(NULL, 0, shared_window_info_thread, info, 0, NULL);
+    ok(thread != NULL, "CreateThread failed, error %u\n", GetLastError());
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static void test_shared_window_info(void)
+{
+    struct shared_window_info info;
+    HWND hwnd, child;
+    RECT rect;
+
+    hwnd = CreateWindowExA(0, "MainWindowClass", NULL, WS_POPUP, 10, 20, 100, 50, 0, 0, NULL, NULL);
+    ok(hwnd != 0, "CreateWindowEx failed\n");
+    child = CreateWindowExA(0, "static", NULL, WS_CHILD, 0, 0, 10, 10, hwnd, 0, NULL, NULL);
+    ok(child != 0, "CreateWindowEx failed\n");
+
+    SetWindowPos(hwnd, 0, 30, 40, 200, 150, SWP_NOZORDER | SWP_NOACTIVATE);
+    GetWindowRect(hwnd, &rect);
+    get_shared_window_info(hwnd, &info);
+    ok(info.is_window, "window not found\n");
+    ok(EqualRect(&info.rect, &rect), "got rect %s, expected %s\n",
+       wine_dbgstr_rect(&info.rect), wine_dbgstr_rect(&rect));
+    ok(info.style == GetWindowLongA(hwnd, GWL_STYLE), "got style %08x\n", info.style);
+
+    ShowWindow(hwnd, SW_SHOWNA);
+    get_shared_window_info(hwnd, &info);
+    ok(info.style & WS_VISIBLE, "got style %08x\n", info.style);
+    ShowWindow(hwnd, SW_HIDE);
+    get_shared_window_info(hwnd, &info);
+    ok(!(info.style & WS_VISIBLE), "got style %08x\n", info.style);
+
+    get_shared_window_info(child, &info);
+    ok(info.is_window, "child not found\n");
+    ok(info.parent == hwnd, "got parent %p, expected %p\n", info.parent, hwnd);
+
+    DestroyWindow(hwnd);
+    get_shared_window_info(hwnd, &info);
+    ok(!info.is_window, "window still exists\n");
+    get_shared_window_info(child, &info);
+    ok(!info.is_window, "child still exists\n");
+}
+
 static void test_map_points(void)
 {
     BOOL ret;
@@ -9998,6 +10190,9 @@ START_TEST(win)
     /* Add the tests below this line */
     test_child_window_from_point();
     test_window_from_point(argv[0]);
+    test_window_from_point_many_children();
+    test_many_properties();
+    test_shared_window_info();
     test_thick_child_size(hwndMain);
     test_fullscreen();
     test_hwnd_message();
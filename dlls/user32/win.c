@@ -103,6 +103,14 @@ static inline void set_win_data( void *ptr, LONG_PTR val, UINT size )
 
 static void *user_handles[NB_USER_HANDLES];
 
+/* views of the desktop shared memory blocks, indexed by user_thread_info->desktop_shm - 1 */
+#define MAX_DESKTOP_SHM 8
+static struct
+{
+    unsigned int                 id;   /* server id of the desktop shared memory */
+    const volatile shmdesktop_t *shm;  /* current view, retired views are never unmapped */
+} desktop_shm[MAX_DESKTOP_SHM];
+
 /***********************************************************************
  *           alloc_user_handle
  */
@@ -187,6 +195,127 @@ void *free_user_handle( HANDLE handle, enum user_obj_type type )
 }
 
 
+/***********************************************************************
+ *           get_desktop_shm
+ *
+ * Return the current view of the thread desktop shared memory block.
+ */
+static const volatile shmdesktop_t *get_desktop_shm(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const volatile shmdesktop_t *shm;
+    DWORD slot = thread_info->desktop_shm;
+    HANDLE handle = 0;
+    unsigned int i, id = 0;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+
+    if (slot == ~0u) return NULL;
+    if (slot && !(shm = desktop_shm[slot - 1].shm)->retired) return shm;
+    if (!wine_get_shmglobal())
+    {
+        thread_info->desktop_shm = ~0u;
+        return NULL;
+    }
+
+    SERVER_START_REQ( get_desktop_shared_memory )
+    {
+        if (!wine_server_call( req ))
+        {
+            handle = wine_server_ptr_handle( reply->handle );
+            id = reply->id;
+        }
+    }
+    SERVER_END_REQ;
+    if (!handle) return NULL;
+
+    USER_Lock();
+    for (i = 0; i < MAX_DESKTOP_SHM; i++)
+        if (!desktop_shm[i].id || desktop_shm[i].id == id) break;
+
+    if (i < MAX_DESKTOP_SHM && (!desktop_shm[i].shm || desktop_shm[i].shm->retired))
+    {
+        /* the old view may still be in use by other threads, so leave it mapped */
+        if (!NtMapViewOfSection( handle, GetCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                                 ViewShare, 0, PAGE_READONLY ))
+        {
+            desktop_shm[i].id  = id;
+            desktop_shm[i].shm = ptr;
+        }
+    }
+    if (i < MAX_DESKTOP_SHM && desktop_shm[i].shm)
+    {
+        thread_info->desktop_shm = i + 1;
+        shm = desktop_shm[i].shm;
+    }
+    else shm = NULL;  /* too many desktops, use the server */
+    USER_Unlock();
+    NtClose( handle );
+    return shm;
+}
+
+
+/***********************************************************************
+ *           get_shared_window
+ *
+ * Retrieve a consistent copy of the server window state from the desktop
+ * shared memory block. Returns FALSE if the caller has to ask the server.
+ */
+BOOL get_shared_window( HWND hwnd, shmwindow_t *info )
+{
+    const volatile shmdesktop_t *shm;
+    const volatile shmwindow_t *entry;
+    WORD index = USER_HANDLE_TO_INDEX( hwnd );
+    unsigned int seq, retry;
+
+    if (!(shm = get_desktop_shm())) return FALSE;
+
+    for (retry = 0; retry < 64; retry++)
+    {
+        if (index >= shm->window_count)
+        {
+            if (!shm->retired) return FALSE;  /* not a window of this desktop */
+            if (!(shm = get_desktop_shm())) return FALSE;
+            continue;
+        }
+        entry = &shm->windows[index];
+        seq = entry->seq;
+        if (seq & 1) continue;  /* the server is updating the entry */
+        shared_read_barrier();
+        info->handle   = entry->handle;
+        info->parent   = entry->parent;
+        info->owner    = entry->owner;
+        info->tid      = entry->tid;
+        info->pid      = entry->pid;
+        info->style    = entry->style;
+        info->ex_style = entry->ex_style;
+        info->window.left   = entry->window.left;
+        info->window.top    = entry->window.top;
+        info->window.right  = entry->window.right;
+        info->window.bottom = entry->window.bottom;
+        info->client.left   = entry->client.left;
+        info->client.top    = entry->client.top;
+        info->client.right  = entry->client.right;
+        info->client.bottom = entry->client.bottom;
+        info->prop_serial   = entry->prop_serial;
+        shared_read_barrier();
+        if (entry->seq != seq) continue;
+        if (shm->retired)  /* the server has moved to a larger block */
+        {
+            if (!(shm = get_desktop_shm())) return FALSE;
+            continue;
+        }
+
+        if (!info->handle) return FALSE;
+        if (info->handle != (UINT)(UINT_PTR)hwnd && HIWORD(hwnd) && HIWORD(hwnd) != 0xffff)
+            return FALSE;
+        info->seq = seq;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           create_window_handle
  *
@@ -292,6 +421,7 @@ static void free_window_handle( HWND hwnd )
         }
         SERVER_END_REQ;
         USER_Unlock();
+        if (ptr) HeapFree( GetProcessHeap(), 0, ((WND *)ptr)->prop_cache );
         HeapFree( GetProcessHeap(), 0, ptr );
     }
 }
@@ -383,7 +513,30 @@ static HWND *list_window_parents( HWND hwnd )
         }
     }
 
-    /* at least one parent belongs to another process, have to query the server */
+    /* at least one parent belongs to another process, try the shared window snapshot */
+
+    for (count = 0; count < 1024; count++)
+    {
+        shmwindow_t info;
+
+        if (!get_shared_window( current, &info )) break;
+        if (!info.parent)
+        {
+            if (!pos) goto empty;
+            list[pos] = 0;
+            return list;
+        }
+        list[pos] = current = wine_server_ptr_handle( info.parent );
+        if (++pos == size - 1)
+        {
+            HWND *new_list = HeapReAlloc( GetProcessHeap(), 0, list, (size+16) * sizeof(HWND) );
+            if (!new_list) goto empty;
+            list = new_list;
+            size += 16;
+        }
+    }
+
+    /* otherwise we have to query the server */
 
     for (;;)
     {
@@ -808,6 +961,74 @@ ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits )
 }
 
 
+/***********************************************************************
+ *           get_shared_window_rectangles
+ *
+ * Compute the rectangles of another process window from the shared window
+ * snapshot. Returns FALSE if the server must be queried.
+ */
+static BOOL get_shared_window_rectangles( HWND hwnd, enum coords_relative relative,
+                                          RECT *rectWindow, RECT *rectClient )
+{
+    shmwindow_t info, parent;
+    RECT window_rect, client_rect, rect;
+    user_handle_t next;
+    int depth;
+
+    if (!get_shared_window( hwnd, &info )) return FALSE;
+
+    SetRect( &window_rect, info.window.left, info.window.top, info.window.right, info.window.bottom );
+    SetRect( &client_rect, info.client.left, info.client.top, info.client.right, info.client.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        OffsetRect( &window_rect, -info.client.left, -info.client.top );
+        OffsetRect( &client_rect, -info.client.left, -info.client.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, info.client.left, info.client.top, info.client.right, info.client.bottom );
+            mirror_rect( &rect, &window_rect );
+        }
+        break;
+    case COORDS_WINDOW:
+        OffsetRect( &window_rect, -info.window.left, -info.window.top );
+        OffsetRect( &client_rect, -info.window.left, -info.window.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, info.window.left, info.window.top, info.window.right, info.window.bottom );
+            mirror_rect( &rect, &client_rect );
+        }
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, parent.client.left, parent.client.top, parent.client.right, parent.client.bottom );
+            mirror_rect( &rect, &window_rect );
+            mirror_rect( &rect, &client_rect );
+        }
+        break;
+    case COORDS_SCREEN:
+        for (next = info.parent, depth = 0; next; next = parent.parent, depth++)
+        {
+            if (depth >= 1024) return FALSE;
+            if (!get_shared_window( wine_server_ptr_handle( next ), &parent )) return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window_rect, parent.client.left, parent.client.top );
+            OffsetRect( &client_rect, parent.client.left, parent.client.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetRectangles
  *
@@ -915,6 +1136,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_shared_window_rectangles( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -1068,6 +1291,7 @@ static void destroy_thread_window( HWND hwnd )
     }
     USER_Unlock();
 
+    if (wndPtr) HeapFree( GetProcessHeap(), 0, wndPtr->prop_cache );
     HeapFree( GetProcessHeap(), 0, wndPtr );
     if (menu) DestroyMenu( menu );
     if (sys_menu) DestroyMenu( sys_menu );
@@ -2253,11 +2477,16 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS)
     {
+        shmwindow_t info;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE) && get_shared_window( hwnd, &info ))
+            return (offset == GWL_STYLE) ? info.style : info.ex_style;
+
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2844,6 +3073,7 @@ INT WINAPI GetWindowTextLengthW( HWND hwnd )
  */
 BOOL WINAPI IsWindow( HWND hwnd )
 {
+    shmwindow_t info;
     WND *ptr;
     BOOL ret;
 
@@ -2857,6 +3087,8 @@ BOOL WINAPI IsWindow( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2872,6 +3104,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    shmwindow_t info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -2891,6 +3124,12 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2921,7 +3160,16 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        shmwindow_t info;
+        LONG style;
+
+        if (get_shared_window( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) return wine_server_ptr_handle( info.owner );
+            if (info.style & WS_CHILD) return wine_server_ptr_handle( info.parent );
+            return 0;
+        }
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -2951,6 +3199,7 @@ HWND WINAPI GetParent( HWND hwnd )
  */
 HWND WINAPI GetAncestor( HWND hwnd, UINT type )
 {
+    shmwindow_t info;
     WND *win;
     HWND *list, ret = 0;
 
@@ -2968,6 +3217,10 @@ HWND WINAPI GetAncestor( HWND hwnd, UINT type )
             ret = win->parent;
             WIN_ReleasePtr( win );
         }
+        else if (get_shared_window( hwnd, &info ))
+        {
+            ret = wine_server_ptr_handle( info.parent );
+        }
         else /* need to query the server */
         {
             SERVER_START_REQ( get_window_tree )
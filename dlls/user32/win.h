@@ -32,6 +32,7 @@
 
 struct tagCLASS;
 struct tagDIALOGINFO;
+struct prop_cache;
 
 typedef struct tagWND
 {
@@ -66,6 +67,7 @@ typedef struct tagWND
     int            pixel_format;  /* Pixel format set by the graphics driver */
     int            cbWndExtra;    /* class cbWndExtra at window creation */
     DWORD_PTR      userdata;      /* User private data */
+    struct prop_cache *prop_cache; /* Cache of GetProp results */
     DWORD          wExtra[1];     /* Window extra bytes */
 } WND;
 
@@ -79,6 +81,13 @@ typedef struct tagWND
 #define WIN_CHILDREN_MOVED        0x0040 /* children may have moved, ignore stored positions */
 #define WIN_HAS_IME_WIN           0x0080 /* the window has been registered with imm32 */
 
+/* order the shared memory reads against the counters published by the server */
+static inline void shared_read_barrier(void)
+{
+    LONG dummy;
+    InterlockedExchange( &dummy, 0 );  /* locked operations are full barriers */
+}
+
   /* Window functions */
 extern HWND get_hwnd_message_parent(void) DECLSPEC_HIDDEN;
 extern BOOL is_desktop_window( HWND hwnd ) DECLSPEC_HIDDEN;
@@ -93,6 +102,7 @@ extern UINT win_set_flags( HWND hwnd, UINT set_mask, UINT clear_mask ) DECLSPEC_
 extern HWND WIN_SetOwner( HWND hwnd, HWND owner ) DECLSPEC_HIDDEN;
 extern ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits ) DECLSPEC_HIDDEN;
 extern BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWindow, RECT *rectClient ) DECLSPEC_HIDDEN;
+extern BOOL get_shared_window( HWND hwnd, shmwindow_t *info ) DECLSPEC_HIDDEN;
 extern void map_window_region( HWND from, HWND to, HRGN hrgn ) DECLSPEC_HIDDEN;
 extern LRESULT WIN_DestroyWindow( HWND hwnd ) DECLSPEC_HIDDEN;
 extern void WIN_DestroyThreadWindows( HWND hwnd ) DECLSPEC_HIDDEN;
@@ -429,6 +429,7 @@ BOOL WINAPI SetThreadDesktop( HDESK handle )
         struct user_key_state_info *key_state_info = thread_info->key_state;
         thread_info->top_window = 0;
         thread_info->msg_window = 0;
+        thread_info->desktop_shm = 0;
         if (key_state_info) key_state_info->time = 0;
     }
     return ret;
@@ -1324,6 +1324,75 @@ static HRESULT fill_array_desc(compile_ctx_t *ctx, dim_decl_t *dim_decl, array_d
     return S_OK;
 }
 
+static BOOL lookup_local_slot(function_t *func, const WCHAR *name, unsigned *ret)
+{
+    unsigned i;
+
+    /* Assignments to the function name store the return value. */
+    if(!strcmpiW(name, func->name))
+        return FALSE;
+
+    for(i=0; i < func->var_cnt; i++) {
+        if(!strcmpiW(func->vars[i].name, name)) {
+            *ret = i;
+            return TRUE;
+        }
+    }
+
+    for(i=0; i < func->arg_cnt; i++) {
+        if(!strcmpiW(func->args[i].name, name)) {
+            *ret = func->var_cnt+i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Binds identifiers referring to function variables and arguments to their slots. */
+static void resolve_local_slots(compile_ctx_t *ctx, function_t *func)
+{
+    instr_t *instr;
+    unsigned slot;
+
+    for(instr = ctx->code->instrs+func->code_off; instr < ctx->code->instrs+ctx->instr_cnt; instr++) {
+        switch(instr->op) {
+        case OP_icall:
+            if(lookup_local_slot(func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_assign_ident:
+            if(lookup_local_slot(func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_assign_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_set_ident:
+            if(lookup_local_slot(func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_set_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_incc:
+            if(lookup_local_slot(func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_incc_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_step:
+            if(lookup_local_slot(func, instr->arg2.bstr, &slot)) {
+                instr->op = OP_step_local;
+                instr->arg2.uint = slot;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 static HRESULT compile_func(compile_ctx_t *ctx, statement_t *stat, function_t *func)
 {
     HRESULT hres;
@@ -1417,6 +1486,9 @@ static HRESULT compile_func(compile_ctx_t *ctx, statement_t *stat, function_t *f
         }
     }
 
+    if(func->type != FUNC_GLOBAL)
+        resolve_local_slots(ctx, func);
+
     if(func->array_cnt) {
         unsigned array_id = 0;
         dim_decl_t *dim_decl;
@@ -17,6 +17,8 @@
  */
 
 #include <assert.h>
+#include <math.h>
+#include <limits.h>
 
 #include "vbscript.h"
 
@@ -95,6 +97,12 @@ static BOOL lookup_dynamic_vars(dynamic_var_t *var, const WCHAR *name, ref_t *re
     return FALSE;
 }
 
+/* Locals resolved by the compiler: slots below var_cnt are variables, the rest are arguments. */
+static inline VARIANT *get_local(exec_ctx_t *ctx, unsigned slot)
+{
+    return slot < ctx->func->var_cnt ? ctx->vars+slot : ctx->args+slot-ctx->func->var_cnt;
+}
+
 static HRESULT lookup_identifier(exec_ctx_t *ctx, BSTR name, vbdisp_invoke_type_t invoke_type, ref_t *ref)
 {
     named_item_t *item;
@@ -522,6 +530,48 @@ static HRESULT array_access(exec_ctx_t *ctx, SAFEARRAY *array, DISPPARAMS *dp, V
     return S_OK;
 }
 
+static HRESULT icall_var(exec_ctx_t *ctx, VARIANT *var, unsigned arg_cnt, VARIANT *res)
+{
+    DISPPARAMS dp;
+    VARIANT *v;
+    HRESULT hres;
+
+    if(!res) {
+        FIXME("REF_VAR no res\n");
+        return E_NOTIMPL;
+    }
+
+    v = V_VT(var) == (VT_VARIANT|VT_BYREF) ? V_VARIANTREF(var) : var;
+
+    if(arg_cnt) {
+        SAFEARRAY *array = NULL;
+
+        switch(V_VT(v)) {
+        case VT_ARRAY|VT_BYREF|VT_VARIANT:
+            array = *V_ARRAYREF(var);
+            break;
+        case VT_ARRAY|VT_VARIANT:
+            array = V_ARRAY(var);
+            break;
+        case VT_DISPATCH:
+            vbstack_to_dp(ctx, arg_cnt, FALSE, &dp);
+            return disp_call(ctx->script, V_DISPATCH(v), DISPID_VALUE, &dp, res);
+        default:
+            FIXME("arguments not implemented\n");
+            return E_NOTIMPL;
+        }
+
+        vbstack_to_dp(ctx, arg_cnt, FALSE, &dp);
+        hres = array_access(ctx, array, &dp, &v);
+        if(FAILED(hres))
+            return hres;
+    }
+
+    V_VT(res) = VT_BYREF|VT_VARIANT;
+    V_BYREF(res) = v;
+    return S_OK;
+}
+
 static HRESULT do_icall(exec_ctx_t *ctx, VARIANT *res)
 {
     BSTR identifier = ctx->instr->arg1.bstr;
@@ -536,50 +586,11 @@ static HRESULT do_icall(exec_ctx_t *ctx, VARIANT *res)
 
     switch(ref.type) {
     case REF_VAR:
-    case REF_CONST: {
-        VARIANT *v;
-
-        if(!res) {
-            FIXME("REF_VAR no res\n");
-            return E_NOTIMPL;
-        }
-
-        v = V_VT(ref.u.v) == (VT_VARIANT|VT_BYREF) ? V_VARIANTREF(ref.u.v) : ref.u.v;
-
-        if(arg_cnt) {
-            SAFEARRAY *array = NULL;
-
-            switch(V_VT(v)) {
-            case VT_ARRAY|VT_BYREF|VT_VARIANT:
-                array = *V_ARRAYREF(ref.u.v);
-                break;
-            case VT_ARRAY|VT_VARIANT:
-                array = V_ARRAY(ref.u.v);
-                break;
-            case VT_DISPATCH:
-                vbstack_to_dp(ctx, arg_cnt, FALSE, &dp);
-                hres = disp_call(ctx->script, V_DISPATCH(v), DISPID_VALUE, &dp, res);
-                if(FAILED(hres))
-                    return hres;
-                break;
-            default:
-                FIXME("arguments not implemented\n");
-                return E_NOTIMPL;
-            }
-
-            if(!array)
-                break;
-
-            vbstack_to_dp(ctx, arg_cnt, FALSE, &dp);
-            hres = array_access(ctx, array, &dp, &v);
-            if(FAILED(hres))
-                return hres;
-        }
-
-        V_VT(res) = VT_BYREF|VT_VARIANT;
-        V_BYREF(res) = v;
+    case REF_CONST:
+        hres = icall_var(ctx, ref.u.v, arg_cnt, res);
+        if(FAILED(hres))
+            return hres;
         break;
-    }
     case REF_DISP:
         vbstack_to_dp(ctx, arg_cnt, FALSE, &dp);
         hres = disp_call(ctx->script, ref.u.d.disp, ref.u.d.id, &dp, res);
@@ -642,6 +653,23 @@ static HRESULT interp_icallv(exec_ctx_t *ctx)
     return do_icall(ctx, NULL);
 }
 
+static HRESULT interp_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    VARIANT v;
+    HRESULT hres;
+
+    TRACE("%u\n", slot);
+
+    hres = icall_var(ctx, get_local(ctx, slot), arg_cnt, &v);
+    if(FAILED(hres))
+        return hres;
+
+    stack_popn(ctx, arg_cnt);
+    return stack_push(ctx, &v);
+}
+
 static HRESULT do_mcall(exec_ctx_t *ctx, VARIANT *res)
 {
     const BSTR identifier = ctx->instr->arg1.bstr;
@@ -694,10 +722,20 @@ static HRESULT interp_mcallv(exec_ctx_t *ctx)
     return do_mcall(ctx, NULL);
 }
 
+static inline BOOL is_simple_vt(VARTYPE vt)
+{
+    return vt == VT_EMPTY || vt == VT_NULL || vt == VT_I2 || vt == VT_I4 || vt == VT_R8 || vt == VT_BOOL;
+}
+
 static HRESULT assign_value(exec_ctx_t *ctx, VARIANT *dst, VARIANT *src, WORD flags)
 {
     HRESULT hres;
 
+    if(is_simple_vt(V_VT(dst)) && is_simple_vt(V_VT(src))) {
+        *dst = *src;
+        return S_OK;
+    }
+
     hres = VariantCopyInd(dst, src);
     if(FAILED(hres))
         return hres;
@@ -716,58 +754,62 @@ static HRESULT assign_value(exec_ctx_t *ctx, VARIANT *dst, VARIANT *src, WORD fl
     return S_OK;
 }
 
-static HRESULT assign_ident(exec_ctx_t *ctx, BSTR name, WORD flags, DISPPARAMS *dp)
+static HRESULT assign_var(exec_ctx_t *ctx, VARIANT *v, WORD flags, DISPPARAMS *dp)
 {
-    ref_t ref;
     HRESULT hres;
 
-    hres = lookup_identifier(ctx, name, VBDISP_LET, &ref);
-    if(FAILED(hres))
-        return hres;
+    if(V_VT(v) == (VT_VARIANT|VT_BYREF))
+        v = V_VARIANTREF(v);
 
-    switch(ref.type) {
-    case REF_VAR: {
-        VARIANT *v = ref.u.v;
+    if(arg_cnt(dp)) {
+        SAFEARRAY *array;
 
-        if(V_VT(v) == (VT_VARIANT|VT_BYREF))
-            v = V_VARIANTREF(v);
+        if(!(V_VT(v) & VT_ARRAY)) {
+            FIXME("array assign on type %d\n", V_VT(v));
+            return E_FAIL;
+        }
 
-        if(arg_cnt(dp)) {
-            SAFEARRAY *array;
+        switch(V_VT(v)) {
+        case VT_ARRAY|VT_BYREF|VT_VARIANT:
+            array = *V_ARRAYREF(v);
+            break;
+        case VT_ARRAY|VT_VARIANT:
+            array = V_ARRAY(v);
+            break;
+        default:
+            FIXME("Unsupported array type %x\n", V_VT(v));
+            return E_NOTIMPL;
+        }
 
-            if(!(V_VT(v) & VT_ARRAY)) {
-                FIXME("array assign on type %d\n", V_VT(v));
-                return E_FAIL;
-            }
+        if(!array) {
+            FIXME("null array\n");
+            return E_FAIL;
+        }
 
-            switch(V_VT(v)) {
-            case VT_ARRAY|VT_BYREF|VT_VARIANT:
-                array = *V_ARRAYREF(v);
-                break;
-            case VT_ARRAY|VT_VARIANT:
-                array = V_ARRAY(v);
-                break;
-            default:
-                FIXME("Unsupported array type %x\n", V_VT(v));
-                return E_NOTIMPL;
-            }
+        hres = array_access(ctx, array, dp, &v);
+        if(FAILED(hres))
+            return hres;
+    }else if(V_VT(v) == (VT_ARRAY|VT_BYREF|VT_VARIANT)) {
+        FIXME("non-array assign\n");
+        return E_NOTIMPL;
+    }
 
-            if(!array) {
-                FIXME("null array\n");
-                return E_FAIL;
-            }
+    return assign_value(ctx, v, dp->rgvarg, flags);
+}
 
-            hres = array_access(ctx, array, dp, &v);
-            if(FAILED(hres))
-                return hres;
-        }else if(V_VT(v) == (VT_ARRAY|VT_BYREF|VT_VARIANT)) {
-            FIXME("non-array assign\n");
-            return E_NOTIMPL;
-        }
+static HRESULT assign_ident(exec_ctx_t *ctx, BSTR name, WORD flags, DISPPARAMS *dp)
+{
+    ref_t ref;
+    HRESULT hres;
+
+    hres = lookup_identifier(ctx, name, VBDISP_LET, &ref);
+    if(FAILED(hres))
+        return hres;
 
-        hres = assign_value(ctx, v, dp->rgvarg, flags);
+    switch(ref.type) {
+    case REF_VAR:
+        hres = assign_var(ctx, ref.u.v, flags, dp);
         break;
-    }
     case REF_DISP:
         hres = disp_propput(ctx->script, ref.u.d.disp, ref.u.d.id, flags, dp);
         break;
@@ -820,6 +862,24 @@ static HRESULT interp_assign_ident(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_assign_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    DISPPARAMS dp;
+    HRESULT hres;
+
+    TRACE("%u\n", slot);
+
+    vbstack_to_dp(ctx, arg_cnt, TRUE, &dp);
+    hres = assign_var(ctx, get_local(ctx, slot), DISPATCH_PROPERTYPUT, &dp);
+    if(FAILED(hres))
+        return hres;
+
+    stack_popn(ctx, arg_cnt+1);
+    return S_OK;
+}
+
 static HRESULT interp_set_ident(exec_ctx_t *ctx)
 {
     const BSTR arg = ctx->instr->arg1.bstr;
@@ -847,6 +907,33 @@ static HRESULT interp_set_ident(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_set_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    DISPPARAMS dp;
+    HRESULT hres;
+
+    TRACE("%u\n", slot);
+
+    if(arg_cnt) {
+        FIXME("arguments not supported\n");
+        return E_NOTIMPL;
+    }
+
+    hres = stack_assume_disp(ctx, 0, NULL);
+    if(FAILED(hres))
+        return hres;
+
+    vbstack_to_dp(ctx, 0, TRUE, &dp);
+    hres = assign_var(ctx, get_local(ctx, slot), DISPATCH_PROPERTYPUTREF, &dp);
+    if(FAILED(hres))
+        return hres;
+
+    stack_popn(ctx, 1);
+    return S_OK;
+}
+
 static HRESULT interp_assign_member(exec_ctx_t *ctx)
 {
     BSTR identifier = ctx->instr->arg1.bstr;
@@ -1068,34 +1155,53 @@ static HRESULT interp_dim(exec_ctx_t *ctx)
     return S_OK;
 }
 
-static HRESULT interp_step(exec_ctx_t *ctx)
+static inline BOOL get_num_val(VARIANT *v, double *ret)
+{
+    switch(V_VT(v)) {
+    case VT_I2:
+        *ret = V_I2(v);
+        return TRUE;
+    case VT_I4:
+        *ret = V_I4(v);
+        return TRUE;
+    case VT_R8:
+        *ret = V_R8(v);
+        return !isnan(*ret);
+    default:
+        return FALSE;
+    }
+}
+
+static HRESULT var_cmp(exec_ctx_t *ctx, VARIANT *l, VARIANT *r)
+{
+    double ld, rd;
+
+    TRACE("%s %s\n", debugstr_variant(l), debugstr_variant(r));
+
+    /* Numeric operands are compared directly, without going through VarCmp. */
+    if(get_num_val(l, &ld) && get_num_val(r, &rd))
+        return ld < rd ? VARCMP_LT : ld > rd ? VARCMP_GT : VARCMP_EQ;
+
+    /* FIXME: Fix comparing string to number */
+
+    return VarCmp(l, r, ctx->script->lcid, 0);
+}
+
+static HRESULT do_step(exec_ctx_t *ctx, VARIANT *var)
 {
-    const BSTR ident = ctx->instr->arg2.bstr;
     BOOL gteq_zero;
     VARIANT zero;
-    ref_t ref;
     HRESULT hres;
 
-    TRACE("%s\n", debugstr_w(ident));
-
     V_VT(&zero) = VT_I2;
     V_I2(&zero) = 0;
-    hres = VarCmp(stack_top(ctx, 0), &zero, ctx->script->lcid, 0);
+    hres = var_cmp(ctx, stack_top(ctx, 0), &zero);
     if(FAILED(hres))
         return hres;
 
     gteq_zero = hres == VARCMP_GT || hres == VARCMP_EQ;
 
-    hres = lookup_identifier(ctx, ident, VBDISP_ANY, &ref);
-    if(FAILED(hres))
-        return hres;
-
-    if(ref.type != REF_VAR) {
-        FIXME("%s is not REF_VAR\n", debugstr_w(ident));
-        return E_FAIL;
-    }
-
-    hres = VarCmp(ref.u.v, stack_top(ctx, 1), ctx->script->lcid, 0);
+    hres = var_cmp(ctx, var, stack_top(ctx, 1));
     if(FAILED(hres))
         return hres;
 
@@ -1108,6 +1214,35 @@ static HRESULT interp_step(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_step(exec_ctx_t *ctx)
+{
+    const BSTR ident = ctx->instr->arg2.bstr;
+    ref_t ref;
+    HRESULT hres;
+
+    TRACE("%s\n", debugstr_w(ident));
+
+    hres = lookup_identifier(ctx, ident, VBDISP_ANY, &ref);
+    if(FAILED(hres))
+        return hres;
+
+    if(ref.type != REF_VAR) {
+        FIXME("%s is not REF_VAR\n", debugstr_w(ident));
+        return E_FAIL;
+    }
+
+    return do_step(ctx, ref.u.v);
+}
+
+static HRESULT interp_step_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg2.uint;
+
+    TRACE("%u\n", slot);
+
+    return do_step(ctx, get_local(ctx, slot));
+}
+
 static HRESULT interp_newenum(exec_ctx_t *ctx)
 {
     variant_val_t v;
@@ -1526,15 +1661,6 @@ static HRESULT interp_imp(exec_ctx_t *ctx)
     return stack_push(ctx, &v);
 }
 
-static HRESULT var_cmp(exec_ctx_t *ctx, VARIANT *l, VARIANT *r)
-{
-    TRACE("%s %s\n", debugstr_variant(l), debugstr_variant(r));
-
-    /* FIXME: Fix comparing string to number */
-
-    return VarCmp(l, r, ctx->script->lcid, 0);
- }
-
 static HRESULT cmp_oper(exec_ctx_t *ctx)
 {
     variant_val_t l, r;
@@ -1760,6 +1886,77 @@ static HRESULT interp_is(exec_ctx_t *ctx)
     return stack_push(ctx, &v);
 }
 
+typedef enum {
+    ARITH_ADD,
+    ARITH_SUB,
+    ARITH_MUL
+} arith_op_t;
+
+/*
+ * Computes integer and double arithmetic in place, following the result type
+ * rules of VarAdd, VarSub and VarMul: Integer results that overflow are
+ * promoted to Long and Long results to Double. Returns FALSE for operand
+ * types that have to go through oleaut32.
+ */
+static BOOL fast_arith(arith_op_t op, VARIANT *l, VARIANT *r, VARIANT *ret)
+{
+    LONGLONG li, ri, res;
+    double ld, rd;
+
+    if((V_VT(l) == VT_I2 || V_VT(l) == VT_I4) && (V_VT(r) == VT_I2 || V_VT(r) == VT_I4)) {
+        li = V_VT(l) == VT_I2 ? V_I2(l) : V_I4(l);
+        ri = V_VT(r) == VT_I2 ? V_I2(r) : V_I4(r);
+
+        switch(op) {
+        case ARITH_ADD: res = li + ri; break;
+        case ARITH_SUB: res = li - ri; break;
+        default:        res = li * ri; break;
+        }
+
+        if(V_VT(l) == VT_I2 && V_VT(r) == VT_I2 && res >= SHRT_MIN && res <= SHRT_MAX) {
+            V_VT(ret) = VT_I2;
+            V_I2(ret) = res;
+        }else if(res >= INT_MIN && res <= INT_MAX) {
+            V_VT(ret) = VT_I4;
+            V_I4(ret) = res;
+        }else {
+            V_VT(ret) = VT_R8;
+            V_R8(ret) = res;
+        }
+        return TRUE;
+    }
+
+    if((V_VT(l) != VT_R8 && V_VT(r) != VT_R8) || !get_num_val(l, &ld) || !get_num_val(r, &rd))
+        return FALSE;
+
+    V_VT(ret) = VT_R8;
+    switch(op) {
+    case ARITH_ADD: V_R8(ret) = ld + rd; break;
+    case ARITH_SUB: V_R8(ret) = ld - rd; break;
+    default:        V_R8(ret) = ld * rd; break;
+    }
+    return TRUE;
+}
+
+static HRESULT concat_bstr(BSTR l, BSTR r, VARIANT *ret)
+{
+    unsigned l_len = SysStringLen(l), r_len = SysStringLen(r);
+    BSTR str;
+
+    str = SysAllocStringLen(NULL, l_len+r_len);
+    if(!str)
+        return E_OUTOFMEMORY;
+
+    if(l_len)
+        memcpy(str, l, l_len*sizeof(WCHAR));
+    if(r_len)
+        memcpy(str+l_len, r, r_len*sizeof(WCHAR));
+
+    V_VT(ret) = VT_BSTR;
+    V_BSTR(ret) = str;
+    return S_OK;
+}
+
 static HRESULT interp_concat(exec_ctx_t *ctx)
 {
     variant_val_t r, l;
@@ -1774,7 +1971,10 @@ static HRESULT interp_concat(exec_ctx_t *ctx)
 
     hres = stack_pop_val(ctx, &l);
     if(SUCCEEDED(hres)) {
-        hres = VarCat(l.v, r.v, &v);
+        if(V_VT(l.v) == VT_BSTR && V_VT(r.v) == VT_BSTR)
+            hres = concat_bstr(V_BSTR(l.v), V_BSTR(r.v), &v);
+        else
+            hres = VarCat(l.v, r.v, &v);
         release_val(&l);
     }
     release_val(&r);
@@ -1798,7 +1998,12 @@ static HRESULT interp_add(exec_ctx_t *ctx)
 
     hres = stack_pop_val(ctx, &l);
     if(SUCCEEDED(hres)) {
-        hres = VarAdd(l.v, r.v, &v);
+        if(fast_arith(ARITH_ADD, l.v, r.v, &v))
+            hres = S_OK;
+        else if(V_VT(l.v) == VT_BSTR && V_VT(r.v) == VT_BSTR)
+            hres = concat_bstr(V_BSTR(l.v), V_BSTR(r.v), &v);
+        else
+            hres = VarAdd(l.v, r.v, &v);
         release_val(&l);
     }
     release_val(&r);
@@ -1822,7 +2027,10 @@ static HRESULT interp_sub(exec_ctx_t *ctx)
 
     hres = stack_pop_val(ctx, &l);
     if(SUCCEEDED(hres)) {
-        hres = VarSub(l.v, r.v, &v);
+        if(fast_arith(ARITH_SUB, l.v, r.v, &v))
+            hres = S_OK;
+        else
+            hres = VarSub(l.v, r.v, &v);
         release_val(&l);
     }
     release_val(&r);
@@ -1918,7 +2126,10 @@ static HRESULT interp_mul(exec_ctx_t *ctx)
 
     hres = stack_pop_val(ctx, &l);
     if(SUCCEEDED(hres)) {
-        hres = VarMul(l.v, r.v, &v);
+        if(fast_arith(ARITH_MUL, l.v, r.v, &v))
+            hres = S_OK;
+        else
+            hres = VarMul(l.v, r.v, &v);
         release_val(&l);
     }
     release_val(&r);
@@ -1970,10 +2181,28 @@ static HRESULT interp_neg(exec_ctx_t *ctx)
     return stack_push(ctx, &v);
 }
 
+static HRESULT incc_var(exec_ctx_t *ctx, VARIANT *var)
+{
+    VARIANT v;
+    HRESULT hres;
+
+    if(fast_arith(ARITH_ADD, stack_top(ctx, 0), var, &v)) {
+        *var = v;
+        return S_OK;
+    }
+
+    hres = VarAdd(stack_top(ctx, 0), var, &v);
+    if(FAILED(hres))
+        return hres;
+
+    VariantClear(var);
+    *var = v;
+    return S_OK;
+}
+
 static HRESULT interp_incc(exec_ctx_t *ctx)
 {
     const BSTR ident = ctx->instr->arg1.bstr;
-    VARIANT v;
     ref_t ref;
     HRESULT hres;
 
@@ -1988,13 +2217,16 @@ static HRESULT interp_incc(exec_ctx_t *ctx)
         return E_FAIL;
     }
 
-    hres = VarAdd(stack_top(ctx, 0), ref.u.v, &v);
-    if(FAILED(hres))
-        return hres;
+    return incc_var(ctx, ref.u.v);
+}
 
-    VariantClear(ref.u.v);
-    *ref.u.v = v;
-    return S_OK;
+static HRESULT interp_incc_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+
+    TRACE("%u\n", slot);
+
+    return incc_var(ctx, get_local(ctx, slot));
 }
 
 static HRESULT interp_catch(exec_ctx_t *ctx)
@@ -52,21 +52,32 @@ typedef struct match_state_t {
 typedef BYTE jsbytecode;
 
 typedef struct regexp_t {
+    LONG                ref;
     WORD                flags;         /* flags, see jsapi.h's REG_* defines */
     size_t              parenCount;    /* number of parenthesized submatches */
     size_t              classCount;    /* count [...] bitmaps */
     struct RECharSet    *classList;    /* list of [...] bitmaps */
     const WCHAR         *source;       /* locked source string, sans // */
     DWORD               source_len;
+    BOOL                hasFirstChar;  /* every match starts with firstChar */
+    WCHAR               firstChar;
+    UINT                nfaLength;     /* number of NFA instructions, 0 if none */
+    struct RENFAInstr   *nfa;          /* NFA used to find match start */
     jsbytecode          program[1];    /* regular expression bytecode */
 } regexp_t;
 
 regexp_t* regexp_new(void*, heap_pool_t*, const WCHAR*, DWORD, WORD, BOOL) DECLSPEC_HIDDEN;
-void regexp_destroy(regexp_t*) DECLSPEC_HIDDEN;
+void regexp_release(regexp_t*) DECLSPEC_HIDDEN;
 HRESULT regexp_execute(regexp_t*, void*, heap_pool_t*, const WCHAR*,
         DWORD, match_state_t*) DECLSPEC_HIDDEN;
 HRESULT regexp_set_flags(regexp_t**, void*, heap_pool_t*, WORD) DECLSPEC_HIDDEN;
 
+static inline regexp_t *regexp_addref(regexp_t *regexp)
+{
+    regexp->ref++;
+    return regexp;
+}
+
 static inline match_state_t* alloc_match_state(regexp_t *regexp,
         heap_pool_t *pool, const WCHAR *pos)
 {
@@ -2303,6 +2303,8 @@ static void run_tests(void)
     run_from_res("api.vbs");
     run_from_res("regexp.vbs");
     run_from_res("error.vbs");
+    if(winetest_interactive)
+        run_from_res("loops.vbs");
 
     test_procedures();
     test_gc();
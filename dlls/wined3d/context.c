@@ -1584,6 +1584,9 @@ void context_invalidate_state(struct wined3d_context *context, DWORD state)
     DWORD idx;
     BYTE shift;
 
+    if (state_affects_tex_unit_map(state))
+        context->update_tex_unit_map = 1;
+
     if (isStateDirty(context, rep)) return;
 
     context->dirtyArray[context->numDirtyEntries++] = rep;
@@ -3825,7 +3828,11 @@ BOOL context_apply_draw_state(struct wined3d_context *context,
     /* Preload resources before FBO setup. Texture preload in particular may
      * result in changes to the current FBO, due to using e.g. FBO blits for
      * updating a resource location. */
-    context_update_tex_unit_map(context, state);
+    if (context->update_tex_unit_map)
+    {
+        context_update_tex_unit_map(context, state);
+        context->update_tex_unit_map = 0;
+    }
     context_preload_textures(context, state);
     context_load_shader_resources(context, state, ~(1u << WINED3D_SHADER_TYPE_COMPUTE));
     context_load_unordered_access_resources(context, state->shader[WINED3D_SHADER_TYPE_PIXEL],
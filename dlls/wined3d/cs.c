@@ -21,6 +21,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 #define WINED3D_INITIAL_CS_SIZE 4096
 
@@ -426,6 +427,179 @@ struct wined3d_cs_stop
     enum wined3d_cs_op opcode;
 };
 
+/* Command stream statistics, collected when the d3d_perf channel is traced.
+ * Packet counts are updated by the worker thread, waits by the application
+ * thread. Synchronisation points are attributed to the last packet
+ * submitted to the queue before the wait. */
+struct wined3d_cs_op_stats
+{
+    ULONG packets;
+    ULONG64 bytes;
+    ULONG syncs;
+    ULONG64 sync_time;
+};
+
+struct wined3d_cs_stats
+{
+    struct wined3d_cs_op_stats ops[WINED3D_CS_OP_STOP];
+    enum wined3d_cs_op last_op[WINED3D_CS_QUEUE_COUNT];
+    ULONG full_waits;
+    ULONG64 full_wait_time;
+    ULONG idle_waits;
+    ULONG64 idle_wait_time;
+    ULONG present_waits;
+    ULONG64 present_wait_time;
+    ULONG worker_waits;
+    ULONG presents;
+    ULONG64 create_time;
+    LARGE_INTEGER frequency;
+};
+
+#define WINED3D_CS_STATS_INTERVAL 600u
+
+static const char *debug_cs_op(enum wined3d_cs_op op)
+{
+    switch (op)
+    {
+#define WINED3D_TO_STR(x) case x: return #x
+        WINED3D_TO_STR(WINED3D_CS_OP_NOP);
+        WINED3D_TO_STR(WINED3D_CS_OP_PRESENT);
+        WINED3D_TO_STR(WINED3D_CS_OP_CLEAR);
+        WINED3D_TO_STR(WINED3D_CS_OP_DISPATCH);
+        WINED3D_TO_STR(WINED3D_CS_OP_DRAW);
+        WINED3D_TO_STR(WINED3D_CS_OP_FLUSH);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_PREDICATION);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_VIEWPORT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SCISSOR_RECT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_RENDERTARGET_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_DEPTH_STENCIL_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_VERTEX_DECLARATION);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_STREAM_SOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_STREAM_SOURCE_FREQ);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_STREAM_OUTPUT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_INDEX_BUFFER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_CONSTANT_BUFFER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_TEXTURE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_UNORDERED_ACCESS_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SAMPLER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SHADER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_RASTERIZER_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_RENDER_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_TEXTURE_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SAMPLER_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_TRANSFORM);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_CLIP_PLANE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_COLOR_KEY);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_MATERIAL);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_LIGHT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_LIGHT_ENABLE);
+        WINED3D_TO_STR(WINED3D_CS_OP_PUSH_CONSTANTS);
+        WINED3D_TO_STR(WINED3D_CS_OP_RESET_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_CALLBACK);
+        WINED3D_TO_STR(WINED3D_CS_OP_QUERY_ISSUE);
+        WINED3D_TO_STR(WINED3D_CS_OP_PRELOAD_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_UNLOAD_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_MAP);
+        WINED3D_TO_STR(WINED3D_CS_OP_UNMAP);
+        WINED3D_TO_STR(WINED3D_CS_OP_BLT_SUB_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_UPDATE_SUB_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_ADD_DIRTY_TEXTURE_REGION);
+        WINED3D_TO_STR(WINED3D_CS_OP_CLEAR_UNORDERED_ACCESS_VIEW);
+#undef WINED3D_TO_STR
+        default:
+            return wine_dbg_sprintf("unrecognised(%#x)", op);
+    }
+}
+
+static ULONG64 wined3d_cs_stats_time(void)
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static double wined3d_cs_stats_msec(const struct wined3d_cs_stats *stats, ULONG64 time)
+{
+    return time * 1000.0 / stats->frequency.QuadPart;
+}
+
+static void wined3d_cs_dump_stats(const struct wined3d_cs *cs)
+{
+    const struct wined3d_cs_stats *stats = cs->stats;
+    const struct wined3d_cs_op_stats *op;
+    unsigned int i;
+
+    TRACE_(d3d_perf)("cs %p: %u presents, queue full %u waits / %.3f ms, resource idle %u waits / %.3f ms, "
+            "present throttle %u waits / %.3f ms, worker slept %u times.\n", cs, stats->presents,
+            stats->full_waits, wined3d_cs_stats_msec(stats, stats->full_wait_time),
+            stats->idle_waits, wined3d_cs_stats_msec(stats, stats->idle_wait_time),
+            stats->present_waits, wined3d_cs_stats_msec(stats, stats->present_wait_time),
+            stats->worker_waits);
+
+    for (i = 0; i < ARRAY_SIZE(stats->ops); ++i)
+    {
+        op = &stats->ops[i];
+        if (!op->packets && !op->syncs)
+            continue;
+        TRACE_(d3d_perf)("  %-45s %10u packets %12s bytes, %u syncs / %.3f ms.\n", debug_cs_op(i),
+                op->packets, wine_dbgstr_longlong(op->bytes),
+                op->syncs, wined3d_cs_stats_msec(stats, op->sync_time));
+    }
+}
+
+static BOOL wined3d_cs_queue_is_empty(const struct wined3d_cs_queue *queue)
+{
+    return *(volatile LONG *)&queue->head == queue->tail;
+}
+
+/* Wait until the worker thread completes another packet. The caller samples
+ * cs->progress before checking its wait condition, so that a packet
+ * completed in between is not missed. */
+static void wined3d_cs_wait_progress(struct wined3d_cs *cs, LONG progress, unsigned int *spin_count)
+{
+    if (++*spin_count < WINED3D_CS_WAIT_SPIN_COUNT)
+    {
+        wined3d_pause();
+        return;
+    }
+
+    InterlockedExchange(&cs->waiting_for_progress, TRUE);
+
+    /* Same as in wined3d_cs_wait_event(), if the worker thread reset
+     * "waiting_for_progress" it has signalled the event as well. */
+    if (*(volatile LONG *)&cs->progress != progress
+            && InterlockedCompareExchange(&cs->waiting_for_progress, FALSE, TRUE))
+        return;
+
+    WaitForSingleObject(cs->progress_event, INFINITE);
+}
+
+void wined3d_cs_wait_resource_idle(struct wined3d_cs *cs, struct wined3d_resource *resource)
+{
+    unsigned int spin_count = 0;
+    ULONG64 start = 0;
+    LONG progress;
+
+    if (cs->stats)
+        start = wined3d_cs_stats_time();
+
+    for (;;)
+    {
+        progress = *(volatile LONG *)&cs->progress;
+        if (!InterlockedCompareExchange(&resource->access_count, 0, 0))
+            break;
+        wined3d_cs_wait_progress(cs, progress, &spin_count);
+    }
+
+    if (cs->stats)
+    {
+        ++cs->stats->idle_waits;
+        cs->stats->idle_wait_time += wined3d_cs_stats_time() - start;
+    }
+}
+
 static void wined3d_cs_exec_nop(struct wined3d_cs *cs, const void *data)
 {
 }
@@ -475,13 +649,37 @@ void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *sw
 
     cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
 
+    if (cs->stats && cs->stats->presents == 0)
+        TRACE_(d3d_perf)("cs %p: first present after %.3f ms.\n", cs,
+                wined3d_cs_stats_msec(cs->stats, wined3d_cs_stats_time() - cs->stats->create_time));
+    if (cs->stats && !(++cs->stats->presents % WINED3D_CS_STATS_INTERVAL))
+        wined3d_cs_dump_stats(cs);
+
     /* Limit input latency by limiting the number of presents that we can get
      * ahead of the worker thread. We have a constant limit here, but
      * IDXGIDevice1 allows tuning this. */
-    while (pending > 1)
+    if (pending > 1)
     {
-        wined3d_pause();
-        pending = InterlockedCompareExchange(&cs->pending_presents, 0, 0);
+        unsigned int spin_count = 0;
+        ULONG64 start = 0;
+        LONG progress;
+
+        if (cs->stats)
+            start = wined3d_cs_stats_time();
+
+        for (;;)
+        {
+            progress = *(volatile LONG *)&cs->progress;
+            if (InterlockedCompareExchange(&cs->pending_presents, 0, 0) <= 1)
+                break;
+            wined3d_cs_wait_progress(cs, progress, &spin_count);
+        }
+
+        if (cs->stats)
+        {
+            ++cs->stats->present_waits;
+            cs->stats->present_wait_time += wined3d_cs_stats_time() - start;
+        }
     }
 }
 
@@ -1711,22 +1909,74 @@ static void wined3d_cs_exec_push_constants(struct wined3d_cs *cs, const void *da
     wined3d_cs_st_push_constants(cs, op->type, op->start_idx, op->count, op->constants);
 }
 
-static void wined3d_cs_mt_push_constants(struct wined3d_cs *cs, enum wined3d_push_constants p,
+static void wined3d_cs_queue_submit(struct wined3d_cs_queue *queue, struct wined3d_cs *cs);
+static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size_t size, struct wined3d_cs *cs);
+
+static void wined3d_cs_emit_push_constants(struct wined3d_cs *cs, enum wined3d_push_constants p,
         unsigned int start_idx, unsigned int count, const void *constants)
 {
+    struct wined3d_cs_queue *queue = &cs->queue[WINED3D_CS_QUEUE_DEFAULT];
     struct wined3d_cs_push_constants *op;
     size_t size;
 
     size = count * wined3d_cs_push_constant_info[p].size;
-    op = cs->ops->require_space(cs, FIELD_OFFSET(struct wined3d_cs_push_constants, constants[size]),
-            WINED3D_CS_QUEUE_DEFAULT);
+    op = wined3d_cs_queue_require_space(queue, FIELD_OFFSET(struct wined3d_cs_push_constants, constants[size]), cs);
     op->opcode = WINED3D_CS_OP_PUSH_CONSTANTS;
     op->type = p;
     op->start_idx = start_idx;
     op->count = count;
     memcpy(op->constants, constants, size);
 
-    cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
+    wined3d_cs_queue_submit(queue, cs);
+}
+
+static void wined3d_cs_flush_pending_constants(struct wined3d_cs *cs, DWORD mask)
+{
+    const BYTE *state = (const BYTE *)&cs->device->state;
+    unsigned int p, start_idx;
+
+    cs->pending_constants_mask &= ~mask;
+    for (p = 0; p < WINED3D_PUSH_CONSTANTS_COUNT; ++p)
+    {
+        if (!(mask & (1u << p)))
+            continue;
+        start_idx = cs->pending_constants[p].start_idx;
+        wined3d_cs_emit_push_constants(cs, p, start_idx, cs->pending_constants[p].end_idx - start_idx,
+                state + wined3d_cs_push_constant_info[p].offset + start_idx * wined3d_cs_push_constant_info[p].size);
+    }
+}
+
+/* Applications typically set a few constant ranges per draw. The values are
+ * already in the device state, so only the ranges are recorded here, and
+ * sent as one packet per constant type before the next command. */
+#define WINED3D_CS_MAX_CONSTANT_GAP 16
+
+static void wined3d_cs_mt_push_constants(struct wined3d_cs *cs, enum wined3d_push_constants p,
+        unsigned int start_idx, unsigned int count, const void *constants)
+{
+    unsigned int end_idx = start_idx + count;
+
+    if (cs->thread_id == GetCurrentThreadId())
+        return wined3d_cs_st_push_constants(cs, p, start_idx, count, constants);
+
+    if (cs->pending_constants_mask & (1u << p))
+    {
+        unsigned int pending_start = cs->pending_constants[p].start_idx;
+        unsigned int pending_end = cs->pending_constants[p].end_idx;
+
+        if (start_idx <= pending_end + WINED3D_CS_MAX_CONSTANT_GAP
+                && pending_start <= end_idx + WINED3D_CS_MAX_CONSTANT_GAP)
+        {
+            cs->pending_constants[p].start_idx = min(start_idx, pending_start);
+            cs->pending_constants[p].end_idx = max(end_idx, pending_end);
+            return;
+        }
+        wined3d_cs_flush_pending_constants(cs, 1u << p);
+    }
+
+    cs->pending_constants[p].start_idx = start_idx;
+    cs->pending_constants[p].end_idx = end_idx;
+    cs->pending_constants_mask |= 1u << p;
 }
 
 static void wined3d_cs_exec_reset_state(struct wined3d_cs *cs, const void *data)
@@ -2280,7 +2530,11 @@ static void wined3d_cs_emit_stop(struct wined3d_cs *cs)
     op->opcode = WINED3D_CS_OP_STOP;
 
     cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
-    cs->ops->finish(cs, WINED3D_CS_QUEUE_DEFAULT);
+
+    /* The worker thread doesn't signal progress for the stop packet, so it
+     * never touches the command stream again once the queue is empty. */
+    while (!wined3d_cs_queue_is_empty(&cs->queue[WINED3D_CS_QUEUE_DEFAULT]))
+        wined3d_pause();
 }
 
 static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void *data) =
@@ -2400,11 +2654,6 @@ static const struct wined3d_cs_ops wined3d_cs_st_ops =
     wined3d_cs_st_push_constants,
 };
 
-static BOOL wined3d_cs_queue_is_empty(const struct wined3d_cs_queue *queue)
-{
-    return *(volatile LONG *)&queue->head == queue->tail;
-}
-
 static void wined3d_cs_queue_submit(struct wined3d_cs_queue *queue, struct wined3d_cs *cs)
 {
     struct wined3d_cs_packet *packet;
@@ -2412,6 +2661,8 @@ static void wined3d_cs_queue_submit(struct wined3d_cs_queue *queue, struct wined
 
     packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
     packet_size = FIELD_OFFSET(struct wined3d_cs_packet, data[packet->size]);
+    if (cs->stats && packet->size)
+        cs->stats->last_op[queue - cs->queue] = *(const enum wined3d_cs_op *)packet->data;
     InterlockedExchange(&queue->head, (queue->head + packet_size) & (WINED3D_CS_QUEUE_SIZE - 1));
 
     if (InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
@@ -2446,6 +2697,8 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
     size_t queue_size = ARRAY_SIZE(queue->data);
     size_t header_size, packet_size, remaining;
     struct wined3d_cs_packet *packet;
+    unsigned int spin_count = 0;
+    ULONG64 start = 0;
 
     header_size = FIELD_OFFSET(struct wined3d_cs_packet, data[0]);
     size = (size + header_size - 1) & ~(header_size - 1);
@@ -2476,6 +2729,7 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
 
     for (;;)
     {
+        LONG progress = *(volatile LONG *)&cs->progress;
         LONG tail = *(volatile LONG *)&queue->tail;
         LONG head = queue->head;
         LONG new_pos;
@@ -2493,8 +2747,20 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
         if (new_pos < tail && new_pos)
             break;
 
-        TRACE("Waiting for free space. Head %u, tail %u, packet size %lu.\n",
-                head, tail, (unsigned long)packet_size);
+        if (!spin_count)
+        {
+            TRACE("Waiting for free space. Head %u, tail %u, packet size %lu.\n",
+                    head, tail, (unsigned long)packet_size);
+            if (cs->stats)
+                start = wined3d_cs_stats_time();
+        }
+        wined3d_cs_wait_progress(cs, progress, &spin_count);
+    }
+
+    if (spin_count && cs->stats)
+    {
+        ++cs->stats->full_waits;
+        cs->stats->full_wait_time += wined3d_cs_stats_time() - start;
     }
 
     packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
@@ -2517,16 +2783,40 @@ static void *wined3d_cs_mt_require_space(struct wined3d_cs *cs, size_t size, enu
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_require_space(cs, size, queue_id);
 
+    if (queue_id == WINED3D_CS_QUEUE_DEFAULT && cs->pending_constants_mask)
+        wined3d_cs_flush_pending_constants(cs, cs->pending_constants_mask);
+
     return wined3d_cs_queue_require_space(&cs->queue[queue_id], size, cs);
 }
 
 static void wined3d_cs_mt_finish(struct wined3d_cs *cs, enum wined3d_cs_queue_id queue_id)
 {
+    struct wined3d_cs_queue *queue = &cs->queue[queue_id];
+    unsigned int spin_count = 0;
+    ULONG64 start = 0;
+    LONG progress;
+
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_finish(cs, queue_id);
 
-    while (!wined3d_cs_queue_is_empty(&cs->queue[queue_id]))
-        wined3d_pause();
+    if (cs->stats)
+        start = wined3d_cs_stats_time();
+
+    for (;;)
+    {
+        progress = *(volatile LONG *)&cs->progress;
+        if (wined3d_cs_queue_is_empty(queue))
+            break;
+        wined3d_cs_wait_progress(cs, progress, &spin_count);
+    }
+
+    if (cs->stats)
+    {
+        struct wined3d_cs_op_stats *op = &cs->stats->ops[cs->stats->last_op[queue_id]];
+
+        ++op->syncs;
+        op->sync_time += wined3d_cs_stats_time() - start;
+    }
 }
 
 static const struct wined3d_cs_ops wined3d_cs_mt_ops =
@@ -2576,6 +2866,7 @@ static void wined3d_cs_wait_event(struct wined3d_cs *cs)
 
 static DWORD WINAPI wined3d_cs_run(void *ctx)
 {
+    unsigned int spin_limit = WINED3D_CS_SPIN_COUNT;
     struct wined3d_cs_packet *packet;
     struct wined3d_cs_queue *queue;
     unsigned int spin_count = 0;
@@ -2602,11 +2893,25 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
             queue = &cs->queue[WINED3D_CS_QUEUE_DEFAULT];
             if (wined3d_cs_queue_is_empty(queue))
             {
-                if (++spin_count >= WINED3D_CS_SPIN_COUNT && list_empty(&cs->query_poll_list))
+                if (++spin_count >= spin_limit && list_empty(&cs->query_poll_list))
+                {
+                    /* Spinning didn't pay off, give up the CPU sooner next time. */
                     wined3d_cs_wait_event(cs);
+                    spin_limit = max(spin_limit / 2, WINED3D_CS_SPIN_COUNT_MIN);
+                    spin_count = 0;
+                    if (cs->stats)
+                        ++cs->stats->worker_waits;
+                }
+                else
+                {
+                    wined3d_pause();
+                }
                 continue;
             }
         }
+        /* The application kept us busy while spinning, spin longer next time. */
+        if (spin_count && spin_count < spin_limit)
+            spin_limit = min(spin_limit * 2, WINED3D_CS_SPIN_COUNT);
         spin_count = 0;
 
         tail = queue->tail;
@@ -2623,11 +2928,22 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
             }
 
             wined3d_cs_op_handlers[opcode](cs, packet->data);
+
+            if (cs->stats)
+            {
+                ++cs->stats->ops[opcode].packets;
+                cs->stats->ops[opcode].bytes += FIELD_OFFSET(struct wined3d_cs_packet, data[packet->size]);
+            }
         }
 
         tail += FIELD_OFFSET(struct wined3d_cs_packet, data[packet->size]);
         tail &= (WINED3D_CS_QUEUE_SIZE - 1);
+        ++cs->progress;
         InterlockedExchange(&queue->tail, tail);
+
+        if (*(volatile LONG *)&cs->waiting_for_progress
+                && InterlockedCompareExchange(&cs->waiting_for_progress, FALSE, TRUE))
+            SetEvent(cs->progress_event);
     }
 
     cs->queue[WINED3D_CS_QUEUE_MAP].tail = cs->queue[WINED3D_CS_QUEUE_MAP].head = 0;
@@ -2672,10 +2988,26 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
             goto fail;
         }
 
+        if (!(cs->progress_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        {
+            ERR("Failed to create command stream progress event.\n");
+            CloseHandle(cs->event);
+            HeapFree(GetProcessHeap(), 0, cs->data);
+            goto fail;
+        }
+
+        if (TRACE_ON(d3d_perf) && (cs->stats = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cs->stats))))
+        {
+            QueryPerformanceFrequency(&cs->stats->frequency);
+            cs->stats->create_time = wined3d_cs_stats_time();
+        }
+
         if (!(GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
                 (const WCHAR *)wined3d_cs_run, &cs->wined3d_module)))
         {
             ERR("Failed to get wined3d module handle.\n");
+            HeapFree(GetProcessHeap(), 0, cs->stats);
+            CloseHandle(cs->progress_event);
             CloseHandle(cs->event);
             HeapFree(GetProcessHeap(), 0, cs->data);
             goto fail;
@@ -2685,6 +3017,8 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
         {
             ERR("Failed to create wined3d command stream thread.\n");
             FreeLibrary(cs->wined3d_module);
+            HeapFree(GetProcessHeap(), 0, cs->stats);
+            CloseHandle(cs->progress_event);
             CloseHandle(cs->event);
             HeapFree(GetProcessHeap(), 0, cs->data);
             goto fail;
@@ -2708,6 +3042,13 @@ void wined3d_cs_destroy(struct wined3d_cs *cs)
         CloseHandle(cs->thread);
         if (!CloseHandle(cs->event))
             ERR("Closing event failed.\n");
+        if (!CloseHandle(cs->progress_event))
+            ERR("Closing progress event failed.\n");
+        if (cs->stats)
+        {
+            wined3d_cs_dump_stats(cs);
+            HeapFree(GetProcessHeap(), 0, cs->stats);
+        }
     }
 
     state_cleanup(&cs->state);
@@ -2383,6 +2383,12 @@ HRESULT CDECL wined3d_device_set_vs_consts_b(struct wined3d_device *device,
 
     if (count > WINED3D_MAX_CONSTS_B - start_idx)
         count = WINED3D_MAX_CONSTS_B - start_idx;
+    if (!device->recording && !memcmp(&device->state.vs_consts_b[start_idx], constants, count * sizeof(*constants)))
+    {
+        TRACE("Application is setting the old values over, nothing to do.\n");
+        return WINED3D_OK;
+    }
+
     memcpy(&device->update_state->vs_consts_b[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2432,6 +2438,12 @@ HRESULT CDECL wined3d_device_set_vs_consts_i(struct wined3d_device *device,
 
     if (count > WINED3D_MAX_CONSTS_I - start_idx)
         count = WINED3D_MAX_CONSTS_I - start_idx;
+    if (!device->recording && !memcmp(&device->state.vs_consts_i[start_idx], constants, count * sizeof(*constants)))
+    {
+        TRACE("Application is setting the old values over, nothing to do.\n");
+        return WINED3D_OK;
+    }
+
     memcpy(&device->update_state->vs_consts_i[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2480,6 +2492,12 @@ HRESULT CDECL wined3d_device_set_vs_consts_f(struct wined3d_device *device,
             || count > d3d_info->limits.vs_uniform_count - start_idx)
         return WINED3DERR_INVALIDCALL;
 
+    if (!device->recording && !memcmp(&device->state.vs_consts_f[start_idx], constants, count * sizeof(*constants)))
+    {
+        TRACE("Application is setting the old values over, nothing to do.\n");
+        return WINED3D_OK;
+    }
+
     memcpy(&device->update_state->vs_consts_f[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2598,6 +2616,12 @@ HRESULT CDECL wined3d_device_set_ps_consts_b(struct wined3d_device *device,
 
     if (count > WINED3D_MAX_CONSTS_B - start_idx)
         count = WINED3D_MAX_CONSTS_B - start_idx;
+    if (!device->recording && !memcmp(&device->state.ps_consts_b[start_idx], constants, count * sizeof(*constants)))
+    {
+        TRACE("Application is setting the old values over, nothing to do.\n");
+        return WINED3D_OK;
+    }
+
     memcpy(&device->update_state->ps_consts_b[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2647,6 +2671,12 @@ HRESULT CDECL wined3d_device_set_ps_consts_i(struct wined3d_device *device,
 
     if (count > WINED3D_MAX_CONSTS_I - start_idx)
         count = WINED3D_MAX_CONSTS_I - start_idx;
+    if (!device->recording && !memcmp(&device->state.ps_consts_i[start_idx], constants, count * sizeof(*constants)))
+    {
+        TRACE("Application is setting the old values over, nothing to do.\n");
+        return WINED3D_OK;
+    }
+
     memcpy(&device->update_state->ps_consts_i[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -2696,6 +2726,12 @@ HRESULT CDECL wined3d_device_set_ps_consts_f(struct wined3d_device *device,
             || count > d3d_info->limits.ps_uniform_count - start_idx)
         return WINED3DERR_INVALIDCALL;
 
+    if (!device->recording && !memcmp(&device->state.ps_consts_f[start_idx], constants, count * sizeof(*constants)))
+    {
+        TRACE("Application is setting the old values over, nothing to do.\n");
+        return WINED3D_OK;
+    }
+
     memcpy(&device->update_state->ps_consts_f[start_idx], constants, count * sizeof(*constants));
     if (TRACE_ON(d3d))
     {
@@ -5189,6 +5225,8 @@ void device_invalidate_state(const struct wined3d_device *device, DWORD state)
     for (i = 0; i < device->context_count; ++i)
     {
         context = device->contexts[i];
+        if (state_affects_tex_unit_map(state))
+            context->update_tex_unit_map = 1;
         if(isStateDirty(context, rep)) continue;
 
         context->dirtyArray[context->numDirtyEntries++] = rep;
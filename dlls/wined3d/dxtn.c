@@ -19,501 +19,697 @@
 #include "config.h"
 #include "wine/port.h"
 #include "wined3d_private.h"
-#include "wine/library.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 
-static void* txc_dxtn_handle;
-static void (*pfetch_2d_texel_rgba_dxt1)(int srcRowStride, const BYTE *pixData, int i, int j, DWORD *texel);
-static void (*pfetch_2d_texel_rgba_dxt3)(int srcRowStride, const BYTE *pixData, int i, int j, DWORD *texel);
-static void (*pfetch_2d_texel_rgba_dxt5)(int srcRowStride, const BYTE *pixData, int i, int j, DWORD *texel);
-static void (*ptx_compress_dxtn)(int comps, int width, int height, const BYTE *srcPixData,
-                                 GLenum destformat, BYTE *dest, int dstRowStride);
+/* Blocks are decoded to and encoded from 4x4 texels in B8G8R8A8 layout,
+ * i.e. 0xaarrggbb. Surfaces with enough blocks are split into slices of
+ * block rows, which are processed by the calling thread and a number of
+ * worker threads. */
+#define BCN_SLICE_ROWS          16
+#define BCN_PARALLEL_MIN_BLOCKS 16384
+#define BCN_MAX_WORKERS         7
 
-static inline BOOL dxt1_to_x8r8g8b8(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, BOOL alpha)
+enum bcn_type
 {
-    unsigned int x, y;
-    DWORD color;
+    BCN_DXT1,
+    BCN_DXT3,
+    BCN_DXT5,
+    BCN_BC4,
+    BCN_BC5,
+};
+
+static const unsigned int bcn_block_size[] = {8, 16, 16, 8, 16};
 
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
+struct bcn_job
+{
+    enum bcn_type type;
+    BOOL encode;
+    const BYTE *src;
+    BYTE *dst;
+    DWORD pitch_in;
+    DWORD pitch_out;
+    enum wined3d_format_id format;
+    unsigned int w, h;
+
+    unsigned int slice_count;
+    LONG next_slice;
+    LONG pending;
+    HANDLE done;
+};
+
+static DWORD rgb565_to_argb(WORD color)
+{
+    DWORD r = (color >> 11) & 0x1f, g = (color >> 5) & 0x3f, b = color & 0x1f;
+
+    return 0xff000000 | ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+}
+
+static WORD argb_to_rgb565(DWORD color)
+{
+    DWORD r = (color >> 16) & 0xff, g = (color >> 8) & 0xff, b = color & 0xff;
+
+    return ((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | (b * 31 + 127) / 255;
+}
+
+static DWORD bcn_blend(DWORD c0, DWORD c1, unsigned int w0, unsigned int w1)
+{
+    unsigned int d = w0 + w1, i;
+    DWORD ret = 0xff000000;
+
+    for (i = 0; i < 24; i += 8)
+        ret |= ((((c0 >> i) & 0xff) * w0 + ((c1 >> i) & 0xff) * w1 + d / 2) / d) << i;
+    return ret;
+}
 
-    for (y = 0; y < h; ++y)
+static void bcn_color_palette(WORD c0, WORD c1, BOOL allow_transparent, DWORD *palette)
+{
+    palette[0] = rgb565_to_argb(c0);
+    palette[1] = rgb565_to_argb(c1);
+    if (c0 > c1 || !allow_transparent)
     {
-        DWORD *dst_line = (DWORD *)(dst + y * pitch_out);
-        for (x = 0; x < w; ++x)
-        {
-            /* pfetch_2d_texel_rgba_dxt1 doesn't correctly handle pitch */
-            pfetch_2d_texel_rgba_dxt1(0, src + (y / 4) * pitch_in + (x / 4) * 8,
-                                      x & 3, y & 3, &color);
-            if (alpha)
-            {
-                dst_line[x] = (color & 0xff00ff00) | ((color & 0xff) << 16) |
-                              ((color & 0xff0000) >> 16);
-            }
-            else
-            {
-                dst_line[x] = 0xff000000 | ((color & 0xff) << 16) |
-                              (color & 0xff00) | ((color & 0xff0000) >> 16);
-            }
-        }
+        palette[2] = bcn_blend(palette[0], palette[1], 2, 1);
+        palette[3] = bcn_blend(palette[0], palette[1], 1, 2);
     }
+    else
+    {
+        palette[2] = bcn_blend(palette[0], palette[1], 1, 1);
+        palette[3] = 0;
+    }
+}
 
-    return TRUE;
+static void bcn_alpha_palette(BYTE a0, BYTE a1, BYTE *palette)
+{
+    unsigned int i;
+
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+        for (i = 1; i < 7; ++i)
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+    }
+    else
+    {
+        for (i = 1; i < 5; ++i)
+            palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+        palette[6] = 0x00;
+        palette[7] = 0xff;
+    }
+}
+
+static void decode_color_block(const BYTE *src, BOOL allow_transparent, DWORD *texels)
+{
+    DWORD palette[4], indices;
+    unsigned int i;
+
+    bcn_color_palette(src[0] | src[1] << 8, src[2] | src[3] << 8, allow_transparent, palette);
+    indices = src[4] | src[5] << 8 | src[6] << 16 | (DWORD)src[7] << 24;
+    for (i = 0; i < 16; ++i, indices >>= 2)
+        texels[i] = palette[indices & 3];
+}
+
+static void decode_alpha_block(const BYTE *src, BYTE *values)
+{
+    ULONG64 indices = 0;
+    BYTE palette[8];
+    unsigned int i;
+
+    bcn_alpha_palette(src[0], src[1], palette);
+    for (i = 0; i < 6; ++i)
+        indices |= (ULONG64)src[i + 2] << (8 * i);
+    for (i = 0; i < 16; ++i, indices >>= 3)
+        values[i] = palette[indices & 7];
 }
 
-static inline BOOL dxt1_to_x4r4g4b4(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, BOOL alpha)
+static void decode_block(enum bcn_type type, const BYTE *src, DWORD *texels)
+{
+    BYTE values[16], values2[16];
+    unsigned int i;
+
+    switch (type)
+    {
+        case BCN_DXT1:
+            decode_color_block(src, TRUE, texels);
+            break;
+
+        case BCN_DXT3:
+            decode_color_block(src + 8, FALSE, texels);
+            for (i = 0; i < 16; ++i)
+                texels[i] = (texels[i] & 0x00ffffff) | (((src[i / 2] >> (4 * (i & 1))) & 0xf) * 0x11u) << 24;
+            break;
+
+        case BCN_DXT5:
+            decode_alpha_block(src, values);
+            decode_color_block(src + 8, FALSE, texels);
+            for (i = 0; i < 16; ++i)
+                texels[i] = (texels[i] & 0x00ffffff) | (DWORD)values[i] << 24;
+            break;
+
+        case BCN_BC4:
+            decode_alpha_block(src, values);
+            for (i = 0; i < 16; ++i)
+                texels[i] = 0xff000000 | values[i] << 16;
+            break;
+
+        case BCN_BC5:
+            decode_alpha_block(src, values);
+            decode_alpha_block(src + 8, values2);
+            for (i = 0; i < 16; ++i)
+                texels[i] = 0xff000000 | values[i] << 16 | values2[i] << 8;
+            break;
+    }
+}
+
+static void store_texels(const DWORD *texels, BYTE *dst, DWORD pitch,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
     unsigned int x, y;
     DWORD color;
 
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
-
-    for (y = 0; y < h; ++y)
+    for (y = 0; y < h; ++y, dst += pitch, texels += 4)
     {
-        WORD *dst_line = (WORD *)(dst + y * pitch_out);
+        DWORD *dst32 = (DWORD *)dst;
+        WORD *dst16 = (WORD *)dst;
+
         for (x = 0; x < w; ++x)
         {
-            /* pfetch_2d_texel_rgba_dxt1 doesn't correctly handle pitch */
-            pfetch_2d_texel_rgba_dxt1(0, src + (y / 4) * pitch_in + (x / 4) * 16,
-                                      x & 3, y & 3, &color);
-            if (alpha)
-            {
-                dst_line[x] = ((color & 0xf0000000) >> 16) | ((color & 0xf00000) >> 20) |
-                              ((color & 0xf000) >> 8) | ((color & 0xf0) << 4);
-            }
-            else
+            color = texels[x];
+            switch (format)
             {
-                dst_line[x] = 0xf000  | ((color & 0xf00000) >> 20) |
-                              ((color & 0xf000) >> 8) | ((color & 0xf0) << 4);
+                case WINED3DFMT_B8G8R8A8_UNORM:
+                    dst32[x] = color;
+                    break;
+                case WINED3DFMT_B8G8R8X8_UNORM:
+                    dst32[x] = color | 0xff000000;
+                    break;
+                case WINED3DFMT_B4G4R4A4_UNORM:
+                case WINED3DFMT_B4G4R4X4_UNORM:
+                    if (format == WINED3DFMT_B4G4R4X4_UNORM)
+                        color |= 0xff000000;
+                    dst16[x] = ((color >> 16) & 0xf000) | ((color >> 12) & 0x0f00)
+                            | ((color >> 8) & 0x00f0) | ((color >> 4) & 0x000f);
+                    break;
+                case WINED3DFMT_B5G5R5A1_UNORM:
+                case WINED3DFMT_B5G5R5X1_UNORM:
+                    if (format == WINED3DFMT_B5G5R5X1_UNORM)
+                        color |= 0xff000000;
+                    dst16[x] = ((color >> 16) & 0x8000) | ((color >> 9) & 0x7c00)
+                            | ((color >> 6) & 0x03e0) | ((color >> 3) & 0x001f);
+                    break;
+                default:
+                    break;
             }
         }
     }
-
-    return TRUE;
 }
 
-static inline BOOL dxt1_to_x1r5g5b5(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, BOOL alpha)
+static void load_texels(const BYTE *src, DWORD pitch, enum wined3d_format_id format,
+        unsigned int w, unsigned int h, DWORD *texels)
 {
+    static const unsigned char convert_5to8[] =
+    {
+        0x00, 0x08, 0x10, 0x19, 0x21, 0x29, 0x31, 0x3a,
+        0x42, 0x4a, 0x52, 0x5a, 0x63, 0x6b, 0x73, 0x7b,
+        0x84, 0x8c, 0x94, 0x9c, 0xa5, 0xad, 0xb5, 0xbd,
+        0xc5, 0xce, 0xd6, 0xde, 0xe6, 0xef, 0xf7, 0xff,
+    };
     unsigned int x, y;
-    DWORD color;
-
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
+    WORD color;
 
-    for (y = 0; y < h; ++y)
+    /* Partial blocks at the right and bottom edges repeat the last texel. */
+    for (y = 0; y < 4; ++y)
     {
-        WORD *dst_line = (WORD *)(dst + y * pitch_out);
-        for (x = 0; x < w; ++x)
+        const BYTE *line = src + min(y, h - 1) * pitch;
+
+        for (x = 0; x < 4; ++x)
         {
-            /* pfetch_2d_texel_rgba_dxt1 doesn't correctly handle pitch */
-            pfetch_2d_texel_rgba_dxt1(0, src + (y / 4) * pitch_in + (x / 4) * 16,
-                                      x & 3, y & 3, &color);
-            if (alpha)
-            {
-                dst_line[x] = ((color & 0x80000000) >> 16) | ((color & 0xf80000) >> 19) |
-                              ((color & 0xf800) >> 6) | ((color & 0xf8) << 7);
-            }
-            else
+            switch (format)
             {
-                dst_line[x] = 0x8000 | ((color & 0xf80000) >> 19) |
-                              ((color & 0xf800) >> 6) | ((color & 0xf8) << 7);
+                case WINED3DFMT_B8G8R8A8_UNORM:
+                    texels[y * 4 + x] = ((const DWORD *)line)[min(x, w - 1)];
+                    break;
+                case WINED3DFMT_B8G8R8X8_UNORM:
+                    texels[y * 4 + x] = ((const DWORD *)line)[min(x, w - 1)] | 0xff000000;
+                    break;
+                case WINED3DFMT_B5G5R5A1_UNORM:
+                case WINED3DFMT_B5G5R5X1_UNORM:
+                    color = ((const WORD *)line)[min(x, w - 1)];
+                    if (format == WINED3DFMT_B5G5R5X1_UNORM)
+                        color |= 0x8000;
+                    texels[y * 4 + x] = ((color & 0x8000) ? 0xff000000 : 0)
+                            | convert_5to8[(color & 0x7c00) >> 10] << 16
+                            | convert_5to8[(color & 0x03e0) >> 5] << 8
+                            | convert_5to8[color & 0x001f];
+                    break;
+                default:
+                    texels[y * 4 + x] = 0;
+                    break;
             }
         }
     }
+}
 
-    return TRUE;
+/* Computes the per-channel bounding box of a block. */
+static void bcn_color_bounds(const DWORD *texels, DWORD *min_color, DWORD *max_color)
+{
+#ifdef __SSE2__
+    __m128i v0 = _mm_loadu_si128((const __m128i *)&texels[0]);
+    __m128i v1 = _mm_loadu_si128((const __m128i *)&texels[4]);
+    __m128i v2 = _mm_loadu_si128((const __m128i *)&texels[8]);
+    __m128i v3 = _mm_loadu_si128((const __m128i *)&texels[12]);
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(v0, v1), _mm_min_epu8(v2, v3));
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(v0, v1), _mm_max_epu8(v2, v3));
+
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    *min_color = _mm_cvtsi128_si32(lo);
+    *max_color = _mm_cvtsi128_si32(hi);
+#else
+    unsigned int i, c, shift;
+    DWORD lo = 0, hi = 0;
+
+    for (shift = 0; shift < 32; shift += 8)
+    {
+        unsigned int min_value = 0xff, max_value = 0;
+
+        for (i = 0; i < 16; ++i)
+        {
+            c = (texels[i] >> shift) & 0xff;
+            min_value = min(min_value, c);
+            max_value = max(max_value, c);
+        }
+        lo |= min_value << shift;
+        hi |= max_value << shift;
+    }
+    *min_color = lo;
+    *max_color = hi;
+#endif
 }
 
-static inline BOOL dxt3_to_x8r8g8b8(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, BOOL alpha)
+/* Computes the dot products of (texel - base) with "dir" for each texel of a block. */
+static void bcn_color_dots(const DWORD *texels, DWORD base, const int *dir, int *dots)
 {
-    unsigned int x, y;
-    DWORD color;
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i basev = _mm_unpacklo_epi8(_mm_set1_epi32(base), zero);
+    __m128i dirv = _mm_setr_epi16(dir[0], dir[1], dir[2], 0, dir[0], dir[1], dir[2], 0);
+    __m128i v, lo, hi;
+    unsigned int i;
+
+    for (i = 0; i < 16; i += 4)
+    {
+        v = _mm_loadu_si128((const __m128i *)&texels[i]);
+        lo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), basev), dirv);
+        hi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), basev), dirv);
+        v = _mm_add_epi32(
+                _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1))));
+        _mm_storeu_si128((__m128i *)&dots[i], v);
+    }
+#else
+    unsigned int i;
 
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
+    for (i = 0; i < 16; ++i)
+    {
+        dots[i] = ((int)(texels[i] & 0xff) - (int)(base & 0xff)) * dir[0]
+                + ((int)((texels[i] >> 8) & 0xff) - (int)((base >> 8) & 0xff)) * dir[1]
+                + ((int)((texels[i] >> 16) & 0xff) - (int)((base >> 16) & 0xff)) * dir[2];
+    }
+#endif
+}
 
-    for (y = 0; y < h; ++y)
+static void encode_color_block(const DWORD *texels, BOOL allow_transparent, BYTE *dst)
+{
+    static const BYTE map4[] = {1, 3, 2, 0};
+    static const BYTE map3[] = {1, 2, 0};
+    DWORD opaque[16], palette[4], min_color, max_color, indices = 0;
+    unsigned int i, t, shift, transparent = 0;
+    int dir[3], dots[16], dd;
+    WORD c0, c1, tmp;
+    BOOL three_color;
+
+    /* Transparent texels don't contribute to the colour endpoints. */
+    for (i = 0; i < 16; ++i)
     {
-        DWORD *dst_line = (DWORD *)(dst + y * pitch_out);
-        for (x = 0; x < w; ++x)
+        if (allow_transparent && texels[i] < 0x80000000)
+            transparent |= 1u << i;
+    }
+    if (transparent == 0xffff)
+    {
+        memset(dst, 0, 4);
+        memset(dst + 4, 0xff, 4);
+        return;
+    }
+    for (i = 0; i < 16; ++i)
+        opaque[i] = texels[i];
+    if (transparent)
+    {
+        for (t = 0; transparent & (1u << t); ++t);
+        for (i = 0; i < 16; ++i)
         {
-            /* pfetch_2d_texel_rgba_dxt3 doesn't correctly handle pitch */
-            pfetch_2d_texel_rgba_dxt3(0, src + (y / 4) * pitch_in + (x / 4) * 16,
-                                      x & 3, y & 3, &color);
-            if (alpha)
-            {
-                dst_line[x] = (color & 0xff00ff00) | ((color & 0xff) << 16) |
-                              ((color & 0xff0000) >> 16);
-            }
-            else
-            {
-                dst_line[x] = 0xff000000 | ((color & 0xff) << 16) |
-                              (color & 0xff00) | ((color & 0xff0000) >> 16);
-            }
+            if (transparent & (1u << i))
+                opaque[i] = texels[t];
         }
     }
 
-    return TRUE;
-}
+    /* Inset the bounding box slightly to reduce the error for the texels in between. */
+    bcn_color_bounds(opaque, &min_color, &max_color);
+    for (shift = 0; shift < 24; shift += 8)
+    {
+        unsigned int lo = (min_color >> shift) & 0xff, hi = (max_color >> shift) & 0xff;
+        unsigned int inset = (hi - lo) >> 4;
 
-static inline BOOL dxt3_to_x4r4g4b4(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, BOOL alpha)
-{
-    unsigned int x, y;
-    DWORD color;
+        min_color = (min_color & ~(0xffu << shift)) | (lo + inset) << shift;
+        max_color = (max_color & ~(0xffu << shift)) | (hi - inset) << shift;
+    }
+    c0 = argb_to_rgb565(max_color);
+    c1 = argb_to_rgb565(min_color);
 
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
+    /* c0 > c1 selects the four colour mode, c0 <= c1 the three colour mode
+     * with transparent black. */
+    three_color = !!transparent;
+    if (three_color ? c0 > c1 : c0 < c1)
+    {
+        tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+    }
 
-    for (y = 0; y < h; ++y)
+    if (c0 != c1)
     {
-        WORD *dst_line = (WORD *)(dst + y * pitch_out);
-        for (x = 0; x < w; ++x)
+        bcn_color_palette(c0, c1, allow_transparent, palette);
+        dir[0] = (int)(palette[0] & 0xff) - (int)(palette[1] & 0xff);
+        dir[1] = (int)((palette[0] >> 8) & 0xff) - (int)((palette[1] >> 8) & 0xff);
+        dir[2] = (int)((palette[0] >> 16) & 0xff) - (int)((palette[1] >> 16) & 0xff);
+        dd = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+        bcn_color_dots(opaque, palette[1], dir, dots);
+
+        for (i = 0; i < 16; ++i)
         {
-            /* pfetch_2d_texel_rgba_dxt3 doesn't correctly handle pitch */
-            pfetch_2d_texel_rgba_dxt3(0, src + (y / 4) * pitch_in + (x / 4) * 16,
-                                      x & 3, y & 3, &color);
-            if (alpha)
-            {
-                dst_line[x] = ((color & 0xf0000000) >> 16) | ((color & 0xf00000) >> 20) |
-                              ((color & 0xf000) >> 8) | ((color & 0xf0) << 4);
-            }
+            if (transparent & (1u << i))
+                t = 3;
+            else if (dots[i] <= 0)
+                t = 1;
+            else if (three_color)
+                t = map3[min((2 * dots[i] + dd / 2) / dd, 2)];
             else
-            {
-                dst_line[x] = 0xf000  | ((color & 0xf00000) >> 20) |
-                              ((color & 0xf000) >> 8) | ((color & 0xf0) << 4);
-            }
+                t = map4[min((3 * dots[i] + dd / 2) / dd, 3)];
+            indices |= t << (2 * i);
+        }
+    }
+    else
+    {
+        for (i = 0; i < 16; ++i)
+        {
+            if (transparent & (1u << i))
+                indices |= 3u << (2 * i);
         }
     }
 
-    return TRUE;
+    dst[0] = c0 & 0xff;
+    dst[1] = c0 >> 8;
+    dst[2] = c1 & 0xff;
+    dst[3] = c1 >> 8;
+    dst[4] = indices & 0xff;
+    dst[5] = (indices >> 8) & 0xff;
+    dst[6] = (indices >> 16) & 0xff;
+    dst[7] = indices >> 24;
 }
 
-static inline BOOL dxt5_to_x8r8g8b8(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, BOOL alpha)
+static void encode_alpha_block(const BYTE *values, BYTE *dst)
 {
-    unsigned int x, y;
-    DWORD color;
+    unsigned int i, t, range, lo = 0xff, hi = 0;
+    ULONG64 indices = 0;
 
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
+    for (i = 0; i < 16; ++i)
+    {
+        lo = min(lo, values[i]);
+        hi = max(hi, values[i]);
+    }
 
-    for (y = 0; y < h; ++y)
+    /* Eight value mode, index 0 is the maximum and index 1 the minimum. */
+    if ((range = hi - lo))
     {
-        DWORD *dst_line = (DWORD *)(dst + y * pitch_out);
-        for (x = 0; x < w; ++x)
+        for (i = 0; i < 16; ++i)
         {
-            /* pfetch_2d_texel_rgba_dxt5 doesn't correctly handle pitch */
-            pfetch_2d_texel_rgba_dxt5(0, src + (y / 4) * pitch_in + (x / 4) * 16,
-                                      x & 3, y & 3, &color);
-            if (alpha)
-            {
-                dst_line[x] = (color & 0xff00ff00) | ((color & 0xff) << 16) |
-                              ((color & 0xff0000) >> 16);
-            }
-            else
-            {
-                dst_line[x] = 0xff000000 | ((color & 0xff) << 16) |
-                              (color & 0xff00) | ((color & 0xff0000) >> 16);
-            }
+            t = ((values[i] - lo) * 7 + range / 2) / range;
+            indices |= (ULONG64)(t == 7 ? 0 : t ? 8 - t : 1) << (3 * i);
         }
     }
 
-    return TRUE;
+    dst[0] = hi;
+    dst[1] = lo;
+    for (i = 0; i < 6; ++i)
+        dst[i + 2] = (indices >> (8 * i)) & 0xff;
 }
 
-static inline BOOL x8r8g8b8_to_dxtn(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, GLenum destformat, BOOL alpha)
+static void encode_block(enum bcn_type type, const DWORD *texels, BOOL alpha, BYTE *dst)
 {
-    unsigned int x, y;
-    DWORD color, *tmp;
+    BYTE values[16];
+    unsigned int i;
 
-    TRACE("Converting %ux%u pixels, pitches %u %u\n", w, h, pitch_in, pitch_out);
-
-    tmp = HeapAlloc(GetProcessHeap(), 0, h * w * sizeof(DWORD));
-    if (!tmp)
+    switch (type)
     {
-        ERR("Failed to allocate memory for conversion\n");
-        return FALSE;
+        case BCN_DXT1:
+            encode_color_block(texels, alpha, dst);
+            break;
+
+        case BCN_DXT3:
+            memset(dst, 0, 8);
+            for (i = 0; i < 16; ++i)
+                dst[i / 2] |= (((texels[i] >> 24) * 15 + 127) / 255) << (4 * (i & 1));
+            encode_color_block(texels, FALSE, dst + 8);
+            break;
+
+        case BCN_DXT5:
+            for (i = 0; i < 16; ++i)
+                values[i] = texels[i] >> 24;
+            encode_alpha_block(values, dst);
+            encode_color_block(texels, FALSE, dst + 8);
+            break;
+
+        case BCN_BC4:
+        case BCN_BC5:
+            for (i = 0; i < 16; ++i)
+                values[i] = texels[i] >> 16;
+            encode_alpha_block(values, dst);
+            if (type == BCN_BC4)
+                break;
+            for (i = 0; i < 16; ++i)
+                values[i] = texels[i] >> 8;
+            encode_alpha_block(values, dst + 8);
+            break;
     }
+}
 
-    for (y = 0; y < h; ++y)
+static void bcn_process_rows(const struct bcn_job *job, unsigned int first, unsigned int last)
+{
+    unsigned int bpp = job->format == WINED3DFMT_B8G8R8A8_UNORM || job->format == WINED3DFMT_B8G8R8X8_UNORM ? 4 : 2;
+    unsigned int block_size = bcn_block_size[job->type];
+    BOOL alpha = job->format == WINED3DFMT_B8G8R8A8_UNORM || job->format == WINED3DFMT_B5G5R5A1_UNORM;
+    unsigned int x, y;
+    DWORD texels[16];
+
+    for (y = first; y < last; ++y)
     {
-        const DWORD *src_line = (const DWORD *)(src + y * pitch_in);
-        DWORD *dst_line = tmp + y * w;
-        for (x = 0; x < w; ++x)
+        unsigned int h = min(job->h - y * 4, 4);
+
+        for (x = 0; x < (job->w + 3) / 4; ++x)
         {
-            color = src_line[x];
-            if (alpha)
+            unsigned int w = min(job->w - x * 4, 4);
+
+            if (job->encode)
             {
-                dst_line[x] = (color & 0xff00ff00) | ((color & 0xff) << 16) |
-                              ((color & 0xff0000) >> 16);
+                load_texels(job->src + y * 4 * job->pitch_in + x * 4 * bpp, job->pitch_in, job->format, w, h, texels);
+                encode_block(job->type, texels, alpha, job->dst + y * job->pitch_out + x * block_size);
             }
             else
             {
-                dst_line[x] = 0xff000000 | ((color & 0xff) << 16) |
-                              (color & 0xff00) | ((color & 0xff0000) >> 16);
+                decode_block(job->type, job->src + y * job->pitch_in + x * block_size, texels);
+                store_texels(texels, job->dst + y * 4 * job->pitch_out + x * 4 * bpp, job->pitch_out, job->format, w, h);
             }
         }
     }
+}
 
-    ptx_compress_dxtn(4, w, h, (BYTE *)tmp, destformat, dst, pitch_out);
-    HeapFree(GetProcessHeap(), 0, tmp);
-    return TRUE;
+static void bcn_run_slices(struct bcn_job *job)
+{
+    unsigned int slice, rows = (job->h + 3) / 4;
+
+    while ((slice = InterlockedIncrement(&job->next_slice) - 1) < job->slice_count)
+        bcn_process_rows(job, slice * BCN_SLICE_ROWS, min((slice + 1) * BCN_SLICE_ROWS, rows));
 }
 
-static inline BOOL x1r5g5b5_to_dxtn(const BYTE *src, BYTE *dst, DWORD pitch_in,
-        DWORD pitch_out, unsigned int w, unsigned int h, GLenum destformat, BOOL alpha)
+static DWORD WINAPI bcn_worker(void *ctx)
 {
-    static const unsigned char convert_5to8[] =
-    {
-        0x00, 0x08, 0x10, 0x19, 0x21, 0x29, 0x31, 0x3a,
-        0x42, 0x4a, 0x52, 0x5a, 0x63, 0x6b, 0x73, 0x7b,
-        0x84, 0x8c, 0x94, 0x9c, 0xa5, 0xad, 0xb5, 0xbd,
-        0xc5, 0xce, 0xd6, 0xde, 0xe6, 0xef, 0xf7, 0xff,
-    };
-    unsigned int x, y;
-    DWORD *tmp;
-    WORD color;
+    struct bcn_job *job = ctx;
+
+    bcn_run_slices(job);
+    if (!InterlockedDecrement(&job->pending))
+        SetEvent(job->done);
+    return 0;
+}
+
+static BOOL bcn_convert(enum bcn_type type, BOOL encode, const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, enum wined3d_format_id format, unsigned int w, unsigned int h)
+{
+    unsigned int rows = (h + 3) / 4, workers = 0, i;
+    struct bcn_job job;
+    SYSTEM_INFO info;
 
     TRACE("Converting %ux%u pixels, pitches %u %u.\n", w, h, pitch_in, pitch_out);
 
-    tmp = HeapAlloc(GetProcessHeap(), 0, h * w * sizeof(DWORD));
-    if (!tmp)
+    if (!w || !h)
+        return TRUE;
+
+    job.type = type;
+    job.encode = encode;
+    job.src = src;
+    job.dst = dst;
+    job.pitch_in = pitch_in;
+    job.pitch_out = pitch_out;
+    job.format = format;
+    job.w = w;
+    job.h = h;
+    job.slice_count = (rows + BCN_SLICE_ROWS - 1) / BCN_SLICE_ROWS;
+    job.next_slice = 0;
+    job.done = NULL;
+
+    if (rows * ((w + 3) / 4) >= BCN_PARALLEL_MIN_BLOCKS)
     {
-        ERR("Failed to allocate memory for conversion\n");
-        return FALSE;
+        GetSystemInfo(&info);
+        workers = min(min(info.dwNumberOfProcessors, job.slice_count) - 1, BCN_MAX_WORKERS);
+        if (workers && !(job.done = CreateEventW(NULL, FALSE, FALSE, NULL)))
+            workers = 0;
     }
 
-    for (y = 0; y < h; ++y)
+    /* The calling thread counts as one of the workers. */
+    job.pending = workers + 1;
+    for (i = 0; i < workers; ++i)
     {
-        const WORD *src_line = (const WORD *)(src + y * pitch_in);
-        DWORD *dst_line = tmp + y * w;
-        for (x = 0; x < w; ++x)
-        {
-            color = src_line[x];
-            if (alpha)
-            {
-                dst_line[x] = ((color & 0x8000) ? 0xff000000 : 0) |
-                              convert_5to8[(color & 0x001f)] << 16 |
-                              convert_5to8[(color & 0x03e0) >> 5] << 8 |
-                              convert_5to8[(color & 0x7c00) >> 10];
-            }
-            else
-            {
-                dst_line[x] = 0xff000000 |
-                              convert_5to8[(color & 0x001f)] << 16 |
-                              convert_5to8[(color & 0x03e0) >> 5] << 8 |
-                              convert_5to8[(color & 0x7c00) >> 10];
-            }
-        }
+        if (!QueueUserWorkItem(bcn_worker, &job, WT_EXECUTEDEFAULT))
+            InterlockedDecrement(&job.pending);
     }
 
-    ptx_compress_dxtn(4, w, h, (BYTE *)tmp, destformat, dst, pitch_out);
-    HeapFree(GetProcessHeap(), 0, tmp);
+    bcn_run_slices(&job);
+    if (InterlockedDecrement(&job.pending))
+        WaitForSingleObject(job.done, INFINITE);
+    if (job.done)
+        CloseHandle(job.done);
+
     return TRUE;
 }
 
-BOOL wined3d_dxt1_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+static BOOL bcn_decode(enum bcn_type type, const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
         enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    if (!txc_dxtn_handle)
-        return FALSE;
+    static const char *names[] = {"DXT1", "DXT3", "DXT5", "BC4", "BC5"};
 
     switch (format)
     {
         case WINED3DFMT_B8G8R8A8_UNORM:
-            return dxt1_to_x8r8g8b8(src, dst, pitch_in, pitch_out, w, h, TRUE);
         case WINED3DFMT_B8G8R8X8_UNORM:
-            return dxt1_to_x8r8g8b8(src, dst, pitch_in, pitch_out, w, h, FALSE);
         case WINED3DFMT_B4G4R4A4_UNORM:
-            return dxt1_to_x4r4g4b4(src, dst, pitch_in, pitch_out, w, h, TRUE);
         case WINED3DFMT_B4G4R4X4_UNORM:
-            return dxt1_to_x4r4g4b4(src, dst, pitch_in, pitch_out, w, h, FALSE);
         case WINED3DFMT_B5G5R5A1_UNORM:
-            return dxt1_to_x1r5g5b5(src, dst, pitch_in, pitch_out, w, h, TRUE);
         case WINED3DFMT_B5G5R5X1_UNORM:
-            return dxt1_to_x1r5g5b5(src, dst, pitch_in, pitch_out, w, h, FALSE);
+            return bcn_convert(type, FALSE, src, dst, pitch_in, pitch_out, format, w, h);
         default:
             break;
     }
 
-    FIXME("Cannot find a conversion function from format DXT1 to %s.\n", debug_d3dformat(format));
+    FIXME("Cannot find a conversion function from format %s to %s.\n", names[type], debug_d3dformat(format));
     return FALSE;
 }
 
-BOOL wined3d_dxt3_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+static BOOL bcn_encode(enum bcn_type type, const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
         enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    if (!txc_dxtn_handle)
-        return FALSE;
+    static const char *names[] = {"DXT1", "DXT3", "DXT5", "BC4", "BC5"};
 
     switch (format)
     {
         case WINED3DFMT_B8G8R8A8_UNORM:
-            return dxt3_to_x8r8g8b8(src, dst, pitch_in, pitch_out, w, h, TRUE);
         case WINED3DFMT_B8G8R8X8_UNORM:
-            return dxt3_to_x8r8g8b8(src, dst, pitch_in, pitch_out, w, h, FALSE);
-        case WINED3DFMT_B4G4R4A4_UNORM:
-            return dxt3_to_x4r4g4b4(src, dst, pitch_in, pitch_out, w, h, TRUE);
-        case WINED3DFMT_B4G4R4X4_UNORM:
-            return dxt3_to_x4r4g4b4(src, dst, pitch_in, pitch_out, w, h, FALSE);
+        case WINED3DFMT_B5G5R5A1_UNORM:
+        case WINED3DFMT_B5G5R5X1_UNORM:
+            return bcn_convert(type, TRUE, src, dst, pitch_in, pitch_out, format, w, h);
         default:
             break;
     }
 
-    FIXME("Cannot find a conversion function from format DXT3 to %s.\n", debug_d3dformat(format));
+    FIXME("Cannot find a conversion function from format %s to %s.\n", debug_d3dformat(format), names[type]);
     return FALSE;
 }
 
-BOOL wined3d_dxt5_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+BOOL wined3d_dxt1_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
         enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    if (!txc_dxtn_handle)
-        return FALSE;
+    return bcn_decode(BCN_DXT1, src, dst, pitch_in, pitch_out, format, w, h);
+}
 
-    switch (format)
-    {
-        case WINED3DFMT_B8G8R8A8_UNORM:
-            return dxt5_to_x8r8g8b8(src, dst, pitch_in, pitch_out, w, h, TRUE);
-        case WINED3DFMT_B8G8R8X8_UNORM:
-            return dxt5_to_x8r8g8b8(src, dst, pitch_in, pitch_out, w, h, FALSE);
-        default:
-            break;
-    }
+BOOL wined3d_dxt3_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
+{
+    return bcn_decode(BCN_DXT3, src, dst, pitch_in, pitch_out, format, w, h);
+}
 
-    FIXME("Cannot find a conversion function from format DXT5 to %s.\n", debug_d3dformat(format));
-    return FALSE;
+BOOL wined3d_dxt5_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
+{
+    return bcn_decode(BCN_DXT5, src, dst, pitch_in, pitch_out, format, w, h);
 }
 
-BOOL wined3d_dxt1_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+BOOL wined3d_bc4_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
         enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    if (!txc_dxtn_handle)
-        return FALSE;
+    return bcn_decode(BCN_BC4, src, dst, pitch_in, pitch_out, format, w, h);
+}
 
-    switch (format)
-    {
-        case WINED3DFMT_B8G8R8A8_UNORM:
-            return x8r8g8b8_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, TRUE);
-        case WINED3DFMT_B8G8R8X8_UNORM:
-            return x8r8g8b8_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGB_S3TC_DXT1_EXT, FALSE);
-        case WINED3DFMT_B5G5R5A1_UNORM:
-            return x1r5g5b5_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, TRUE);
-        case WINED3DFMT_B5G5R5X1_UNORM:
-            return x1r5g5b5_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGB_S3TC_DXT1_EXT, FALSE);
-        default:
-            break;
-    }
+BOOL wined3d_bc5_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
+{
+    return bcn_decode(BCN_BC5, src, dst, pitch_in, pitch_out, format, w, h);
+}
 
-    FIXME("Cannot find a conversion function from format %s to DXT1.\n", debug_d3dformat(format));
-    return FALSE;
+BOOL wined3d_dxt1_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
+{
+    return bcn_encode(BCN_DXT1, src, dst, pitch_in, pitch_out, format, w, h);
 }
 
 BOOL wined3d_dxt3_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
         enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    if (!txc_dxtn_handle)
-        return FALSE;
-
-    switch (format)
-    {
-        case WINED3DFMT_B8G8R8A8_UNORM:
-            return x8r8g8b8_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, TRUE);
-        case WINED3DFMT_B8G8R8X8_UNORM:
-            return x8r8g8b8_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, FALSE);
-        default:
-            break;
-    }
-
-    FIXME("Cannot find a conversion function from format %s to DXT3.\n", debug_d3dformat(format));
-    return FALSE;
+    return bcn_encode(BCN_DXT3, src, dst, pitch_in, pitch_out, format, w, h);
 }
 
 BOOL wined3d_dxt5_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
         enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    if (!txc_dxtn_handle)
-        return FALSE;
-
-    switch (format)
-    {
-        case WINED3DFMT_B8G8R8A8_UNORM:
-            return x8r8g8b8_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, TRUE);
-        case WINED3DFMT_B8G8R8X8_UNORM:
-            return x8r8g8b8_to_dxtn(src, dst, pitch_in, pitch_out, w, h,
-                                    GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, FALSE);
-        default:
-            break;
-    }
-
-    FIXME("Cannot find a conversion function from format %s to DXT5.\n", debug_d3dformat(format));
-    return FALSE;
+    return bcn_encode(BCN_DXT5, src, dst, pitch_in, pitch_out, format, w, h);
 }
 
-BOOL wined3d_dxtn_init(void)
+BOOL wined3d_bc4_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    static const char *soname[] =
-    {
-#ifdef SONAME_LIBTXC_DXTN
-        SONAME_LIBTXC_DXTN,
-#endif
-#ifdef __APPLE__
-        "libtxc_dxtn.dylib",
-        "libtxc_dxtn_s2tc.dylib",
-#endif
-        "libtxc_dxtn.so",
-        "libtxc_dxtn_s2tc.so.0"
-    };
-    int i;
-
-    for (i = 0; i < sizeof(soname)/sizeof(soname[0]); i++)
-    {
-        txc_dxtn_handle = wine_dlopen(soname[i], RTLD_NOW, NULL, 0);
-        if (txc_dxtn_handle) break;
-    }
-
-    if (!txc_dxtn_handle)
-    {
-        FIXME("Wine cannot find the txc_dxtn library, DXTn software support unavailable.\n");
-        return FALSE;
-    }
-
-    #define LOAD_FUNCPTR(f) \
-        if (!(p##f = wine_dlsym(txc_dxtn_handle, #f, NULL, 0))) \
-        { \
-            ERR("Can't find symbol %s , DXTn software support unavailable.\n", #f); \
-            goto error; \
-        }
-
-    LOAD_FUNCPTR(fetch_2d_texel_rgba_dxt1);
-    LOAD_FUNCPTR(fetch_2d_texel_rgba_dxt3);
-    LOAD_FUNCPTR(fetch_2d_texel_rgba_dxt5);
-    LOAD_FUNCPTR(tx_compress_dxtn);
-
-    #undef LOAD_FUNCPTR
-    return TRUE;
-
-error:
-    wine_dlclose(txc_dxtn_handle, NULL, 0);
-    txc_dxtn_handle = NULL;
-    return FALSE;
+    return bcn_encode(BCN_BC4, src, dst, pitch_in, pitch_out, format, w, h);
 }
 
-BOOL wined3d_dxtn_supported(void)
+BOOL wined3d_bc5_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h)
 {
-    return (txc_dxtn_handle != NULL);
+    return bcn_encode(BCN_BC5, src, dst, pitch_in, pitch_out, format, w, h);
 }
 
-void wined3d_dxtn_free(void)
+BOOL wined3d_dxtn_supported(void)
 {
-    if (txc_dxtn_handle)
-        wine_dlclose(txc_dxtn_handle, NULL, 0);
+    return TRUE;
 }
@@ -42,6 +42,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
 WINE_DECLARE_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 #define WINED3D_GLSL_SAMPLE_PROJECTED   0x01
@@ -115,6 +116,21 @@ struct constant_heap
 };
 
 /* GLSL shader private data */
+struct glsl_binary_cache
+{
+    BOOL initialised;
+    BOOL enabled;
+    ULONG64 driver_key;
+
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int stores;
+    unsigned int rejects;
+    ULONG64 load_time;
+    ULONG64 link_time;
+    LARGE_INTEGER frequency;
+};
+
 struct shader_glsl_priv
 {
     struct wined3d_string_buffer shader_buffer;
@@ -131,6 +147,8 @@ struct shader_glsl_priv
     struct wine_rb_tree ffp_fragment_shaders;
     BOOL ffp_proj_control;
     BOOL legacy_lighting;
+
+    struct glsl_binary_cache binary_cache;
 };
 
 struct glsl_vs_program
@@ -585,6 +603,440 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+/* Linked programs are cached on disk in the ShaderCachePath directory, one
+ * file per program. Files are keyed by a hash of the wined3d version, the
+ * GL driver strings, the sources of the attached shaders and the state set
+ * on the program before linking. They are written from a worker thread,
+ * and the least recently used ones are evicted when the cache grows past
+ * ShaderCacheSize. */
+#define GLSL_BINARY_CACHE_MAGIC     0x42503357u /* "W3PB" */
+#define GLSL_BINARY_CACHE_VERSION   1u
+#define GLSL_BINARY_CACHE_HASH_SEED (((ULONG64)0xcbf29ce4 << 32) | 0x84222325)
+#define GLSL_BINARY_CACHE_HASH_MUL  (((ULONG64)0x00000100 << 32) | 0x000001b3)
+
+struct glsl_binary_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    ULONG64 key;
+    DWORD format;
+    DWORD size;
+    DWORD checksum;
+    DWORD padding;
+};
+
+struct glsl_binary_cache_write
+{
+    char path[MAX_PATH];
+    DWORD size;
+    BYTE data[1];
+};
+
+struct glsl_binary_cache_file
+{
+    char name[MAX_PATH];
+    ULONG64 size;
+    FILETIME time;
+};
+
+/* Number of queued cache writes and evictions, protected by glsl_binary_cache_cs. */
+static unsigned int glsl_binary_cache_pending;
+static CONDITION_VARIABLE glsl_binary_cache_idle = CONDITION_VARIABLE_INIT;
+
+static CRITICAL_SECTION glsl_binary_cache_cs;
+static CRITICAL_SECTION_DEBUG glsl_binary_cache_cs_debug =
+{
+    0, 0, &glsl_binary_cache_cs,
+    {&glsl_binary_cache_cs_debug.ProcessLocksList,
+    &glsl_binary_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": glsl_binary_cache_cs")}
+};
+static CRITICAL_SECTION glsl_binary_cache_cs = {&glsl_binary_cache_cs_debug, -1, 0, 0, 0, 0};
+
+static BOOL glsl_binary_cache_queue(LPTHREAD_START_ROUTINE func, void *ctx)
+{
+    BOOL ret;
+
+    EnterCriticalSection(&glsl_binary_cache_cs);
+    if ((ret = QueueUserWorkItem(func, ctx, WT_EXECUTEDEFAULT)))
+        ++glsl_binary_cache_pending;
+    LeaveCriticalSection(&glsl_binary_cache_cs);
+    return ret;
+}
+
+static void glsl_binary_cache_complete(void)
+{
+    EnterCriticalSection(&glsl_binary_cache_cs);
+    if (!--glsl_binary_cache_pending)
+        WakeAllConditionVariable(&glsl_binary_cache_idle);
+    LeaveCriticalSection(&glsl_binary_cache_cs);
+}
+
+static ULONG64 glsl_binary_cache_hash(ULONG64 hash, const void *data, SIZE_T size)
+{
+    const BYTE *p = data;
+
+    while (size--)
+        hash = (hash ^ *p++) * GLSL_BINARY_CACHE_HASH_MUL;
+    return hash;
+}
+
+static DWORD glsl_binary_cache_checksum(const BYTE *data, DWORD size)
+{
+    DWORD checksum = 0x811c9dc5;
+
+    while (size--)
+        checksum = (checksum ^ *data++) * 0x01000193;
+    return checksum;
+}
+
+static BOOL glsl_binary_cache_get_path(char *path, ULONG64 key)
+{
+    int len = snprintf(path, MAX_PATH, "%s\\%08x%08x.bin", wined3d_settings.shader_cache_path,
+            (unsigned int)(key >> 32), (unsigned int)key);
+
+    return len > 0 && len < MAX_PATH;
+}
+
+static int glsl_binary_cache_file_compare(const void *a, const void *b)
+{
+    const struct glsl_binary_cache_file *f1 = a, *f2 = b;
+
+    return CompareFileTime(&f1->time, &f2->time);
+}
+
+static DWORD WINAPI glsl_binary_cache_evict(void *ctx)
+{
+    ULONG64 total = 0, limit = (ULONG64)wined3d_settings.shader_cache_size << 20;
+    struct glsl_binary_cache_file *files = NULL;
+    SIZE_T count = 0, capacity = 0, i;
+    char path[MAX_PATH];
+    WIN32_FIND_DATAA data;
+    HANDLE find;
+
+    snprintf(path, sizeof(path), "%s\\*.bin", wined3d_settings.shader_cache_path);
+    if ((find = FindFirstFileA(path, &data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            if (!wined3d_array_reserve((void **)&files, &capacity, count + 1, sizeof(*files)))
+                break;
+            snprintf(files[count].name, sizeof(files[count].name), "%s\\%s",
+                    wined3d_settings.shader_cache_path, data.cFileName);
+            files[count].size = ((ULONG64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+            files[count].time = data.ftLastWriteTime;
+            total += files[count++].size;
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+
+    if (total > limit)
+    {
+        TRACE("Shader cache size %s exceeds the limit, evicting.\n", wine_dbgstr_longlong(total));
+        qsort(files, count, sizeof(*files), glsl_binary_cache_file_compare);
+        for (i = 0; i < count && total > limit / 4 * 3; ++i)
+        {
+            if (DeleteFileA(files[i].name))
+                total -= files[i].size;
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, files);
+    glsl_binary_cache_complete();
+    return 0;
+}
+
+static DWORD WINAPI glsl_binary_cache_write(void *ctx)
+{
+    struct glsl_binary_cache_write *write = ctx;
+    char tmp_path[MAX_PATH + 16];
+    DWORD written;
+    HANDLE file;
+    BOOL ret;
+
+    /* Write to a temporary file first, so that readers never see a partially written one. */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%08x", write->path, GetCurrentThreadId());
+    file = CreateFileA(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        ret = WriteFile(file, write->data, write->size, &written, NULL) && written == write->size;
+        CloseHandle(file);
+        if (!ret || !MoveFileExA(tmp_path, write->path, MOVEFILE_REPLACE_EXISTING))
+        {
+            WARN("Failed to write shader cache file %s.\n", debugstr_a(write->path));
+            DeleteFileA(tmp_path);
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, write);
+    glsl_binary_cache_complete();
+    return 0;
+}
+
+/* Context activation is done by the caller. */
+static BOOL shader_glsl_binary_cache_enabled(struct shader_glsl_priv *priv, const struct wined3d_gl_info *gl_info)
+{
+    static const char version[] = PACKAGE_VERSION;
+    static const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    struct glsl_binary_cache *cache = &priv->binary_cache;
+    const char *str;
+    unsigned int i;
+    GLint count;
+
+    if (cache->initialised)
+        return cache->enabled;
+    cache->initialised = TRUE;
+
+    if (!wined3d_settings.shader_cache_path || !gl_info->supported[ARB_GET_PROGRAM_BINARY])
+        return FALSE;
+
+    count = 0;
+    gl_info->gl_ops.gl.p_glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    checkGLcall("glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS)");
+    if (!count)
+    {
+        TRACE("The driver doesn't support any program binary formats.\n");
+        return FALSE;
+    }
+
+    if (!CreateDirectoryA(wined3d_settings.shader_cache_path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+    {
+        WARN("Failed to create shader cache directory %s, error %u.\n",
+                debugstr_a(wined3d_settings.shader_cache_path), GetLastError());
+        return FALSE;
+    }
+
+    cache->driver_key = glsl_binary_cache_hash(GLSL_BINARY_CACHE_HASH_SEED, version, sizeof(version));
+    for (i = 0; i < ARRAY_SIZE(names); ++i)
+    {
+        if ((str = (const char *)gl_info->gl_ops.gl.p_glGetString(names[i])))
+            cache->driver_key = glsl_binary_cache_hash(cache->driver_key, str, strlen(str) + 1);
+    }
+    QueryPerformanceFrequency(&cache->frequency);
+
+    glsl_binary_cache_queue(glsl_binary_cache_evict, NULL);
+
+    return cache->enabled = TRUE;
+}
+
+static int glsl_binary_cache_hash_compare(const void *a, const void *b)
+{
+    ULONG64 h1 = *(const ULONG64 *)a, h2 = *(const ULONG64 *)b;
+
+    return h1 < h2 ? -1 : h1 > h2;
+}
+
+/* Context activation is done by the caller. */
+static ULONG64 shader_glsl_binary_cache_key(const struct wined3d_gl_info *gl_info,
+        const struct shader_glsl_priv *priv, GLuint program_id, const void *link_state, SIZE_T link_state_size)
+{
+    GLint count = 0, length, source_size = 0, type;
+    ULONG64 key = 0, *hashes = NULL;
+    GLuint *shaders = NULL;
+    char *source = NULL;
+    GLint i;
+
+    GL_EXTCALL(glGetProgramiv(program_id, GL_ATTACHED_SHADERS, &count));
+    if (count <= 0)
+        return 0;
+    if (!(shaders = wined3d_calloc(count, sizeof(*shaders))) || !(hashes = wined3d_calloc(count, sizeof(*hashes))))
+        goto done;
+    GL_EXTCALL(glGetAttachedShaders(program_id, count, NULL, shaders));
+
+    for (i = 0; i < count; ++i)
+    {
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length));
+        if (length > source_size)
+        {
+            HeapFree(GetProcessHeap(), 0, source);
+            if (!(source = HeapAlloc(GetProcessHeap(), 0, length)))
+                goto done;
+            source_size = length;
+        }
+        GL_EXTCALL(glGetShaderSource(shaders[i], source_size, &length, source));
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type));
+
+        hashes[i] = glsl_binary_cache_hash(GLSL_BINARY_CACHE_HASH_SEED, &type, sizeof(type));
+        hashes[i] = glsl_binary_cache_hash(hashes[i], source, length);
+    }
+    checkGLcall("get shader sources");
+
+    /* The order of attached shaders isn't defined. */
+    qsort(hashes, count, sizeof(*hashes), glsl_binary_cache_hash_compare);
+    key = glsl_binary_cache_hash(priv->binary_cache.driver_key, hashes, count * sizeof(*hashes));
+    key = glsl_binary_cache_hash(key, link_state, link_state_size);
+
+done:
+    HeapFree(GetProcessHeap(), 0, source);
+    HeapFree(GetProcessHeap(), 0, hashes);
+    HeapFree(GetProcessHeap(), 0, shaders);
+    return key;
+}
+
+/* Context activation is done by the caller. */
+static BOOL shader_glsl_load_program_binary(const struct wined3d_gl_info *gl_info,
+        struct shader_glsl_priv *priv, GLuint program_id, ULONG64 key)
+{
+    struct glsl_binary_cache_header header;
+    char path[MAX_PATH];
+    BYTE *data = NULL;
+    FILETIME now;
+    DWORD read;
+    BOOL ret = FALSE;
+    HANDLE file;
+    GLint status;
+
+    if (!glsl_binary_cache_get_path(path, key))
+        return FALSE;
+    file = CreateFileA(path, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    if (!ReadFile(file, &header, sizeof(header), &read, NULL) || read != sizeof(header)
+            || header.magic != GLSL_BINARY_CACHE_MAGIC || header.version != GLSL_BINARY_CACHE_VERSION
+            || header.key != key || header.size != GetFileSize(file, NULL) - sizeof(header))
+        goto done;
+    if (!(data = HeapAlloc(GetProcessHeap(), 0, header.size)))
+        goto done;
+    if (!ReadFile(file, data, header.size, &read, NULL) || read != header.size
+            || glsl_binary_cache_checksum(data, header.size) != header.checksum)
+        goto done;
+
+    GL_EXTCALL(glProgramBinary(program_id, header.format, data, header.size));
+    GL_EXTCALL(glGetProgramiv(program_id, GL_LINK_STATUS, &status));
+    checkGLcall("glProgramBinary");
+    if (!status)
+    {
+        TRACE("The driver rejected the binary for program %u.\n", program_id);
+        goto done;
+    }
+
+    /* Keep track of the last use for eviction. */
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, NULL, NULL, &now);
+    ret = TRUE;
+
+done:
+    CloseHandle(file);
+    HeapFree(GetProcessHeap(), 0, data);
+    if (!ret)
+    {
+        WARN("Discarding invalid shader cache file %s.\n", debugstr_a(path));
+        DeleteFileA(path);
+        ++priv->binary_cache.rejects;
+    }
+    return ret;
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_store_program_binary(const struct wined3d_gl_info *gl_info,
+        struct shader_glsl_priv *priv, GLuint program_id, ULONG64 key)
+{
+    struct glsl_binary_cache_header *header;
+    struct glsl_binary_cache_write *write;
+    GLint status, length = 0;
+    GLenum format;
+
+    GL_EXTCALL(glGetProgramiv(program_id, GL_LINK_STATUS, &status));
+    if (!status)
+        return;
+    GL_EXTCALL(glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0)
+        return;
+
+    if (!(write = HeapAlloc(GetProcessHeap(), 0,
+            FIELD_OFFSET(struct glsl_binary_cache_write, data[sizeof(*header) + length]))))
+        return;
+    if (!glsl_binary_cache_get_path(write->path, key))
+    {
+        HeapFree(GetProcessHeap(), 0, write);
+        return;
+    }
+
+    header = (struct glsl_binary_cache_header *)write->data;
+    GL_EXTCALL(glGetProgramBinary(program_id, length, &length, &format, header + 1));
+    checkGLcall("glGetProgramBinary");
+
+    header->magic = GLSL_BINARY_CACHE_MAGIC;
+    header->version = GLSL_BINARY_CACHE_VERSION;
+    header->key = key;
+    header->format = format;
+    header->size = length;
+    header->checksum = glsl_binary_cache_checksum((const BYTE *)(header + 1), length);
+    header->padding = 0;
+    write->size = sizeof(*header) + length;
+
+    if (!glsl_binary_cache_queue(glsl_binary_cache_write, write))
+    {
+        HeapFree(GetProcessHeap(), 0, write);
+        return;
+    }
+    ++priv->binary_cache.stores;
+}
+
+static ULONG64 shader_glsl_binary_cache_time(void)
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+/* Context activation is done by the caller. "link_state" describes the state
+ * set on the program before linking that isn't part of the shader sources;
+ * NULL means the program can't be cached. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info, struct shader_glsl_priv *priv,
+        GLuint program_id, const void *link_state, SIZE_T link_state_size)
+{
+    struct glsl_binary_cache *cache = &priv->binary_cache;
+    ULONG64 key = 0, start = 0;
+
+    if (link_state && shader_glsl_binary_cache_enabled(priv, gl_info))
+    {
+        start = shader_glsl_binary_cache_time();
+        if ((key = shader_glsl_binary_cache_key(gl_info, priv, program_id, link_state, link_state_size))
+                && shader_glsl_load_program_binary(gl_info, priv, program_id, key))
+        {
+            TRACE("Loaded GLSL shader program %u from the shader cache.\n", program_id);
+            ++cache->hits;
+            cache->load_time += shader_glsl_binary_cache_time() - start;
+            return;
+        }
+        ++cache->misses;
+        GL_EXTCALL(glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+
+    TRACE("Linking GLSL shader program %u.\n", program_id);
+    GL_EXTCALL(glLinkProgram(program_id));
+    shader_glsl_validate_link(gl_info, program_id);
+
+    if (key)
+    {
+        shader_glsl_store_program_binary(gl_info, priv, program_id, key);
+        cache->link_time += shader_glsl_binary_cache_time() - start;
+    }
+}
+
+static void shader_glsl_binary_cache_cleanup(struct shader_glsl_priv *priv)
+{
+    const struct glsl_binary_cache *cache = &priv->binary_cache;
+
+    if (cache->enabled)
+        TRACE_(d3d_perf)("Shader cache: %u hits (%.3f ms), %u misses (%.3f ms), %u stores, %u rejected.\n",
+                cache->hits, cache->load_time * 1000.0 / cache->frequency.QuadPart,
+                cache->misses, cache->link_time * 1000.0 / cache->frequency.QuadPart,
+                cache->stores, cache->rejects);
+
+    /* Don't let the DLL go away under pending writes. */
+    EnterCriticalSection(&glsl_binary_cache_cs);
+    while (glsl_binary_cache_pending)
+        SleepConditionVariableCS(&glsl_binary_cache_idle, &glsl_binary_cache_cs, INFINITE);
+    LeaveCriticalSection(&glsl_binary_cache_cs);
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -9514,6 +9966,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     const struct wined3d_gl_info *gl_info = context->gl_info;
     struct glsl_cs_compiled_shader *gl_shaders;
     struct glsl_shader_private *shader_data;
+    static const DWORD link_state = WINED3D_SHADER_TYPE_COMPUTE;
     struct glsl_shader_prog_link *entry;
     GLuint shader_id, program_id;
 
@@ -9569,9 +10022,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
 
     list_add_head(&shader->linked_programs, &entry->cs.shader_entry);
 
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, priv, program_id, &link_state, sizeof(link_state));
 
     GL_EXTCALL(glUseProgram(program_id));
     checkGLcall("glUseProgram");
@@ -9653,6 +10104,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     struct list *ps_list = NULL, *vs_list = NULL;
     WORD attribs_map;
     struct wined3d_string_buffer *tmp_name;
+    DWORD link_state[4];
 
     if (!(context->shader_update_mask & (1u << WINED3D_SHADER_TYPE_VERTEX)) && ctx_data->glsl_program)
     {
@@ -9809,6 +10261,11 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         attribs_map = (1u << WINED3D_FFP_ATTRIBS_COUNT) - 1;
     }
 
+    link_state[0] = attribs_map;
+    link_state[1] = vshader && vshader->reg_maps.shader_version.major >= 4;
+    link_state[2] = needs_legacy_glsl_syntax(gl_info);
+    link_state[3] = shader_glsl_use_explicit_attrib_location(gl_info);
+
     if (!shader_glsl_use_explicit_attrib_location(gl_info))
     {
         /* Bind vertex attributes to a corresponding index number to match
@@ -9885,10 +10342,10 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         list_add_head(ps_list, &entry->ps.shader_entry);
     }
 
-    /* Link the program */
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    /* Link the program. Stream output varyings aren't part of the cache
+     * key, so programs using them aren't cached. */
+    shader_glsl_link_program(gl_info, priv, program_id,
+            gshader && gshader->u.gs.so_desc.element_count ? NULL : link_state, sizeof(link_state));
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
@@ -10496,6 +10953,7 @@ static void shader_glsl_free(struct wined3d_device *device)
     HeapFree(GetProcessHeap(), 0, priv->stack);
     string_buffer_list_cleanup(&priv->string_buffers);
     string_buffer_free(&priv->shader_buffer);
+    shader_glsl_binary_cache_cleanup(priv);
     priv->fragment_pipe->free_private(device);
     priv->vertex_pipe->vp_free(device);
 
@@ -1335,6 +1335,30 @@ static void convert_x8r8g8b8_dxt5(const BYTE *src, BYTE *dst,
     wined3d_dxt5_encode(src, dst, pitch_in, pitch_out, WINED3DFMT_B8G8R8X8_UNORM, w, h);
 }
 
+static void convert_bc4_a8r8g8b8(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    wined3d_bc4_decode(src, dst, pitch_in, pitch_out, WINED3DFMT_B8G8R8A8_UNORM, w, h);
+}
+
+static void convert_bc5_a8r8g8b8(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    wined3d_bc5_decode(src, dst, pitch_in, pitch_out, WINED3DFMT_B8G8R8A8_UNORM, w, h);
+}
+
+static void convert_a8r8g8b8_bc4(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    wined3d_bc4_encode(src, dst, pitch_in, pitch_out, WINED3DFMT_B8G8R8A8_UNORM, w, h);
+}
+
+static void convert_a8r8g8b8_bc5(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    wined3d_bc5_encode(src, dst, pitch_in, pitch_out, WINED3DFMT_B8G8R8A8_UNORM, w, h);
+}
+
 struct d3dfmt_converter_desc
 {
     enum wined3d_format_id from, to;
@@ -1366,6 +1390,8 @@ static const struct d3dfmt_converter_desc dxtn_converters[] =
     {WINED3DFMT_DXT3,           WINED3DFMT_B4G4R4X4_UNORM,  convert_dxt3_x4r4g4b4},
     {WINED3DFMT_DXT5,           WINED3DFMT_B8G8R8A8_UNORM,  convert_dxt5_a8r8g8b8},
     {WINED3DFMT_DXT5,           WINED3DFMT_B8G8R8X8_UNORM,  convert_dxt5_x8r8g8b8},
+    {WINED3DFMT_BC4_UNORM,      WINED3DFMT_B8G8R8A8_UNORM,  convert_bc4_a8r8g8b8},
+    {WINED3DFMT_BC5_UNORM,      WINED3DFMT_B8G8R8A8_UNORM,  convert_bc5_a8r8g8b8},
 
     /* encode DXT */
     {WINED3DFMT_B8G8R8A8_UNORM, WINED3DFMT_DXT1,            convert_a8r8g8b8_dxt1},
@@ -1375,7 +1401,9 @@ static const struct d3dfmt_converter_desc dxtn_converters[] =
     {WINED3DFMT_B8G8R8A8_UNORM, WINED3DFMT_DXT3,            convert_a8r8g8b8_dxt3},
     {WINED3DFMT_B8G8R8X8_UNORM, WINED3DFMT_DXT3,            convert_x8r8g8b8_dxt3},
     {WINED3DFMT_B8G8R8A8_UNORM, WINED3DFMT_DXT5,            convert_a8r8g8b8_dxt5},
-    {WINED3DFMT_B8G8R8X8_UNORM, WINED3DFMT_DXT5,            convert_x8r8g8b8_dxt5}
+    {WINED3DFMT_B8G8R8X8_UNORM, WINED3DFMT_DXT5,            convert_x8r8g8b8_dxt5},
+    {WINED3DFMT_B8G8R8A8_UNORM, WINED3DFMT_BC4_UNORM,       convert_a8r8g8b8_bc4},
+    {WINED3DFMT_B8G8R8A8_UNORM, WINED3DFMT_BC5_UNORM,       convert_a8r8g8b8_bc5},
 };
 
 static inline const struct d3dfmt_converter_desc *find_converter(enum wined3d_format_id from,
@@ -1392,7 +1420,7 @@ static inline const struct d3dfmt_converter_desc *find_converter(enum wined3d_fo
     for (i = 0; i < (sizeof(dxtn_converters) / sizeof(*dxtn_converters)); ++i)
     {
         if (dxtn_converters[i].from == from && dxtn_converters[i].to == to)
-            return wined3d_dxtn_supported() ? &dxtn_converters[i] : NULL;
+            return &dxtn_converters[i];
     }
 
     return NULL;
@@ -94,6 +94,8 @@ struct wined3d_settings wined3d_settings =
     ~0U,            /* No PS shader model limit by default. */
     ~0u,            /* No CS shader model limit by default. */
     FALSE,          /* 3D support enabled by default. */
+    NULL,           /* No shader cache by default. */
+    256,            /* Shader cache size limit in MiB. */
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -323,13 +325,23 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Disabling 3D support.\n");
             wined3d_settings.no_3d = TRUE;
         }
+        if (!get_config_key(hkey, appkey, "ShaderCachePath", buffer, size) && *buffer)
+        {
+            size_t len = strlen(buffer) + 1;
+
+            TRACE("Using shader cache directory %s.\n", debugstr_a(buffer));
+            if (!(wined3d_settings.shader_cache_path = HeapAlloc(GetProcessHeap(), 0, len)))
+                ERR("Failed to allocate shader cache path memory.\n");
+            else
+                memcpy(wined3d_settings.shader_cache_path, buffer, len);
+        }
+        if (!get_config_key_dword(hkey, appkey, "ShaderCacheSize", &wined3d_settings.shader_cache_size))
+            TRACE("Limiting shader cache size to %u MiB.\n", wined3d_settings.shader_cache_size);
     }
 
     if (appkey) RegCloseKey( appkey );
     if (hkey) RegCloseKey( hkey );
 
-    wined3d_dxtn_init();
-
     return TRUE;
 }
 
@@ -357,13 +369,12 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     HeapFree(GetProcessHeap(), 0, wndproc_table.entries);
 
     HeapFree(GetProcessHeap(), 0, wined3d_settings.logo);
+    HeapFree(GetProcessHeap(), 0, wined3d_settings.shader_cache_path);
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
     DeleteCriticalSection(&wined3d_wndproc_cs);
     DeleteCriticalSection(&wined3d_cs);
 
-    wined3d_dxtn_free();
-
     return TRUE;
 }
 
@@ -398,6 +398,8 @@ struct wined3d_settings
     unsigned int max_sm_ps;
     unsigned int max_sm_cs;
     BOOL no_3d;
+    char *shader_cache_path;
+    unsigned int shader_cache_size;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
@@ -1829,7 +1831,8 @@ struct wined3d_context
     DWORD destroy_delayed : 1;
     DWORD transform_feedback_active : 1;
     DWORD transform_feedback_paused : 1;
-    DWORD padding : 7;
+    DWORD update_tex_unit_map : 1;
+    DWORD padding : 6;
     DWORD last_swizzle_map; /* MAX_ATTRIBS, 16 */
     DWORD shader_update_mask;
     DWORD constant_update_mask;
@@ -2901,6 +2904,14 @@ static inline BOOL isStateDirty(const struct wined3d_context *context, DWORD sta
     return context->isStateDirty[idx] & (1u << shift);
 }
 
+/* States the texture unit mapping depends on. */
+static inline BOOL state_affects_tex_unit_map(DWORD state)
+{
+    return STATE_IS_TEXTURESTAGE(state) || state == STATE_VDECL
+            || state == STATE_SHADER(WINED3D_SHADER_TYPE_VERTEX)
+            || state == STATE_SHADER(WINED3D_SHADER_TYPE_PIXEL);
+}
+
 #define WINED3D_RESOURCE_ACCESS_GPU     0x1
 #define WINED3D_RESOURCE_ACCESS_CPU     0x2
 
@@ -3385,11 +3396,14 @@ enum wined3d_push_constants
     WINED3D_PUSH_CONSTANTS_PS_I,
     WINED3D_PUSH_CONSTANTS_VS_B,
     WINED3D_PUSH_CONSTANTS_PS_B,
+    WINED3D_PUSH_CONSTANTS_COUNT,
 };
 
 #define WINED3D_CS_QUERY_POLL_INTERVAL  10u
 #define WINED3D_CS_QUEUE_SIZE           0x100000u
-#define WINED3D_CS_SPIN_COUNT           10000000u
+#define WINED3D_CS_SPIN_COUNT           100000u
+#define WINED3D_CS_SPIN_COUNT_MIN       1000u
+#define WINED3D_CS_WAIT_SPIN_COUNT      4000u
 
 struct wined3d_cs_queue
 {
@@ -3427,10 +3441,28 @@ struct wined3d_cs
     HANDLE event;
     BOOL waiting_for_event;
     LONG pending_presents;
+
+    /* Constant ranges set by the application thread, sent to the worker
+     * thread along with the next command. */
+    DWORD pending_constants_mask;
+    struct
+    {
+        unsigned int start_idx;
+        unsigned int end_idx;
+    } pending_constants[WINED3D_PUSH_CONSTANTS_COUNT];
+
+    /* Signalled by the worker thread when it completes a packet while the
+     * application thread is blocked on it. */
+    HANDLE progress_event;
+    LONG waiting_for_progress;
+    LONG progress;
+
+    struct wined3d_cs_stats *stats;
 };
 
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device) DECLSPEC_HIDDEN;
 void wined3d_cs_destroy(struct wined3d_cs *cs) DECLSPEC_HIDDEN;
+void wined3d_cs_wait_resource_idle(struct wined3d_cs *cs, struct wined3d_resource *resource) DECLSPEC_HIDDEN;
 void wined3d_cs_destroy_object(struct wined3d_cs *cs,
         void (*callback)(void *object), void *object) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_add_dirty_texture_region(struct wined3d_cs *cs,
@@ -3521,13 +3553,13 @@ static inline void wined3d_cs_push_constants(struct wined3d_cs *cs, enum wined3d
 
 static inline void wined3d_resource_wait_idle(struct wined3d_resource *resource)
 {
-    const struct wined3d_cs *cs = resource->device->cs;
+    struct wined3d_cs *cs = resource->device->cs;
 
     if (!cs->thread || cs->thread_id == GetCurrentThreadId())
         return;
 
-    while (InterlockedCompareExchange(&resource->access_count, 0, 0))
-        wined3d_pause();
+    if (InterlockedCompareExchange(&resource->access_count, 0, 0))
+        wined3d_cs_wait_resource_idle(cs, resource);
 }
 
 /* TODO: Add tests and support for FLOAT16_4 POSITIONT, D3DCOLOR position, other
@@ -4275,8 +4307,14 @@ static inline void wined3d_not_from_cs(struct wined3d_cs *cs)
     assert(cs->thread_id != GetCurrentThreadId());
 }
 
-BOOL wined3d_dxtn_init(void) DECLSPEC_HIDDEN;
-void wined3d_dxtn_free(void) DECLSPEC_HIDDEN;
+BOOL wined3d_bc4_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h) DECLSPEC_HIDDEN;
+BOOL wined3d_bc4_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h) DECLSPEC_HIDDEN;
+BOOL wined3d_bc5_decode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h) DECLSPEC_HIDDEN;
+BOOL wined3d_bc5_encode(const BYTE *src, BYTE *dst, DWORD pitch_in, DWORD pitch_out,
+        enum wined3d_format_id format, unsigned int w, unsigned int h) DECLSPEC_HIDDEN;
 
 /* The WNDCLASS-Name for the fake window which we use to retrieve the GL capabilities */
 #define WINED3D_OPENGL_WINDOW_CLASS_NAME "WineD3D_OpenGL"
@@ -133,6 +133,13 @@ static inline shmlocal_t *wine_get_shmlocal(void)
     return (shmlocal_t *)NtCurrentTeb()->Reserved5[2];
 }
 
+/* returns a pointer to the client writable part of the wineserver local shared memory block */
+static inline shmclient_t *wine_get_shmclient(void)
+{
+    char *shm = NtCurrentTeb()->Reserved5[2];
+    return shm ? (shmclient_t *)(shm + SHM_CLIENT_OFFSET) : NULL;
+}
+
 /* macros for server requests */
 
 #define SERVER_START_REQ(type) \
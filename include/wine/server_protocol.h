@@ -56,9 +56,17 @@ struct request_max_size
 
 typedef struct
 {
-    unsigned int last_input_time;
-    unsigned int foreground_wnd_epoch;
-} shmglobal_t;
+    user_handle_t   win;
+    unsigned int    msg;
+    lparam_t        wparam;
+    lparam_t        lparam;
+    int             x;
+    int             y;
+    unsigned int    time;
+    int             __pad;
+} shmmessage_t;
+
+#define SHM_POST_RING_SIZE 64
 
 
 typedef struct
@@ -67,9 +75,21 @@ typedef struct
     user_handle_t   input_focus;
     user_handle_t   input_capture;
     user_handle_t   input_active;
+    unsigned int    post_head;
+    int             __pad[3];
+    shmmessage_t    post_ring[SHM_POST_RING_SIZE];
 } shmlocal_t;
 
 
+typedef struct
+{
+    unsigned int    get_msg_count;
+    unsigned int    post_tail;
+} shmclient_t;
+
+#define SHM_CLIENT_OFFSET 0x1000
+
+
 typedef union
 {
     int code;
@@ -263,6 +283,50 @@ typedef struct
 } rectangle_t;
 
 
+typedef struct
+{
+    unsigned int    seq;
+    user_handle_t   handle;
+    user_handle_t   parent;
+    user_handle_t   owner;
+    thread_id_t     tid;
+    process_id_t    pid;
+    unsigned int    style;
+    unsigned int    ex_style;
+    rectangle_t     window;
+    rectangle_t     client;
+    unsigned int    prop_serial;
+} shmwindow_t;
+
+
+typedef struct
+{
+    unsigned int    retired;
+    unsigned int    window_count;
+    shmwindow_t     windows[1];
+} shmdesktop_t;
+
+
+typedef struct
+{
+    unsigned int    seq;
+    unsigned int    hash;
+    atom_t          atom;
+    data_size_t     len;
+    WCHAR           str[60];
+} shmatom_t;
+
+#define SHM_ATOM_COUNT 1024
+
+
+typedef struct
+{
+    unsigned int last_input_time;
+    unsigned int foreground_wnd_epoch;
+    shmatom_t    atoms[SHM_ATOM_COUNT];
+} shmglobal_t;
+
+
 typedef struct
 {
     obj_handle_t    handle;
@@ -3071,6 +3135,8 @@ struct send_message_request
     lparam_t        wparam;
     lparam_t        lparam;
     timeout_t       timeout;
+    obj_handle_t    section;
+    data_size_t     section_size;
     /* VARARG(data,message_data); */
 };
 struct send_message_reply
@@ -3128,6 +3194,26 @@ struct send_hardware_message_reply
 
 
 
+struct send_hardware_input_request
+{
+    struct request_header __header;
+    unsigned int    flags;
+    /* VARARG(input,hw_inputs); */
+};
+struct send_hardware_input_reply
+{
+    struct reply_header __header;
+    unsigned int    count;
+    int             wait;
+    int             prev_x;
+    int             prev_y;
+    int             new_x;
+    int             new_y;
+    /* VARARG(keystate,bytes); */
+};
+
+
+
 struct get_message_request
 {
     struct request_header __header;
@@ -3152,7 +3238,9 @@ struct get_message_reply
     unsigned int    time;
     unsigned int    active_hooks;
     data_size_t     total;
+    obj_handle_t    section;
     /* VARARG(data,message_data); */
+    char __pad_60[4];
 };
 
 
@@ -4128,6 +4216,20 @@ struct set_thread_desktop_reply
 
 
 
+struct get_desktop_shared_memory_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_desktop_shared_memory_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    unsigned int id;
+};
+
+
+
 struct enum_desktop_request
 {
     struct request_header __header;
@@ -5888,6 +5990,7 @@ enum request
     REQ_send_message,
     REQ_post_quit_message,
     REQ_send_hardware_message,
+    REQ_send_hardware_input,
     REQ_get_message,
     REQ_reply_message,
     REQ_accept_hardware_message,
@@ -5947,6 +6050,7 @@ enum request
     REQ_close_desktop,
     REQ_get_thread_desktop,
     REQ_set_thread_desktop,
+    REQ_get_desktop_shared_memory,
     REQ_enum_desktop,
     REQ_set_user_object_info,
     REQ_register_hotkey,
@@ -6191,6 +6295,7 @@ union generic_request
     struct send_message_request send_message_request;
     struct post_quit_message_request post_quit_message_request;
     struct send_hardware_message_request send_hardware_message_request;
+    struct send_hardware_input_request send_hardware_input_request;
     struct get_message_request get_message_request;
     struct reply_message_request reply_message_request;
     struct accept_hardware_message_request accept_hardware_message_request;
@@ -6250,6 +6355,7 @@ union generic_request
     struct close_desktop_request close_desktop_request;
     struct get_thread_desktop_request get_thread_desktop_request;
     struct set_thread_desktop_request set_thread_desktop_request;
+    struct get_desktop_shared_memory_request get_desktop_shared_memory_request;
     struct enum_desktop_request enum_desktop_request;
     struct set_user_object_info_request set_user_object_info_request;
     struct register_hotkey_request register_hotkey_request;
@@ -6492,6 +6598,7 @@ union generic_reply
     struct send_message_reply send_message_reply;
     struct post_quit_message_reply post_quit_message_reply;
     struct send_hardware_message_reply send_hardware_message_reply;
+    struct send_hardware_input_reply send_hardware_input_reply;
     struct get_message_reply get_message_reply;
     struct reply_message_reply reply_message_reply;
     struct accept_hardware_message_reply accept_hardware_message_reply;
@@ -6551,6 +6658,7 @@ union generic_reply
     struct close_desktop_reply close_desktop_reply;
     struct get_thread_desktop_reply get_thread_desktop_reply;
     struct set_thread_desktop_reply set_thread_desktop_reply;
+    struct get_desktop_shared_memory_reply get_desktop_shared_memory_reply;
     struct enum_desktop_reply enum_desktop_reply;
     struct set_user_object_info_reply set_user_object_info_reply;
     struct register_hotkey_reply register_hotkey_reply;
@@ -6652,6 +6760,6 @@ union generic_reply
     struct resume_process_reply resume_process_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 534
+#define SERVER_PROTOCOL_VERSION 544
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
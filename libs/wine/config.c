@@ -510,9 +510,6 @@ const char *wine_libs[] = {
 #ifdef SONAME_LIBTIFF
     SONAME_LIBTIFF,
 #endif
-#ifdef SONAME_LIBTXC_DXTN
-    SONAME_LIBTXC_DXTN,
-#endif
 #ifdef SONAME_LIBV4L1
     SONAME_LIBV4L1,
 #endif
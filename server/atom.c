@@ -36,6 +36,7 @@
 #include "process.h"
 #include "handle.h"
 #include "user.h"
+#include "file.h"
 #include "winuser.h"
 #include "winternl.h"
 
@@ -49,12 +50,10 @@
 
 struct atom_entry
 {
-    struct atom_entry *next;   /* hash table list */
-    struct atom_entry *prev;   /* hash table list */
     int                count;  /* reference count */
     short              pinned; /* whether the atom is pinned or not */
     atom_t             atom;   /* atom handle */
-    unsigned short     hash;   /* string hash */
+    unsigned int       hash;   /* string hash */
     unsigned short     len;    /* string len */
     WCHAR              str[1]; /* atom string */
 };
@@ -65,10 +64,14 @@ struct atom_table
     int                 count;               /* count of atom handles */
     int                 last;                /* last handle in-use */
     struct atom_entry **handles;             /* atom handles */
-    int                 entries_count;       /* number of hash entries */
-    struct atom_entry **entries;             /* hash table entries */
+    int                 entries_count;       /* size of the hash table, a power of two */
+    int                 entries_used;        /* number of used hash slots, including deleted ones */
+    struct atom_entry **entries;             /* open-addressed hash table */
 };
 
+/* marker for deleted hash slots, so that probe sequences stay unbroken */
+static struct atom_entry deleted_entry;
+
 static void atom_table_dump( struct object *obj, int verbose );
 static void atom_table_destroy( struct object *obj );
 
@@ -104,10 +107,15 @@ static struct atom_table *create_table(int entries_count)
 
     if ((table = alloc_object( &atom_table_ops )))
     {
+        int size = 16;
+
         if ((entries_count < MIN_HASH_SIZE) ||
             (entries_count > MAX_HASH_SIZE)) entries_count = HASH_SIZE;
+        /* keep the load factor below one half for the requested size */
+        while (size < 2 * entries_count) size *= 2;
         table->handles = NULL;
-        table->entries_count = entries_count;
+        table->entries_count = size;
+        table->entries_used = 0;
         if (!(table->entries = malloc( sizeof(*table->entries) * table->entries_count )))
         {
             set_error( STATUS_NO_MEMORY );
@@ -163,13 +171,31 @@ static atom_t add_atom_entry( struct atom_table *table, struct atom_entry *entry
     return entry->atom;
 }
 
-/* compute the hash code for a string */
-static unsigned short atom_hash( struct atom_table *table, const struct unicode_str *str )
+/* compute the case-insensitive hash code for a string; must match the client side */
+static unsigned int atom_hash( const struct unicode_str *str )
 {
-    unsigned int i;
-    unsigned short hash = 0;
-    for (i = 0; i < str->len / sizeof(WCHAR); i++) hash ^= toupperW(str->str[i]) + i;
-    return hash % table->entries_count;
+    unsigned int i, hash = 0x811c9dc5;
+    for (i = 0; i < str->len / sizeof(WCHAR); i++) hash = (hash ^ toupperW(str->str[i])) * 0x01000193;
+    return hash;
+}
+
+/* mirror a global atom into the shared memory snapshot, or remove it with a NULL string */
+static void update_shared_atom( struct atom_table *table, atom_t atom, unsigned int hash,
+                                const WCHAR *str, data_size_t len )
+{
+    shmatom_t *shm;
+
+    if (!shmglobal || table != global_table) return;
+    shm = &shmglobal->atoms[hash & (SHM_ATOM_COUNT - 1)];
+    if (!str && shm->atom != atom) return;
+    if (str && len > sizeof(shm->str)) return;
+
+    interlocked_xchg_add( (int *)&shm->seq, 1 );  /* readers retry while the counter is odd */
+    shm->atom = str ? atom : 0;
+    shm->hash = hash;
+    shm->len  = str ? len : 0;
+    if (str) memcpy( shm->str, str, len );
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
 }
 
 /* dump an atom table */
@@ -186,7 +212,7 @@ static void atom_table_dump( struct object *obj, int verbose )
     {
         struct atom_entry *entry = table->handles[i];
         if (!entry) continue;
-        fprintf( stderr, "  %04x: ref=%d pinned=%c hash=%d \"",
+        fprintf( stderr, "  %04x: ref=%d pinned=%c hash=%08x \"",
                  entry->atom, entry->count, entry->pinned ? 'Y' : 'N', entry->hash );
         dump_strW( entry->str, entry->len / sizeof(WCHAR), stderr, "\"\"");
         fprintf( stderr, "\"\n" );
@@ -207,24 +233,72 @@ static void atom_table_destroy( struct object *obj )
     free( table->entries );
 }
 
-/* find an atom entry in its hash list */
+/* find an atom entry in the hash table */
 static struct atom_entry *find_atom_entry( struct atom_table *table, const struct unicode_str *str,
-                                           unsigned short hash )
+                                           unsigned int hash )
 {
-    struct atom_entry *entry = table->entries[hash];
-    while (entry)
+    unsigned int mask = table->entries_count - 1, i = hash & mask;
+    struct atom_entry *entry;
+
+    while ((entry = table->entries[i]))
     {
-        if (entry->len == str->len && !memicmpW( entry->str, str->str, str->len/sizeof(WCHAR) )) break;
-        entry = entry->next;
+        if (entry != &deleted_entry && entry->hash == hash && entry->len == str->len &&
+            !memicmpW( entry->str, str->str, str->len/sizeof(WCHAR) ))
+            return entry;
+        i = (i + 1) & mask;
     }
-    return entry;
+    return NULL;
+}
+
+/* store an entry in the first free slot of its probe sequence */
+static void insert_atom_entry( struct atom_table *table, struct atom_entry *entry )
+{
+    unsigned int mask = table->entries_count - 1, i = entry->hash & mask;
+
+    while (table->entries[i] && table->entries[i] != &deleted_entry) i = (i + 1) & mask;
+    if (!table->entries[i]) table->entries_used++;
+    table->entries[i] = entry;
+}
+
+/* remove an entry from the hash table */
+static void remove_atom_entry( struct atom_table *table, struct atom_entry *entry )
+{
+    unsigned int mask = table->entries_count - 1, i = entry->hash & mask;
+
+    while (table->entries[i] != entry) i = (i + 1) & mask;
+    table->entries[i] = &deleted_entry;
+    update_shared_atom( table, entry->atom, entry->hash, NULL, 0 );
+}
+
+/* make room for a new entry, growing the hash table or purging the deleted slots */
+static int reserve_atom_entry( struct atom_table *table )
+{
+    struct atom_entry **old_entries = table->entries;
+    int i, old_count = table->entries_count, new_count = old_count;
+
+    if ((table->entries_used + 1) * 4 <= table->entries_count * 3) return 1;
+
+    if ((table->last + 2) * 2 > old_count) new_count *= 2;
+    if (!(table->entries = calloc( new_count, sizeof(*table->entries) )))
+    {
+        table->entries = old_entries;
+        set_error( STATUS_NO_MEMORY );
+        return 0;
+    }
+    table->entries_count = new_count;
+    table->entries_used = 0;
+    for (i = 0; i < old_count; i++)
+        if (old_entries[i] && old_entries[i] != &deleted_entry)
+            insert_atom_entry( table, old_entries[i] );
+    free( old_entries );
+    return 1;
 }
 
 /* add an atom to the table */
 static atom_t add_atom( struct atom_table *table, const struct unicode_str *str )
 {
     struct atom_entry *entry;
-    unsigned short hash = atom_hash( table, str );
+    unsigned int hash = atom_hash( str );
     atom_t atom = 0;
 
     if (!str->len)
@@ -242,19 +316,19 @@ static atom_t add_atom( struct atom_table *table, const struct unicode_str *str
         entry->count++;
         return entry->atom;
     }
+    if (!reserve_atom_entry( table )) return 0;
 
     if ((entry = mem_alloc( FIELD_OFFSET( struct atom_entry, str[str->len / sizeof(WCHAR)] ) )))
     {
         if ((atom = add_atom_entry( table, entry )))
         {
-            entry->prev  = NULL;
-            if ((entry->next = table->entries[hash])) entry->next->prev = entry;
-            table->entries[hash] = entry;
             entry->count  = 1;
             entry->pinned = 0;
             entry->hash   = hash;
             entry->len    = str->len;
             memcpy( entry->str, str->str, str->len );
+            insert_atom_entry( table, entry );
+            update_shared_atom( table, atom, hash, entry->str, entry->len );
         }
         else free( entry );
     }
@@ -270,9 +344,7 @@ static void delete_atom( struct atom_table *table, atom_t atom, int if_pinned )
     if (entry->pinned && !if_pinned) set_error( STATUS_WAS_LOCKED );
     else if (!--entry->count)
     {
-        if (entry->next) entry->next->prev = entry->prev;
-        if (entry->prev) entry->prev->next = entry->next;
-        else table->entries[entry->hash] = entry->next;
+        remove_atom_entry( table, entry );
         table->handles[atom - MIN_STR_ATOM] = NULL;
         free( entry );
     }
@@ -293,8 +365,12 @@ static atom_t find_atom( struct atom_table *table, const struct unicode_str *str
         set_error( STATUS_INVALID_PARAMETER );
         return 0;
     }
-    if (table && (entry = find_atom_entry( table, str, atom_hash(table, str) )))
+    if (table && (entry = find_atom_entry( table, str, atom_hash( str ) )))
+    {
+        /* the snapshot slot may have been taken over by another atom */
+        update_shared_atom( table, entry->atom, entry->hash, entry->str, entry->len );
         return entry->atom;
+    }
     set_error( STATUS_OBJECT_NAME_NOT_FOUND );
     return 0;
 }
@@ -350,7 +426,7 @@ atom_t find_global_atom( struct winstation *winstation, const struct unicode_str
     struct atom_entry *entry;
 
     if (!str->len || str->len > MAX_ATOM_LEN || !table) return 0;
-    if ((entry = find_atom_entry( table, str, atom_hash(table, str) )))
+    if ((entry = find_atom_entry( table, str, atom_hash( str ) )))
         return entry->atom;
     return 0;
 }
@@ -481,9 +557,7 @@ DECL_HANDLER(empty_atom_table)
             entry = table->handles[i];
             if (entry && (!entry->pinned || req->if_pinned))
             {
-                if (entry->next) entry->next->prev = entry->prev;
-                if (entry->prev) entry->prev->next = entry->next;
-                else table->entries[entry->hash] = entry->next;
+                remove_atom_entry( table, entry );
                 table->handles[i] = NULL;
                 free( entry );
             }
@@ -42,6 +42,7 @@
 struct window_class
 {
     struct list     entry;           /* entry in process list */
+    struct list     hash_entry;      /* entry in class hash table */
     struct process *process;         /* process owning the class */
     int             count;           /* reference count */
     int             local;           /* local class? */
@@ -54,8 +55,29 @@ struct window_class
     char            extra_bytes[1];  /* extra bytes storage */
 };
 
-static struct window_class *create_class( struct process *process, int extra_bytes, int local )
+#define CLASS_HASH_SIZE 512  /* must be a power of 2 */
+
+static struct list class_hash[CLASS_HASH_SIZE];  /* classes hashed by process and atom */
+
+/* get the hash bucket of the classes with a given atom */
+static struct list *get_class_bucket( struct process *process, atom_t atom )
+{
+    static int initialized;
+    unsigned int hash;
+
+    if (!initialized)
+    {
+        for (hash = 0; hash < CLASS_HASH_SIZE; hash++) list_init( &class_hash[hash] );
+        initialized = 1;
+    }
+    hash = ((unsigned int)(unsigned long)process >> 4) ^ (atom * 0x9e3779b1);
+    return &class_hash[(hash ^ (hash >> 16)) & (CLASS_HASH_SIZE - 1)];
+}
+
+static struct window_class *create_class( struct process *process, int extra_bytes, int local,
+                                          atom_t atom )
 {
+    struct list *bucket = get_class_bucket( process, atom );
     struct window_class *class;
 
     if (!(class = mem_alloc( sizeof(*class) + extra_bytes - 1 ))) return NULL;
@@ -63,19 +85,49 @@ static struct window_class *create_class( struct process *process, int extra_byt
     class->process = (struct process *)grab_object( process );
     class->count = 0;
     class->local = local;
+    class->atom = atom;
     class->nb_extra_bytes = extra_bytes;
     memset( class->extra_bytes, 0, extra_bytes );
     /* other fields are initialized by caller */
 
-    /* local classes have priority so we put them first in the list */
-    if (local) list_add_head( &process->classes, &class->entry );
-    else list_add_tail( &process->classes, &class->entry );
+    /* local classes have priority so we put them first in the lists */
+    if (local)
+    {
+        list_add_head( &process->classes, &class->entry );
+        list_add_head( bucket, &class->hash_entry );
+    }
+    else
+    {
+        list_add_tail( &process->classes, &class->entry );
+        list_add_tail( bucket, &class->hash_entry );
+    }
     return class;
 }
 
+/* move a class to the hash bucket of its new atom */
+static void rehash_class( struct window_class *class )
+{
+    struct window_class *next;
+    struct list *ptr;
+
+    list_remove( &class->hash_entry );
+
+    /* keep the same relative order as in the process list */
+    for (ptr = list_next( &class->process->classes, &class->entry ); ptr;
+         ptr = list_next( &class->process->classes, ptr ))
+    {
+        next = LIST_ENTRY( ptr, struct window_class, entry );
+        if (next->atom != class->atom) continue;
+        list_add_before( &next->hash_entry, &class->hash_entry );
+        return;
+    }
+    list_add_tail( get_class_bucket( class->process, class->atom ), &class->hash_entry );
+}
+
 static void destroy_class( struct window_class *class )
 {
     list_remove( &class->entry );
+    list_remove( &class->hash_entry );
     release_object( class->process );
     free( class );
 }
@@ -95,10 +147,10 @@ static struct window_class *find_class( struct process *process, atom_t atom, mo
 {
     struct list *ptr;
 
-    LIST_FOR_EACH( ptr, &process->classes )
+    LIST_FOR_EACH( ptr, get_class_bucket( process, atom ) )
     {
-        struct window_class *class = LIST_ENTRY( ptr, struct window_class, entry );
-        if (class->atom != atom) continue;
+        struct window_class *class = LIST_ENTRY( ptr, struct window_class, hash_entry );
+        if (class->process != process || class->atom != atom) continue;
         if (!instance || !class->local || class->instance == instance) return class;
     }
     return NULL;
@@ -179,12 +231,11 @@ DECL_HANDLER(create_class)
         return;
     }
 
-    if (!(class = create_class( current->process, req->extra, req->local )))
+    if (!(class = create_class( current->process, req->extra, req->local, atom )))
     {
         release_global_atom( NULL, atom );
         return;
     }
-    class->atom       = atom;
     class->instance   = req->instance;
     class->style      = req->style;
     class->win_extra  = req->win_extra;
@@ -259,6 +310,7 @@ DECL_HANDLER(set_class_info)
         if (!grab_global_atom( NULL, req->atom )) return;
         release_global_atom( NULL, class->atom );
         class->atom = req->atom;
+        rehash_class( class );
     }
     if (req->flags & SET_CLASS_STYLE) class->style = req->style;
     if (req->flags & SET_CLASS_WINEXTRA) class->win_extra = req->win_extra;
@@ -2607,9 +2607,12 @@ DECL_HANDLER(get_shared_memory)
         struct thread *thread = get_thread_from_id( req->tid );
         if (thread)
         {
+            C_ASSERT( sizeof(shmlocal_t) <= SHM_CLIENT_OFFSET );
+
             if (thread->shm_fd != -1 || allocate_shared_memory( &thread->shm_fd,
-                (void **)&thread->shm, sizeof(*thread->shm) ))
+                (void **)&thread->shm, THREAD_SHM_SIZE ))
             {
+                thread->shm_client = (shmclient_t *)((char *)thread->shm + SHM_CLIENT_OFFSET);
                 send_client_fd( current->process, thread->shm_fd, 0 );
             }
             else
@@ -693,6 +693,26 @@ static struct object *create_mapping( struct object *root, const struct unicode_
     return NULL;
 }
 
+/* create an anonymous mapping that is also mapped writable into the server address space */
+struct object *create_shared_mapping( mem_size_t size, void **ptr )
+{
+    struct mapping *mapping;
+    void *mem;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, NULL, 0, size, SEC_COMMIT,
+                                                      VPROT_READ | VPROT_WRITE, 0, NULL )))
+        return NULL;
+    mem = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (mem == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    *ptr = mem;
+    return &mapping->obj;
+}
+
 struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct mapping *)get_handle_obj( process, handle, access, &mapping_ops );
@@ -36,6 +36,7 @@
 #include "wingdi.h"
 #include "winuser.h"
 #include "winternl.h"
+#include "dde.h"
 
 #include "handle.h"
 #include "file.h"
@@ -67,6 +68,8 @@ struct message_result
     void                  *data;          /* message reply data */
     unsigned int           data_size;     /* size of message reply data */
     struct timeout_user   *timeout;       /* result timeout */
+    struct mapping        *section;       /* section holding the message data for large messages */
+    data_size_t            section_size;  /* size of the message data in the section */
 };
 
 struct message
@@ -147,6 +150,8 @@ struct msg_queue
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
     unsigned int           ignore_post_msg; /* ignore post messages newer than this unique id */
+    unsigned int           shm_get_msg_count; /* last seen client get message count */
+    unsigned int           shm_post_head;   /* next entry of the shared memory post ring */
 };
 
 struct hotkey
@@ -333,6 +338,8 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
         queue->ignore_post_msg = 0;
+        queue->shm_get_msg_count = 0;
+        queue->shm_post_head   = 0;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -340,6 +347,12 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         for (i = 0; i < NB_MSG_KINDS; i++) list_init( &queue->msg_list[i] );
 
         thread->queue = queue;
+        if (thread->shm)
+        {
+            thread->shm->post_head = 0;
+            thread->shm_client->get_msg_count = 0;
+            thread->shm_client->post_tail = 0;
+        }
     }
     if (new_input)
     {
@@ -609,6 +622,7 @@ static void free_result( struct message_result *result )
     if (result->callback_msg) free_message( result->callback_msg );
     if (result->hardware_msg) free_message( result->hardware_msg );
     if (result->desktop) release_object( result->desktop );
+    if (result->section) release_object( result->section );
     free( result );
 }
 
@@ -739,6 +753,8 @@ static struct message_result *alloc_message_result( struct msg_queue *send_queue
         result->hardware_msg = NULL;
         result->desktop      = NULL;
         result->callback_msg = NULL;
+        result->section      = NULL;
+        result->section_size = 0;
 
         if (msg->type == MSG_CALLBACK)
         {
@@ -804,6 +820,15 @@ static void receive_message( struct msg_queue *queue, struct message *msg,
     /* put the result on the receiver result stack */
     if (result)
     {
+        /* hand the data section over to the receiving process */
+        if (result->section)
+        {
+            reply->section = alloc_handle( current->process, result->section,
+                                           SECTION_MAP_READ | SECTION_MAP_WRITE, 0 );
+            if (reply->section) reply->total = result->section_size;
+            release_object( result->section );
+            result->section = NULL;
+        }
         result->msg = NULL;
         result->recv_next  = queue->recv_result;
         queue->recv_result = result;
@@ -843,6 +868,96 @@ static int match_window( user_handle_t win, user_handle_t msg_win )
     return is_child_window( win, msg_win );
 }
 
+/* number of posted messages in the shared memory ring that the client hasn't retrieved yet */
+static unsigned int get_shm_post_count( struct msg_queue *queue )
+{
+    shmclient_t *client = queue->thread->shm_client;
+    /* the tail is written by the client, read it only once and don't trust it */
+    unsigned int count = queue->shm_post_head - *(volatile unsigned int *)&client->post_tail;
+
+    if (count > SHM_POST_RING_SIZE)
+    {
+        client->post_tail = queue->shm_post_head;
+        count = 0;
+    }
+    return count;
+}
+
+/* clear the posted message bits once the client has retrieved everything from the ring */
+static void update_shm_post_bits( struct msg_queue *queue )
+{
+    if (!queue->thread || !queue->thread->shm) return;
+    if (get_shm_post_count( queue )) return;
+    if (list_empty( &queue->msg_list[POST_MESSAGE] ) && !queue->quit_message)
+        clear_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+}
+
+/* store a posted message in the shared memory ring, where the receiver can fetch it without a server call */
+static int post_shm_message( struct msg_queue *queue, const struct message *msg )
+{
+    shmmessage_t *entry;
+    shmlocal_t *shm;
+
+    if (!queue->thread || !(shm = queue->thread->shm)) return 0;
+    if (msg->data || msg->msg == WM_HOTKEY || (msg->msg & 0x80000000)) return 0;
+    if (msg->msg >= WM_DDE_FIRST && msg->msg <= WM_DDE_LAST) return 0;
+    /* ring messages must be older than the queued ones to keep the posting order */
+    if (!list_empty( &queue->msg_list[POST_MESSAGE] )) return 0;
+    /* messages already seen by PeekMessage have to be returned first */
+    if (queue->ignore_post_msg) return 0;
+    if (get_shm_post_count( queue ) >= SHM_POST_RING_SIZE) return 0;
+
+    entry = &shm->post_ring[queue->shm_post_head & (SHM_POST_RING_SIZE - 1)];
+    entry->win    = msg->win;
+    entry->msg    = msg->msg;
+    entry->wparam = msg->wparam;
+    entry->lparam = msg->lparam;
+    entry->x      = msg->x;
+    entry->y      = msg->y;
+    entry->time   = msg->time;
+    /* publish the entry only once it is complete */
+    interlocked_xchg( (int *)&shm->post_head, ++queue->shm_post_head );
+    set_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+    return 1;
+}
+
+/* move the posted messages left in the shared memory ring to the head of the posted list */
+static void drain_shm_posted_messages( struct msg_queue *queue )
+{
+    struct list *first = list_head( &queue->msg_list[POST_MESSAGE] );
+    struct message *msg;
+    unsigned int count, tail;
+    shmlocal_t *shm;
+
+    if (!queue->thread || !(shm = queue->thread->shm)) return;
+
+    count = get_shm_post_count( queue );
+    for (tail = queue->shm_post_head - count; count; count--)
+    {
+        const shmmessage_t *entry = &shm->post_ring[tail++ & (SHM_POST_RING_SIZE - 1)];
+
+        if (!(msg = mem_alloc( sizeof(*msg) ))) continue;
+        msg->type      = MSG_POSTED;
+        msg->win       = entry->win;
+        msg->msg       = entry->msg;
+        msg->wparam    = entry->wparam;
+        msg->lparam    = entry->lparam;
+        msg->x         = entry->x;
+        msg->y         = entry->y;
+        msg->time      = entry->time;
+        msg->data      = NULL;
+        msg->data_size = 0;
+        msg->result    = NULL;
+        msg->unique_id = get_unique_post_id();
+        if (first) list_add_before( first, &msg->entry );
+        else list_add_tail( &queue->msg_list[POST_MESSAGE], &msg->entry );
+    }
+    queue->thread->shm_client->post_tail = tail;
+
+    /* the client may have retrieved all the messages by itself */
+    update_shm_post_bits( queue );
+}
+
 /* retrieve a posted message */
 static int get_posted_message( struct msg_queue *queue, unsigned int ignore_msg, user_handle_t win,
                                unsigned int first, unsigned int last, unsigned int flags,
@@ -955,6 +1070,14 @@ static int is_queue_hung( struct msg_queue *queue )
 {
     struct wait_queue_entry *entry;
 
+    /* get message calls satisfied from the shared memory don't reach the server */
+    if (queue->thread && queue->thread->shm &&
+        queue->thread->shm_client->get_msg_count != queue->shm_get_msg_count)
+    {
+        queue->shm_get_msg_count = queue->thread->shm_client->get_msg_count;
+        queue->last_get_msg = current_time;
+    }
+
     if (current_time - queue->last_get_msg <= 5 * TICKS_PER_SEC)
         return 0;  /* less than 5 seconds since last get message -> not hung */
 
@@ -1581,6 +1704,15 @@ static void update_rawinput_device(const struct rawinput_device *device)
     e->device.target = get_user_full_handle( e->device.target );
 }
 
+/* clip a position to the cursor clipping rectangle */
+static void clip_cursor_position( const struct desktop *desktop, int *x, int *y )
+{
+    if (*x < desktop->cursor.clip.left) *x = desktop->cursor.clip.left;
+    else if (*x >= desktop->cursor.clip.right) *x = desktop->cursor.clip.right - 1;
+    if (*y < desktop->cursor.clip.top) *y = desktop->cursor.clip.top;
+    else if (*y >= desktop->cursor.clip.bottom) *y = desktop->cursor.clip.bottom - 1;
+}
+
 /* queue a hardware message into a given thread input */
 static void queue_hardware_message( struct desktop *desktop, struct message *msg, int always_queue )
 {
@@ -1606,10 +1738,7 @@ static void queue_hardware_message( struct desktop *desktop, struct message *msg
         if (msg->msg == WM_MOUSEMOVE)
         {
             int x = msg->x, y = msg->y;
-            if (x < desktop->cursor.clip.left) x = desktop->cursor.clip.left;
-            else if (x >= desktop->cursor.clip.right) x = desktop->cursor.clip.right - 1;
-            if (y < desktop->cursor.clip.top) y = desktop->cursor.clip.top;
-            else if (y >= desktop->cursor.clip.bottom) y = desktop->cursor.clip.bottom - 1;
+            clip_cursor_position( desktop, &x, &y );
             if (desktop->cursor.x != x || desktop->cursor.y != y) always_queue = 1;
             desktop->cursor.x = x;
             desktop->cursor.y = y;
@@ -2012,6 +2141,49 @@ static void queue_custom_hardware_message( struct desktop *desktop, user_handle_
     queue_hardware_message( desktop, msg, 1 );
 }
 
+/* check whether a mouse event only moves the cursor and can be merged with the following motion */
+static int is_coalescable_motion( const hw_input_t *input )
+{
+    if (input->type != INPUT_MOUSE) return 0;
+    return (input->mouse.flags & ~MOUSEEVENTF_ABSOLUTE) == MOUSEEVENTF_MOVE;
+}
+
+/* merge consecutive cursor motions of an input batch into a single absolute motion */
+static unsigned int coalesce_mouse_motion( struct desktop *desktop, const hw_input_t *inputs,
+                                           unsigned int count, hw_input_t *merged )
+{
+    unsigned int i;
+    int x = desktop->cursor.x, y = desktop->cursor.y;
+
+    *merged = inputs[0];
+    /* the low-level hook and raw input clients expect to see every event */
+    if (current->process->rawinput_mouse || get_first_global_hook( WH_MOUSE_LL )) return 1;
+
+    for (i = 0; i < count && is_coalescable_motion( &inputs[i] ); i++)
+    {
+        if (inputs[i].mouse.info != inputs[0].mouse.info) break;
+        if (inputs[i].mouse.flags & MOUSEEVENTF_ABSOLUTE)
+        {
+            x = inputs[i].mouse.x;
+            y = inputs[i].mouse.y;
+        }
+        else
+        {
+            x += inputs[i].mouse.x;
+            y += inputs[i].mouse.y;
+        }
+        clip_cursor_position( desktop, &x, &y );
+    }
+    if (i <= 1) return 1;
+
+    /* keep the timestamp of the last motion, the one matching the final position */
+    merged->mouse.x     = x;
+    merged->mouse.y     = y;
+    merged->mouse.flags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+    merged->mouse.time  = inputs[i - 1].mouse.time;
+    return i;
+}
+
 /* check message filter for a hardware message */
 static int check_hw_message_filter( user_handle_t win, unsigned int msg_code,
                                     user_handle_t filter_win, unsigned int first, unsigned int last )
@@ -2383,6 +2555,7 @@ DECL_HANDLER(set_queue_mask)
 
     if (queue)
     {
+        update_shm_post_bits( queue );
         queue->wake_mask    = req->wake_mask;
         queue->changed_mask = req->changed_mask;
         reply->wake_bits    = queue->wake_bits;
@@ -2403,6 +2576,7 @@ DECL_HANDLER(get_queue_status)
     struct msg_queue *queue = current->queue;
     if (queue)
     {
+        drain_shm_posted_messages( queue );
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
@@ -2418,20 +2592,35 @@ DECL_HANDLER(send_message)
     struct msg_queue *send_queue = get_current_queue();
     struct msg_queue *recv_queue = NULL;
     struct thread *thread = NULL;
+    struct mapping *section = NULL;
+
+    if (req->section)
+    {
+        /* large message data is only passed through a section between processes */
+        if (req->type != MSG_OTHER_PROCESS || get_req_data_size())
+        {
+            set_error( STATUS_INVALID_PARAMETER );
+            return;
+        }
+        if (!(section = get_mapping_obj( current->process, req->section,
+                                         SECTION_MAP_READ | SECTION_MAP_WRITE ))) return;
+    }
 
-    if (!(thread = get_thread_from_id( req->id ))) return;
+    if (!(thread = get_thread_from_id( req->id )))
+    {
+        if (section) release_object( section );
+        return;
+    }
 
     if (!(recv_queue = thread->queue))
     {
         set_error( STATUS_INVALID_PARAMETER );
-        release_object( thread );
-        return;
+        goto done;
     }
     if ((req->flags & SEND_MSG_ABORT_IF_HUNG) && is_queue_hung(recv_queue))
     {
         set_error( STATUS_TIMEOUT );
-        release_object( thread );
-        return;
+        goto done;
     }
 
     if ((msg = mem_alloc( sizeof(*msg) )))
@@ -2450,8 +2639,7 @@ DECL_HANDLER(send_message)
         if (msg->data_size && !(msg->data = memdup( get_req_data(), msg->data_size )))
         {
             free( msg );
-            release_object( thread );
-            return;
+            goto done;
         }
 
         switch(msg->type)
@@ -2465,12 +2653,23 @@ DECL_HANDLER(send_message)
                 free_message( msg );
                 break;
             }
+            if (section)
+            {
+                msg->result->section      = section;
+                msg->result->section_size = req->section_size;
+                section = NULL;
+            }
             /* fall through */
         case MSG_NOTIFY:
             list_add_tail( &recv_queue->msg_list[SEND_MESSAGE], &msg->entry );
             set_queue_bits( recv_queue, QS_SENDMESSAGE );
             break;
         case MSG_POSTED:
+            if (post_shm_message( recv_queue, msg ))
+            {
+                free( msg );
+                break;
+            }
             msg->unique_id = get_unique_post_id();
             list_add_tail( &recv_queue->msg_list[POST_MESSAGE], &msg->entry );
             set_queue_bits( recv_queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
@@ -2489,6 +2688,8 @@ DECL_HANDLER(send_message)
             break;
         }
     }
+done:
+    if (section) release_object( section );
     release_object( thread );
 }
 
@@ -2538,6 +2739,57 @@ DECL_HANDLER(send_hardware_message)
     release_object( desktop );
 }
 
+/* send a batch of hardware input events */
+DECL_HANDLER(send_hardware_input)
+{
+    struct desktop *desktop;
+    struct msg_queue *sender = get_current_queue();
+    const hw_input_t *inputs = get_req_data();
+    unsigned int i, merged, count = get_req_data_size() / sizeof(*inputs);
+    data_size_t size = min( 256, get_reply_max_size() );
+
+    if (!(desktop = get_thread_desktop( current, 0 ))) return;
+
+    reply->prev_x = desktop->cursor.x;
+    reply->prev_y = desktop->cursor.y;
+
+    /* only the last event waits for the low-level hooks, the previous
+     * ones are dispatched to the hooks without blocking the sender */
+    for (i = 0; i < count; i += merged)
+    {
+        struct msg_queue *wait_queue;
+        hw_input_t input = inputs[i];
+
+        merged = 1;
+        if (is_coalescable_motion( &input ))
+            merged = coalesce_mouse_motion( desktop, inputs + i, count - i, &input );
+        wait_queue = (i + merged == count) ? sender : NULL;
+
+        switch (input.type)
+        {
+        case INPUT_MOUSE:
+            reply->wait = queue_mouse_message( desktop, 0, &input, req->flags, wait_queue );
+            break;
+        case INPUT_KEYBOARD:
+            reply->wait = queue_keyboard_message( desktop, 0, &input, req->flags, wait_queue );
+            break;
+        case INPUT_HARDWARE:
+            queue_custom_hardware_message( desktop, 0, &input );
+            break;
+        default:
+            set_error( STATUS_INVALID_PARAMETER );
+            break;
+        }
+        if (get_error()) break;
+    }
+    reply->count = i;
+
+    reply->new_x = desktop->cursor.x;
+    reply->new_y = desktop->cursor.y;
+    set_reply_data( desktop->keystate, size );
+    release_object( desktop );
+}
+
 /* post a quit message to the current queue */
 DECL_HANDLER(post_quit_message)
 {
@@ -2566,6 +2818,8 @@ DECL_HANDLER(get_message)
     queue->last_get_msg = current_time;
     if (!filter) filter = QS_ALLINPUT;
 
+    drain_shm_posted_messages( queue );
+
     /* no longer lock the keystate if we have processed all input */
     if (queue->keystate_locked && !(queue->wake_bits & QS_ALLINPUT))
     {
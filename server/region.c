@@ -98,6 +98,13 @@ struct region
     (r1)->bottom > (r2)->top && \
     (r1)->top < (r2)->bottom)
 
+/* check if a rectangle completely contains another one */
+static inline int rect_contains( const rectangle_t *outer, const rectangle_t *inner )
+{
+    return (outer->left <= inner->left && outer->top <= inner->top &&
+            outer->right >= inner->right && outer->bottom >= inner->bottom);
+}
+
 typedef int (*overlap_func_t)( struct region *reg, const rectangle_t *r1, const rectangle_t *r1End,
                                const rectangle_t *r2, const rectangle_t *r2End, int top, int bottom );
 typedef int (*non_overlap_func_t)( struct region *reg, const rectangle_t *r,
@@ -105,6 +112,11 @@ typedef int (*non_overlap_func_t)( struct region *reg, const rectangle_t *r,
 
 static const rectangle_t empty_rect;  /* all-zero rectangle for empty regions */
 
+/* scratch storage for building the result of region operations, kept across calls while it is small */
+#define RGN_SCRATCH_MAX_RECTS 256
+static rectangle_t *scratch_rects;
+static int scratch_size;
+
 /* add a rectangle to a region */
 static inline rectangle_t *add_rect( struct region *reg )
 {
@@ -219,14 +231,25 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
     const rectangle_t *r1End = r1 + reg1->num_rects;
     const rectangle_t *r2End = r2 + reg2->num_rects;
 
-    rectangle_t *new_rects, *old_rects = newReg->rects;
+    struct region tmp, *dstReg = newReg;
+    rectangle_t *new_rects;
     int new_size, ret = 0;
 
+    /* build the result in the scratch storage, the destination can be one of the sources */
     new_size = max( reg1->num_rects, reg2->num_rects ) * 2;
-    if (!(new_rects = mem_alloc( new_size * sizeof(*newReg->rects) ))) return 0;
-
-    newReg->size = new_size;
-    newReg->rects = new_rects;
+    if (scratch_size < new_size)
+    {
+        if (!(new_rects = realloc( scratch_rects, new_size * sizeof(*new_rects) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        scratch_rects = new_rects;
+        scratch_size = new_size;
+    }
+    newReg = &tmp;
+    newReg->size = scratch_size;
+    newReg->rects = scratch_rects;
     newReg->num_rects = 0;
 
     if (reg1->extents.top < reg2->extents.top)
@@ -321,18 +344,40 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
 
     if (newReg->num_rects != curBand) coalesce_region(newReg, prevBand, curBand);
 
-    if ((newReg->num_rects < (newReg->size / 2)) && (newReg->size > 2))
+    /* copy the result, reallocating the destination only when it is too small or much too large */
+    new_size = max( newReg->num_rects, RGN_DEFAULT_RECTS );
+    if (dstReg->size < new_size || dstReg->size > 2 * new_size)
     {
-        new_size = max( newReg->num_rects, RGN_DEFAULT_RECTS );
-        if ((new_rects = realloc( newReg->rects, sizeof(*newReg->rects) * new_size )))
+        if (!(new_rects = realloc( dstReg->rects, sizeof(*new_rects) * new_size )))
         {
-            newReg->rects = new_rects;
-            newReg->size = new_size;
+            if (dstReg->size < new_size)
+            {
+                set_error( STATUS_NO_MEMORY );
+                goto done;
+            }
+        }
+        else
+        {
+            dstReg->rects = new_rects;
+            dstReg->size = new_size;
         }
     }
+    memcpy( dstReg->rects, newReg->rects, newReg->num_rects * sizeof(*newReg->rects) );
+    dstReg->num_rects = newReg->num_rects;
     ret = 1;
 done:
-    free( old_rects );
+    /* add_rect may have grown the scratch storage, don't hold on to a large buffer */
+    if (newReg->size > RGN_SCRATCH_MAX_RECTS)
+    {
+        free( newReg->rects );
+        scratch_rects = NULL;
+        scratch_size = 0;
+    }
+    else
+    {
+        scratch_rects = newReg->rects;
+        scratch_size = newReg->size;
+    }
     return ret;
 }
 
@@ -770,6 +815,22 @@ struct region *intersect_region( struct region *dst, const struct region *src1,
         dst->extents.bottom = 0;
         return dst;
     }
+    if (src1->num_rects == 1 && src2->num_rects == 1)
+    {
+        rectangle_t rect;
+
+        rect.left   = max( src1->extents.left, src2->extents.left );
+        rect.top    = max( src1->extents.top, src2->extents.top );
+        rect.right  = min( src1->extents.right, src2->extents.right );
+        rect.bottom = min( src1->extents.bottom, src2->extents.bottom );
+        set_region_rect( dst, &rect );
+        return dst;
+    }
+    if (src1->num_rects == 1 && rect_contains( &src1->extents, &src2->extents ))
+        return copy_region( dst, src2 );
+    if (src2->num_rects == 1 && rect_contains( &src2->extents, &src1->extents ))
+        return copy_region( dst, src1 );
+
     if (!region_op( dst, src1, src2, intersect_overlapping, NULL, NULL )) return NULL;
     set_region_extents( dst );
     return dst;
@@ -782,6 +843,12 @@ struct region *subtract_region( struct region *dst, const struct region *src1,
     if (!src1->num_rects || !src2->num_rects || !EXTENTCHECK(&src1->extents, &src2->extents))
         return copy_region( dst, src1 );
 
+    if (src2->num_rects == 1 && rect_contains( &src2->extents, &src1->extents ))
+    {
+        set_region_rect( dst, &empty_rect );
+        return dst;
+    }
+
     if (!region_op( dst, src1, src2, subtract_overlapping,
                     subtract_non_overlapping, NULL )) return NULL;
     set_region_extents( dst );
@@ -796,20 +863,33 @@ struct region *union_region( struct region *dst, const struct region *src1,
     if (!src1->num_rects) return copy_region( dst, src2 );
     if (!src2->num_rects) return copy_region( dst, src1 );
 
-    if ((src1->num_rects == 1) &&
-        (src1->extents.left <= src2->extents.left) &&
-        (src1->extents.top <= src2->extents.top) &&
-        (src1->extents.right >= src2->extents.right) &&
-        (src1->extents.bottom >= src2->extents.bottom))
+    if (src1->num_rects == 1 && rect_contains( &src1->extents, &src2->extents ))
         return copy_region( dst, src1 );
 
-    if ((src2->num_rects == 1) &&
-        (src2->extents.left <= src1->extents.left) &&
-        (src2->extents.top <= src1->extents.top) &&
-        (src2->extents.right >= src1->extents.right) &&
-        (src2->extents.bottom >= src1->extents.bottom))
+    if (src2->num_rects == 1 && rect_contains( &src2->extents, &src1->extents ))
         return copy_region( dst, src2 );
 
+    if (src1->num_rects == 1 && src2->num_rects == 1)
+    {
+        const rectangle_t *r1 = &src1->extents, *r2 = &src2->extents;
+
+        /* two rectangles in the same band, or stacked on top of each other, merge into one */
+        if ((r1->top == r2->top && r1->bottom == r2->bottom &&
+             r1->left <= r2->right && r2->left <= r1->right) ||
+            (r1->left == r2->left && r1->right == r2->right &&
+             r1->top <= r2->bottom && r2->top <= r1->bottom))
+        {
+            rectangle_t rect;
+
+            rect.left   = min( r1->left, r2->left );
+            rect.top    = min( r1->top, r2->top );
+            rect.right  = max( r1->right, r2->right );
+            rect.bottom = max( r1->bottom, r2->bottom );
+            set_region_rect( dst, &rect );
+            return dst;
+        }
+    }
+
     if (!region_op( dst, src1, src2, union_overlapping,
                     union_non_overlapping, union_non_overlapping )) return NULL;
 
@@ -842,6 +922,9 @@ int point_in_region( struct region *region, int x, int y )
 {
     const rectangle_t *ptr, *end;
 
+    if (x < region->extents.left || x >= region->extents.right ||
+        y < region->extents.top || y >= region->extents.bottom) return 0;
+
     for (ptr = region->rects, end = region->rects + region->num_rects; ptr < end; ptr++)
     {
         if (ptr->top > y) return 0;
@@ -859,6 +942,9 @@ int rect_in_region( struct region *region, const rectangle_t *rect )
 {
     const rectangle_t *ptr, *end;
 
+    if (!region->num_rects || !EXTENTCHECK( &region->extents, rect )) return 0;
+    if (region->num_rects == 1) return 1;
+
     for (ptr = region->rects, end = region->rects + region->num_rects; ptr < end; ptr++)
     {
         if (ptr->top >= rect->bottom) return 0;
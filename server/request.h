@@ -250,6 +250,7 @@ DECL_HANDLER(get_process_idle_event);
 DECL_HANDLER(send_message);
 DECL_HANDLER(post_quit_message);
 DECL_HANDLER(send_hardware_message);
+DECL_HANDLER(send_hardware_input);
 DECL_HANDLER(get_message);
 DECL_HANDLER(reply_message);
 DECL_HANDLER(accept_hardware_message);
@@ -309,6 +310,7 @@ DECL_HANDLER(open_input_desktop);
 DECL_HANDLER(close_desktop);
 DECL_HANDLER(get_thread_desktop);
 DECL_HANDLER(set_thread_desktop);
+DECL_HANDLER(get_desktop_shared_memory);
 DECL_HANDLER(enum_desktop);
 DECL_HANDLER(set_user_object_info);
 DECL_HANDLER(register_hotkey);
@@ -552,6 +554,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_send_message,
     (req_handler)req_post_quit_message,
     (req_handler)req_send_hardware_message,
+    (req_handler)req_send_hardware_input,
     (req_handler)req_get_message,
     (req_handler)req_reply_message,
     (req_handler)req_accept_hardware_message,
@@ -611,6 +614,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_close_desktop,
     (req_handler)req_get_thread_desktop,
     (req_handler)req_set_thread_desktop,
+    (req_handler)req_get_desktop_shared_memory,
     (req_handler)req_enum_desktop,
     (req_handler)req_set_user_object_info,
     (req_handler)req_register_hotkey,
@@ -1541,7 +1545,9 @@ C_ASSERT( FIELD_OFFSET(struct send_message_request, msg) == 28 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, wparam) == 32 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, lparam) == 40 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, timeout) == 48 );
-C_ASSERT( sizeof(struct send_message_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct send_message_request, section) == 56 );
+C_ASSERT( FIELD_OFFSET(struct send_message_request, section_size) == 60 );
+C_ASSERT( sizeof(struct send_message_request) == 64 );
 C_ASSERT( FIELD_OFFSET(struct post_quit_message_request, exit_code) == 12 );
 C_ASSERT( sizeof(struct post_quit_message_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct send_hardware_message_request, win) == 12 );
@@ -1554,6 +1560,15 @@ C_ASSERT( FIELD_OFFSET(struct send_hardware_message_reply, prev_y) == 16 );
 C_ASSERT( FIELD_OFFSET(struct send_hardware_message_reply, new_x) == 20 );
 C_ASSERT( FIELD_OFFSET(struct send_hardware_message_reply, new_y) == 24 );
 C_ASSERT( sizeof(struct send_hardware_message_reply) == 32 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_request, flags) == 12 );
+C_ASSERT( sizeof(struct send_hardware_input_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_reply, count) == 8 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_reply, wait) == 12 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_reply, prev_x) == 16 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_reply, prev_y) == 20 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_reply, new_x) == 24 );
+C_ASSERT( FIELD_OFFSET(struct send_hardware_input_reply, new_y) == 28 );
+C_ASSERT( sizeof(struct send_hardware_input_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_message_request, flags) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_message_request, get_win) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_message_request, get_first) == 20 );
@@ -1572,7 +1587,8 @@ C_ASSERT( FIELD_OFFSET(struct get_message_reply, y) == 40 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, time) == 44 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, active_hooks) == 48 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, total) == 52 );
-C_ASSERT( sizeof(struct get_message_reply) == 56 );
+C_ASSERT( FIELD_OFFSET(struct get_message_reply, section) == 56 );
+C_ASSERT( sizeof(struct get_message_reply) == 64 );
 C_ASSERT( FIELD_OFFSET(struct reply_message_request, remove) == 12 );
 C_ASSERT( FIELD_OFFSET(struct reply_message_request, result) == 16 );
 C_ASSERT( sizeof(struct reply_message_request) == 24 );
@@ -1890,6 +1906,10 @@ C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_reply, handle) == 8 );
 C_ASSERT( sizeof(struct get_thread_desktop_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_thread_desktop_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_thread_desktop_request) == 16 );
+C_ASSERT( sizeof(struct get_desktop_shared_memory_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_desktop_shared_memory_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_desktop_shared_memory_reply, id) == 12 );
+C_ASSERT( sizeof(struct get_desktop_shared_memory_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_desktop_request, winstation) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_desktop_request, index) == 16 );
 C_ASSERT( sizeof(struct enum_desktop_request) == 24 );
@@ -204,6 +204,7 @@ static inline void init_thread_structure( struct thread *thread )
     thread->exit_poll       = NULL;
     thread->shm_fd          = -1;
     thread->shm             = NULL;
+    thread->shm_client      = NULL;
 
     thread->creation_time = current_time;
     thread->exit_time     = 0;
@@ -305,7 +306,7 @@ static void cleanup_thread( struct thread *thread )
             thread->inflight[i].client = thread->inflight[i].server = -1;
         }
     }
-    release_shared_memory( thread->shm_fd, thread->shm, sizeof(*thread->shm) );
+    release_shared_memory( thread->shm_fd, thread->shm, THREAD_SHM_SIZE );
 
     thread->req_data = NULL;
     thread->reply_data = NULL;
@@ -317,6 +318,7 @@ static void cleanup_thread( struct thread *thread )
     thread->desktop = 0;
     thread->shm_fd = -1;
     thread->shm = NULL;
+    thread->shm_client = NULL;
 
 }
 
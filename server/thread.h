@@ -91,8 +91,12 @@ struct thread
     struct timeout_user   *exit_poll;     /* poll if the thread/process has exited already */
     int                    shm_fd;        /* file descriptor for thread local shared memory */
     shmlocal_t            *shm;           /* thread local shared memory pointer */
+    shmclient_t           *shm_client;    /* part of the local shared memory written by the client */
 };
 
+/* size of the thread local shared memory, including the client block */
+#define THREAD_SHM_SIZE (SHM_CLIENT_OFFSET + sizeof(shmclient_t))
+
 struct thread_snapshot
 {
     struct thread  *thread;    /* thread ptr */
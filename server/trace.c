@@ -857,6 +857,21 @@ static void dump_varargs_rectangles( const char *prefix, data_size_t size )
     remove_data( size );
 }
 
+static void dump_varargs_hw_inputs( const char *prefix, data_size_t size )
+{
+    const hw_input_t *input = cur_data;
+    data_size_t len = size / sizeof(*input);
+
+    fprintf( stderr,"%s{", prefix );
+    while (len > 0)
+    {
+        dump_hw_input( "", input++ );
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_message_data( const char *prefix, data_size_t size )
 {
     /* FIXME: dump the structured data */
@@ -2766,6 +2781,8 @@ static void dump_send_message_request( const struct send_message_request *req )
     dump_uint64( ", wparam=", &req->wparam );
     dump_uint64( ", lparam=", &req->lparam );
     dump_timeout( ", timeout=", &req->timeout );
+    fprintf( stderr, ", section=%04x", req->section );
+    fprintf( stderr, ", section_size=%u", req->section_size );
     dump_varargs_message_data( ", data=", cur_size );
 }
 
@@ -2791,6 +2808,23 @@ static void dump_send_hardware_message_reply( const struct send_hardware_message
     dump_varargs_bytes( ", keystate=", cur_size );
 }
 
+static void dump_send_hardware_input_request( const struct send_hardware_input_request *req )
+{
+    fprintf( stderr, " flags=%08x", req->flags );
+    dump_varargs_hw_inputs( ", input=", cur_size );
+}
+
+static void dump_send_hardware_input_reply( const struct send_hardware_input_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    fprintf( stderr, ", wait=%d", req->wait );
+    fprintf( stderr, ", prev_x=%d", req->prev_x );
+    fprintf( stderr, ", prev_y=%d", req->prev_y );
+    fprintf( stderr, ", new_x=%d", req->new_x );
+    fprintf( stderr, ", new_y=%d", req->new_y );
+    dump_varargs_bytes( ", keystate=", cur_size );
+}
+
 static void dump_get_message_request( const struct get_message_request *req )
 {
     fprintf( stderr, " flags=%08x", req->flags );
@@ -2814,6 +2848,7 @@ static void dump_get_message_reply( const struct get_message_reply *req )
     fprintf( stderr, ", time=%08x", req->time );
     fprintf( stderr, ", active_hooks=%08x", req->active_hooks );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", section=%04x", req->section );
     dump_varargs_message_data( ", data=", cur_size );
 }
 
@@ -3458,6 +3493,16 @@ static void dump_set_thread_desktop_request( const struct set_thread_desktop_req
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_desktop_shared_memory_request( const struct get_desktop_shared_memory_request *req )
+{
+}
+
+static void dump_get_desktop_shared_memory_reply( const struct get_desktop_shared_memory_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", id=%08x", req->id );
+}
+
 static void dump_enum_desktop_request( const struct enum_desktop_request *req )
 {
     fprintf( stderr, " winstation=%04x", req->winstation );
@@ -4693,6 +4738,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_send_message_request,
     (dump_func)dump_post_quit_message_request,
     (dump_func)dump_send_hardware_message_request,
+    (dump_func)dump_send_hardware_input_request,
     (dump_func)dump_get_message_request,
     (dump_func)dump_reply_message_request,
     (dump_func)dump_accept_hardware_message_request,
@@ -4752,6 +4798,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_close_desktop_request,
     (dump_func)dump_get_thread_desktop_request,
     (dump_func)dump_set_thread_desktop_request,
+    (dump_func)dump_get_desktop_shared_memory_request,
     (dump_func)dump_enum_desktop_request,
     (dump_func)dump_set_user_object_info_request,
     (dump_func)dump_register_hotkey_request,
@@ -4992,6 +5039,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     NULL,
     (dump_func)dump_send_hardware_message_reply,
+    (dump_func)dump_send_hardware_input_reply,
     (dump_func)dump_get_message_reply,
     NULL,
     NULL,
@@ -5051,6 +5099,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_get_thread_desktop_reply,
     NULL,
+    (dump_func)dump_get_desktop_shared_memory_reply,
     (dump_func)dump_enum_desktop_reply,
     (dump_func)dump_set_user_object_info_reply,
     (dump_func)dump_register_hotkey_reply,
@@ -5291,6 +5340,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "send_message",
     "post_quit_message",
     "send_hardware_message",
+    "send_hardware_input",
     "get_message",
     "reply_message",
     "accept_hardware_message",
@@ -5350,6 +5400,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "close_desktop",
     "get_thread_desktop",
     "set_thread_desktop",
+    "get_desktop_shared_memory",
     "enum_desktop",
     "set_user_object_info",
     "register_hotkey",
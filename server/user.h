@@ -77,6 +77,10 @@ struct desktop
     unsigned int         users;            /* processes and threads using this desktop */
     struct global_cursor cursor;           /* global cursor information */
     unsigned char        keystate[256];    /* asynchronous key state */
+    struct object       *shm_mapping;      /* mapping of the shared memory block */
+    shmdesktop_t        *shm;              /* shared memory block, mapped in the server */
+    mem_size_t           shm_size;         /* size of the shared memory block */
+    unsigned int         shm_id;           /* unique id of the shared memory, kept when it grows */
 };
 
 /* user handles functions */
@@ -182,6 +186,7 @@ extern client_ptr_t get_class_client_ptr( struct window_class *class );
 extern struct desktop *get_desktop_obj( struct process *process, obj_handle_t handle, unsigned int access );
 extern struct winstation *get_process_winstation( struct process *process, unsigned int access );
 extern struct desktop *get_thread_desktop( struct thread *thread, unsigned int access );
+extern int grow_desktop_shared_memory( struct desktop *desktop, unsigned int count );
 extern void connect_process_winstation( struct process *process, struct thread *parent );
 extern void set_process_default_desktop( struct process *process, struct desktop *desktop,
                                          obj_handle_t handle );
@@ -38,6 +38,7 @@
 #include "process.h"
 #include "user.h"
 #include "unicode.h"
+#include "file.h"
 
 /* a window property */
 struct property
@@ -54,6 +55,8 @@ enum property_type
     PROP_TYPE_ATOM    /* plain atom */
 };
 
+#define PROP_HASH_THRESHOLD 16  /* number of allocated properties before we build a hash index */
+
 
 struct window
 {
@@ -81,6 +84,7 @@ struct window
     unsigned int     is_unicode : 1;  /* ANSI or unicode */
     unsigned int     is_linked : 1;   /* is it linked into the parent z-order list? */
     unsigned int     is_layered : 1;  /* has layered info been set? */
+    unsigned int     is_indexed : 1;  /* is it in the spatial index of its parent? */
     unsigned int     color_key;       /* color key for a layered window */
     unsigned int     alpha;           /* alpha value for a layered window */
     unsigned int     layered_flags;   /* flags for a layered window */
@@ -90,6 +94,13 @@ struct window
     int              prop_inuse;      /* number of in-use window properties */
     int              prop_alloc;      /* number of allocated window properties */
     struct property *properties;      /* window properties array */
+    int             *prop_hash;       /* hash index of the properties (index + 1, 0 if empty) */
+    unsigned int     prop_hash_size;  /* size of the hash index, a power of 2 */
+    unsigned int     prop_serial;     /* incremented when the properties change */
+    struct child_index *child_index;  /* spatial index of the children, built on demand */
+    rectangle_t      index_rect;      /* visible rect the window was indexed with */
+    unsigned int     zorder;          /* rank in the parent z-order list, valid while indexed */
+    unsigned int     index_stamp;     /* stamp of the last index query that visited this window */
     int              nb_extra_bytes;  /* number of extra bytes */
     char             extra_bytes[1];  /* extra bytes storage */
 };
@@ -139,6 +150,53 @@ static inline int is_desktop_window( const struct window *win )
     return !win->parent;  /* only desktop windows have no parent */
 }
 
+/* get the shared memory snapshot entry for a window, optionally growing the desktop block */
+static inline shmwindow_t *get_shared_window( const struct window *win, int grow )
+{
+    unsigned int index = ((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1;
+    struct desktop *desktop = win->desktop;
+
+    if (grow)
+    {
+        unsigned int error = get_error();  /* failing to grow the block is not fatal */
+        grow_desktop_shared_memory( desktop, index + 1 );
+        set_error( error );
+    }
+    if (!desktop->shm || index >= desktop->shm->window_count) return NULL;
+    return &desktop->shm->windows[index];
+}
+
+/* publish the current window state to the desktop shared memory block */
+static void update_shared_window( const struct window *win )
+{
+    shmwindow_t *shm = get_shared_window( win, 1 );
+
+    if (!shm) return;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );  /* readers retry while the counter is odd */
+    shm->handle   = win->handle;
+    shm->parent   = win->parent ? win->parent->handle : 0;
+    shm->owner    = win->owner;
+    shm->tid      = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->pid      = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->style    = win->style;
+    shm->ex_style = win->ex_style;
+    shm->window   = win->window_rect;
+    shm->client   = win->client_rect;
+    shm->prop_serial = win->prop_serial;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+}
+
+/* remove a window from the desktop shared memory block */
+static void clear_shared_window( const struct window *win )
+{
+    shmwindow_t *shm = get_shared_window( win, 0 );
+
+    if (!shm || shm->handle != win->handle) return;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    shm->handle = 0;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+}
+
 /* get next window in Z-order list */
 static inline struct window *get_next_window( struct window *win )
 {
@@ -175,6 +233,234 @@ static inline void update_pixel_format_flags( struct window *win )
         win->paint_flags |= PAINT_PIXEL_FORMAT_CHILD;
 }
 
+/* spatial index of the children of a window, used to speed up hit-testing and clipping */
+
+#define CHILD_INDEX_THRESHOLD  64   /* number of children walked before we bother building an index */
+#define CHILD_INDEX_CELL_SHIFT 7    /* cells are 128x128 pixels */
+#define CHILD_INDEX_BUCKETS    256  /* number of hash buckets, must be a power of 2 */
+#define CHILD_INDEX_MAX_CELLS  64   /* windows spanning more cells are kept in a separate list */
+
+struct child_index_cell
+{
+    struct list      entry;         /* entry in the hash bucket */
+    int              x;             /* cell coordinates */
+    int              y;
+    unsigned int     count;         /* number of windows overlapping the cell */
+    unsigned int     size;          /* allocated size of the windows array */
+    struct window  **windows;       /* windows overlapping the cell, in no particular order */
+};
+
+struct child_index
+{
+    struct list             buckets[CHILD_INDEX_BUCKETS]; /* hash table of cells */
+    struct child_index_cell large;                        /* windows spanning too many cells */
+    int                     zorder_valid;                 /* are the children z-order ranks up to date? */
+};
+
+static unsigned int child_index_stamp;  /* stamp used to skip duplicates in multi-cell queries */
+
+static inline unsigned int child_index_hash( int x, int y )
+{
+    return ((unsigned int)x * 0x9e3779b1 + (unsigned int)y) & (CHILD_INDEX_BUCKETS - 1);
+}
+
+/* get the range of cells covered by a rectangle, return 0 if the rectangle is empty */
+static inline int get_child_index_range( const rectangle_t *rect, int *x0, int *y0, int *x1, int *y1 )
+{
+    if (rect->left >= rect->right || rect->top >= rect->bottom) return 0;
+    *x0 = rect->left >> CHILD_INDEX_CELL_SHIFT;
+    *y0 = rect->top >> CHILD_INDEX_CELL_SHIFT;
+    *x1 = (rect->right - 1) >> CHILD_INDEX_CELL_SHIFT;
+    *y1 = (rect->bottom - 1) >> CHILD_INDEX_CELL_SHIFT;
+    return 1;
+}
+
+/* check if a cell range is too large to be stored in individual cells */
+static inline int is_large_child_index_range( int x0, int y0, int x1, int y1 )
+{
+    return (x1 - x0 >= CHILD_INDEX_MAX_CELLS || y1 - y0 >= CHILD_INDEX_MAX_CELLS ||
+            (x1 - x0 + 1) * (y1 - y0 + 1) > CHILD_INDEX_MAX_CELLS);
+}
+
+/* find a cell of the index, optionally creating it */
+static struct child_index_cell *get_child_index_cell( struct child_index *index, int x, int y, int create )
+{
+    struct list *bucket = &index->buckets[child_index_hash( x, y )];
+    struct child_index_cell *cell;
+
+    LIST_FOR_EACH_ENTRY( cell, bucket, struct child_index_cell, entry )
+        if (cell->x == x && cell->y == y) return cell;
+
+    if (!create || !(cell = malloc( sizeof(*cell) ))) return NULL;
+    cell->x = x;
+    cell->y = y;
+    cell->count = cell->size = 0;
+    cell->windows = NULL;
+    list_add_head( bucket, &cell->entry );
+    return cell;
+}
+
+static int add_child_index_cell_window( struct child_index_cell *cell, struct window *win )
+{
+    if (cell->count == cell->size)
+    {
+        unsigned int new_size = max( cell->size * 2, 8 );
+        struct window **new_windows = realloc( cell->windows, new_size * sizeof(*new_windows) );
+        if (!new_windows) return 0;
+        cell->windows = new_windows;
+        cell->size = new_size;
+    }
+    cell->windows[cell->count++] = win;
+    return 1;
+}
+
+static void remove_child_index_cell_window( struct child_index_cell *cell, struct window *win )
+{
+    unsigned int i;
+
+    for (i = 0; i < cell->count; i++)
+    {
+        if (cell->windows[i] != win) continue;
+        cell->windows[i] = cell->windows[--cell->count];
+        break;
+    }
+}
+
+/* free the spatial index of the children of a window */
+static void free_child_index( struct window *win )
+{
+    struct child_index *index = win->child_index;
+    struct child_index_cell *cell, *next;
+    struct window *child;
+    unsigned int i;
+
+    if (!index) return;
+    for (i = 0; i < CHILD_INDEX_BUCKETS; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( cell, next, &index->buckets[i], struct child_index_cell, entry )
+        {
+            free( cell->windows );
+            free( cell );
+        }
+    }
+    free( index->large.windows );
+    LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry ) child->is_indexed = 0;
+    free( index );
+    win->child_index = NULL;
+}
+
+/* add a window to the spatial index of its parent */
+static int index_child_window( struct window *parent, struct window *win )
+{
+    struct child_index *index = parent->child_index;
+    struct child_index_cell *cell;
+    int x, y, x0, y0, x1, y1;
+
+    win->index_rect = win->visible_rect;
+    win->is_indexed = 1;
+    if (!get_child_index_range( &win->index_rect, &x0, &y0, &x1, &y1 )) return 1;  /* can't be hit */
+    if (is_large_child_index_range( x0, y0, x1, y1 ))
+        return add_child_index_cell_window( &index->large, win );
+
+    for (y = y0; y <= y1; y++)
+        for (x = x0; x <= x1; x++)
+            if (!(cell = get_child_index_cell( index, x, y, 1 )) ||
+                !add_child_index_cell_window( cell, win )) return 0;
+    return 1;
+}
+
+/* remove a window from the spatial index of its parent */
+static void unindex_child_window( struct window *parent, struct window *win )
+{
+    struct child_index *index = parent->child_index;
+    struct child_index_cell *cell;
+    int x, y, x0, y0, x1, y1;
+
+    if (!win->is_indexed) return;
+    win->is_indexed = 0;
+    if (!get_child_index_range( &win->index_rect, &x0, &y0, &x1, &y1 )) return;
+    if (is_large_child_index_range( x0, y0, x1, y1 ))
+    {
+        remove_child_index_cell_window( &index->large, win );
+        return;
+    }
+
+    for (y = y0; y <= y1; y++)
+    {
+        for (x = x0; x <= x1; x++)
+        {
+            if (!(cell = get_child_index_cell( index, x, y, 0 ))) continue;
+            remove_child_index_cell_window( cell, win );
+            if (cell->count) continue;
+            list_remove( &cell->entry );
+            free( cell->windows );
+            free( cell );
+        }
+    }
+}
+
+/* build the spatial index of the children of a window */
+static void create_child_index( struct window *win )
+{
+    struct child_index *index;
+    struct window *child;
+    unsigned int i;
+
+    if (win->child_index || !(index = malloc( sizeof(*index) ))) return;
+    for (i = 0; i < CHILD_INDEX_BUCKETS; i++) list_init( &index->buckets[i] );
+    index->large.count = index->large.size = 0;
+    index->large.windows = NULL;
+    index->zorder_valid = 0;
+    win->child_index = index;
+
+    LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+    {
+        if (index_child_window( win, child )) continue;
+        free_child_index( win );
+        return;
+    }
+}
+
+/* the z-order of the children of a window has changed, the ranks have to be recomputed */
+static inline void invalidate_child_index_zorder( struct window *win )
+{
+    if (win->child_index) win->child_index->zorder_valid = 0;
+}
+
+/* update the index after a window has been linked into the z-order list of its parent */
+static void link_child_index( struct window *win )
+{
+    struct window *parent = win->parent;
+
+    if (!parent->child_index) return;
+    invalidate_child_index_zorder( parent );
+    if (!win->is_indexed && !index_child_window( parent, win )) free_child_index( parent );
+}
+
+/* update the index after the visible rectangle of a window has changed */
+static void reindex_child_window( struct window *win )
+{
+    struct window *parent = win->parent;
+
+    if (!win->is_indexed) return;
+    if (win->index_rect.left == win->visible_rect.left && win->index_rect.top == win->visible_rect.top &&
+        win->index_rect.right == win->visible_rect.right && win->index_rect.bottom == win->visible_rect.bottom)
+        return;
+    unindex_child_window( parent, win );
+    if (!index_child_window( parent, win )) free_child_index( parent );
+}
+
+/* recompute the z-order ranks of the children of an indexed window */
+static void update_child_index_zorder( struct window *win )
+{
+    struct window *child;
+    unsigned int rank = 0;
+
+    if (win->child_index->zorder_valid) return;
+    LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry ) child->zorder = rank++;
+    win->child_index->zorder_valid = 1;
+}
+
 /* link a window at the right place in the siblings list */
 static void link_window( struct window *win, struct window *previous )
 {
@@ -228,6 +514,8 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    link_child_index( win );
+    update_shared_window( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -245,6 +533,8 @@ static int set_parent_window( struct window *win, struct window *parent )
         }
     }
 
+    unindex_child_window( win->parent, win );
+
     if (parent)
     {
         win->parent = parent;
@@ -264,6 +554,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
     }
+    update_shared_window( win );
     return 1;
 }
 
@@ -287,6 +578,80 @@ static int add_handle_to_array( struct user_handle_array *array, user_handle_t h
     return 1;
 }
 
+/* hash a property atom into the window hash index */
+static inline unsigned int property_hash( const struct window *win, atom_t atom )
+{
+    return (atom * 0x9e3779b1) >> 16 & (win->prop_hash_size - 1);
+}
+
+/* add a property to the hash index */
+static void add_property_hash( struct window *win, int index )
+{
+    unsigned int pos = property_hash( win, win->properties[index].atom );
+
+    while (win->prop_hash[pos]) pos = (pos + 1) & (win->prop_hash_size - 1);
+    win->prop_hash[pos] = index + 1;
+}
+
+/* rebuild the property hash index after the properties array has been reallocated */
+static void rebuild_property_hash( struct window *win )
+{
+    unsigned int size = 16;
+    int i;
+
+    while (size < 2 * win->prop_alloc) size *= 2;
+    free( win->prop_hash );
+    win->prop_hash_size = 0;
+    /* without an index we simply fall back to a linear search */
+    if (!(win->prop_hash = calloc( size, sizeof(*win->prop_hash) ))) return;
+    win->prop_hash_size = size;
+
+    for (i = 0; i < win->prop_inuse; i++)
+        if (win->properties[i].type != PROP_TYPE_FREE) add_property_hash( win, i );
+}
+
+/* compact the properties array by removing the free entries */
+static void compact_properties( struct window *win )
+{
+    int i, count = 0;
+
+    for (i = 0; i < win->prop_inuse; i++)
+    {
+        if (win->properties[i].type == PROP_TYPE_FREE) continue;
+        win->properties[count++] = win->properties[i];
+    }
+    if (count == win->prop_inuse) return;
+    win->prop_inuse = count;
+    rebuild_property_hash( win );
+}
+
+/* find the index of a window property, or -1 if not found */
+static int find_property( struct window *win, atom_t atom )
+{
+    unsigned int pos, count;
+    int i;
+
+    if (win->prop_hash)
+    {
+        /* entries pointing to free properties are left in place as tombstones */
+        pos = property_hash( win, atom );
+        for (count = 0; count < win->prop_hash_size; count++, pos = (pos + 1) & (win->prop_hash_size - 1))
+        {
+            if (!(i = win->prop_hash[pos])) break;
+            if (win->properties[i - 1].type == PROP_TYPE_FREE) continue;
+            if (win->properties[i - 1].atom == atom) return i - 1;
+        }
+        return -1;
+    }
+
+    for (i = 0; i < win->prop_inuse; i++)
+    {
+        if (win->properties[i].type == PROP_TYPE_FREE) continue;
+        if (win->properties[i].atom == atom) return i;
+    }
+    return -1;
+}
+
 /* set a window property */
 static void set_property( struct window *win, atom_t atom, lparam_t data, enum property_type type )
 {
@@ -294,23 +659,27 @@ static void set_property( struct window *win, atom_t atom, lparam_t data, enum p
     struct property *new_props;
 
     /* check if it exists already */
-    for (i = 0; i < win->prop_inuse; i++)
+    if ((i = find_property( win, atom )) != -1)
     {
-        if (win->properties[i].type == PROP_TYPE_FREE)
-        {
-            free = i;
-            continue;
-        }
-        if (win->properties[i].atom == atom)
-        {
-            win->properties[i].type = type;
-            win->properties[i].data = data;
-            return;
-        }
+        win->properties[i].type = type;
+        win->properties[i].data = data;
+        win->prop_serial++;
+        update_shared_window( win );
+        return;
     }
 
     /* need to add an entry */
     if (!grab_global_atom( NULL, atom )) return;
+    if (win->prop_hash)
+    {
+        /* free entries can't be reused without rebuilding the index */
+        if (win->prop_inuse >= win->prop_alloc) compact_properties( win );
+    }
+    else
+    {
+        for (i = 0; i < win->prop_inuse; i++)
+            if (win->properties[i].type == PROP_TYPE_FREE) free = i;
+    }
     if (free == -1)
     {
         /* no free entry */
@@ -326,12 +695,16 @@ static void set_property( struct window *win, atom_t atom, lparam_t data, enum p
             }
             win->prop_alloc += 16;
             win->properties = new_props;
+            if (win->prop_alloc > PROP_HASH_THRESHOLD) rebuild_property_hash( win );
         }
         free = win->prop_inuse++;
     }
     win->properties[free].atom = atom;
     win->properties[free].type = type;
     win->properties[free].data = data;
+    if (win->prop_hash) add_property_hash( win, free );
+    win->prop_serial++;
+    update_shared_window( win );
 }
 
 /* remove a window property */
@@ -339,15 +712,13 @@ static lparam_t remove_property( struct window *win, atom_t atom )
 {
     int i;
 
-    for (i = 0; i < win->prop_inuse; i++)
+    if ((i = find_property( win, atom )) != -1)
     {
-        if (win->properties[i].type == PROP_TYPE_FREE) continue;
-        if (win->properties[i].atom == atom)
-        {
-            release_global_atom( NULL, atom );
-            win->properties[i].type = PROP_TYPE_FREE;
-            return win->properties[i].data;
-        }
+        release_global_atom( NULL, atom );
+        win->properties[i].type = PROP_TYPE_FREE;
+        win->prop_serial++;
+        update_shared_window( win );
+        return win->properties[i].data;
     }
     /* FIXME: last error? */
     return 0;
@@ -358,11 +729,7 @@ static lparam_t get_property( struct window *win, atom_t atom )
 {
     int i;
 
-    for (i = 0; i < win->prop_inuse; i++)
-    {
-        if (win->properties[i].type == PROP_TYPE_FREE) continue;
-        if (win->properties[i].atom == atom) return win->properties[i].data;
-    }
+    if ((i = find_property( win, atom )) != -1) return win->properties[i].data;
     /* FIXME: last error? */
     return 0;
 }
@@ -379,6 +746,7 @@ static inline void destroy_properties( struct window *win )
         release_global_atom( NULL, win->properties[i].atom );
     }
     free( win->properties );
+    free( win->prop_hash );
 }
 
 /* detach a window from its owner thread but keep the window around */
@@ -402,6 +770,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_shared_window( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -487,12 +856,19 @@ static struct window *create_window( struct window *parent, struct window *owner
     win->is_unicode     = 1;
     win->is_linked      = 0;
     win->is_layered     = 0;
+    win->is_indexed     = 0;
     win->user_data      = 0;
     win->text           = NULL;
     win->paint_flags    = 0;
     win->prop_inuse     = 0;
     win->prop_alloc     = 0;
     win->properties     = NULL;
+    win->prop_hash      = NULL;
+    win->prop_hash_size = 0;
+    win->prop_serial    = 0;
+    win->child_index    = NULL;
+    win->zorder         = 0;
+    win->index_stamp    = 0;
     win->nb_extra_bytes = extra_bytes;
     win->window_rect = win->visible_rect = win->client_rect = empty_rect;
     memset( win->extra_bytes, 0, extra_bytes );
@@ -529,6 +905,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_shared_window( win );
     return win;
 
 failed:
@@ -684,15 +1061,55 @@ static unsigned int get_children_windows( struct window *parent, atom_t atom, th
     return count;
 }
 
-/* find child of 'parent' that contains the given point (in parent-relative coords) */
-static struct window *child_window_from_point( struct window *parent, int x, int y )
+/* find the topmost window of an index cell containing the point, above 'best' in z-order */
+static struct window *child_index_cell_from_point( struct child_index_cell *cell, struct window *best,
+                                                   int x, int y )
 {
-    struct window *ptr;
+    unsigned int i;
+
+    for (i = 0; i < cell->count; i++)
+    {
+        struct window *ptr = cell->windows[i];
+        if (best && ptr->zorder >= best->zorder) continue;
+        if (is_point_in_window( ptr, x, y )) best = ptr;
+    }
+    return best;
+}
+
+/* find the topmost direct child of 'parent' that contains the given point */
+static struct window *get_child_from_point( struct window *parent, int x, int y )
+{
+    struct child_index_cell *cell;
+    struct window *ptr, *ret = NULL;
+    unsigned int count = 0;
+
+    if (parent->child_index)
+    {
+        update_child_index_zorder( parent );
+        cell = get_child_index_cell( parent->child_index, x >> CHILD_INDEX_CELL_SHIFT,
+                                     y >> CHILD_INDEX_CELL_SHIFT, 0 );
+        if (cell) ret = child_index_cell_from_point( cell, ret, x, y );
+        return child_index_cell_from_point( &parent->child_index->large, ret, x, y );
+    }
 
     LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
     {
+        count++;
         if (!is_point_in_window( ptr, x, y )) continue;  /* skip it */
+        ret = ptr;
+        break;
+    }
+    if (count >= CHILD_INDEX_THRESHOLD) create_child_index( parent );
+    return ret;
+}
+
+/* find child of 'parent' that contains the given point (in parent-relative coords) */
+static struct window *child_window_from_point( struct window *parent, int x, int y )
+{
+    struct window *ptr;
 
+    if ((ptr = get_child_from_point( parent, x, y )))
+    {
         /* if window is minimized or disabled, return at once */
         if (ptr->style & (WS_MINIMIZE|WS_DISABLED)) return ptr;
 
@@ -706,29 +1123,81 @@ static struct window *child_window_from_point( struct window *parent, int x, int
     return parent;  /* not found any child */
 }
 
+static int get_window_children_from_point( struct window *parent, int x, int y,
+                                           struct user_handle_array *array );
+
+/* add a window containing the given point and its children to the array */
+static int add_window_from_point( struct window *win, int x, int y, struct user_handle_array *array )
+{
+    /* if point is in client area, and window is not minimized or disabled, check children */
+    if (!(win->style & (WS_MINIMIZE|WS_DISABLED)) &&
+        x >= win->client_rect.left && x < win->client_rect.right &&
+        y >= win->client_rect.top && y < win->client_rect.bottom)
+    {
+        if (!get_window_children_from_point( win, x - win->client_rect.left,
+                                             y - win->client_rect.top, array ))
+            return 0;
+    }
+
+    /* now add window to the array */
+    return add_handle_to_array( array, win->handle );
+}
+
+/* collect the windows of an index cell containing the point, sorted in z-order */
+static unsigned int child_index_cell_all_from_point( struct child_index_cell *cell, int x, int y,
+                                                     struct window **windows, unsigned int count,
+                                                     unsigned int max_count )
+{
+    unsigned int i, pos;
+
+    for (i = 0; i < cell->count; i++)
+    {
+        struct window *ptr = cell->windows[i];
+        if (!is_point_in_window( ptr, x, y )) continue;
+        if (count == max_count) return max_count + 1;
+        for (pos = count++; pos > 0 && windows[pos - 1]->zorder > ptr->zorder; pos--)
+            windows[pos] = windows[pos - 1];
+        windows[pos] = ptr;
+    }
+    return count;
+}
+
 /* find all children of 'parent' that contain the given point */
 static int get_window_children_from_point( struct window *parent, int x, int y,
                                            struct user_handle_array *array )
 {
     struct window *ptr;
+    unsigned int count = 0;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    if (parent->child_index)
     {
-        if (!is_point_in_window( ptr, x, y )) continue;  /* skip it */
+        struct window *windows[64];
+        struct child_index_cell *cell;
+        unsigned int i, max_count = sizeof(windows) / sizeof(windows[0]);
 
-        /* if point is in client area, and window is not minimized or disabled, check children */
-        if (!(ptr->style & (WS_MINIMIZE|WS_DISABLED)) &&
-            x >= ptr->client_rect.left && x < ptr->client_rect.right &&
-            y >= ptr->client_rect.top && y < ptr->client_rect.bottom)
+        update_child_index_zorder( parent );
+        cell = get_child_index_cell( parent->child_index, x >> CHILD_INDEX_CELL_SHIFT,
+                                     y >> CHILD_INDEX_CELL_SHIFT, 0 );
+        if (cell) count = child_index_cell_all_from_point( cell, x, y, windows, count, max_count );
+        if (count <= max_count)
+            count = child_index_cell_all_from_point( &parent->child_index->large, x, y,
+                                                     windows, count, max_count );
+        if (count <= max_count)
         {
-            if (!get_window_children_from_point( ptr, x - ptr->client_rect.left,
-                                                 y - ptr->client_rect.top, array ))
-                return 0;
+            for (i = 0; i < count; i++)
+                if (!add_window_from_point( windows[i], x, y, array )) return 0;
+            return 1;
         }
+        count = 0;  /* too many overlapping windows, walk the list instead */
+    }
 
-        /* now add window to the array */
-        if (!add_handle_to_array( array, ptr->handle )) return 0;
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        count++;
+        if (!is_point_in_window( ptr, x, y )) continue;  /* skip it */
+        if (!add_window_from_point( ptr, x, y, array )) return 0;
     }
+    if (count >= CHILD_INDEX_THRESHOLD) create_child_index( parent );
     return 1;
 }
 
@@ -739,11 +1208,7 @@ user_handle_t shallow_window_from_point( struct desktop *desktop, int x, int y )
 
     if (!desktop->top_window) return 0;
 
-    LIST_FOR_EACH_ENTRY( ptr, &desktop->top_window->children, struct window, entry )
-    {
-        if (!is_point_in_window( ptr, x, y )) continue;  /* skip it */
-        return ptr->handle;
-    }
+    if ((ptr = get_child_from_point( desktop->top_window, x, y ))) return ptr->handle;
     return desktop->top_window->handle;
 }
 
@@ -927,35 +1392,97 @@ static inline void map_win_region_to_screen( struct window *win, struct region *
 }
 
 
+/* clip a single child window out of the visible region */
+static struct region *clip_child_window( struct window *ptr, struct region *region, struct region *tmp,
+                                         int offset_x, int offset_y )
+{
+    if (!(ptr->style & WS_VISIBLE)) return region;
+    if (ptr->ex_style & WS_EX_TRANSPARENT) return region;
+    set_region_rect( tmp, &ptr->visible_rect );
+    if (ptr->win_region && !intersect_window_region( tmp, ptr )) return NULL;
+    if (ptr->layer_region && !intersect_layer_region( tmp, ptr )) return NULL;
+    offset_region( tmp, offset_x, offset_y );
+    return subtract_region( region, region, tmp );
+}
+
+/* clip the windows of an index cell that are above 'limit' in z-order out of the visible region */
+static struct region *clip_child_index_cell( struct child_index_cell *cell, unsigned int limit,
+                                             struct region *region, struct region *tmp,
+                                             int offset_x, int offset_y )
+{
+    unsigned int i;
+
+    for (i = 0; i < cell->count; i++)
+    {
+        struct window *ptr = cell->windows[i];
+        if (ptr->index_stamp == child_index_stamp) continue;  /* already clipped */
+        ptr->index_stamp = child_index_stamp;
+        if (ptr->zorder >= limit) continue;
+        if (!(region = clip_child_window( ptr, region, tmp, offset_x, offset_y ))) break;
+        if (is_region_empty( region )) break;
+    }
+    return region;
+}
+
+/* clip the children overlapping the region using the spatial index, return 0 if it can't be used */
+static int clip_indexed_children( struct window *parent, struct window *last, struct region **region,
+                                  struct region *tmp, int offset_x, int offset_y )
+{
+    struct child_index_cell *cell;
+    unsigned int limit = ~0u;
+    rectangle_t rect;
+    int x, y, x0, y0, x1, y1;
+
+    get_region_extents( *region, &rect );
+    rect.left   -= offset_x;
+    rect.right  -= offset_x;
+    rect.top    -= offset_y;
+    rect.bottom -= offset_y;
+    if (!get_child_index_range( &rect, &x0, &y0, &x1, &y1 )) return 1;  /* empty region */
+    if (x1 - x0 >= 4 * CHILD_INDEX_MAX_CELLS || y1 - y0 >= 4 * CHILD_INDEX_MAX_CELLS ||
+        (x1 - x0 + 1) * (y1 - y0 + 1) > 4 * CHILD_INDEX_MAX_CELLS)
+        return 0;
+
+    update_child_index_zorder( parent );
+    if (last && last->is_linked) limit = last->zorder;
+    child_index_stamp++;
+
+    *region = clip_child_index_cell( &parent->child_index->large, limit, *region, tmp, offset_x, offset_y );
+    for (y = y0; y <= y1 && *region && !is_region_empty( *region ); y++)
+    {
+        for (x = x0; x <= x1 && *region && !is_region_empty( *region ); x++)
+        {
+            if (!(cell = get_child_index_cell( parent->child_index, x, y, 0 ))) continue;
+            *region = clip_child_index_cell( cell, limit, *region, tmp, offset_x, offset_y );
+        }
+    }
+    return 1;
+}
+
 /* clip all children of a given window out of the visible region */
 static struct region *clip_children( struct window *parent, struct window *last,
                                      struct region *region, int offset_x, int offset_y )
 {
     struct window *ptr;
     struct region *tmp = create_empty_region();
+    unsigned int count = 0;
 
     if (!tmp) return NULL;
+    if (parent->child_index && clip_indexed_children( parent, last, &region, tmp, offset_x, offset_y ))
+    {
+        free_region( tmp );
+        return region;
+    }
+
     LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
     {
         if (ptr == last) break;
-        if (!(ptr->style & WS_VISIBLE)) continue;
-        if (ptr->ex_style & WS_EX_TRANSPARENT) continue;
-        set_region_rect( tmp, &ptr->visible_rect );
-        if (ptr->win_region && !intersect_window_region( tmp, ptr ))
-        {
-            free_region( tmp );
-            return NULL;
-        }
-        if (ptr->layer_region && !intersect_layer_region( tmp, ptr ))
-        {
-            free_region( tmp );
-            return NULL;
-        }
-        offset_region( tmp, offset_x, offset_y );
-        if (!(region = subtract_region( region, region, tmp ))) break;
+        count++;
+        if (!(region = clip_child_window( ptr, region, tmp, offset_x, offset_y ))) break;
         if (is_region_empty( region )) break;
     }
     free_region( tmp );
+    if (count >= CHILD_INDEX_THRESHOLD) create_child_index( parent );
     return region;
 }
 
@@ -1684,6 +2211,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     win->visible_rect = *visible_rect;
     win->client_rect  = *client_rect;
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
+    if (win->parent) reindex_child_window( win );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
 
@@ -1699,8 +2227,11 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->window_rect, new_size - old_size, 0 );
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            reindex_child_window( child );
+            update_shared_window( child );
         }
     }
+    update_shared_window( win );
 
     /* reset cursor clip rectangle when the desktop changes size */
     if (win == win->desktop->top_window) win->desktop->cursor.clip = *window_rect;
@@ -1895,6 +2426,8 @@ void destroy_window( struct window *win )
     cleanup_clipboard_window( win->desktop, win->handle );
     free_user_handle( win->handle );
     destroy_properties( win );
+    free_child_index( win );
+    if (win->parent) unindex_child_window( win->parent, win );
     list_remove( &win->entry );
     if (is_desktop_window(win))
     {
@@ -1909,6 +2442,7 @@ void destroy_window( struct window *win )
     }
 
     detach_window_thread( win );
+    clear_shared_window( win );
     if (win->win_region) free_region( win->win_region );
     if (win->layer_region) free_region( win->layer_region );
     if (win->update_region) free_region( win->update_region );
@@ -2005,6 +2539,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_shared_window( desktop->top_window );
         }
     }
 
@@ -2017,6 +2552,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_shared_window( desktop->msg_window );
         }
     }
 
@@ -2052,6 +2588,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_shared_window( win );
 }
 
 
@@ -2125,6 +2662,8 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
 
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE)) update_shared_window( win );
+
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
 }
@@ -2701,6 +3240,7 @@ DECL_HANDLER(update_window_zorder)
         {
             list_remove( &win->entry );
             list_add_before( &ptr->entry, &win->entry );
+            invalidate_child_index_zorder( win->parent );
         }
         break;
     }
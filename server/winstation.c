@@ -23,6 +23,9 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -252,6 +255,10 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
             desktop->users = 0;
             memset( &desktop->cursor, 0, sizeof(desktop->cursor) );
             memset( desktop->keystate, 0, sizeof(desktop->keystate) );
+            desktop->shm_mapping = NULL;
+            desktop->shm = NULL;
+            desktop->shm_size = 0;
+            desktop->shm_id = 0;
             list_add_tail( &winstation->desktops, &desktop->entry );
             list_init( &desktop->hotkeys );
         }
@@ -353,6 +360,11 @@ static void desktop_destroy( struct object *obj )
     if (desktop->msg_window) destroy_window( desktop->msg_window );
     if (desktop->global_hooks) release_object( desktop->global_hooks );
     if (desktop->close_timeout) remove_timeout_user( desktop->close_timeout );
+    if (desktop->shm_mapping)
+    {
+        munmap( desktop->shm, desktop->shm_size );
+        release_object( desktop->shm_mapping );
+    }
     list_remove( &desktop->entry );
     release_object( desktop->winstation );
 }
@@ -374,6 +386,43 @@ struct desktop *get_thread_desktop( struct thread *thread, unsigned int access )
     return get_desktop_obj( thread->process, thread->desktop, access );
 }
 
+/* make sure the desktop shared memory block can hold at least count windows */
+int grow_desktop_shared_memory( struct desktop *desktop, unsigned int count )
+{
+    static const unsigned int max_count = (LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1;
+    static unsigned int last_id;
+    struct object *mapping;
+    shmdesktop_t *shm;
+    mem_size_t size;
+
+    if (!shmglobal) return 0;
+    if (desktop->shm && count <= desktop->shm->window_count) return 1;
+    if (count > max_count) return 0;
+
+    if (desktop->shm) count = max( count, desktop->shm->window_count * 2 );
+    count = min( max( count, 64 ), max_count );
+    size = offsetof( shmdesktop_t, windows[count] );
+    size = (size + get_page_size() - 1) & ~((mem_size_t)get_page_size() - 1);
+
+    if (!(mapping = create_shared_mapping( size, (void **)&shm ))) return 0;
+    shm->window_count = min( (size - offsetof( shmdesktop_t, windows )) / sizeof(shmwindow_t), max_count );
+
+    if (desktop->shm)
+    {
+        /* clients still holding the old block notice the flag and remap */
+        memcpy( shm->windows, desktop->shm->windows,
+                desktop->shm->window_count * sizeof(shmwindow_t) );
+        desktop->shm->retired = 1;
+        munmap( desktop->shm, desktop->shm_size );
+        release_object( desktop->shm_mapping );
+    }
+    desktop->shm_mapping = mapping;
+    desktop->shm         = shm;
+    desktop->shm_size    = size;
+    if (!desktop->shm_id) desktop->shm_id = ++last_id;
+    return 1;
+}
+
 /* set the process default desktop handle */
 void set_process_default_desktop( struct process *process, struct desktop *desktop,
                                   obj_handle_t handle )
@@ -657,6 +706,29 @@ DECL_HANDLER(set_thread_desktop)
 }
 
 
+/* get a mapping of the shared memory block of the thread desktop */
+DECL_HANDLER(get_desktop_shared_memory)
+{
+    struct desktop *desktop;
+
+    if (!shmglobal)
+    {
+        set_error( STATUS_NOT_SUPPORTED );
+        return;
+    }
+    if (!(desktop = get_thread_desktop( current, 0 ))) return;
+
+    if (grow_desktop_shared_memory( desktop, 0 ))
+    {
+        reply->handle = alloc_handle( current->process, desktop->shm_mapping,
+                                      SECTION_MAP_READ | SECTION_QUERY, 0 );
+        reply->id     = desktop->shm_id;
+    }
+    else if (!get_error()) set_error( STATUS_NO_MEMORY );
+    release_object( desktop );
+}
+
+
 /* get/set information about a user object (window station or desktop) */
 DECL_HANDLER(set_user_object_info)
 {